@@ -0,0 +1,532 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.asset_cache_server/asset_cache_server_app.h"
+#include "workshop.assets/caches/asset_cache_socket_transport.h"
+#include "workshop.core/filesystem/file.h"
+#include "workshop.core/filesystem/disk_stream.h"
+#include "workshop.core/filesystem/virtual_file_system_disk_handler.h"
+#include "workshop.core/hashing/guid.h"
+#include "workshop.core/containers/string.h"
+#include "workshop.core/utils/time.h"
+#include "workshop.core/debug/debug.h"
+
+std::shared_ptr<ws::app> make_app()
+{
+    return std::make_shared<ws::asset_cache_server_app>();
+}
+
+namespace ws {
+
+using protocol = asset_cache_socket_transport;
+
+std::string asset_cache_server_app::get_name()
+{
+    return "asset_cache_server";
+}
+
+result<void> asset_cache_server_app::parse_command_line()
+{
+    const std::vector<std::string>& args = get_command_line();
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        const std::string& arg = args[i];
+        bool has_value = (i + 1 < args.size());
+
+        if (arg == "-socket" && has_value)
+        {
+            m_socket_path = args[++i];
+        }
+        else if (arg == "-benchmark")
+        {
+            m_benchmark = true;
+        }
+        else if (m_storage_directory.empty())
+        {
+            m_storage_directory = arg;
+        }
+        else
+        {
+            db_error(core, "Unknown argument: %s", arg.c_str());
+            return standard_errors::invalid_parameter;
+        }
+    }
+
+    if (!m_benchmark && m_storage_directory.empty())
+    {
+        db_error(core, "Usage: workshop.asset_cache_server <storage directory> [-socket <path>]");
+        db_error(core, "       workshop.asset_cache_server -benchmark [-socket <path>]");
+        return standard_errors::invalid_parameter;
+    }
+
+    return true;
+}
+
+result<void> asset_cache_server_app::start()
+{
+    if (result<void> ret = parse_command_line(); !ret)
+    {
+        return ret;
+    }
+
+    if (m_benchmark)
+    {
+        // Entries are fetched through the virtual file system, as the engine does, into a scratch directory.
+        m_benchmark_directory = std::filesystem::temp_directory_path() / string_format("workshop_asset_cache_benchmark_%s", to_string(guid::generate()).c_str());
+        std::filesystem::create_directories(m_benchmark_directory);
+
+        m_filesystem = std::make_unique<virtual_file_system>();
+        m_filesystem->register_handler("temp", 0, std::make_unique<virtual_file_system_disk_handler>(m_benchmark_directory.string().c_str(), false));
+
+        return true;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(m_storage_directory, error);
+    if (!std::filesystem::is_directory(m_storage_directory))
+    {
+        db_error(core, "Failed to create storage directory: %s", m_storage_directory.string().c_str());
+        return standard_errors::failed;
+    }
+
+    scan_storage();
+
+    m_listen_socket = local_socket::listen(m_socket_path);
+    if (!m_listen_socket)
+    {
+        return standard_errors::failed;
+    }
+
+    db_log(core, "Serving %zi cached assets from '%s' on socket: %s", m_entries.size(), m_storage_directory.string().c_str(), m_socket_path.string().c_str());
+
+    return true;
+}
+
+result<void> asset_cache_server_app::stop()
+{
+    if (m_listen_socket)
+    {
+        m_listen_socket->shutdown();
+    }
+
+    {
+        std::scoped_lock lock(m_clients_mutex);
+        for (std::unique_ptr<local_socket>& connection : m_client_connections)
+        {
+            connection->shutdown();
+        }
+    }
+
+    for (std::thread& thread : m_client_threads)
+    {
+        thread.join();
+    }
+
+    m_client_threads.clear();
+    m_client_connections.clear();
+    m_listen_socket = nullptr;
+
+    if (m_filesystem)
+    {
+        m_filesystem = nullptr;
+
+        std::error_code error;
+        std::filesystem::remove_all(m_benchmark_directory, error);
+    }
+
+    return true;
+}
+
+result<void> asset_cache_server_app::loop()
+{
+    if (m_benchmark)
+    {
+        return run_benchmark();
+    }
+
+    while (!is_quitting())
+    {
+        std::unique_ptr<local_socket> connection = m_listen_socket->accept();
+        if (!connection)
+        {
+            break;
+        }
+
+        std::scoped_lock lock(m_clients_mutex);
+
+        local_socket* connection_ptr = connection.get();
+        m_client_connections.push_back(std::move(connection));
+        m_client_threads.emplace_back([this, connection_ptr]() {
+            serve_client(connection_ptr);
+        });
+    }
+
+    return true;
+}
+
+void asset_cache_server_app::scan_storage()
+{
+    std::error_code error;
+    std::filesystem::recursive_directory_iterator iter(m_storage_directory, error);
+    std::filesystem::recursive_directory_iterator end;
+
+    for (; !error && iter != end; iter.increment(error))
+    {
+        if (!iter->is_regular_file())
+        {
+            continue;
+        }
+
+        std::string key = iter->path().filename().string();
+
+        // Remove anything left behind by publishes that were interrupted, temporary files
+        // are named so they are never valid keys.
+        if (!is_valid_key(key))
+        {
+            std::error_code remove_error;
+            std::filesystem::remove(iter->path(), remove_error);
+            continue;
+        }
+
+        disk_stream stream;
+        double compile_time = 0.0;
+
+        if (!stream.open(iter->path(), false) ||
+            stream.length() < sizeof(compile_time) ||
+            stream.read(reinterpret_cast<char*>(&compile_time), sizeof(compile_time)) != sizeof(compile_time))
+        {
+            continue;
+        }
+
+        entry& new_entry = m_entries[key];
+        new_entry.size = stream.length() - sizeof(compile_time);
+        new_entry.compile_time = compile_time;
+    }
+}
+
+bool asset_cache_server_app::is_valid_key(const std::string& key)
+{
+    if (key.empty() || key.size() > protocol::k_max_key_length)
+    {
+        return false;
+    }
+
+    if (key[0] == '.')
+    {
+        return false;
+    }
+
+    for (char c : key)
+    {
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-' && c != '.')
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::filesystem::path asset_cache_server_app::get_entry_path(const std::string& key)
+{
+    // Split into directories by the first characters to avoid one massive directory.
+    return m_storage_directory / key.substr(0, 2) / key;
+}
+
+void asset_cache_server_app::serve_client(local_socket* connection)
+{
+    db_set_thread_name("asset cache client");
+
+    while (true)
+    {
+        protocol::request_header header;
+        if (!connection->receive(&header, sizeof(header)) ||
+            header.magic != protocol::k_magic ||
+            header.key_length > protocol::k_max_key_length)
+        {
+            break;
+        }
+
+        std::string key(header.key_length, '\0');
+        if (!connection->receive(key.data(), key.size()))
+        {
+            break;
+        }
+
+        bool success = false;
+        switch (header.request)
+        {
+        case protocol::command::fetch:
+            {
+                success = serve_fetch(*connection, key);
+                break;
+            }
+        case protocol::command::publish:
+            {
+                success = serve_publish(*connection, key, header.data_size, header.compile_time);
+                break;
+            }
+        case protocol::command::list:
+            {
+                success = serve_list(*connection);
+                break;
+            }
+        }
+
+        if (!success)
+        {
+            break;
+        }
+    }
+
+    connection->shutdown();
+}
+
+bool asset_cache_server_app::serve_fetch(local_socket& connection, const std::string& key)
+{
+    protocol::response_header response;
+    response.magic = protocol::k_magic;
+    response.result = protocol::status::not_found;
+    response.data_size = 0;
+    response.compile_time = 0.0;
+
+    disk_stream stream;
+    bool found = false;
+    {
+        std::scoped_lock lock(m_entries_mutex);
+        if (auto iter = m_entries.find(key); iter != m_entries.end())
+        {
+            response.data_size = iter->second.size;
+            response.compile_time = iter->second.compile_time;
+            found = true;
+        }
+    }
+
+    // Entries are never modified once written, so the file can be read without holding the lock.
+    if (found && stream.open(get_entry_path(key), false) && stream.length() == response.data_size + sizeof(double))
+    {
+        response.result = protocol::status::ok;
+        stream.seek(sizeof(double));
+    }
+    else
+    {
+        response.data_size = 0;
+    }
+
+    if (!connection.send(&response, sizeof(response)))
+    {
+        return false;
+    }
+
+    std::vector<char> buffer(std::min(static_cast<size_t>(response.data_size), protocol::k_chunk_size));
+    for (uint64_t remaining = response.data_size; remaining > 0; )
+    {
+        size_t chunk = static_cast<size_t>(std::min(remaining, static_cast<uint64_t>(buffer.size())));
+
+        // If the read fails we have no way to tell the client, so drop the connection.
+        if (stream.read(buffer.data(), chunk) != chunk ||
+            !connection.send(buffer.data(), chunk))
+        {
+            return false;
+        }
+
+        remaining -= chunk;
+    }
+
+    return true;
+}
+
+bool asset_cache_server_app::serve_publish(local_socket& connection, const std::string& key, uint64_t data_size, double compile_time)
+{
+    bool valid = is_valid_key(key);
+    bool exists = false;
+    {
+        std::scoped_lock lock(m_entries_mutex);
+        exists = m_entries.contains(key);
+    }
+
+    // Write to a temporary file and rename it into place once complete, so nothing
+    // sees a partially written entry.
+    std::filesystem::path path = get_entry_path(key);
+    std::filesystem::path tmp_path = path.parent_path() / string_format("~tmp_%s", to_string(guid::generate()).c_str());
+
+    disk_stream stream;
+    bool opened = false;
+    bool writing = false;
+
+    if (valid && !exists)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+
+        opened = static_cast<bool>(stream.open(tmp_path, true));
+        writing = opened && stream.write(reinterpret_cast<const char*>(&compile_time), sizeof(compile_time)) == sizeof(compile_time);
+    }
+
+    // Always consume the data, even if we aren't storing it, to keep the connection in sync.
+    std::vector<char> buffer(std::min(static_cast<size_t>(data_size), protocol::k_chunk_size));
+    for (uint64_t remaining = data_size; remaining > 0; )
+    {
+        size_t chunk = static_cast<size_t>(std::min(remaining, static_cast<uint64_t>(buffer.size())));
+        if (!connection.receive(buffer.data(), chunk))
+        {
+            if (opened)
+            {
+                stream.close();
+
+                std::error_code error;
+                std::filesystem::remove(tmp_path, error);
+            }
+            return false;
+        }
+
+        if (writing && stream.write(buffer.data(), chunk) != chunk)
+        {
+            writing = false;
+        }
+
+        remaining -= chunk;
+    }
+
+    if (opened)
+    {
+        stream.close();
+    }
+
+    protocol::status result = protocol::status::ok;
+    if (!valid)
+    {
+        result = protocol::status::failed;
+    }
+    else if (!exists)
+    {
+        std::error_code error;
+        if (writing)
+        {
+            std::filesystem::rename(tmp_path, path, error);
+        }
+
+        if (!writing || error)
+        {
+            std::filesystem::remove(tmp_path, error);
+            result = protocol::status::failed;
+        }
+        else
+        {
+            std::scoped_lock lock(m_entries_mutex);
+
+            entry& new_entry = m_entries[key];
+            new_entry.size = static_cast<size_t>(data_size);
+            new_entry.compile_time = compile_time;
+        }
+    }
+
+    protocol::response_header response;
+    response.magic = protocol::k_magic;
+    response.result = result;
+    response.data_size = 0;
+    response.compile_time = 0.0;
+
+    return connection.send(&response, sizeof(response));
+}
+
+bool asset_cache_server_app::serve_list(local_socket& connection)
+{
+    std::vector<std::pair<std::string, entry>> entries;
+    {
+        std::scoped_lock lock(m_entries_mutex);
+        entries.assign(m_entries.begin(), m_entries.end());
+    }
+
+    protocol::response_header response;
+    response.magic = protocol::k_magic;
+    response.result = protocol::status::ok;
+    response.data_size = entries.size();
+    response.compile_time = 0.0;
+
+    if (!connection.send(&response, sizeof(response)))
+    {
+        return false;
+    }
+
+    for (auto& [key, value] : entries)
+    {
+        protocol::list_entry header;
+        header.key_length = static_cast<uint32_t>(key.size());
+        header.size = value.size;
+        header.compile_time = value.compile_time;
+
+        if (!connection.send(&header, sizeof(header)) ||
+            !connection.send(key.data(), key.size()))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+result<void> asset_cache_server_app::run_benchmark()
+{
+    asset_cache_socket_transport transport(m_socket_path);
+
+    std::vector<asset_cache_transport::entry> entries;
+    if (!transport.list(entries))
+    {
+        db_error(core, "Failed to list entries in shared asset cache, is the daemon running on '%s'?", m_socket_path.string().c_str());
+        return standard_errors::failed;
+    }
+
+    db_log(core, "Fetching %zi entries from shared asset cache.", entries.size());
+
+    size_t total_bytes = 0;
+    size_t fetched_count = 0;
+    size_t unknown_compile_time_count = 0;
+    double total_compile_time = 0.0;
+
+    double start_time = get_seconds();
+
+    for (asset_cache_transport::entry& entry : entries)
+    {
+        std::string output_path = string_format("temp:%s", entry.key.c_str());
+
+        double compile_time = 0.0;
+        if (!transport.fetch(entry.key, output_path.c_str(), compile_time))
+        {
+            db_warning(core, "Failed to fetch entry: %s", entry.key.c_str());
+            continue;
+        }
+
+        // Don't let the scratch directory grow to the size of the entire cache.
+        virtual_file_system::get().remove(output_path.c_str());
+
+        fetched_count++;
+        total_bytes += entry.size;
+        total_compile_time += compile_time;
+
+        if (compile_time <= 0.0)
+        {
+            unknown_compile_time_count++;
+        }
+    }
+
+    double elapsed = get_seconds() - start_time;
+    double throughput = elapsed > 0.0 ? (total_bytes / (1024.0 * 1024.0)) / elapsed : 0.0;
+
+    db_log(core, "");
+    db_log(core, "Fetched %zi entries (%.2f MB) in %.3f s, %.2f MB/s.", fetched_count, total_bytes / (1024.0 * 1024.0), elapsed, throughput);
+    db_log(core, "Cold start with cold shared cache: %.3f s compiling.", total_compile_time);
+    db_log(core, "Cold start with warm shared cache: %.3f s fetching.", elapsed);
+    db_log(core, "Speedup: %.2fx", elapsed > 0.0 ? total_compile_time / elapsed : 0.0);
+
+    if (unknown_compile_time_count > 0)
+    {
+        db_log(core, "%zi entries had no recorded compile time and are excluded from the compile time.", unknown_compile_time_count);
+    }
+
+    return true;
+}
+
+}; // namespace ws
@@ -0,0 +1,92 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/app/app.h"
+#include "workshop.core/network/local_socket.h"
+#include "workshop.core/filesystem/virtual_file_system.h"
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace ws {
+
+// ================================================================================================
+//  Daemon that serves a shared asset cache over a local socket, for use by 
+//  asset_cache_socket_transport. Every engine instance and build agent on the machine pointed
+//  at the socket (via the asset_cache_shared_socket cvar) shares the compiled assets in it.
+// 
+//  Entries are stored as individual files in the storage directory, prefixed with the
+//  time they took to compile.
+//
+//  With -benchmark it instead connects to a running daemon and fetches every entry in it, 
+//  comparing the time taken against the time the entries originally took to compile. This
+//  is the time saved by a cold start (an empty local cache) with a warm shared cache.
+//
+//  Usage: workshop.asset_cache_server <storage directory> [-socket <path>]
+//         workshop.asset_cache_server -benchmark [-socket <path>]
+// ================================================================================================
+class asset_cache_server_app : public app
+{
+public:
+    virtual std::string get_name() override;
+
+protected:
+    virtual result<void> start() override;
+    virtual result<void> loop() override;
+    virtual result<void> stop() override;
+
+private:
+
+    struct entry
+    {
+        size_t size;
+        double compile_time;
+    };
+
+    result<void> parse_command_line();
+
+    // Builds the index of entries from the storage directory.
+    void scan_storage();
+
+    // Serves requests from a single client until it disconnects.
+    void serve_client(local_socket* connection);
+
+    bool serve_fetch(local_socket& connection, const std::string& key);
+    bool serve_publish(local_socket& connection, const std::string& key, uint64_t data_size, double compile_time);
+    bool serve_list(local_socket& connection);
+
+    // Keys become filenames, so only allow characters that are safe to use in them.
+    bool is_valid_key(const std::string& key);
+
+    std::filesystem::path get_entry_path(const std::string& key);
+
+    result<void> run_benchmark();
+
+private:
+
+    std::filesystem::path m_storage_directory;
+    std::filesystem::path m_socket_path = std::filesystem::temp_directory_path() / "workshop_asset_cache.sock";
+    bool m_benchmark = false;
+
+    std::unique_ptr<local_socket> m_listen_socket;
+
+    std::mutex m_entries_mutex;
+    std::unordered_map<std::string, entry> m_entries;
+
+    std::mutex m_clients_mutex;
+    std::vector<std::unique_ptr<local_socket>> m_client_connections;
+    std::vector<std::thread> m_client_threads;
+
+    std::unique_ptr<virtual_file_system> m_filesystem;
+    std::filesystem::path m_benchmark_directory;
+
+};
+
+}; // namespace ws
@@ -0,0 +1,106 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.asset_packer/asset_packer_app.h"
+#include "workshop.assets/caches/asset_cache_archive.h"
+#include "workshop.core/filesystem/file.h"
+#include "workshop.core/containers/string.h"
+#include "workshop.core/utils/time.h"
+#include "workshop.core/debug/debug.h"
+
+std::shared_ptr<ws::app> make_app()
+{
+    return std::make_shared<ws::asset_packer_app>();
+}
+
+namespace ws {
+
+std::string asset_packer_app::get_name()
+{
+    return "asset_packer";
+}
+
+result<void> asset_packer_app::parse_command_line()
+{
+    const std::vector<std::string>& args = get_command_line();
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        const std::string& arg = args[i];
+        bool has_value = (i + 1 < args.size());
+
+        if (arg == "-platform" && has_value)
+        {
+            result<platform_type> value = from_string<platform_type>(args[++i]);
+            if (!value)
+            {
+                db_error(core, "Invalid platform: %s", args[i].c_str());
+                return standard_errors::invalid_parameter;
+            }
+            m_platform = value.get();
+        }
+        else if (arg == "-level" && has_value)
+        {
+            result<uint64_t> value = from_string<uint64_t>(args[++i]);
+            if (!value || value.get() > 9)
+            {
+                db_error(core, "Invalid compression level: %s", args[i].c_str());
+                return standard_errors::invalid_parameter;
+            }
+            m_compression_level = static_cast<int>(value.get());
+        }
+        else if (arg == "-compress")
+        {
+            m_compress = true;
+        }
+        else if (m_cache_directory.empty())
+        {
+            m_cache_directory = arg;
+        }
+        else if (m_output_path.empty())
+        {
+            m_output_path = arg;
+        }
+        else
+        {
+            db_error(core, "Unknown argument: %s", arg.c_str());
+            return standard_errors::invalid_parameter;
+        }
+    }
+
+    if (m_cache_directory.empty() || m_output_path.empty() || !std::filesystem::is_directory(m_cache_directory))
+    {
+        db_error(core, "Usage: workshop.asset_packer <cache directory> <output archive> [-platform <name>] [-compress] [-level <0-9>]");
+        return standard_errors::invalid_parameter;
+    }
+
+    return true;
+}
+
+result<void> asset_packer_app::start()
+{
+    return parse_command_line();
+}
+
+result<void> asset_packer_app::stop()
+{
+    return true;
+}
+
+result<void> asset_packer_app::loop()
+{
+    double start_time = get_seconds();
+
+    if (result<void> ret = asset_cache_archive::pack(m_cache_directory, m_platform, m_output_path, m_compress, m_compression_level); !ret)
+    {
+        db_error(core, "Failed to pack asset cache.");
+        return ret;
+    }
+
+    db_log(core, "Packed archive in %.2f s.", get_seconds() - start_time);
+
+    return true;
+}
+
+}; // namespace ws
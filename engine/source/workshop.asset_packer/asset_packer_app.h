@@ -0,0 +1,45 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/app/app.h"
+#include "workshop.core/platform/platform.h"
+
+#include <filesystem>
+#include <string>
+
+namespace ws {
+
+// ================================================================================================
+//  Packs the compiled assets in a local asset cache directory into a single asset_archive
+//  that can be shipped in place of the loose files.
+//
+//  Usage: workshop.asset_packer <cache directory> <output archive> [-platform <name>] [-compress] [-level <0-9>]
+// ================================================================================================
+class asset_packer_app : public app
+{
+public:
+    virtual std::string get_name() override;
+
+protected:
+    virtual result<void> start() override;
+    virtual result<void> loop() override;
+    virtual result<void> stop() override;
+
+private:
+
+    result<void> parse_command_line();
+
+private:
+
+    std::filesystem::path m_cache_directory;
+    std::filesystem::path m_output_path;
+    platform_type m_platform = get_platform();
+    bool m_compress = false;
+    int m_compression_level = 6;
+
+};
+
+}; // namespace ws
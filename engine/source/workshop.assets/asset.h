@@ -71,8 +71,8 @@ protected:
     // required post-processing, such as creating rendering resources, etc.
     // This will be called from a worker thread.
     // 
-    // post_load is (currently) serialized, so avoid doing complex
-    // logic in it, consider doing it in load_dependencies instead.
+    // Different assets may be post_load'd at the same time, so anything
+    // shared between them must be thread safe.
     virtual bool post_load() { return true; };
 
 };
@@ -5,6 +5,7 @@
 #include "workshop.assets/asset_cache.h"
 #include "workshop.assets/asset_manager.h"
 #include "workshop.core/hashing/hash.h"
+#include "workshop.core/hashing/hash128.h"
 
 #include <filesystem>
 
@@ -16,13 +17,24 @@ std::string asset_cache_key::hash() const
 
     // Generate hash from key source material.
     size_t hash = 0;
-    hash_combine(hash, source.path);
-    hash_combine(hash, source.modified_time);
+    auto combine_file = [this, &hash](const asset_cache_key_file& file) {
+        hash_combine(hash, file.path);
+        if (content_hashed)
+        {
+            hash_combine(hash, file.content_hash);
+        }
+        else
+        {
+            hash_combine(hash, file.modified_time);
+        }
+    };
+
+    combine_file(source);
     for (const asset_cache_key_file& dep : dependencies)
     {
-        hash_combine(hash, dep.path);
-        hash_combine(hash, dep.modified_time);
+        combine_file(dep);
     }
+    hash_combine(hash, content_hashed);
     hash_combine(hash, version);
     hash_combine(hash, static_cast<size_t>(platform));
     hash_combine(hash, static_cast<size_t>(config));
@@ -37,4 +49,45 @@ std::string asset_cache_key::hash() const
     return result;
 }
 
+std::string asset_cache_key::shared_hash() const
+{
+    db_assert(content_hashed);
+
+    // Everything is written out in a fixed layout, with strings length prefixed, so no two
+    // keys produce the same data.
+    std::vector<uint8_t> data;
+
+    auto append_value = [&data](uint64_t value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        data.insert(data.end(), bytes, bytes + sizeof(value));
+    };
+
+    auto append_file = [&data, &append_value](const asset_cache_key_file& file) {
+        append_value(file.path.size());
+        data.insert(data.end(), file.path.begin(), file.path.end());
+        append_value(file.content_hash.low);
+        append_value(file.content_hash.high);
+    };
+
+    append_file(source);
+    append_value(dependencies.size());
+    for (const asset_cache_key_file& dep : dependencies)
+    {
+        append_file(dep);
+    }
+    append_value(version);
+    append_value(static_cast<uint64_t>(platform));
+    append_value(static_cast<uint64_t>(config));
+    append_value(static_cast<uint64_t>(flags));
+
+    std::string result = to_string(hash128::calculate(data));
+
+    // Same as above, the filename makes entries easier to identify in the shared cache.
+    std::string filename = string_filter_out(source.path, "\\/:", '_');
+    std::string compiled_filename = filename.append(asset_manager::k_compiled_asset_extension);
+    result.append("_" + compiled_filename);
+
+    return result;
+}
+
 }; // namespace workshop
@@ -8,6 +8,7 @@
 #include "workshop.core/platform/platform.h"
 
 #include "workshop.core/filesystem/virtual_file_system_types.h"
+#include "workshop.core/hashing/hash128.h"
 
 #include <string>
 
@@ -42,6 +43,9 @@ struct asset_cache_key_file
 {
     std::string path;
     virtual_file_system_time_point modified_time;
+
+    // Hash of the files contents, only set if the key is content hashed.
+    hash128 content_hash;
 };
 
 // Data about an asset that is used to generate a unique
@@ -66,10 +70,19 @@ struct asset_cache_key
     // Flags dictating how this asset differs from others.
     asset_flags flags;
 
+    // If set files are identified by their content_hash rather than their modified_time, so
+    // the key is unaffected by files being touched or copied between machines.
+    bool content_hashed = false;
+
     // Calculates a string representation of the key data.
     // This can be used to identify the asset in the underlying
     // cache storage.
     std::string hash() const;
+
+    // Same as hash, but calculated with a hash that is stable between processes, machines and 
+    // compilers. Used to identify the asset in caches shared between them. Only meaningful for
+    // content hashed keys, as modification times differ between machines.
+    std::string shared_hash() const;
 };
 
 // ================================================================================================
@@ -0,0 +1,50 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace ws {
+
+// ================================================================================================
+//  Base class for transports that give access to a cache shared between multiple machines or
+//  processes, such as a cache daemon or remote server.
+// 
+//  Entries are identified by the string returned by asset_cache_key::hash and are immutable
+//  once published.
+// 
+//  Implementations should be thread safe.
+// ================================================================================================
+class asset_cache_transport
+{
+public:
+
+    struct entry
+    {
+        std::string key;
+        size_t size;
+
+        // How long the entry originally took to compile, in seconds. 0 if not known.
+        double compile_time;
+    };
+
+    virtual ~asset_cache_transport() = default;
+
+    // Fetches the entry with the given key into the file at output_path, which is a 
+    // virtual file system path. Returns false if the entry doesn't exist or could not
+    // be fetched.
+    virtual bool fetch(const std::string& key, const char* output_path, double& compile_time) = 0;
+
+    // Publishes the file at input_path, which is a virtual file system path, under the given key.
+    // Returns false if the entry could not be published.
+    virtual bool publish(const std::string& key, const char* input_path, double compile_time) = 0;
+
+    // Gets a list of all the entries in the shared cache.
+    virtual bool list(std::vector<entry>& entries) = 0;
+
+};
+
+}; // namespace workshop
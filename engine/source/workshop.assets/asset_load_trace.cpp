@@ -0,0 +1,450 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.assets/asset_load_trace.h"
+#include "workshop.core/containers/string.h"
+#include "workshop.core/utils/time.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace ws {
+
+namespace {
+
+// Escapes a string so it can be embedded in a json string literal.
+std::string json_escape(const std::string& value)
+{
+    std::string result;
+    result.reserve(value.size());
+
+    for (char c : value)
+    {
+        switch (c)
+        {
+        case '"':   result += "\\\"";   break;
+        case '\\':  result += "\\\\";   break;
+        case '\n':  result += "\\n";    break;
+        case '\r':  result += "\\r";    break;
+        case '\t':  result += "\\t";    break;
+        default:
+            {
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    result += string_format("\\u%04x", static_cast<unsigned char>(c));
+                }
+                else
+                {
+                    result += c;
+                }
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+// Time spent actually doing work on a worker, rather than waiting.
+double get_busy_time(const asset_load_trace::asset_record& record)
+{
+    return record.phase_time[static_cast<int>(asset_load_phase::loading)] +
+           record.phase_time[static_cast<int>(asset_load_phase::compiling)] +
+           record.phase_time[static_cast<int>(asset_load_phase::post_load)];
+}
+
+std::string format_phase_times(const std::array<double, static_cast<int>(asset_load_phase::COUNT)>& phase_time)
+{
+    std::string result;
+    for (size_t i = 0; i < static_cast<int>(asset_load_phase::COUNT); i++)
+    {
+        if (!result.empty())
+        {
+            result += ", ";
+        }
+        result += string_format("%s %.2f ms", asset_load_phase_strings[i], phase_time[i] * 1000.0);
+    }
+    return result;
+}
+
+};
+
+double asset_load_trace::asset_record::get_start_time() const
+{
+    return spans.empty() ? 0.0 : spans.front().start;
+}
+
+double asset_load_trace::asset_record::get_end_time() const
+{
+    return spans.empty() ? 0.0 : spans.back().end;
+}
+
+asset_load_trace::asset_load_trace(const char* name)
+    : m_name(name)
+{
+    m_start_time = get_seconds();
+}
+
+double asset_load_trace::get_time()
+{
+    return get_seconds() - m_start_time;
+}
+
+size_t asset_load_trace::find_or_create_record(const std::string& path)
+{
+    if (auto iter = m_record_lookup.find(path); iter != m_record_lookup.end())
+    {
+        return iter->second;
+    }
+
+    size_t index = m_records.size();
+
+    asset_record& record = m_records.emplace_back();
+    record.path = path;
+
+    m_open_phases.emplace_back();
+    m_record_lookup[path] = index;
+
+    return index;
+}
+
+void asset_load_trace::close_phase(size_t index, double time)
+{
+    open_phase& phase = m_open_phases[index];
+    if (!phase.active)
+    {
+        return;
+    }
+
+    asset_record& record = m_records[index];
+
+    span& new_span = record.spans.emplace_back();
+    new_span.phase = phase.phase;
+    new_span.start = phase.start;
+    new_span.end = time;
+    new_span.worker = phase.worker;
+
+    record.phase_time[static_cast<int>(phase.phase)] += (time - phase.start);
+
+    phase.active = false;
+}
+
+void asset_load_trace::begin_phase(const std::string& path, asset_load_phase phase, size_t worker)
+{
+    if (m_finished)
+    {
+        return;
+    }
+
+    double time = get_time();
+
+    size_t index = find_or_create_record(path);
+    close_phase(index, time);
+
+    m_records[index].finished = false;
+
+    open_phase& new_phase = m_open_phases[index];
+    new_phase.active = true;
+    new_phase.phase = phase;
+    new_phase.start = time;
+    new_phase.worker = worker;
+}
+
+void asset_load_trace::end_asset(const std::string& path, bool failed)
+{
+    if (m_finished)
+    {
+        return;
+    }
+
+    auto iter = m_record_lookup.find(path);
+    if (iter == m_record_lookup.end())
+    {
+        return;
+    }
+
+    close_phase(iter->second, get_time());
+
+    asset_record& record = m_records[iter->second];
+    record.finished = true;
+    record.failed = failed;
+}
+
+bool asset_load_trace::has_asset(const std::string& path)
+{
+    return m_record_lookup.find(path) != m_record_lookup.end();
+}
+
+void asset_load_trace::set_asset_info(const std::string& path, const char* type, const std::vector<std::string>& dependencies)
+{
+    auto iter = m_record_lookup.find(path);
+    if (iter == m_record_lookup.end())
+    {
+        return;
+    }
+
+    asset_record& record = m_records[iter->second];
+    record.type = type;
+    record.dependencies.clear();
+
+    for (const std::string& dependency : dependencies)
+    {
+        if (auto dep_iter = m_record_lookup.find(dependency); dep_iter != m_record_lookup.end())
+        {
+            record.dependencies.push_back(dep_iter->second);
+        }
+    }
+}
+
+void asset_load_trace::finish()
+{
+    if (m_finished)
+    {
+        return;
+    }
+
+    m_end_time = get_time();
+
+    for (size_t i = 0; i < m_records.size(); i++)
+    {
+        close_phase(i, m_end_time);
+    }
+
+    m_finished = true;
+}
+
+const std::vector<asset_load_trace::asset_record>& asset_load_trace::get_assets()
+{
+    return m_records;
+}
+
+std::vector<size_t> asset_load_trace::get_critical_path(const std::string& root_path)
+{
+    std::vector<size_t> path;
+
+    auto iter = m_record_lookup.find(root_path);
+    if (iter == m_record_lookup.end())
+    {
+        return path;
+    }
+
+    std::vector<bool> visited(m_records.size(), false);
+    size_t index = iter->second;
+
+    while (!visited[index])
+    {
+        visited[index] = true;
+        path.push_back(index);
+
+        // If the asset never had to wait then its dependencies didn't hold it up, it was
+        // gated by its own work.
+        const asset_record& record = m_records[index];
+        if (record.phase_time[static_cast<int>(asset_load_phase::waiting_for_dependencies)] <= 0.0)
+        {
+            break;
+        }
+
+        // Otherwise the dependency that finished last is the one it was waiting on.
+        size_t gating_index = m_records.size();
+        double gating_end_time = 0.0;
+
+        for (size_t dependency : record.dependencies)
+        {
+            double end_time = m_records[dependency].get_end_time();
+            if (!visited[dependency] && (gating_index == m_records.size() || end_time > gating_end_time))
+            {
+                gating_index = dependency;
+                gating_end_time = end_time;
+            }
+        }
+
+        if (gating_index == m_records.size())
+        {
+            break;
+        }
+
+        index = gating_index;
+    }
+
+    return path;
+}
+
+std::string asset_load_trace::export_chrome_trace()
+{
+    constexpr int k_worker_pid = 0;
+    constexpr int k_asset_pid = 1;
+
+    std::string result = "{\"traceEvents\":[\n";
+    bool first = true;
+
+    auto add_event = [&result, &first](const std::string& event) {
+        if (!first)
+        {
+            result += ",\n";
+        }
+        result += event;
+        first = false;
+    };
+
+    add_event(string_format("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%i,\"args\":{\"name\":\"Workers\"}}", k_worker_pid));
+    add_event(string_format("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%i,\"args\":{\"name\":\"Assets: %s\"}}", k_asset_pid, json_escape(m_name).c_str()));
+
+    // Work not done on a worker (eg. post-load run on the coordinator) is put on track 0.
+    std::set<size_t> workers;
+
+    for (size_t i = 0; i < m_records.size(); i++)
+    {
+        const asset_record& record = m_records[i];
+        std::string escaped_path = json_escape(record.path);
+        std::string escaped_type = json_escape(record.type);
+
+        add_event(string_format("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%i,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+            k_asset_pid, i, escaped_path.c_str()));
+
+        for (const span& entry : record.spans)
+        {
+            const char* phase_name = asset_load_phase_strings[static_cast<int>(entry.phase)];
+            double start_us = entry.start * 1000000.0;
+            double duration_us = (entry.end - entry.start) * 1000000.0;
+
+            add_event(string_format("{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%i,\"tid\":%zu,\"args\":{\"type\":\"%s\"}}",
+                phase_name, phase_name, start_us, duration_us, k_asset_pid, i, escaped_type.c_str()));
+
+            // Only phases that occupy a thread are shown on the worker tracks.
+            if (entry.phase == asset_load_phase::loading ||
+                entry.phase == asset_load_phase::compiling ||
+                entry.phase == asset_load_phase::post_load)
+            {
+                size_t worker_tid = (entry.worker == k_no_worker ? 0 : entry.worker + 1);
+                workers.insert(worker_tid);
+
+                add_event(string_format("{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%i,\"tid\":%zu,\"args\":{\"path\":\"%s\",\"type\":\"%s\"}}",
+                    escaped_path.c_str(), phase_name, start_us, duration_us, k_worker_pid, worker_tid, escaped_path.c_str(), escaped_type.c_str()));
+            }
+        }
+    }
+
+    for (size_t worker_tid : workers)
+    {
+        std::string name = (worker_tid == 0 ? "Other Threads" : string_format("Worker %zu", worker_tid - 1));
+        add_event(string_format("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%i,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+            k_worker_pid, worker_tid, name.c_str()));
+    }
+
+    result += "\n]}\n";
+    return result;
+}
+
+std::string asset_load_trace::export_summary(const std::string& root_path, size_t max_assets)
+{
+    std::string result;
+
+    size_t failed_count = 0;
+    for (const asset_record& record : m_records)
+    {
+        if (record.failed)
+        {
+            failed_count++;
+        }
+    }
+
+    result += string_format("Asset load trace: %s\n", m_name.c_str());
+    result += string_format("  %zu assets (%zu failed) in %.2f ms\n", m_records.size(), failed_count, m_end_time * 1000.0);
+
+    // Critical path, the chain of assets the root was waiting on.
+    std::vector<size_t> critical_path = get_critical_path(root_path);
+    if (!critical_path.empty())
+    {
+        const asset_record& root = m_records[critical_path.front()];
+
+        result += string_format("\nCritical path (%.2f ms):\n", (root.get_end_time() - root.get_start_time()) * 1000.0);
+
+        for (size_t index : critical_path)
+        {
+            const asset_record& record = m_records[index];
+            result += string_format("  %s [%s] %.2f ms busy (%s)\n",
+                record.path.c_str(),
+                record.type.c_str(),
+                get_busy_time(record) * 1000.0,
+                format_phase_times(record.phase_time).c_str());
+        }
+    }
+
+    // Time taken by each asset type, this determines which loaders are most worth optimizing.
+    struct type_summary
+    {
+        std::string type;
+        size_t count = 0;
+        double busy_time = 0.0;
+        double max_busy_time = 0.0;
+        std::array<double, static_cast<int>(asset_load_phase::COUNT)> phase_time = {};
+    };
+
+    std::map<std::string, type_summary> type_summaries;
+    for (const asset_record& record : m_records)
+    {
+        type_summary& summary = type_summaries[record.type];
+        summary.type = record.type;
+        summary.count++;
+        summary.busy_time += get_busy_time(record);
+        summary.max_busy_time = std::max(summary.max_busy_time, get_busy_time(record));
+
+        for (size_t i = 0; i < static_cast<int>(asset_load_phase::COUNT); i++)
+        {
+            summary.phase_time[i] += record.phase_time[i];
+        }
+    }
+
+    std::vector<type_summary> sorted_types;
+    for (auto& [type, summary] : type_summaries)
+    {
+        sorted_types.push_back(summary);
+    }
+    std::sort(sorted_types.begin(), sorted_types.end(), [](const type_summary& a, const type_summary& b) {
+        return a.busy_time > b.busy_time;
+    });
+
+    result += "\nTime by asset type:\n";
+    result += string_format("  %-16s %8s %12s %12s %12s %12s %12s %12s\n", "type", "assets", "busy", "max busy", "queued", "loading", "compiling", "post load");
+
+    for (const type_summary& summary : sorted_types)
+    {
+        result += string_format("  %-16s %8zu %9.2f ms %9.2f ms %9.2f ms %9.2f ms %9.2f ms %9.2f ms\n",
+            summary.type.empty() ? "unknown" : summary.type.c_str(),
+            summary.count,
+            summary.busy_time * 1000.0,
+            summary.max_busy_time * 1000.0,
+            summary.phase_time[static_cast<int>(asset_load_phase::queued)] * 1000.0,
+            summary.phase_time[static_cast<int>(asset_load_phase::loading)] * 1000.0,
+            summary.phase_time[static_cast<int>(asset_load_phase::compiling)] * 1000.0,
+            summary.phase_time[static_cast<int>(asset_load_phase::post_load)] * 1000.0);
+    }
+
+    // Individual assets that took the longest to process.
+    std::vector<size_t> sorted_assets(m_records.size());
+    for (size_t i = 0; i < m_records.size(); i++)
+    {
+        sorted_assets[i] = i;
+    }
+    std::sort(sorted_assets.begin(), sorted_assets.end(), [this](size_t a, size_t b) {
+        return get_busy_time(m_records[a]) > get_busy_time(m_records[b]);
+    });
+
+    result += string_format("\nSlowest assets:\n");
+
+    for (size_t i = 0; i < sorted_assets.size() && i < max_assets; i++)
+    {
+        const asset_record& record = m_records[sorted_assets[i]];
+        result += string_format("  %9.2f ms  %s [%s]%s\n",
+            get_busy_time(record) * 1000.0,
+            record.path.c_str(),
+            record.type.c_str(),
+            record.failed ? " (failed)" : "");
+    }
+
+    return result;
+}
+
+}; // namespace ws
@@ -0,0 +1,155 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include <array>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ws {
+
+// Phases an asset moves through while being loaded.
+enum class asset_load_phase
+{
+    // Waiting in the asset managers queue, or for a worker to pick up the load.
+    queued,
+
+    // Reading and deserializing the compiled asset.
+    loading,
+
+    // Compiling the asset as no up to date compiled version was available.
+    compiling,
+
+    // Loaded, but waiting for the assets it depends on to finish loading.
+    waiting_for_dependencies,
+
+    // Running the assets post_load.
+    post_load,
+
+    COUNT
+};
+
+static const char* asset_load_phase_strings[static_cast<int>(asset_load_phase::COUNT)] = {
+    "queued",
+    "loading",
+    "compiling",
+    "waiting_for_dependencies",
+    "post_load",
+};
+
+// ================================================================================================
+//  Timeline of every asset loaded while the trace was recording, broken down by the time each
+//  asset spent in each phase of loading and which worker it ran on.
+//
+//  Once recording has finished the critical path through the dependency graph can be found,
+//  this is the chain of assets that gated the root asset from finishing. The timeline can be
+//  exported as chrome trace json (viewable in chrome://tracing or perfetto) or as a text summary
+//  of where the time went.
+//
+//  This class is not thread safe, the asset manager only accesses it while holding its
+//  trace mutex.
+// ================================================================================================
+class asset_load_trace
+{
+public:
+
+    // Value used as the worker of spans not run on a task scheduler worker.
+    static inline constexpr size_t k_no_worker = std::numeric_limits<size_t>::max();
+
+    struct span
+    {
+        asset_load_phase phase;
+
+        // Seconds since the trace started.
+        double start = 0.0;
+        double end = 0.0;
+
+        size_t worker = k_no_worker;
+    };
+
+    struct asset_record
+    {
+        std::string path;
+        std::string type;
+
+        bool failed = false;
+        bool finished = false;
+
+        std::vector<span> spans;
+
+        // Indices of the records of any dependencies loaded as part of the trace.
+        std::vector<size_t> dependencies;
+
+        // Total time spent in each phase.
+        std::array<double, static_cast<int>(asset_load_phase::COUNT)> phase_time = {};
+
+        double get_start_time() const;
+        double get_end_time() const;
+    };
+
+    asset_load_trace(const char* name);
+
+    // Starts a new phase for the given asset, ending the phase it was previously in.
+    void begin_phase(const std::string& path, asset_load_phase phase, size_t worker);
+
+    // Ends the current phase of the given asset and marks it as finished loading.
+    void end_asset(const std::string& path, bool failed);
+
+    // Returns true if the given asset has been recorded.
+    bool has_asset(const std::string& path);
+
+    // Stores the type and dependencies of an asset, used when building the report.
+    void set_asset_info(const std::string& path, const char* type, const std::vector<std::string>& dependencies);
+
+    // Stops recording, closing the phases of any assets that have not finished.
+    void finish();
+
+    // Gets all the recorded assets.
+    const std::vector<asset_record>& get_assets();
+
+    // Gets the indices of the assets on the critical path leading up to the given root asset,
+    // starting with the root. Empty if the root was not recorded.
+    std::vector<size_t> get_critical_path(const std::string& root_path);
+
+    // Exports the timeline in the chrome trace event format. Each asset is shown on its own track
+    // along with each worker showing the loading work it did.
+    std::string export_chrome_trace();
+
+    // Exports a text summary of the critical path, time taken by each asset type and the
+    // slowest assets.
+    std::string export_summary(const std::string& root_path, size_t max_assets);
+
+private:
+
+    struct open_phase
+    {
+        bool active = false;
+        asset_load_phase phase;
+        double start = 0.0;
+        size_t worker = k_no_worker;
+    };
+
+    size_t find_or_create_record(const std::string& path);
+
+    void close_phase(size_t index, double time);
+
+    double get_time();
+
+private:
+
+    std::string m_name;
+    double m_start_time = 0.0;
+    double m_end_time = 0.0;
+    bool m_finished = false;
+
+    std::vector<asset_record> m_records;
+    std::vector<open_phase> m_open_phases;
+    std::unordered_map<std::string, size_t> m_record_lookup;
+
+};
+
+}; // namespace ws
@@ -5,12 +5,16 @@
 #include "workshop.assets/asset_loader.h"
 #include "workshop.assets/asset_cache.h"
 #include "workshop.assets/asset.h"
+#include "workshop.assets/content_hash_index.h"
 
 #include "workshop.core/filesystem/stream.h"
+#include "workshop.core/filesystem/compressed_stream.h"
 #include "workshop.core/filesystem/virtual_file_system.h"
 
 #include "workshop.core/containers/string.h"
+#include "workshop.core/cvar/core_cvars.h"
 
+#include <cstring>
 #include <stdexcept>
 
 namespace ws {
@@ -91,6 +95,48 @@ bool asset_loader::load_asset_descriptor(const char* path, YAML::Node& node, con
     return true;
 }
 
+std::unique_ptr<stream> asset_loader::open_compiled_stream(const char* path, bool for_writing, compiled_asset_header& header, int compression_level)
+{
+    std::unique_ptr<stream> result = virtual_file_system::get().open(path, for_writing);
+    if (!result)
+    {
+        db_error(asset, "[%s] Failed to open stream to asset.", path);
+        return nullptr;
+    }
+
+    if (!serialize_header(*result, header, path))
+    {
+        return nullptr;
+    }
+
+    if (for_writing)
+    {
+        if (compression_level > 0)
+        {
+            return std::make_unique<compressed_stream>(std::move(result), compression_level);
+        }
+        return result;
+    }
+
+    return compressed_stream::open_for_reading(std::move(result));
+}
+
+bool asset_loader::close_compiled_stream(stream& compiled_stream, const char* path)
+{
+    if (compressed_stream* compressed = dynamic_cast<compressed_stream*>(&compiled_stream))
+    {
+        if (!compressed->finish())
+        {
+            db_error(asset, "[%s] Failed to write compressed asset data.", path);
+            return false;
+        }
+        return true;
+    }
+
+    compiled_stream.close();
+    return true;
+}
+
 bool asset_loader::serialize_header(stream& out, compiled_asset_header& header, const char* path)
 {
     compiled_asset_header tmp = header;
@@ -123,20 +169,41 @@ bool asset_loader::get_cache_key(const char* path, platform_type asset_platform,
     key.config = asset_config;
     key.flags = flags;
     key.source.path = path;
-    if (!virtual_file_system::get().modified_time(path, key.source.modified_time))
+    key.version = get_compiled_version();
+    key.content_hashed = cvar_asset_cache_content_hash.get();
+
+    auto fill_file = [&key](asset_cache_key_file& file) -> bool {
+        if (!virtual_file_system::get().modified_time(file.path.c_str(), file.modified_time))
+        {
+            return false;
+        }
+
+        if (key.content_hashed)
+        {
+            content_hash_index* index = content_hash_index::try_get();
+            bool success = index ? index->get_hash(file.path.c_str(), file.content_hash) : content_hash_index::calculate_hash(file.path.c_str(), file.content_hash);
+            if (!success)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    if (!fill_file(key.source))
     {
-        db_error(asset, "[%s] Could not get modification time of source file.", path);
+        db_error(asset, "[%s] Could not get modification time or hash of source file.", path);
         return false;
     }
-    key.version = get_compiled_version();
 
     for (const std::string& dep : dependencies)
     {
         asset_cache_key_file& file = key.dependencies.emplace_back();
         file.path = dep;
-        if (!virtual_file_system::get().modified_time(dep.c_str(), file.modified_time))
+        if (!fill_file(file))
         {
-            db_error(asset, "[%s] Could not get modification time of dependent file: %s", path, dep.c_str());
+            db_error(asset, "[%s] Could not get modification time or hash of dependent file: %s", path, dep.c_str());
             return false;
         }
     }
@@ -146,6 +213,7 @@ bool asset_loader::get_cache_key(const char* path, platform_type asset_platform,
 
 bool asset_loader::load_header(const char* path, compiled_asset_header& header)
 {
+    // The header is never compressed, so it can be read directly without decompressing anything.
     std::unique_ptr<stream> stream = virtual_file_system::get().open(path, false);
     if (!stream)
     {
@@ -158,4 +226,63 @@ bool asset_loader::load_header(const char* path, compiled_asset_header& header)
     return true;
 }
 
+bool asset_loader::load_header(std::span<const uint8_t> data, compiled_asset_header& header)
+{
+    // Mirrors stream_serialize for compiled_asset_header, but fails rather than reading past the
+    // end of the data as the caller has usually only read the start of the file.
+    size_t position = 0;
+
+    auto read_bytes = [&data, &position](void* output, size_t size) -> bool {
+        if (size > data.size() - position)
+        {
+            return false;
+        }
+
+        memcpy(output, data.data() + position, size);
+        position += size;
+
+        return true;
+    };
+
+    auto read_string = [&data, &position, &read_bytes](std::string& output) -> bool {
+        uint32_t length = 0;
+        if (!read_bytes(&length, sizeof(length)) || length > data.size() - position)
+        {
+            return false;
+        }
+
+        output.assign(reinterpret_cast<const char*>(data.data() + position), length);
+        position += length;
+
+        return true;
+    };
+
+    uint32_t dependency_count = 0;
+
+    if (!read_string(header.compiled_hash) ||
+        !read_string(header.type) ||
+        !read_bytes(&header.version, sizeof(header.version)) ||
+        !read_bytes(&dependency_count, sizeof(dependency_count)))
+    {
+        return false;
+    }
+
+    // Every dependency has at least a length, this stops a truncated count allocating a huge list.
+    if (dependency_count > (data.size() - position) / sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    header.dependencies.resize(dependency_count);
+    for (std::string& dependency : header.dependencies)
+    {
+        if (!read_string(dependency))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 }; // namespace ws
@@ -16,6 +16,7 @@
 #include "thirdparty/yamlcpp/include/yaml-cpp/yaml.h"
 
 #include <typeinfo>
+#include <span>
 
 namespace ws {
 
@@ -78,6 +79,11 @@ public:
     // Gets the current version of the compiled asset format.
     virtual size_t get_compiled_version() = 0;
 
+    // Gets the zlib level compiled assets are compressed with when compiled for the given config, 
+    // 0 leaves them uncompressed. Compressed assets are smaller on disk but cost time to decompress
+    // on load. Bump the compiled version when changing this so existing assets are recompiled.
+    virtual int get_compression_level(config_type asset_config) { return 0; }
+
     // Saves an asset to a raw uncompiled yaml file.
     virtual bool save_uncompiled(const char* path, asset& instance) { return false; };
 
@@ -91,12 +97,27 @@ public:
     // to determine if an asset needs to be recompiled.
     bool load_header(const char* path, compiled_asset_header& header);
 
+    // Same as above but parses the header from a block of data read from the start of a compiled
+    // asset. Returns false if the header extends past the end of the data.
+    bool load_header(std::span<const uint8_t> data, compiled_asset_header& header);
+
     // Helper function, reads the YAML asset descriptor from
     // the filesystem, does basic error processing and return it.
     static bool load_asset_descriptor(const char* path, YAML::Node& node, const char* expected_type, size_t min_version, size_t max_version);
 
 protected:
 
+    // Opens a stream to a compiled asset and serializes its header with serialize_header. The header
+    // is always stored uncompressed so load_header doesn't need to decompress anything. When writing, 
+    // everything written after the header is compressed if compression_level is above 0. When 
+    // reading, compressed data is detected and decompressed transparently. Returns nullptr on failure.
+    std::unique_ptr<stream> open_compiled_stream(const char* path, bool for_writing, compiled_asset_header& header, int compression_level = 0);
+
+    // Closes a stream opened with open_compiled_stream. When writing compressed data this is where
+    // it is all written out, so the result must be checked. Returns false if any of it failed
+    // to be written, in which case the compiled asset is incomplete and shouldn't be used.
+    bool close_compiled_stream(stream& compiled_stream, const char* path);
+
     // Serializes an asset header into or out of the given stream.
     // When reading header the values read are validated to match those in the passed in header
     // if any are abnormal (eg. version missmatch) an error is logged and it returns false.
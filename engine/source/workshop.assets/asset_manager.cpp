@@ -9,14 +9,19 @@
 #include "workshop.assets/asset.h"
 #include "workshop.core/debug/debug.h"
 #include "workshop.core/async/async.h"
+#include "workshop.core/cvar/core_cvars.h"
 #include "workshop.core/filesystem/virtual_file_system.h"
 #include "workshop.core/memory/memory_tracker.h"
+#include "workshop.core/statistics/statistics_manager.h"
+#include "workshop.core/utils/time.h"
 #include <cstring>
 
 #include <algorithm>
+#include <filesystem>
 #include <thread>
 #include <future>
 #include <array>
+#include <chrono>
 
 // The asset manager is multithreaded, its important to know how it behaves before 
 // attempting to make changes to it.
@@ -42,10 +47,35 @@
 // begin_load and begin_unload queue asynchronous operations which run in the 
 // task_scheduler worker pool. Once they finish doing their task process_asset
 // is called again incase its state has changed while the operation has been in progress.
+//
+// Loads run as coroutine tasks (see load_asset). Rather than blocking a worker they suspend
+// while the header of the compiled asset is read from disk, and while waiting for any
+// dependencies requested by load_dependencies. A load waiting on dependencies gives up its
+// operation slot and is resumed by whichever dependency finishes loading last, at which
+// point it is post-loaded.
 // 
 // If the task is now in the correct state the asset_manager is done with it until its
 // next state change.
 //
+// Pending states are held in a heap ordered by their effective priority. This is the priority
+// they were requested at, which can be changed at any time, raised above the priority of any
+// asset that is waiting on them to load as a dependency. If all references to an asset are
+// lost while its load is queued it is removed from the queue, if the load is in progress 
+// it's abandoned at the next opportunity (before compiling and before loading dependencies)
+// and the asset returns to the unloaded state.
+//
+// When all references to a loaded asset are lost it is not unloaded immediately, instead it's
+// parked in a keep alive pool in case it is requested again shortly after (eg. when moving 
+// back and forth between levels), in which case it's handed back without reloading. The pool
+// is bounded by a memory budget and a timeout, the least recently used assets are evicted 
+// (unloaded) when either is exceeded, when memory budgets come under pressure, or when the 
+// queue is drained. A parked asset is charged for any dependencies only it keeps loaded, and
+// if memory isn't being tracked the pool is bounded by a count instead.
+//
+// While a load trace is being recorded each asset reports when it enters each phase of 
+// loading (queued, loading, compiling, waiting on dependencies, post-load), this is used to 
+// find out where the time goes when loading large sets of assets such as a world.
+//
 // All functions accessible to calling-code (requesting an asset, checking an asset state, etc)
 // are expected to be thread-safe and callable from anywhere.
 
@@ -61,12 +91,176 @@ static thread_local asset_state* g_tls_current_post_load_asset = nullptr;
 
 };
 
+void asset_pending_queue::push(asset_state* state)
+{
+    db_assert(state->queue_index == asset_state::k_not_queued);
+
+    state->queue_index = m_heap.size();
+    state->queue_sequence = m_next_sequence++;
+    state->queue_time = get_seconds();
+
+    m_heap.push_back(state);
+    sift_up(state->queue_index);
+}
+
+asset_state* asset_pending_queue::pop()
+{
+    db_assert(!m_heap.empty());
+
+    asset_state* state = m_heap.front();
+    remove(state);
+
+    return state;
+}
+
+void asset_pending_queue::remove(asset_state* state)
+{
+    size_t index = state->queue_index;
+    db_assert(index < m_heap.size() && m_heap[index] == state);
+
+    size_t last = m_heap.size() - 1;
+    if (index != last)
+    {
+        swap(index, last);
+    }
+
+    m_heap.pop_back();
+    state->queue_index = asset_state::k_not_queued;
+
+    // The state moved into the gap could belong either above or below it.
+    if (index < m_heap.size())
+    {
+        asset_state* moved_state = m_heap[index];
+        sift_up(index);
+        sift_down(moved_state->queue_index);
+    }
+}
+
+void asset_pending_queue::update(asset_state* state)
+{
+    if (state->queue_index == asset_state::k_not_queued)
+    {
+        return;
+    }
+
+    sift_up(state->queue_index);
+    sift_down(state->queue_index);
+}
+
+size_t asset_pending_queue::size() const
+{
+    return m_heap.size();
+}
+
+bool asset_pending_queue::empty() const
+{
+    return m_heap.empty();
+}
+
+bool asset_pending_queue::is_before(size_t a, size_t b) const
+{
+    const asset_state* state_a = m_heap[a];
+    const asset_state* state_b = m_heap[b];
+
+    if (state_a->effective_priority != state_b->effective_priority)
+    {
+        return state_a->effective_priority > state_b->effective_priority;
+    }
+
+    // Equal priorities are processed in the order they were queued.
+    return state_a->queue_sequence < state_b->queue_sequence;
+}
+
+void asset_pending_queue::swap(size_t a, size_t b)
+{
+    std::swap(m_heap[a], m_heap[b]);
+    m_heap[a]->queue_index = a;
+    m_heap[b]->queue_index = b;
+}
+
+void asset_pending_queue::sift_up(size_t index)
+{
+    while (index > 0)
+    {
+        size_t parent = (index - 1) / 2;
+        if (!is_before(index, parent))
+        {
+            break;
+        }
+
+        swap(index, parent);
+        index = parent;
+    }
+}
+
+void asset_pending_queue::sift_down(size_t index)
+{
+    while (true)
+    {
+        size_t left = (index * 2) + 1;
+        size_t right = left + 1;
+        size_t first = index;
+
+        if (left < m_heap.size() && is_before(left, first))
+        {
+            first = left;
+        }
+        if (right < m_heap.size() && is_before(right, first))
+        {
+            first = right;
+        }
+
+        if (first == index)
+        {
+            break;
+        }
+
+        swap(index, first);
+        index = first;
+    }
+}
+
 asset_manager::asset_manager(platform_type asset_platform, config_type asset_config)
     : m_asset_platform(asset_platform)
     , m_asset_config(asset_config)
 {
     m_max_concurrent_ops = task_scheduler::get().get_worker_count(task_queue::loading);
 
+    if (statistics_manager* stats = statistics_manager::try_get())
+    {
+        m_stats_queue_depth = stats->find_or_create_channel("asset manager/queue depth");
+        m_stats_queue_wait_time = stats->find_or_create_channel("asset manager/queue wait time");
+        m_stats_cancelled_loads = stats->find_or_create_channel("asset manager/cancelled loads");
+
+        m_stats_parked_bytes = stats->find_or_create_channel("asset keep alive/parked bytes");
+        m_stats_parked_assets = stats->find_or_create_channel("asset keep alive/parked assets");
+        m_stats_keep_alive_hit_rate = stats->find_or_create_channel("asset keep alive/hit rate");
+        m_stats_reloads_avoided = stats->find_or_create_channel("asset keep alive/reloads avoided");
+        m_stats_keep_alive_evictions = stats->find_or_create_channel("asset keep alive/evictions");
+    }
+
+    // Parked assets can hold any type of memory, so give it all back when any budget is under pressure.
+    if (memory_budgets* budgets = memory_budgets::try_get())
+    {
+        m_memory_pressure_delegate = budgets->on_pressure.add_shared([this](const memory_budgets::budget_state& state) {
+            if (state.pressure == memory_pressure::none)
+            {
+                return;
+            }
+
+            std::unique_lock lock(m_states_mutex);
+
+            if (state.pressure == memory_pressure::hard)
+            {
+                evict_parked_lockless(0, 0);
+            }
+            else
+            {
+                evict_parked_lockless(m_parked_bytes / 2, m_parked_states.size() / 2);
+            }
+        });
+    }
+
     m_load_thread = std::thread([this]() {
 
         db_set_thread_name("Asset Manager Coordinator");    
@@ -77,6 +271,8 @@ asset_manager::asset_manager(platform_type asset_platform, config_type asset_con
 
 asset_manager::~asset_manager()
 {
+    m_memory_pressure_delegate = nullptr;
+
     {
         std::unique_lock lock(m_states_mutex);
         m_shutting_down = true;
@@ -257,7 +453,11 @@ void asset_manager::drain_queue()
 {
     std::unique_lock lock(m_states_mutex);
 
-    while (m_pending_queue.size() > 0 || m_outstanding_ops.load() > 0)
+    // Callers drain the queue to ensure everything they released is gone, so nothing can
+    // be left in the keep alive pool.
+    evict_parked_lockless(0, 0);
+
+    while (m_pending_queue.size() > 0 || m_outstanding_ops.load() > 0 || m_suspended_loads > 0)
     {
         m_states_convar.wait(lock);
     }
@@ -321,6 +521,7 @@ asset_state* asset_manager::create_asset_state_lockless(const std::type_info& id
         {
             state = *iter;
             state->priority = priority;
+            update_effective_priority(state);
 
             // If we've previously failed to load, try and reload as we are requesting the asset again.
             if (state->loading_state == asset_loading_state::failed)
@@ -365,6 +566,9 @@ asset_state* asset_manager::create_asset_state_lockless(const std::type_info& id
 
             // Parent holds a ref to child until its fully unloaded.
             increment_ref(state, true);
+
+            // The parent can't finish loading until we have, so make sure we are queued ahead of it.
+            update_effective_priority(state);
         }
     }
 
@@ -400,265 +604,751 @@ void asset_manager::request_unload(asset_state* state)
 
 void asset_manager::request_load_lockless(asset_state* state)
 {
+    // Still loaded from the last time it was referenced, so nothing needs doing.
+    if (state->is_parked)
+    {
+        db_verbose(asset, "[%s] Reusing asset from keep alive pool.", state->path.c_str());
+
+        unpark_lockless(state, false);
+
+        m_keep_alive_hits++;
+        submit_keep_alive_statistics();
+        return;
+    }
+
     state->should_be_loaded = true;
+    state->effective_priority = calculate_effective_priority(state);
 
     bool expected = false;
     if (state->is_pending.compare_exchange_weak(expected, true))
     {
-        // Insert into queue in priority order.
-        auto iter = std::lower_bound(m_pending_queue.begin(), m_pending_queue.end(), state->priority, [](const asset_state* info, size_t value)
+        m_pending_queue.push(state);
+        submit_queue_statistics(nullptr);
+
+        if (state->loading_state == asset_loading_state::unloaded)
         {
-            return info->priority < value;
-        });
-        m_pending_queue.insert(iter, state);
+            trace_load_phase(state, asset_load_phase::queued);
+        }
 
         m_states_convar.notify_all();
     }
+    else
+    {
+        m_pending_queue.update(state);
+    }
 }
 
-void asset_manager::request_unload_lockless(asset_state* state)
+void asset_manager::request_unload_lockless(asset_state* state, bool allow_keep_alive)
 {
+    if (allow_keep_alive && park_lockless(state))
+    {
+        return;
+    }
+
     state->should_be_loaded = false;
 
+    // If the asset is still waiting in the queue to start loading there is nothing to undo, 
+    // so cancel the load by removing it from the queue rather than leaving it to hold up assets
+    // that are still wanted.
+    if (state->is_pending && 
+        state->loading_state == asset_loading_state::unloaded && 
+        state->current_operations.load() == 0)
+    {
+        db_verbose(asset, "[%s] Cancelled queued load, asset is no longer referenced.", state->path.c_str());
+
+        m_pending_queue.remove(state);
+        state->is_pending = false;
+
+        m_cancelled_loads++;
+        submit_queue_statistics(nullptr);
+
+        // Nothing will process the state again so remove it, unless it has been referenced again
+        // since its last reference was dropped.
+        if (state->references == 0)
+        {
+            delete_state(state);
+        }
+
+        m_states_convar.notify_all();
+        return;
+    }
+
     bool expected = false;
     if (state->is_pending.compare_exchange_weak(expected, true))
     {
-        // Insert into queue in priority order.
-        auto iter = std::lower_bound(m_pending_queue.begin(), m_pending_queue.end(), state->priority, [](const asset_state* info, size_t value)
-        {
-            return info->priority < value;
-        });
-        m_pending_queue.insert(iter, state);
+        m_pending_queue.push(state);
+        submit_queue_statistics(nullptr);
 
         m_states_convar.notify_all();
     }
 }
 
-void asset_manager::wait_for_load(const asset_state* state)
+void asset_manager::set_priority(asset_state* state, int32_t priority)
 {
     std::unique_lock lock(m_states_mutex);
 
-    while (true)
-    {
-        if (state->loading_state == asset_loading_state::loaded ||
-            state->loading_state == asset_loading_state::failed)
-        {
-            return;
-        }
-
-        m_states_convar.wait(lock);
-    }
+    state->priority = priority;
+    update_effective_priority(state);
 }
 
-void asset_manager::do_work()
+int32_t asset_manager::calculate_effective_priority(asset_state* state)
 {
-    std::unique_lock lock(m_states_mutex);
+    int32_t priority = state->priority;
 
-    while (!m_shutting_down)
+    for (asset_state* parent : state->depended_on_by)
     {
-        if (m_outstanding_ops.load() < m_max_concurrent_ops)
+        if (parent->loading_state != asset_loading_state::loading &&
+            parent->loading_state != asset_loading_state::compiling &&
+            parent->loading_state != asset_loading_state::waiting_for_dependencies)
         {
-            if (m_pending_queue.size() > 0)
-            {
-                asset_state* state = m_pending_queue.back();
-                m_pending_queue.pop_back();
-
-                state->is_pending = false;
-
-                process_asset(state, false);
+            continue;
+        }
 
-                continue;
-            }
+        int32_t boosted_priority = parent->effective_priority;
+        if (boosted_priority <= std::numeric_limits<int32_t>::max() - k_dependency_priority_boost)
+        {
+            boosted_priority += k_dependency_priority_boost;
         }
 
-        m_states_convar.wait(lock);
+        priority = std::max(priority, boosted_priority);
     }
+
+    return priority;
 }
 
-void asset_manager::process_asset(asset_state* state, bool release_operation_reference)
+void asset_manager::update_effective_priority(asset_state* state, size_t depth)
 {
-    std::scoped_lock lock(state->process_mutex);
-
-    // If we are at the end of an operation we reduce the operation count here while
-    // under the process_mutex to avoid race conditions.
-    if (release_operation_reference)
+    int32_t new_priority = calculate_effective_priority(state);
+    if (new_priority == state->effective_priority)
     {
-        state->current_operations.fetch_sub(1);
-        db_verbose(asset, "[%s] Reduced operation count to %zi", state->path.c_str(), state->current_operations.load());
+        return;
     }
 
-    // A different thread is already operating on this asset. We don't need to do anything
-    // here as they will handle processing the asset when they finish.
-    if (state->current_operations.load() > 0)
+    state->effective_priority = new_priority;
+
+    if (state->is_pending)
     {
-        db_verbose(asset, "[%s] Skipping process as operation count is %zi", state->path.c_str(), state->current_operations.load());
-        return;
+        m_pending_queue.update(state);
     }
 
-    switch (state->loading_state)
+    // Our dependencies may have been boosted by our old priority, so they need updating as well.
+    if (depth < k_max_priority_propagation_depth)
     {
-    case asset_loading_state::loaded:
-        {
-            if (!state->should_be_loaded)
-            {
-                begin_unload(state);
-            }
-            break;
-        }
-    case asset_loading_state::unloaded:
+        for (asset_state* dependency : state->dependencies)
         {
-            if (state->should_be_loaded)
-            {
-                begin_load(state);
-            }
-            break;
+            update_effective_priority(dependency, depth + 1);
         }
-    case asset_loading_state::failed:
-        {
-            // We do nothing to failed assets, they sit in
-            // this state and return a default asset if available.
+    }
+}
 
-            break;
-        }
-    case asset_loading_state::waiting_for_dependencies:
-        {
-            // Do nothing while waiting for dependencies, the assets we depend on will move us out of this state.
-            break;
-        }
-    default:
+bool asset_manager::is_load_cancelled(asset_state* state)
+{
+    return !state->should_be_loaded;
+}
+
+void asset_manager::submit_queue_statistics(asset_state* popped_state)
+{
+    if (m_stats_queue_depth)
+    {
+        m_stats_queue_depth->submit(m_pending_queue.size());
+        m_stats_cancelled_loads->submit(m_cancelled_loads);
+
+        if (popped_state)
         {
-            db_assert(false);
-            break;
+            m_stats_queue_wait_time->submit((get_seconds() - popped_state->queue_time) * 1000.0);
         }
     }
 }
 
-void asset_manager::begin_load(asset_state* state)
+size_t asset_manager::get_keep_alive_budget()
 {
-    db_assert(state->loading_state == asset_loading_state::unloaded)
-    set_load_state(state, asset_loading_state::loading);
+    return static_cast<size_t>(std::max(0, cvar_asset_keep_alive_budget.get())) * 1024 * 1024;
+}
 
-    m_outstanding_ops.fetch_add(1);
+size_t asset_manager::get_keep_alive_max_count()
+{
+    // Without a tracker every asset measures as zero bytes, so the budget can't bound the pool.
+    if (memory_tracker::try_get() == nullptr)
+    {
+        return static_cast<size_t>(std::max(0, cvar_asset_keep_alive_max_count.get()));
+    }
 
-    state->current_operations.fetch_add(1);
+    return std::numeric_limits<size_t>::max();
+}
 
-    async("Load Asset", task_queue::loading, [this, state]() mutable {
-    
-        do_load(state);
+size_t asset_manager::calculate_parked_bytes(asset_state* state)
+{
+    memory_tracker* tracker = memory_tracker::try_get();
+    if (tracker == nullptr)
+    {
+        return 0;
+    }
 
-        {
-            std::unique_lock lock(m_states_mutex);
+    // Walk down the dependency graph collecting every dependency that nothing outside of the
+    // parked assets depends on. This is repeated until nothing changes as a dependency can be
+    // shared between several assets that are only charged later in the walk.
+    std::vector<asset_state*> charged = { state };
 
-            asset_loading_state new_state;
-            if (state->instance)
+    auto is_charged = [&charged](asset_state* other) {
+        return std::find(charged.begin(), charged.end(), other) != charged.end();
+    };
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+
+        for (size_t i = 0; i < charged.size(); i++)
+        {
+            for (asset_state* dependency : charged[i]->dependencies)
             {
-                if (are_dependencies_loaded(state))
-                {
-                    // TODO: Move this out of the lock, right now post-load is serialized.
-                    if (!post_load_asset(state))
-                    {
-                        new_state = asset_loading_state::failed;
-                    }
-                    else
-                    {
-                        new_state = asset_loading_state::loaded;
-                    }
-                }
-                else
+                if (is_charged(dependency) || dependency->is_parked)
                 {
-                    new_state = asset_loading_state::waiting_for_dependencies;
+                    continue;
                 }
-            }
-            else
-            {
-                new_state = asset_loading_state::failed;
-            }
 
-            set_load_state(state, new_state);
+                bool only_held_by_parked = std::all_of(dependency->depended_on_by.begin(), dependency->depended_on_by.end(), [&is_charged](asset_state* parent) {
+                    return parent->is_parked || is_charged(parent);
+                });
 
-            // Let anything we depend on know that we have loaded.
-            for (asset_state* parent : state->depended_on_by)
-            {
-                if (parent->loading_state == asset_loading_state::waiting_for_dependencies)
+                if (only_held_by_parked)
                 {
-                    check_dependency_load_state(parent);
+                    charged.push_back(dependency);
+                    changed = true;
                 }
             }
+        }
+    }
 
-            // Process the asset again incase the requested state
-            // has changed during this process.
-            process_asset(state, true);
+    size_t bytes = 0;
+    for (asset_state* charged_state : charged)
+    {
+        bytes += tracker->get_asset_used_bytes(string_hash(charged_state->path));
+    }
 
-            m_outstanding_ops.fetch_sub(1);
-            m_states_convar.notify_all();
-        }
-    
-    });
+    return bytes;
 }
 
-bool asset_manager::post_load_asset(asset_state* state)
+bool asset_manager::park_lockless(asset_state* state)
 {
-    // Mark which asset is being post_load'd so we can handle things
-    // differently in dependent assets are loaded during post_load.
-    asset_state* old_state = g_tls_current_post_load_asset;
-    g_tls_current_post_load_asset = state;
+    if (state->is_parked ||
+        state->is_for_hot_reload ||
+        state->loading_state != asset_loading_state::loaded ||
+        m_shutting_down)
+    {
+        return false;
+    }
 
-    bool success = false;
-    if (state->instance->post_load())
+    size_t budget = get_keep_alive_budget();
+    if (budget == 0 || get_keep_alive_max_count() == 0)
     {
-        success = true;
+        return false;
     }
-    else
+
+    size_t bytes = calculate_parked_bytes(state);
+
+    // No point evicting everything else to make room for an asset that will never fit.
+    if (bytes > budget)
     {
-        asset_loader* loader = get_loader_for_type(state->type_id);
-        if (loader)
+        return false;
+    }
+
+    db_verbose(asset, "[%s] Keeping unreferenced asset alive (%zu bytes).", state->path.c_str(), bytes);
+
+    state->is_parked = true;
+    state->parked_time = get_seconds();
+    state->parked_bytes = bytes;
+    state->parked_iter = m_parked_states.insert(m_parked_states.end(), state);
+    m_parked_bytes += bytes;
+
+    evict_parked_lockless(budget, get_keep_alive_max_count());
+    submit_keep_alive_statistics();
+
+    // Wake up the load thread so it starts checking for timeouts.
+    m_states_convar.notify_all();
+
+    return true;
+}
+
+void asset_manager::unpark_lockless(asset_state* state, bool evict)
+{
+    db_assert(state->is_parked);
+
+    m_parked_states.erase(state->parked_iter);
+    m_parked_bytes -= state->parked_bytes;
+
+    state->is_parked = false;
+    state->parked_bytes = 0;
+
+    if (evict)
+    {
+        db_verbose(asset, "[%s] Evicting asset from keep alive pool.", state->path.c_str());
+
+        m_keep_alive_evictions++;
+        request_unload_lockless(state, false);
+    }
+}
+
+void asset_manager::evict_parked_lockless(size_t max_bytes, size_t max_count)
+{
+    if (m_parked_states.empty())
+    {
+        return;
+    }
+
+    double timeout = cvar_asset_keep_alive_timeout.get();
+    double current_time = get_seconds();
+
+    while (!m_parked_states.empty())
+    {
+        asset_state* state = m_parked_states.front();
+
+        bool over_limit = (m_parked_bytes > max_bytes || m_parked_states.size() > max_count);
+        bool timed_out = (current_time - state->parked_time) >= timeout;
+
+        // The pool is ordered by when assets were parked, so if the oldest hasn't timed out
+        // none of the others have either.
+        if (!over_limit && !timed_out)
         {
-            loader->unload(state->instance);
+            break;
         }
-        state->instance = nullptr;
+
+        unpark_lockless(state, true);
     }
 
-    g_tls_current_post_load_asset = old_state;
+    submit_keep_alive_statistics();
+}
 
-    return success;
+void asset_manager::submit_keep_alive_statistics()
+{
+    if (m_stats_parked_bytes)
+    {
+        size_t requests = m_keep_alive_hits + m_keep_alive_misses;
+
+        m_stats_parked_bytes->submit(m_parked_bytes);
+        m_stats_parked_assets->submit(m_parked_states.size());
+        m_stats_keep_alive_hit_rate->submit(requests > 0 ? m_keep_alive_hits / static_cast<double>(requests) : 0.0);
+        m_stats_reloads_avoided->submit(m_keep_alive_hits);
+        m_stats_keep_alive_evictions->submit(m_keep_alive_evictions);
+    }
 }
 
-void asset_manager::check_dependency_load_state(asset_state* state)
+void asset_manager::begin_load_trace(const char* name)
 {
-    db_assert(state->loading_state == asset_loading_state::waiting_for_dependencies);
+    std::scoped_lock lock(m_load_trace_mutex);
+    m_load_trace = std::make_unique<asset_load_trace>(name);
+}
 
-    bool all_loaded = are_dependencies_loaded(state);
+std::unique_ptr<asset_load_trace> asset_manager::end_load_trace()
+{
+    std::unique_ptr<asset_load_trace> trace;
+    {
+        std::scoped_lock lock(m_load_trace_mutex);
+        trace = std::move(m_load_trace);
+    }
+
+    if (!trace)
+    {
+        return nullptr;
+    }
+
+    trace->finish();
+
+    // Fill in the dependency graph and types so the trace can work out the critical path.
+    std::unique_lock lock(m_states_mutex);
 
-    if (all_loaded)
+    for (asset_state* state : m_states)
     {
-        // TODO: Move this out of the lock, right now post-load is serialized.
-        if (!post_load_asset(state))
+        if (state->is_for_hot_reload || !trace->has_asset(state->path))
         {
-            set_load_state(state, asset_loading_state::failed);
+            continue;
+        }
 
+        std::vector<std::string> dependencies;
+        for (asset_state* dependency : state->dependencies)
+        {
+            dependencies.push_back(dependency->path);
+        }
+
+        asset_loader* loader = get_loader_for_type(state->type_id);
+        trace->set_asset_info(state->path, loader ? loader->get_descriptor_type() : "", dependencies);
+    }
+
+    return trace;
+}
+
+void asset_manager::trace_load_phase(asset_state* state, asset_load_phase phase)
+{
+    if (state->is_for_hot_reload)
+    {
+        return;
+    }
+
+    std::scoped_lock lock(m_load_trace_mutex);
+    if (m_load_trace)
+    {
+        m_load_trace->begin_phase(state->path, phase, task_scheduler::get_current_worker_index());
+    }
+}
+
+void asset_manager::trace_load_end(asset_state* state, bool failed)
+{
+    if (state->is_for_hot_reload)
+    {
+        return;
+    }
+
+    std::scoped_lock lock(m_load_trace_mutex);
+    if (m_load_trace)
+    {
+        m_load_trace->end_asset(state->path, failed);
+    }
+}
+
+void asset_manager::wait_for_load(const asset_state* state)
+{
+    std::unique_lock lock(m_states_mutex);
+
+    while (true)
+    {
+        if (state->loading_state == asset_loading_state::loaded ||
+            state->loading_state == asset_loading_state::failed)
+        {
+            return;
+        }
+
+        m_states_convar.wait(lock);
+    }
+}
+
+void asset_manager::do_work()
+{
+    std::unique_lock lock(m_states_mutex);
+
+    while (!m_shutting_down)
+    {
+        if (!m_parked_states.empty())
+        {
+            evict_parked_lockless(get_keep_alive_budget(), get_keep_alive_max_count());
+        }
+
+        if (m_outstanding_ops.load() < m_max_concurrent_ops)
+        {
+            if (!m_pending_queue.empty())
+            {
+                asset_state* state = m_pending_queue.pop();
+                state->is_pending = false;
+
+                submit_queue_statistics(state);
+
+                process_asset(state, false);
+
+                // Processing may not have started any operation that would notify those waiting
+                // for the queue to drain (eg. if the asset no longer needs loading), so wake them here.
+                if (m_pending_queue.empty())
+                {
+                    m_states_convar.notify_all();
+                }
+
+                continue;
+            }
+        }
+
+        // Parked assets need to be periodically checked to see if they have timed out.
+        if (m_parked_states.empty())
+        {
+            m_states_convar.wait(lock);
         }
         else
         {
-            set_load_state(state, asset_loading_state::loaded);
+            m_states_convar.wait_for(lock, std::chrono::milliseconds(static_cast<int>(k_keep_alive_check_interval * 1000.0)));
+        }
+    }
+}
+
+void asset_manager::process_asset(asset_state* state, bool release_operation_reference)
+{
+    std::scoped_lock lock(state->process_mutex);
+
+    // If we are at the end of an operation we reduce the operation count here while
+    // under the process_mutex to avoid race conditions.
+    if (release_operation_reference)
+    {
+        state->current_operations.fetch_sub(1);
+        db_verbose(asset, "[%s] Reduced operation count to %zi", state->path.c_str(), state->current_operations.load());
+    }
+
+    // A different thread is already operating on this asset. We don't need to do anything
+    // here as they will handle processing the asset when they finish.
+    if (state->current_operations.load() > 0)
+    {
+        db_verbose(asset, "[%s] Skipping process as operation count is %zi", state->path.c_str(), state->current_operations.load());
+        return;
+    }
+
+    switch (state->loading_state)
+    {
+    case asset_loading_state::loaded:
+        {
+            if (!state->should_be_loaded)
+            {
+                begin_unload(state);
+            }
+            break;
+        }
+    case asset_loading_state::unloaded:
+        {
+            if (state->should_be_loaded)
+            {
+                begin_load(state);
+            }
+            break;
+        }
+    case asset_loading_state::failed:
+        {
+            // We do nothing to failed assets, they sit in
+            // this state and return a default asset if available.
+
+            break;
+        }
+    case asset_loading_state::waiting_for_dependencies:
+        {
+            // Do nothing while waiting for dependencies, the assets we depend on will move us out of this state.
+            break;
+        }
+    default:
+        {
+            db_assert(false);
+            break;
         }
+    }
+}
+
+void asset_manager::begin_load(asset_state* state)
+{
+    db_assert(state->loading_state == asset_loading_state::unloaded)
+    set_load_state(state, asset_loading_state::loading);
 
-        // Propogate the load upwards to any parents that depend on us.
-        for (asset_state* parent : state->depended_on_by)
+    if (!state->is_for_hot_reload)
+    {
+        m_keep_alive_misses++;
+    }
+
+    m_outstanding_ops.fetch_add(1);
+
+    state->current_operations.fetch_add(1);
+
+    async("Load Asset", task_queue::loading, task_priority::low, load_asset(state));
+}
+
+coroutine_task asset_manager::load_asset(asset_state* state)
+{
+    bool completed = true;
+
+    if (is_load_cancelled(state))
+    {
+        db_verbose(asset, "[%s] Cancelled load, asset is no longer referenced.", state->path.c_str());
+        completed = false;
+    }
+    else if (asset_loader* loader = get_loader_for_type(state->type_id); loader == nullptr)
+    {
+        db_error(asset, "[%s] Failed to find loader for asset type.", state->path.c_str());
+    }
+    else
+    {
+        trace_load_phase(state, asset_load_phase::loading);
+
+        asset_cache_key cache_key;
+        std::string compiled_path;
+        bool needs_validation = false;
+
+        bool resolved = find_compiled_asset(loader, state, cache_key, compiled_path, needs_validation);
+        if (resolved && needs_validation)
+        {
+            // Read the header of the compiled asset to check if it's out of date. The worker is
+            // free to run other tasks while waiting on the disk.
+            compiled_asset_header header;
+            bool has_header = false;
+
+            if (async_io_request::ptr request = request_compiled_header(compiled_path))
+            {
+                co_await request;
+                has_header = (!request->has_failed() && loader->load_header(request->data(), header));
+            }
+
+            resolved = resolve_compiled_asset(loader, state, cache_key, compiled_path, has_header ? &header : nullptr, nullptr);
+        }
+
+        if (!resolved)
         {
-            if (parent->loading_state == asset_loading_state::waiting_for_dependencies)
+            if (is_load_cancelled(state))
             {
-                check_dependency_load_state(parent);
+                db_verbose(asset, "[%s] Cancelled load, asset is no longer referenced.", state->path.c_str());
+                completed = false;
             }
+            else
+            {
+                db_error(asset, "[%s] Failed to determine compiled asset path.", state->path.c_str());
+            }
+        }
+        else
+        {
+            completed = do_load(state, loader, compiled_path);
+        }
+    }
+
+    // Wait for anything requested by load_dependencies before running post-load. The 
+    // task is resumed by whichever dependency finishes loading last.
+    if (completed && state->instance)
+    {
+        co_await dependency_awaiter{ this, state };
+    }
+
+    // Post-load runs outside the lock so different assets can post-load in parallel. Nothing
+    // else touches the state while our operation is outstanding, process_asset skips it and it
+    // can't be deleted, and our dependencies are loaded and kept alive by our references.
+    bool post_loaded = false;
+    if (completed && state->instance)
+    {
+        post_loaded = post_load_asset(state);
+    }
+
+    {
+        std::unique_lock lock(m_states_mutex);
+
+        asset_loading_state new_state;
+        if (!completed)
+        {
+            // Nothing references the asset anymore so the load was abandoned, it goes back
+            // to being unloaded so it can be requested again later.
+            m_cancelled_loads++;
+            submit_queue_statistics(nullptr);
+
+            new_state = asset_loading_state::unloaded;
+        }
+        else if (post_loaded)
+        {
+            new_state = asset_loading_state::loaded;
+        }
+        else
+        {
+            new_state = asset_loading_state::failed;
         }
 
+        // Loads that waited for dependencies already gave up their operation slot.
+        if (state->loading_state == asset_loading_state::waiting_for_dependencies)
+        {
+            m_suspended_loads--;
+        }
+        else
+        {
+            m_outstanding_ops.fetch_sub(1);
+        }
+
+        // Resumes anything waiting for us to load.
+        set_load_state(state, new_state);
+
         // Process the asset again incase the requested state
         // has changed during this process.
-        process_asset(state, false);
+        process_asset(state, true);
+
+        // If nothing has requested the asset again since the load was cancelled then nothing
+        // will ever process the state again, so remove it the same way as a final unload.
+        if (!completed && state->references == 0 && state->current_operations.load() == 0)
+        {
+            delete_state(state);
+        }
 
         m_states_convar.notify_all();
     }
 }
 
+bool asset_manager::suspend_until_dependencies_loaded(asset_state* state)
+{
+    task_scheduler& scheduler = task_scheduler::get();
+
+    std::unique_lock lock(m_states_mutex);
+
+    size_t wait_count = 0;
+    for (asset_state* child : state->dependencies)
+    {
+        if (child->loading_state != asset_loading_state::loaded &&
+            child->loading_state != asset_loading_state::failed)
+        {
+            wait_count++;
+        }
+    }
+
+    if (wait_count == 0)
+    {
+        return false;
+    }
+
+    set_load_state(state, asset_loading_state::waiting_for_dependencies);
+    trace_load_phase(state, asset_load_phase::waiting_for_dependencies);
+
+    // Our dependencies may be queued behind us, so give up our operation slot while we wait
+    // otherwise enough waiting loads could stop anything else from starting.
+    m_outstanding_ops.fetch_sub(1);
+    m_suspended_loads++;
+    m_states_convar.notify_all();
+
+    task_index_t task_index = scheduler.begin_suspend_task(wait_count);
+
+    for (asset_state* child : state->dependencies)
+    {
+        if (child->loading_state != asset_loading_state::loaded &&
+            child->loading_state != asset_loading_state::failed)
+        {
+            child->load_waiters.push_back(task_index);
+        }
+    }
+
+    lock.unlock();
+
+    return scheduler.end_suspend_task(task_index);
+}
+
+void asset_manager::resume_load_waiters(asset_state* state)
+{
+    std::vector<task_index_t> waiters = std::move(state->load_waiters);
+    state->load_waiters.clear();
+
+    for (task_index_t task_index : waiters)
+    {
+        task_scheduler::get().resume_suspended_task(task_index);
+    }
+}
+
+bool asset_manager::post_load_asset(asset_state* state)
+{
+    // Mark which asset is being post_load'd so we can handle things
+    // differently in dependent assets are loaded during post_load.
+    asset_state* old_state = g_tls_current_post_load_asset;
+    g_tls_current_post_load_asset = state;
+
+    trace_load_phase(state, asset_load_phase::post_load);
+
+    bool success = false;
+    if (state->instance->post_load())
+    {
+        success = true;
+    }
+    else
+    {
+        asset_loader* loader = get_loader_for_type(state->type_id);
+        if (loader)
+        {
+            loader->unload(state->instance);
+        }
+        state->instance = nullptr;
+    }
+
+    g_tls_current_post_load_asset = old_state;
+
+    return success;
+}
+
 void asset_manager::begin_unload(asset_state* state)
 {
     db_assert(state->loading_state == asset_loading_state::loaded);
@@ -668,7 +1358,7 @@ void asset_manager::begin_unload(asset_state* state)
 
     state->current_operations.fetch_add(1);
 
-    async("Unload Asset", task_queue::loading, [this, state]() {
+    async("Unload Asset", task_queue::loading, task_priority::low, [this, state]() {
     
         do_unload(state);
 
@@ -678,21 +1368,6 @@ void asset_manager::begin_unload(asset_state* state)
             // This is the final unload, nuke the state completely.
             if (state->references == 0)
             {
-                // Remove reference from all assets we depend on.
-                for (asset_state* dependent : state->dependencies)
-                {
-                    auto iter = std::find(dependent->depended_on_by.begin(), dependent->depended_on_by.end(), state);
-                    db_assert(iter != dependent->depended_on_by.end());
-
-                    // Release the ref the parent gained on the child in create_asset_state.
-                    decrement_ref(dependent, true);
-
-                    dependent->depended_on_by.erase(iter);
-                }
-
-                state->dependencies.clear();
-
-                // Nuke the state.
                 delete_state(state);
             }
             else
@@ -713,6 +1388,21 @@ void asset_manager::begin_unload(asset_state* state)
 
 void asset_manager::delete_state(asset_state* state)
 {
+    // Remove reference from all assets we depend on.
+    std::vector<asset_state*> dependencies = std::move(state->dependencies);
+    state->dependencies.clear();
+
+    for (asset_state* dependent : dependencies)
+    {
+        auto iter = std::find(dependent->depended_on_by.begin(), dependent->depended_on_by.end(), state);
+        db_assert(iter != dependent->depended_on_by.end());
+        dependent->depended_on_by.erase(iter);
+
+        // Release the ref the parent gained on the child in create_asset_state. This is done last
+        // as it may delete the child if nothing else references it.
+        decrement_ref(dependent, true);
+    }
+
     if (state->hot_reload_state)
     {
         decrement_ref(state->hot_reload_state, true);
@@ -723,6 +1413,14 @@ void asset_manager::delete_state(asset_state* state)
     {
         m_hot_reload_queue.erase(iter);
     }
+    if (state->queue_index != asset_state::k_not_queued)
+    {
+        m_pending_queue.remove(state);
+    }
+    if (state->is_parked)
+    {
+        unpark_lockless(state, false);
+    }
     m_states.erase(std::find(m_states.begin(), m_states.end(), state));
     delete state;
 }
@@ -742,7 +1440,7 @@ bool asset_manager::search_cache_for_key(const asset_cache_key& cache_key, std::
             {
                 size_t best_cache = std::numeric_limits<size_t>::max();
 
-                for (size_t j = 0; j < i; i++)
+                for (size_t j = 0; j < i; j++)
                 {
                     registered_cache& other_cache = m_caches[j];
                     if (!other_cache.cache->is_read_only())
@@ -772,16 +1470,17 @@ bool asset_manager::search_cache_for_key(const asset_cache_key& cache_key, std::
 bool asset_manager::compile_asset(asset_cache_key& cache_key, asset_loader* loader, asset_state* state, std::string& compiled_path)
 {
     std::string temporary_path = string_format("temp:%s", to_string(guid::generate()).c_str());
-    
-    asset_flags flags = asset_flags::none;
-    if (state->is_for_hot_reload)
-    {
-        flags = static_cast<asset_flags>(static_cast<size_t>(flags) | static_cast<size_t>(asset_flags::hot_reload));
-    }
 
-    if (!loader->compile(state->path.c_str(), temporary_path.c_str(), m_asset_platform, m_asset_config, flags))
+    if (!loader->compile(state->path.c_str(), temporary_path.c_str(), m_asset_platform, m_asset_config, get_asset_flags(state)))
     {
         db_error(asset, "[%s] Failed to compile asset.", state->path.c_str());
+
+        // Anything written may be incomplete, so make sure it can't be picked up later.
+        if (virtual_file_system::get().exists(temporary_path.c_str()))
+        {
+            virtual_file_system::get().remove(temporary_path.c_str());
+        }
+
         return false;
     }
     else
@@ -825,15 +1524,37 @@ bool asset_manager::compile_asset(asset_cache_key& cache_key, asset_loader* load
     return true;
 }
 
-bool asset_manager::get_asset_compiled_path(asset_loader* loader, asset_state* state, std::string& compiled_path)
+asset_flags asset_manager::get_asset_flags(asset_state* state)
 {
-    asset_cache_key cache_key;
-
     asset_flags flags = asset_flags::none;
     if (state->is_for_hot_reload)
     {
         flags = static_cast<asset_flags>(static_cast<size_t>(flags) | static_cast<size_t>(asset_flags::hot_reload));
     }
+    return flags;
+}
+
+bool asset_manager::get_asset_compiled_path(asset_loader* loader, asset_state* state, std::string& compiled_path, bool* was_compiled)
+{
+    asset_cache_key cache_key;
+    bool needs_validation = false;
+
+    if (!find_compiled_asset(loader, state, cache_key, compiled_path, needs_validation))
+    {
+        return false;
+    }
+
+    if (needs_validation)
+    {
+        return resolve_compiled_asset(loader, state, cache_key, compiled_path, nullptr, was_compiled);
+    }
+
+    return true;
+}
+
+bool asset_manager::find_compiled_asset(asset_loader* loader, asset_state* state, asset_cache_key& cache_key, std::string& compiled_path, bool& needs_validation)
+{
+    needs_validation = false;
 
     std::string with_compiled_extension = state->path + k_compiled_asset_extension;
 
@@ -847,7 +1568,7 @@ bool asset_manager::get_asset_compiled_path(asset_loader* loader, asset_state* s
     else if (!m_caches.empty())
     {
         // Generate a key with no dependencies.
-        if (!loader->get_cache_key(state->path.c_str(), m_asset_platform, m_asset_config, flags, cache_key, { }))
+        if (!loader->get_cache_key(state->path.c_str(), m_asset_platform, m_asset_config, get_asset_flags(state), cache_key, { }))
         {
             db_error(asset, "[%s] Failed to calculate cache key for asset.", state->path.c_str());
             return false;
@@ -856,117 +1577,185 @@ bool asset_manager::get_asset_compiled_path(asset_loader* loader, asset_state* s
         // Search for key with no dependencies in cache.
         search_cache_for_key(cache_key, compiled_path);
 
-        bool needs_compile = false;
+        needs_validation = true;
+    }
 
-        // Always compile if no compiled asset is found.
-        if (compiled_path.empty())
-        {
-            db_log(asset, "[%s] No compiled version available, compiling now.", state->path.c_str());
-            needs_compile = true;
-        }
-        // If compile asset exists, read the dependency header block and generate a cache key from the data
-        // if it differs from the one in the header, we need to rebuild it.
-        else
-        {
-            compiled_asset_header header;
+    return true;
+}
 
-            if (!loader->load_header(compiled_path.c_str(), header))
+bool asset_manager::resolve_compiled_asset(asset_loader* loader, asset_state* state, asset_cache_key& cache_key, std::string& compiled_path, const compiled_asset_header* header, bool* was_compiled)
+{
+    bool needs_compile = false;
+
+    // Always compile if no compiled asset is found.
+    if (compiled_path.empty())
+    {
+        db_log(asset, "[%s] No compiled version available, compiling now.", state->path.c_str());
+        needs_compile = true;
+    }
+    // If compile asset exists, read the dependency header block and generate a cache key from the data
+    // if it differs from the one in the header, we need to rebuild it.
+    else
+    {
+        compiled_asset_header read_header;
+
+        if (header == nullptr)
+        {
+            if (!loader->load_header(compiled_path.c_str(), read_header))
             {
                 db_error(asset, "[%s] Failed to read header from compiled asset: %s", state->path.c_str(), compiled_path.c_str());
                 return false;
             }
 
-            asset_cache_key compiled_cache_key;
-            if (!loader->get_cache_key(state->path.c_str(), m_asset_platform, m_asset_config, flags, compiled_cache_key, header.dependencies))
+            header = &read_header;
+        }
+
+        asset_cache_key compiled_cache_key;
+        if (!loader->get_cache_key(state->path.c_str(), m_asset_platform, m_asset_config, get_asset_flags(state), compiled_cache_key, header->dependencies))
+        {
+            // This can fail if one of our dependencies has been deleted, in which case we know we need to rebuild.
+            db_warning(asset, "[%s] Failed to calculate dependency cache key for asset, recompile required.", state->path.c_str());
+            needs_compile = true;
+        }
+        else
+        {
+            state->cache_key = compiled_cache_key;
+
+            if (compiled_cache_key.hash() != header->compiled_hash)
             {
-                // This can fail if one of our dependencies has been deleted, in which case we know we need to rebuild.
-                db_warning(asset, "[%s] Failed to calculate dependency cache key for asset, recompile required.", state->path.c_str());
+                db_warning(asset, "[%s] Compiled asset looks to be out of date, recompile required.", state->path.c_str());
                 needs_compile = true;
             }
-            else
-            {
-                state->cache_key = compiled_cache_key;
+        }
+    }
 
-                if (compiled_cache_key.hash() != header.compiled_hash)
-                {
-                    db_warning(asset, "[%s] Compiled asset looks to be out of date, recompile required.", state->path.c_str());
-                    needs_compile = true;
-                }
-            }
+    // If no compiled version is available, compile to a temporary location.
+    if (needs_compile)
+    {
+        // Don't spend time compiling an asset nothing wants anymore.
+        if (is_load_cancelled(state))
+        {
+            return false;
         }
 
-        // If no compiled version is available, compile to a temporary location.
-        if (needs_compile)
+        set_load_state(state, asset_loading_state::compiling);
+        trace_load_phase(state, asset_load_phase::compiling);
+
+        bool result = compile_asset(cache_key, loader, state, compiled_path);
+
+        set_load_state(state, asset_loading_state::loading);
+        trace_load_phase(state, asset_load_phase::loading);
+
+        if (!result)
         {
-            set_load_state(state, asset_loading_state::compiling);
-            bool result = compile_asset(cache_key, loader, state, compiled_path);
-            set_load_state(state, asset_loading_state::loading);
+            return false;
+        }
 
-            if (!result)
-            {
-                return false;
-            }
-            
-            // Run through this function again to grab the correct cache key.
-            return get_asset_compiled_path(loader, state, compiled_path);
+        if (was_compiled)
+        {
+            *was_compiled = true;
         }
+        
+        // Run through this function again to grab the correct cache key.
+        return get_asset_compiled_path(loader, state, compiled_path, was_compiled);
     }
 
     return true;
 }
 
-void asset_manager::do_load(asset_state* state)
+async_io_request::ptr asset_manager::request_compiled_header(const std::string& compiled_path)
 {
-    asset_loader* loader = get_loader_for_type(state->type_id);
-    if (loader != nullptr)
+    async_io_manager* io_manager = async_io_manager::try_get();
+    if (io_manager == nullptr)
     {
-        std::string compiled_path;
+        return nullptr;
+    }
 
-        if (!get_asset_compiled_path(loader, state, compiled_path))
-        {
-            db_error(asset, "[%s] Failed to determine compiled asset path.", state->path.c_str());
-            return;
-        }
+    // Only assets stored directly on disk can be read asynchronously.
+    std::string disk_path = virtual_file_system::get().get_disk_location(compiled_path.c_str());
+    if (disk_path.empty())
+    {
+        return nullptr;
+    }
 
-        // Load the resulting compiled asset.
-        if (!compiled_path.empty())
-        {
-            memory_scope scope(memory_type::asset, string_hash(state->path));
+    std::error_code error;
+    size_t file_size = static_cast<size_t>(std::filesystem::file_size(disk_path, error));
+    if (error || file_size == 0)
+    {
+        return nullptr;
+    }
 
-            state->instance = loader->load(compiled_path.c_str());
+    return io_manager->request(disk_path.c_str(), 0, std::min(file_size, k_compiled_header_read_size), async_io_request_options::none);
+}
 
-            if (state->instance)
-            {
-                // Mark which asset is being load_dependencies'd so we can handle things
-                // differently in dependent assets are loaded during load_dependencies.
-                asset_state* old_state = g_tls_current_load_dependencies_asset;
-                g_tls_current_load_dependencies_asset = state;
+asset_cook_result asset_manager::cook_asset(const char* path, asset_loader* loader)
+{
+    // The state is only used to carry the path and cache key through the compile, it's never
+    // registered so nothing else can observe it.
+    asset_state state;
+    state.path = path;
+    state.type_id = &loader->get_type();
+    state.loading_state = asset_loading_state::loading;
+    state.should_be_loaded = true;
+
+    std::string compiled_path;
+    bool was_compiled = false;
+
+    if (!get_asset_compiled_path(loader, &state, compiled_path, &was_compiled))
+    {
+        return asset_cook_result::failed;
+    }
 
-                // Allow instance to load any dependent assets.
-                if (!state->instance->load_dependencies())
-                {
-                    db_error(asset, "[%s] Failed to load asset dependencies.", state->path.c_str());
+    return was_compiled ? asset_cook_result::compiled : asset_cook_result::up_to_date;
+}
 
-                    loader->unload(state->instance);
-                    state->instance = nullptr;
-                }
+bool asset_manager::do_load(asset_state* state, asset_loader* loader, const std::string& compiled_path)
+{
+    if (compiled_path.empty())
+    {
+        db_error(asset, "[%s] Failed to find compiled data for asset.", state->path.c_str());
+        return true;
+    }
 
-                g_tls_current_load_dependencies_asset = old_state;
-            }
-            else
-            {
-                db_error(asset, "[%s] Loader failed to load asset.", state->path.c_str());
-            }
-        }
-        else
+    memory_scope scope(memory_type::asset, string_hash(state->path));
+
+    state->instance = loader->load(compiled_path.c_str());
+
+    // Last chance to cancel, once dependencies are requested they have to be followed through.
+    if (state->instance && is_load_cancelled(state))
+    {
+        db_verbose(asset, "[%s] Cancelled load, asset is no longer referenced.", state->path.c_str());
+
+        loader->unload(state->instance);
+        state->instance = nullptr;
+
+        return false;
+    }
+
+    if (state->instance)
+    {
+        // Mark which asset is being load_dependencies'd so we can handle things
+        // differently in dependent assets are loaded during load_dependencies.
+        asset_state* old_state = g_tls_current_load_dependencies_asset;
+        g_tls_current_load_dependencies_asset = state;
+
+        // Allow instance to load any dependent assets.
+        if (!state->instance->load_dependencies())
         {
-            db_error(asset, "[%s] Failed to find compiled data for asset.", state->path.c_str());
+            db_error(asset, "[%s] Failed to load asset dependencies.", state->path.c_str());
+
+            loader->unload(state->instance);
+            state->instance = nullptr;
         }
+
+        g_tls_current_load_dependencies_asset = old_state;
     }
     else
     {
-        db_error(asset, "[%s] Failed to find loader for asset type.", state->path.c_str());
+        db_error(asset, "[%s] Loader failed to load asset.", state->path.c_str());
     }
+
+    return true;
 }
 
 void asset_manager::do_unload(asset_state* state)
@@ -1023,6 +1812,19 @@ void asset_manager::set_load_state(asset_state* state, asset_loading_state new_s
         db_log(asset, "[%s] Loaded in %.2f ms", state->path.c_str(), state->load_timer.get_elapsed_ms());
     }
 
+    if (new_state == asset_loading_state::loaded ||
+        new_state == asset_loading_state::failed ||
+        (new_state == asset_loading_state::unloaded && old_state == asset_loading_state::loading))
+    {
+        trace_load_end(state, new_state == asset_loading_state::failed);
+    }
+
+    if (new_state == asset_loading_state::loaded ||
+        new_state == asset_loading_state::failed)
+    {
+        resume_load_waiters(state);
+    }
+
     if (!state->is_for_hot_reload)
     {
         if (new_state == asset_loading_state::loaded)
@@ -10,23 +10,29 @@
 #include "workshop.core/utils/singleton.h"
 #include "workshop.core/utils/yaml.h"
 #include "workshop.core/filesystem/stream.h"
+#include "workshop.core/memory/memory_budgets.h"
+#include "workshop.core/async/task_coroutine.h"
 #include "workshop.assets/asset_loader.h"
 #include "workshop.assets/asset_importer.h"
 #include "workshop.assets/asset_cache.h"
+#include "workshop.assets/asset_load_trace.h"
 
 #include <thread>
 #include <string>
 #include <vector>
+#include <list>
 #include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
 #include <typeindex>
+#include <limits>
 
 namespace ws {
 
 class asset;
 class asset_manager;
+class statistics_channel;
 
 // Loading state of an asset.
 enum class asset_loading_state
@@ -52,6 +58,14 @@ static const char* asset_loading_state_strings[static_cast<int>(asset_loading_st
     "failed",
 };
 
+// Result of ensuring an asset is compiled with asset_manager::cook_asset.
+enum class asset_cook_result
+{
+    up_to_date,
+    compiled,
+    failed,
+};
+
 // Internal state representing the current loading state of an asset.
 struct asset_state
 {
@@ -87,6 +101,69 @@ struct asset_state
     event<> on_change_callback;
 
     timer load_timer;
+
+    // Priority the state is ordered by in the pending queue. This is the requested priority
+    // boosted by any assets that are waiting on this one to load as a dependency.
+    int32_t effective_priority = 0;
+
+    // Position of the state in the pending queue, or k_not_queued if its not in it.
+    static inline constexpr size_t k_not_queued = std::numeric_limits<size_t>::max();
+    size_t queue_index = k_not_queued;
+    size_t queue_sequence = 0;
+    double queue_time = 0.0;
+
+    // Set while the asset has no references but is being kept loaded in the keep alive
+    // pool in case its requested again. 
+    bool is_parked = false;
+    double parked_time = 0.0;
+    size_t parked_bytes = 0;
+    std::list<asset_state*>::iterator parked_iter;
+
+    // Suspended load tasks of assets that depend on this one, resumed once this asset
+    // has loaded or failed to load.
+    std::vector<task_index_t> load_waiters;
+};
+
+// ================================================================================================
+//  Binary max-heap of asset states waiting to be processed, ordered by effective priority
+//  and then by the order they were queued in. Each state tracks its own index in the heap
+//  so it can be removed or re-prioritized without searching.
+// 
+//  This class is not thread safe, the asset manager only accesses it while holding its
+//  states mutex.
+// ================================================================================================
+class asset_pending_queue
+{
+public:
+
+    // Adds a state to the queue. The state must not already be queued.
+    void push(asset_state* state);
+
+    // Removes and returns the state with the highest priority.
+    asset_state* pop();
+
+    // Removes a state from anywhere in the queue.
+    void remove(asset_state* state);
+
+    // Moves a state to the correct position after its effective priority has changed.
+    void update(asset_state* state);
+
+    size_t size() const;
+    bool empty() const;
+
+private:
+
+    // Returns true if the state at index a should be processed before the state at index b.
+    bool is_before(size_t a, size_t b) const;
+
+    void swap(size_t a, size_t b);
+    void sift_up(size_t index);
+    void sift_down(size_t index);
+
+private:
+    std::vector<asset_state*> m_heap;
+    size_t m_next_sequence = 0;
+
 };
 
 // ================================================================================================
@@ -143,6 +220,10 @@ public:
     // Switches the asset being pointed to and invalidates the current asset held.
     void set_path(const char* path);
 
+    // Changes the priority of the asset in the loading queue, higher priorities are loaded first.
+    // This also raises the priority of any dependencies the asset is waiting on.
+    void set_priority(int32_t priority);
+
 protected:
 
     // Swaps the state this pointer holds for a different one.
@@ -239,16 +320,32 @@ public:
     // If the asset is not already loaded it will be queued for load, use the asset_ptr
     // interface returned to determine the current loading state.
     // 
-    // The higher the priority given the higher the asset will be in the loading queue.
+    // The higher the priority given the higher the asset will be in the loading queue. The 
+    // priority can be changed later with asset_ptr::set_priority. If all references to the
+    // asset are dropped before it finishes loading, the load is cancelled.
     template<typename T>
     asset_ptr<T> request_asset(const char* path, int32_t priority)
     {
         return asset_ptr<T>(this, create_asset_state(typeid(T), path, priority, false));
     }
 
-    // Blocks until all pending asset operations have completed.
+    // Blocks until all pending asset operations have completed. Any assets being kept
+    // alive without references are unloaded first.
     void drain_queue();
 
+    // Ensures an up to date compiled version of the asset at the given path exists in the caches,
+    // compiling it with the given loader if required, without loading the asset. This is used
+    // to compile assets ahead of time and can be called from any thread, the caller is 
+    // responsible for not cooking the same asset on multiple threads at once.
+    asset_cook_result cook_asset(const char* path, asset_loader* loader);
+
+    // Starts recording how long every asset spends in each phase of loading, see asset_load_trace.
+    // Any trace already being recorded is discarded.
+    void begin_load_trace(const char* name);
+
+    // Stops recording the current load trace and returns it, or nullptr if no trace was being recorded.
+    std::unique_ptr<asset_load_trace> end_load_trace();
+
     // Returns true if any hot reloads are pending and apply_hot_reloads is needed.
     bool has_pending_hot_reloads();
 
@@ -324,10 +421,6 @@ protected:
     template <typename value_type>
     friend void yaml_serialize(YAML::Node& out, bool is_loading, asset_ptr_base& value);
 
-    // Called for assets in waiting_for_depencies state to check if 
-    // they can now proceed to the loading state or not.
-    void check_dependency_load_state(asset_state* state);
-
     // Increments the reference count for a given asset state. May trigger a load.
     void increment_ref(asset_state* state, bool state_lock_held = false);
 
@@ -350,12 +443,62 @@ protected:
     void request_load_lockless(asset_state* state);
 
     // Requests to start unloading a given asset state, should only be called by asset_ptr.
+    // If allow_keep_alive is set the asset may be kept loaded in the keep alive pool instead.
     void request_unload(asset_state* state);
-    void request_unload_lockless(asset_state* state);
+    void request_unload_lockless(asset_state* state, bool allow_keep_alive = true);
 
     // Blocks until the given asset is either loaded or load has failed.
     void wait_for_load(const asset_state* state);
 
+    // Changes the requested priority of an asset, should only be called by asset_ptr.
+    void set_priority(asset_state* state, int32_t priority);
+
+    // Calculates the priority a state should be queued with, taking into account any
+    // assets waiting on it.
+    int32_t calculate_effective_priority(asset_state* state);
+
+    // Recalculates the effective priority of a state, repositioning it in the pending queue and
+    // propagating the change to its dependencies if it changes.
+    void update_effective_priority(asset_state* state, size_t depth = 0);
+
+    // Returns true if an in progress load should be abandoned as nothing wants the asset anymore.
+    bool is_load_cancelled(asset_state* state);
+
+    // Submits the current queue statistics.
+    void submit_queue_statistics(asset_state* popped_state);
+
+    // Gets the maximum number of bytes that unreferenced assets can be kept loaded with.
+    size_t get_keep_alive_budget();
+
+    // Gets the maximum number of unreferenced assets that can be kept loaded. This is only limited
+    // when there is no memory tracker to measure assets against the budget with.
+    size_t get_keep_alive_max_count();
+
+    // Calculates the memory an asset will hold while parked. This includes any dependencies that
+    // are only depended on by the asset (or other parked assets), as they stay loaded for as long
+    // as the asset holds its references to them.
+    size_t calculate_parked_bytes(asset_state* state);
+
+    // Keeps an asset that has lost all its references loaded in the keep alive pool
+    // rather than unloading it. Returns false if the asset cannot be kept alive.
+    bool park_lockless(asset_state* state);
+
+    // Removes an asset from the keep alive pool. If evict is set the asset is unloaded.
+    void unpark_lockless(asset_state* state, bool evict);
+
+    // Evicts assets from the keep alive pool that have timed out, then evicts the least
+    // recently used until the pool is within the given limits.
+    void evict_parked_lockless(size_t max_bytes, size_t max_count);
+
+    // Submits the current keep alive pool statistics.
+    void submit_keep_alive_statistics();
+
+    // Records an asset entering a new phase of loading in the active load trace.
+    void trace_load_phase(asset_state* state, asset_load_phase phase);
+
+    // Records an asset finishing loading in the active load trace.
+    void trace_load_end(asset_state* state, bool failed);
+
     // Runs on the load thread, queues up new loads and unloads.
     void do_work();
 
@@ -371,9 +514,14 @@ protected:
     // Called on coordinator thread.
     void begin_unload(asset_state* state);
 
-    // Performs the actual asset load.
+    // Loads the asset as a coroutine task. The worker is released while waiting on the disk
+    // and while waiting for dependencies to load.
+    // Called on worker thread.
+    coroutine_task load_asset(asset_state* state);
+
+    // Performs the actual asset load from its compiled data. Returns false if the load was cancelled.
     // Called on worker thread.
-    void do_load(asset_state* state);
+    bool do_load(asset_state* state, asset_loader* loader, const std::string& compiled_path);
 
     // Performs the actual asset unload.
     // Called on worker thread.
@@ -386,8 +534,24 @@ protected:
 
     // Tries to find the compiled version of an asset by looking through
     // all caches. If not available it will compile the asset and insert
-    // into into relevant caches.
-    bool get_asset_compiled_path(asset_loader* loader, asset_state* state, std::string& compiled_path);
+    // into into relevant caches. If was_compiled is provided it is set to true if the asset was compiled.
+    bool get_asset_compiled_path(asset_loader* loader, asset_state* state, std::string& compiled_path, bool* was_compiled = nullptr);
+
+    // First half of get_asset_compiled_path. Looks for a compiled version of the asset next to the source
+    // or in the caches. If needs_validation is set, resolve_compiled_asset must be called to check the
+    // compiled version is up to date and to compile it if it is missing.
+    bool find_compiled_asset(asset_loader* loader, asset_state* state, asset_cache_key& cache_key, std::string& compiled_path, bool& needs_validation);
+
+    // Second half of get_asset_compiled_path. Compiles the asset if it's missing or if the given header of
+    // the compiled version is out of date. If header is null it is read from compiled_path.
+    bool resolve_compiled_asset(asset_loader* loader, asset_state* state, asset_cache_key& cache_key, std::string& compiled_path, const compiled_asset_header* header, bool* was_compiled);
+
+    // Starts reading the start of a compiled asset through the async_io_manager so its header can be checked
+    // without blocking. Returns nullptr if the asset can't be read that way.
+    async_io_request::ptr request_compiled_header(const std::string& compiled_path);
+
+    // Gets the flags an asset should be compiled with.
+    asset_flags get_asset_flags(asset_state* state);
 
     // Searches for all asset caches for the given cache key and provides the path to the compiled
     // version if it exists. May migrate assets to closer caches in found in far caches.
@@ -396,6 +560,24 @@ protected:
     // Checks if all dependencies of an asset have finished loading.
     bool are_dependencies_loaded(asset_state* state);
 
+    // Awaitable that suspends a load task until all dependencies of its asset have finished loading.
+    struct dependency_awaiter
+    {
+        asset_manager* manager;
+        asset_state* state;
+
+        bool await_ready() { return false; }
+        bool await_suspend(std::coroutine_handle<> coroutine) { return manager->suspend_until_dependencies_loaded(state); }
+        void await_resume() {}
+    };
+
+    // Suspends the calling load task until all dependencies of the asset have finished loading. Returns false
+    // without suspending if they already have.
+    bool suspend_until_dependencies_loaded(asset_state* state);
+
+    // Resumes all load tasks waiting for the given asset to finish loading.
+    void resume_load_waiters(asset_state* state);
+
     // Checks if any dependencies failed to load.
     bool any_dependencies_failed(asset_state* state);
 
@@ -412,7 +594,8 @@ protected:
     // Queus a state for hot reload.
     void hot_reload(asset_state* state);
 
-    // Cleans up a state that has been unloaded and no longer required.
+    // Cleans up a state that has been unloaded and no longer required, releasing the references
+    // it holds on its dependencies.
     void delete_state(asset_state* state);
 
 private:
@@ -502,15 +685,56 @@ private:
     std::mutex m_states_mutex;
     std::condition_variable m_states_convar;
     std::vector<asset_state*> m_states;
-    std::vector<asset_state*> m_pending_queue;
+    asset_pending_queue m_pending_queue;
     std::vector<asset_state*> m_pending_hot_reload;
 
     std::vector<asset_state*> m_hot_reload_queue;
 
     size_t m_max_concurrent_ops = 32;
 
+    // How much higher than an asset waiting on its dependencies the dependencies are queued.
+    static inline constexpr int32_t k_dependency_priority_boost = 1;
+
+    // Limits how far priority changes are propagated through chains of dependencies.
+    static inline constexpr size_t k_max_priority_propagation_depth = 16;
+
+    size_t m_cancelled_loads = 0;
+
+    statistics_channel* m_stats_queue_depth = nullptr;
+    statistics_channel* m_stats_queue_wait_time = nullptr;
+    statistics_channel* m_stats_cancelled_loads = nullptr;
+
+    // Assets with no references that are being kept loaded, least recently used first.
+    std::list<asset_state*> m_parked_states;
+    size_t m_parked_bytes = 0;
+
+    // How often the keep alive pool is checked for assets that have timed out.
+    static inline constexpr double k_keep_alive_check_interval = 1.0;
+
+    size_t m_keep_alive_hits = 0;
+    size_t m_keep_alive_misses = 0;
+    size_t m_keep_alive_evictions = 0;
+
+    statistics_channel* m_stats_parked_bytes = nullptr;
+    statistics_channel* m_stats_parked_assets = nullptr;
+    statistics_channel* m_stats_keep_alive_hit_rate = nullptr;
+    statistics_channel* m_stats_reloads_avoided = nullptr;
+    statistics_channel* m_stats_keep_alive_evictions = nullptr;
+
+    event<const memory_budgets::budget_state&>::delegate_ptr m_memory_pressure_delegate;
+
+    std::mutex m_load_trace_mutex;
+    std::unique_ptr<asset_load_trace> m_load_trace;
+
     std::atomic_size_t m_outstanding_ops;
 
+    // Number of loads suspended waiting for their dependencies. These give up their place in
+    // m_outstanding_ops so the dependencies can load.
+    size_t m_suspended_loads = 0;
+
+    // How much of a compiled asset is read to check its header. If the header is larger it is read again in full.
+    static inline constexpr size_t k_compiled_header_read_size = 16 * 1024;
+
     std::thread m_load_thread;
 
     bool m_shutting_down = false;
@@ -621,6 +845,14 @@ inline void asset_ptr_base::set_path(const char* path)
     }
 }
 
+inline void asset_ptr_base::set_priority(int32_t priority)
+{
+    if (m_state)
+    {
+        m_asset_manager->set_priority(m_state, priority);
+    }
+}
+
 inline asset_ptr_base::asset_ptr_base()
     : m_asset_manager(nullptr)
     , m_state(nullptr)
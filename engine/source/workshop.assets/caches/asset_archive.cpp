@@ -0,0 +1,463 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.assets/caches/asset_archive.h"
+#include "workshop.core/filesystem/disk_stream.h"
+#include "workshop.core/filesystem/virtual_file_system.h"
+#include "workshop.core/containers/string.h"
+#include "workshop.core/hashing/guid.h"
+#include "workshop.core/debug/debug.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <zlib.h>
+
+namespace ws {
+
+namespace {
+
+size_t align_offset(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+bool write_padding(disk_stream& out, size_t alignment)
+{
+    static const std::vector<char> k_zeros(asset_archive::k_alignment, 0);
+
+    size_t padding = align_offset(out.position(), alignment) - out.position();
+    return out.write(k_zeros.data(), padding) == padding;
+}
+
+}; // namespace
+
+std::shared_ptr<asset_archive> asset_archive::open(const std::filesystem::path& path)
+{
+    // Entries are accessed in whatever order assets are loaded, so don't hint sequential access.
+    std::shared_ptr<mapped_file> file = mapped_file::open(path, false);
+    if (file == nullptr)
+    {
+        return nullptr;
+    }
+
+    std::span<uint8_t> data = file->data();
+    if (data.size() < sizeof(header))
+    {
+        db_error(asset, "Asset archive is truncated: %s", path.string().c_str());
+        return nullptr;
+    }
+
+    const header* archive_header = reinterpret_cast<const header*>(data.data());
+    if (archive_header->magic != k_magic || archive_header->version != k_version)
+    {
+        db_error(asset, "Asset archive has invalid header or is an unsupported version: %s", path.string().c_str());
+        return nullptr;
+    }
+
+    size_t toc_size = archive_header->entry_count * sizeof(toc_entry);
+    if (archive_header->toc_offset + toc_size > data.size() ||
+        archive_header->string_table_offset + archive_header->string_table_size > data.size())
+    {
+        db_error(asset, "Asset archive table of contents is out of bounds: %s", path.string().c_str());
+        return nullptr;
+    }
+
+    std::shared_ptr<asset_archive> archive(new asset_archive());
+    archive->m_path = path;
+    archive->m_file = file;
+    archive->m_entries = std::span<const toc_entry>(reinterpret_cast<const toc_entry*>(data.data() + archive_header->toc_offset), archive_header->entry_count);
+    archive->m_string_table = std::string_view(reinterpret_cast<const char*>(data.data() + archive_header->string_table_offset), archive_header->string_table_size);
+
+    for (const toc_entry& entry : archive->m_entries)
+    {
+        if (entry.name_offset + entry.name_length > archive->m_string_table.size() ||
+            entry.data_offset + entry.stored_size > data.size())
+        {
+            db_error(asset, "Asset archive entry is out of bounds: %s", path.string().c_str());
+            return nullptr;
+        }
+    }
+
+    db_log(asset, "Opened asset archive with %zi entries: %s", archive->m_entries.size(), path.string().c_str());
+
+    return archive;
+}
+
+result<void> asset_archive::write(const std::filesystem::path& path, std::vector<source_file> files, bool compress, int compression_level)
+{
+    // Names are normalized as paths passed to virtual file system handlers are.
+    for (source_file& file : files)
+    {
+        file.name = virtual_file_system::normalize(file.name.c_str());
+    }
+
+    std::sort(files.begin(), files.end(), [](const source_file& a, const source_file& b) {
+        return a.name < b.name;
+    });
+
+    // Write to a temporary file so nothing tries to read a partially written archive.
+    std::filesystem::path temporary_path = path;
+    temporary_path += string_format(".tmp_%s", to_string(guid::generate()).c_str());
+
+    disk_stream out;
+    if (!out.open(temporary_path, true))
+    {
+        db_error(asset, "Failed to open archive for writing: %s", temporary_path.string().c_str());
+        return false;
+    }
+
+    // Header is written last once we know where everything is.
+    header archive_header = {};
+    archive_header.magic = k_magic;
+    archive_header.version = k_version;
+    archive_header.entry_count = static_cast<uint32_t>(files.size());
+    archive_header.alignment = static_cast<uint32_t>(k_alignment);
+
+    std::vector<char> header_placeholder(k_alignment, 0);
+    out.write(header_placeholder.data(), header_placeholder.size());
+
+    std::vector<toc_entry> entries;
+    std::string string_table;
+    std::vector<uint8_t> buffer;
+    std::vector<uint8_t> compressed_buffer;
+    size_t compressed_count = 0;
+
+    for (source_file& file : files)
+    {
+        disk_stream in;
+        if (!in.open(file.path, false))
+        {
+            db_error(asset, "Failed to open file to add to archive: %s", file.path.string().c_str());
+            out.close();
+            std::filesystem::remove(temporary_path);
+            return false;
+        }
+
+        buffer.resize(in.length());
+        if (in.read(reinterpret_cast<char*>(buffer.data()), buffer.size()) != buffer.size())
+        {
+            db_error(asset, "Failed to read file to add to archive: %s", file.path.string().c_str());
+            out.close();
+            std::filesystem::remove(temporary_path);
+            return false;
+        }
+        in.close();
+
+        toc_entry& entry = entries.emplace_back();
+        entry.name_offset = string_table.size();
+        entry.name_length = static_cast<uint32_t>(file.name.size());
+        entry.flags = entry_flags::none;
+        entry.data_offset = out.position();
+        entry.stored_size = buffer.size();
+        entry.uncompressed_size = buffer.size();
+
+        string_table.append(file.name);
+
+        std::span<uint8_t> stored_data = buffer;
+
+        if (compress && !buffer.empty())
+        {
+            uLongf compressed_size = compressBound(static_cast<uLong>(buffer.size()));
+            compressed_buffer.resize(compressed_size);
+
+            int ret = compress2(compressed_buffer.data(), &compressed_size, buffer.data(), static_cast<uLong>(buffer.size()), compression_level);
+
+            // Only keep the compressed version if it saves more than an eighth of the size, otherwise
+            // its not worth the cost of decompressing or losing the ability to async read it.
+            if (ret == Z_OK && compressed_size < buffer.size() - (buffer.size() / 8))
+            {
+                entry.flags = entry_flags::compressed;
+                entry.stored_size = compressed_size;
+                stored_data = std::span<uint8_t>(compressed_buffer.data(), compressed_size);
+                compressed_count++;
+            }
+        }
+
+        if (out.write(reinterpret_cast<const char*>(stored_data.data()), stored_data.size()) != stored_data.size() ||
+            !write_padding(out, k_alignment))
+        {
+            db_error(asset, "Failed to write entry to archive: %s", file.name.c_str());
+            out.close();
+            std::filesystem::remove(temporary_path);
+            return false;
+        }
+    }
+
+    archive_header.toc_offset = out.position();
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(toc_entry));
+
+    archive_header.string_table_offset = out.position();
+    archive_header.string_table_size = string_table.size();
+    out.write(string_table.data(), string_table.size());
+
+    out.seek(0);
+    if (out.write(reinterpret_cast<const char*>(&archive_header), sizeof(archive_header)) != sizeof(archive_header))
+    {
+        db_error(asset, "Failed to write archive header: %s", temporary_path.string().c_str());
+        out.close();
+        std::filesystem::remove(temporary_path);
+        return false;
+    }
+
+    out.close();
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, path, error);
+    if (error)
+    {
+        db_error(asset, "Failed to rename archive to final path: %s", path.string().c_str());
+        std::filesystem::remove(temporary_path);
+        return false;
+    }
+
+    db_log(asset, "Wrote asset archive with %zi entries (%zi compressed): %s", entries.size(), compressed_count, path.string().c_str());
+
+    return true;
+}
+
+const asset_archive::toc_entry* asset_archive::find(std::string_view name)
+{
+    auto iter = std::lower_bound(m_entries.begin(), m_entries.end(), name, [this](const toc_entry& entry, std::string_view value) {
+        return get_name(entry) < value;
+    });
+
+    if (iter != m_entries.end() && get_name(*iter) == name)
+    {
+        return &(*iter);
+    }
+
+    return nullptr;
+}
+
+std::unique_ptr<stream> asset_archive::open_entry(std::string_view name)
+{
+    const toc_entry* entry = find(name);
+    if (entry == nullptr)
+    {
+        return nullptr;
+    }
+
+    std::span<uint8_t> stored_data = m_file->data().subspan(entry->data_offset, entry->stored_size);
+
+    if ((static_cast<uint32_t>(entry->flags) & static_cast<uint32_t>(entry_flags::compressed)) == 0)
+    {
+        return std::make_unique<asset_archive_stream>(m_file, stored_data, m_path.string(), entry->data_offset);
+    }
+
+    std::shared_ptr<std::vector<uint8_t>> buffer = std::make_shared<std::vector<uint8_t>>(entry->uncompressed_size);
+
+    uLongf uncompressed_size = static_cast<uLongf>(buffer->size());
+    int ret = uncompress(buffer->data(), &uncompressed_size, stored_data.data(), static_cast<uLong>(stored_data.size()));
+    if (ret != Z_OK || uncompressed_size != buffer->size())
+    {
+        db_error(asset, "Failed to decompress archive entry '%.*s', error %i.", static_cast<int>(name.size()), name.data(), ret);
+        return nullptr;
+    }
+
+    return std::make_unique<asset_archive_stream>(buffer, *buffer, "", 0);
+}
+
+std::string_view asset_archive::get_name(const toc_entry& entry)
+{
+    return m_string_table.substr(entry.name_offset, entry.name_length);
+}
+
+std::span<const asset_archive::toc_entry> asset_archive::get_entries()
+{
+    return m_entries;
+}
+
+const std::filesystem::path& asset_archive::get_path()
+{
+    return m_path;
+}
+
+asset_archive_stream::asset_archive_stream(std::shared_ptr<void> owner, std::span<uint8_t> data, const std::string& async_path, size_t async_offset)
+    : m_owner(owner)
+    , m_data(data)
+    , m_async_path(async_path)
+    , m_async_offset(async_offset)
+{
+}
+
+void asset_archive_stream::close()
+{
+    m_owner = nullptr;
+    m_data = {};
+}
+
+void asset_archive_stream::flush()
+{
+}
+
+bool asset_archive_stream::can_write()
+{
+    return false;
+}
+
+size_t asset_archive_stream::position()
+{
+    return m_position;
+}
+
+size_t asset_archive_stream::length()
+{
+    return m_data.size();
+}
+
+void asset_archive_stream::seek(size_t position)
+{
+    m_position = std::min(position, m_data.size());
+}
+
+size_t asset_archive_stream::write(const char* data, size_t size)
+{
+    db_assert_message(false, "Attempted to write to read-only archive stream.");
+    return 0;
+}
+
+size_t asset_archive_stream::read(char* data, size_t size)
+{
+    if (size > remaining())
+    {
+        return 0;
+    }
+
+    memcpy(data, m_data.data() + m_position, size);
+    m_position += size;
+
+    return size;
+}
+
+std::span<uint8_t> asset_archive_stream::read_view(size_t size)
+{
+    if (size > remaining())
+    {
+        return {};
+    }
+
+    std::span<uint8_t> result = m_data.subspan(m_position, size);
+    m_position += size;
+
+    return result;
+}
+
+std::shared_ptr<void> asset_archive_stream::get_view_owner()
+{
+    return m_owner;
+}
+
+std::string asset_archive_stream::get_async_path()
+{
+    return m_async_path;
+}
+
+size_t asset_archive_stream::get_async_offset()
+{
+    return m_async_offset + m_position;
+}
+
+virtual_file_system_archive_handler::virtual_file_system_archive_handler(std::shared_ptr<asset_archive> archive)
+    : m_archive(archive)
+{
+}
+
+std::unique_ptr<stream> virtual_file_system_archive_handler::open(const char* path, bool for_writing)
+{
+    if (for_writing)
+    {
+        return nullptr;
+    }
+
+    return m_archive->open_entry(path);
+}
+
+virtual_file_system_path_type virtual_file_system_archive_handler::type(const char* path)
+{
+    if (*path == '\0')
+    {
+        return virtual_file_system_path_type::directory;
+    }
+    else if (m_archive->find(path) != nullptr)
+    {
+        return virtual_file_system_path_type::file;
+    }
+
+    return virtual_file_system_path_type::non_existant;
+}
+
+bool virtual_file_system_archive_handler::remove(const char* path)
+{
+    return false;
+}
+
+bool virtual_file_system_archive_handler::rename(const char* source, const char* destination)
+{
+    return false;
+}
+
+bool virtual_file_system_archive_handler::create_directory(const char* path)
+{
+    return false;
+}
+
+bool virtual_file_system_archive_handler::modified_time(const char* path, virtual_file_system_time_point& timepoint)
+{
+    if (m_archive->find(path) == nullptr)
+    {
+        return false;
+    }
+
+    // Entries don't store their own times, they are as old as the archive.
+    std::error_code error;
+    std::filesystem::file_time_type time = std::filesystem::last_write_time(m_archive->get_path(), error);
+    if (error)
+    {
+        return false;
+    }
+
+    timepoint = time.time_since_epoch().count();
+    return true;
+}
+
+std::vector<std::string> virtual_file_system_archive_handler::list(const char* path, virtual_file_system_path_type type, bool recursive)
+{
+    std::vector<std::string> result;
+
+    // Archives are flat, all entries live in the root.
+    if (*path != '\0' || type != virtual_file_system_path_type::file)
+    {
+        return result;
+    }
+
+    for (const asset_archive::toc_entry& entry : m_archive->get_entries())
+    {
+        result.push_back(std::string(m_archive->get_name(entry)));
+    }
+
+    return result;
+}
+
+std::unique_ptr<virtual_file_system_watcher> virtual_file_system_archive_handler::watch(const char* path, virtual_file_system_watcher::callback_t callback)
+{
+    // Archives are immutable, nothing to watch.
+    return nullptr;
+}
+
+void virtual_file_system_archive_handler::raise_watch_events()
+{
+}
+
+bool virtual_file_system_archive_handler::get_disk_location(const char* path, std::string& output_path)
+{
+    return false;
+}
+
+bool virtual_file_system_archive_handler::get_vfs_location(const char* path, std::string& output_path)
+{
+    return false;
+}
+
+}; // namespace workshop
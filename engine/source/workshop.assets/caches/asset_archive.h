@@ -0,0 +1,179 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/filesystem/stream.h"
+#include "workshop.core/filesystem/mapped_file.h"
+#include "workshop.core/filesystem/virtual_file_system_handler.h"
+#include "workshop.core/utils/result.h"
+
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ws {
+
+// ================================================================================================
+//  An archive packs many compiled assets into a single file so they can be accessed without
+//  the cost of opening and stat'ing thousands of loose files.
+//
+//  Layout:
+//      header
+//      entry data, each entry aligned to k_alignment
+//      table of contents, sorted by entry name
+//      string table holding entry names
+//
+//  The archive is memory mapped when read. Entries can optionally be compressed with zlib,
+//  uncompressed entries are referenced directly in the mapping and can be async read
+//  from the archive file.
+//
+//  This class is thread safe.
+// ================================================================================================
+class asset_archive
+{
+public:
+
+    static inline constexpr uint32_t k_magic = 0x52415357; // WSAR
+    static inline constexpr uint32_t k_version = 1;
+    static inline constexpr size_t k_alignment = 4096;
+
+    enum class entry_flags : uint32_t
+    {
+        none = 0,
+        compressed = 1,
+    };
+
+    struct header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entry_count;
+        uint32_t alignment;
+        uint64_t toc_offset;
+        uint64_t string_table_offset;
+        uint64_t string_table_size;
+    };
+
+    struct toc_entry
+    {
+        uint64_t name_offset;
+        uint32_t name_length;
+        entry_flags flags;
+        uint64_t data_offset;
+        uint64_t stored_size;
+        uint64_t uncompressed_size;
+    };
+
+    // A file to be added to an archive by write.
+    struct source_file
+    {
+        std::string name;
+        std::filesystem::path path;
+    };
+
+    // Opens the archive at the given path. Returns nullptr if the archive doesn't exist or is invalid.
+    static std::shared_ptr<asset_archive> open(const std::filesystem::path& path);
+
+    // Writes a new archive containing the given files. Entries are compressed if
+    // compress is set and it saves a meaningful amount of space. Entry names are
+    // normalized in the same way as virtual file system paths.
+    static result<void> write(const std::filesystem::path& path, std::vector<source_file> files, bool compress, int compression_level);
+
+    // Finds the entry with the given name, returns nullptr if it doesn't exist.
+    const toc_entry* find(std::string_view name);
+
+    // Opens a read-only stream to the entry with the given name.
+    std::unique_ptr<stream> open_entry(std::string_view name);
+
+    // Gets the name of the given entry.
+    std::string_view get_name(const toc_entry& entry);
+
+    // Gets all entries in the archive.
+    std::span<const toc_entry> get_entries();
+
+    // Gets the on-disk path of the archive.
+    const std::filesystem::path& get_path();
+
+private:
+    asset_archive() = default;
+
+private:
+    std::filesystem::path m_path;
+
+    std::shared_ptr<mapped_file> m_file;
+
+    std::span<const toc_entry> m_entries;
+    std::string_view m_string_table;
+
+};
+
+// ================================================================================================
+//  Read-only stream to an entry in an asset_archive.
+//
+//  Uncompressed entries reference the archive mapping directly, compressed entries
+//  are decompressed into memory when opened. Compressed entries can't be async read.
+// ================================================================================================
+class asset_archive_stream : public stream
+{
+public:
+
+    asset_archive_stream(std::shared_ptr<void> owner, std::span<uint8_t> data, const std::string& async_path, size_t async_offset);
+
+    virtual void close() override;
+    virtual void flush() override;
+    virtual bool can_write() override;
+    virtual size_t position() override;
+    virtual size_t length() override;
+    virtual void seek(size_t position) override;
+    virtual size_t write(const char* data, size_t size) override;
+    virtual size_t read(char* data, size_t size) override;
+    virtual std::span<uint8_t> read_view(size_t size) override;
+    virtual std::shared_ptr<void> get_view_owner() override;
+
+    virtual std::string get_async_path() override;
+    virtual size_t get_async_offset() override;
+
+private:
+    std::shared_ptr<void> m_owner;
+    std::span<uint8_t> m_data;
+
+    std::string m_async_path;
+    size_t m_async_offset;
+
+    size_t m_position = 0;
+
+};
+
+// ================================================================================================
+//  Exposes the entries of an asset_archive through the virtual file system. Paths are the
+//  entry names.
+// ================================================================================================
+class virtual_file_system_archive_handler : public virtual_file_system_handler
+{
+public:
+
+    virtual_file_system_archive_handler(std::shared_ptr<asset_archive> archive);
+
+    virtual std::unique_ptr<stream> open(const char* path, bool for_writing) override;
+    virtual virtual_file_system_path_type type(const char* path) override;
+    virtual bool remove(const char* path) override;
+    virtual bool rename(const char* source, const char* destination) override;
+    virtual bool create_directory(const char* path) override;
+    virtual bool modified_time(const char* path, virtual_file_system_time_point& timepoint) override;
+    virtual std::vector<std::string> list(const char* path, virtual_file_system_path_type type, bool recursive) override;
+    virtual std::unique_ptr<virtual_file_system_watcher> watch(const char* path, virtual_file_system_watcher::callback_t callback) override;
+    virtual void raise_watch_events() override;
+    virtual bool get_disk_location(const char* path, std::string& output_path) override;
+    virtual bool get_vfs_location(const char* path, std::string& output_path) override;
+
+private:
+    std::shared_ptr<asset_archive> m_archive;
+
+};
+
+}; // namespace workshop
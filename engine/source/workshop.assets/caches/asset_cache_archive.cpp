@@ -2,54 +2,102 @@
 //  workshop
 //  Copyright (C) 2021 Tim Leonard
 // ================================================================================================
-#include "workshop.engine/assets/caches/asset_cache_disk.h"
+#include "workshop.assets/caches/asset_cache_archive.h"
+#include "workshop.core/filesystem/virtual_file_system.h"
+#include "workshop.core/filesystem/virtual_file_system_redirect_handler.h"
 
 namespace ws {
 
-asset_cache_disk::asset_cache_disk(const std::filesystem::path& root, bool read_only)
-    : m_root(root)
-    , m_read_only(read_only)
+asset_cache_archive::asset_cache_archive(std::shared_ptr<asset_archive> archive, platform_type platform, const std::string& storage_protocol, const std::string& access_protocol)
+    : m_archive(archive)
+    , m_platform(platform)
+    , m_storage_protocol(storage_protocol)
+    , m_access_protocol(access_protocol)
 {
+    m_access_handlers = virtual_file_system::get().get_handlers(access_protocol);
+    db_assert_message(!m_access_handlers.empty(), "Archive asset cache using access protocol that hasn't been registered to virtual file system.");
 }
 
-bool asset_cache_disk::get(const asset_cache_key& key, std::string& storage_path)
+bool asset_cache_archive::get(const asset_cache_key& key, std::string& storage_path)
 {
-    std::filesystem::path path = get_path_from_key(key);
+    if (key.platform != m_platform)
+    {
+        return false;
+    }
+
+    std::string name = virtual_file_system::normalize(key.hash().c_str());
+
+    if (m_archive->find(name) != nullptr)
+    {
+        update_handlers_for_path(key.source.path, m_storage_protocol + ":" + name);
+
+        storage_path = virtual_file_system::replace_protocol(key.source.path.c_str(), m_access_protocol.c_str());
+
+        return true;
+    }
 
     return false;
 }
 
-bool asset_cache_disk::set(const asset_cache_key& key, const char* temporary_file)
+bool asset_cache_archive::set(const asset_cache_key& key, const char* temporary_file)
 {
-    std::filesystem::path path = get_path_from_key(key);
-
+    // Archives are immutable once packed.
     return false;
 }
 
-bool asset_cache_disk::is_read_only()
+bool asset_cache_archive::is_read_only()
 {
-    return m_read_only;
+    return true;
 }
 
-std::filesystem::path asset_cache_disk::get_path_from_key(const asset_cache_key& key)
+result<void> asset_cache_archive::pack(const std::filesystem::path& cache_root, platform_type platform, const std::filesystem::path& output_path, bool compress, int compression_level)
 {
-    std::filesystem::path path = m_root / to_string(key.platform);
-
-    std::string hash_string = key.hash();
+    std::filesystem::path platform_root = cache_root / to_string(platform);
+    if (!std::filesystem::is_directory(platform_root))
+    {
+        db_error(asset, "Asset cache does not contain any assets for platform %s: %s", to_string(platform).c_str(), cache_root.string().c_str());
+        return false;
+    }
 
-    // First n characters are seperate directories to avoid just one massive
-    // directory with a billion entries in it.
-    constexpr size_t k_seperation_directory_count = 3;
-    db_assert(hash_string.size() > k_seperation_directory_count);
+    std::vector<asset_archive::source_file> files;
 
-    for (size_t i = 0; i < k_seperation_directory_count; i++)
+    for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(platform_root))
     {
-        path = path / std::string(1, hash_string[i]);
+        if (!entry.is_regular_file())
+        {
+            continue;
+        }
+
+        // Skip any files that are still being copied into the cache.
+        std::string filename = entry.path().filename().string();
+        if (filename.find(".tmp_") != std::string::npos)
+        {
+            continue;
+        }
+
+        asset_archive::source_file& file = files.emplace_back();
+        file.name = filename;
+        file.path = entry.path();
     }
 
-    path = path / hash_string;
+    db_log(asset, "Packing %zi compiled assets into archive: %s", files.size(), output_path.string().c_str());
+
+    return asset_archive::write(output_path, std::move(files), compress, compression_level);
+}
+
+void asset_cache_archive::update_handlers_for_path(const std::string& virtual_path, const std::string& archive_path)
+{
+    std::string protocol, filename;
+    virtual_file_system::crack(virtual_path.c_str(), protocol, filename);
 
-    return path;
+    for (virtual_file_system_handler* handler : m_access_handlers)
+    {
+        virtual_file_system_redirect_handler* aliased_handler = dynamic_cast<virtual_file_system_redirect_handler*>(handler);
+        if (aliased_handler)
+        {
+            aliased_handler->alias(filename.c_str(), archive_path.c_str());
+        }
+    }
 }
 
 }; // namespace workshop
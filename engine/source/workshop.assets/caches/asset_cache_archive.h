@@ -4,33 +4,48 @@
 // ================================================================================================
 #pragma once
 
-#include "workshop.engine/assets/asset_cache.h"
+#include "workshop.assets/asset_cache.h"
+#include "workshop.assets/caches/asset_archive.h"
 
 namespace ws {
 
+class virtual_file_system_handler;
+
 // ================================================================================================
-//  This class implements and asset cache that uses a directory on disk as backing storage.
+//  This class implements a read-only asset cache backed by a single asset_archive.
+// 
+//  The archive's entries are expected to be accessible through the storage protocol,
+//  via a virtual_file_system_archive_handler.
 // 
 //  This class is thread safe.
 // ================================================================================================
-class asset_cache_disk : public asset_cache
+class asset_cache_archive : public asset_cache
 {
 public:
 
-    asset_cache_disk(const std::filesystem::path& root, bool read_only);
+    asset_cache_archive(std::shared_ptr<asset_archive> archive, platform_type platform, const std::string& storage_protocol, const std::string& access_protocol);
 
     virtual bool get(const asset_cache_key& key, std::string& storage_path) override;
     virtual bool set(const asset_cache_key& key, const char* temporary_file) override;
     virtual bool is_read_only() override;
 
-protected:
+    // Packs all the compiled assets for the given platform in an asset_cache_disk's root
+    // directory into an archive.
+    static result<void> pack(const std::filesystem::path& cache_root, platform_type platform, const std::filesystem::path& output_path, bool compress, int compression_level);
 
-    std::filesystem::path get_path_from_key(const asset_cache_key& key);
+protected:
 
+    void update_handlers_for_path(const std::string& virtual_path, const std::string& archive_path);
+     
 private:
 
-    std::filesystem::path m_root;
-    bool m_read_only;
+    std::shared_ptr<asset_archive> m_archive;
+    platform_type m_platform;
+
+    std::string m_storage_protocol;
+    std::string m_access_protocol;
+
+    std::vector<virtual_file_system_handler*> m_access_handlers;
 
 };
 
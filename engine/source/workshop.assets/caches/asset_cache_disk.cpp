@@ -7,6 +7,7 @@
 #include "workshop.core/filesystem/virtual_file_system_redirect_handler.h"
 #include "workshop.core/filesystem/disk_stream.h"
 #include "workshop.core/hashing/guid.h"
+#include "workshop.assets/content_hash_index.h"
 
 #include <thread>
 
@@ -81,7 +82,10 @@ bool asset_cache_disk::set(const asset_cache_key& key, const char* temporary_fil
         }
     }
 
-    if (!vfs.copy(temporary_file, tmp_cache_path.c_str()))
+    // If keyed by content, identical outputs are likely (eg. the same texture under different
+    // names), so link to a single copy of the data rather than storing it again.
+    bool linked = key.content_hashed && link_to_blob(key, temporary_file, tmp_cache_path);
+    if (!linked && !vfs.copy(temporary_file, tmp_cache_path.c_str()))
     {
         db_error(asset, "[%s] Failed to copy data to destination file: %s", temporary_file, tmp_cache_dir.c_str());
         return false;
@@ -99,11 +103,108 @@ bool asset_cache_disk::set(const asset_cache_key& key, const char* temporary_fil
     return true;
 }
 
+bool asset_cache_disk::link_to_blob(const asset_cache_key& key, const char* temporary_file, const std::string& link_path)
+{
+    virtual_file_system& vfs = virtual_file_system::get();
+
+    hash128 content_hash;
+    if (!content_hash_index::calculate_hash(temporary_file, content_hash))
+    {
+        return false;
+    }
+
+    // Blobs are stored outside the platform directory so they are not picked up as cache entries.
+    std::string hash_string = to_string(content_hash);
+    std::string blob_path = string_format("%s:blobs/%s/%s/%s", m_storage_protocol.c_str(), to_string(key.platform).c_str(), hash_string.substr(0, 2).c_str(), hash_string.c_str());
+
+    if (!vfs.exists(blob_path.c_str()))
+    {
+        std::string blob_dir = virtual_file_system::get_parent(blob_path.c_str());
+        if (!vfs.exists(blob_dir.c_str()) && !vfs.create_directory(blob_dir.c_str()))
+        {
+            return false;
+        }
+
+        std::string tmp_blob_path = blob_path + string_format(".tmp_%s", to_string(guid::generate()).c_str());
+        if (!vfs.copy(temporary_file, tmp_blob_path.c_str()) ||
+            !vfs.rename(tmp_blob_path.c_str(), blob_path.c_str()))
+        {
+            vfs.remove(tmp_blob_path.c_str());
+            return false;
+        }
+    }
+
+    // Hard links are only possible if both paths are on disk.
+    std::string blob_disk_path = vfs.get_disk_location(blob_path.c_str());
+    std::string link_disk_path = vfs.get_disk_location(link_path.c_str());
+    if (blob_disk_path.empty() || link_disk_path.empty())
+    {
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::create_hard_link(blob_disk_path, link_disk_path, error);
+    if (error)
+    {
+        db_verbose(asset, "[%s] Failed to link to cached blob, falling back to copying: %s", temporary_file, error.message().c_str());
+        return false;
+    }
+
+    return true;
+}
+
 bool asset_cache_disk::is_read_only()
 {
     return m_read_only;
 }
 
+size_t asset_cache_disk::remove_unreferenced_blobs()
+{
+    if (m_read_only)
+    {
+        return 0;
+    }
+
+    std::string blob_root = m_storage_protocol + ":blobs";
+    std::string blob_root_disk_path = virtual_file_system::get().get_disk_location(blob_root.c_str());
+    if (blob_root_disk_path.empty() || !std::filesystem::is_directory(blob_root_disk_path))
+    {
+        return 0;
+    }
+
+    // Every entry is a hard link to its blob, so a blob with no other links is unreferenced.
+    // Other processes may be linking to blobs while this runs, if one is removed just before 
+    // it's linked to create_hard_link fails and link_to_blob falls back to copying.
+    size_t removed_count = 0;
+
+    std::error_code error;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(blob_root_disk_path, error))
+    {
+        if (!entry.is_regular_file())
+        {
+            continue;
+        }
+
+        // Blobs that are still being written.
+        if (entry.path().filename().string().find(".tmp_") != std::string::npos)
+        {
+            continue;
+        }
+
+        if (entry.hard_link_count(error) == 1 && std::filesystem::remove(entry.path(), error))
+        {
+            removed_count++;
+        }
+    }
+
+    if (removed_count > 0)
+    {
+        db_log(asset, "Removed %zi unreferenced blobs from asset cache.", removed_count);
+    }
+
+    return removed_count;
+}
+
 std::string asset_cache_disk::get_path_from_key(const asset_cache_key& key)
 {
     std::string path = m_storage_protocol + ":" + to_string(key.platform);
@@ -25,11 +25,20 @@ public:
     virtual bool set(const asset_cache_key& key, const char* temporary_file) override;
     virtual bool is_read_only() override;
 
+    // Removes blobs that no cache entry links to anymore, such as those of entries that have
+    // been replaced. Nothing else removes blobs, so the blob directory only grows until this
+    // is called. Returns the number of blobs removed.
+    size_t remove_unreferenced_blobs();
+
 protected:
 
     std::string get_path_from_key(const asset_cache_key& key);
 
     void update_handlers_for_path(const std::string& virtual_path, const std::string& disk_path);
+
+    // Stores the file in a blob named by the hash of its contents, if one doesn't already
+    // exist, and hard links link_path to it. Returns false if linking is not possible.
+    bool link_to_blob(const asset_cache_key& key, const char* temporary_file, const std::string& link_path);
      
 private:
 
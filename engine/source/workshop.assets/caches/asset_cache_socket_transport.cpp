@@ -0,0 +1,223 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.assets/caches/asset_cache_socket_transport.h"
+#include "workshop.core/filesystem/virtual_file_system.h"
+#include "workshop.core/filesystem/stream.h"
+#include "workshop.core/utils/time.h"
+#include "workshop.core/debug/debug.h"
+
+namespace ws {
+
+asset_cache_socket_transport::asset_cache_socket_transport(const std::filesystem::path& socket_path)
+    : m_socket_path(socket_path)
+{
+}
+
+std::unique_ptr<local_socket> asset_cache_socket_transport::acquire_connection()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+
+        if (!m_idle_connections.empty())
+        {
+            std::unique_ptr<local_socket> connection = std::move(m_idle_connections.back());
+            m_idle_connections.pop_back();
+            return connection;
+        }
+
+        if (get_seconds() < m_retry_connect_time)
+        {
+            return nullptr;
+        }
+    }
+
+    std::unique_ptr<local_socket> connection = local_socket::connect(m_socket_path);
+
+    std::scoped_lock lock(m_mutex);
+
+    if (!connection)
+    {
+        if (!m_warned_unreachable)
+        {
+            db_warning(asset, "Failed to connect to shared asset cache, only local caches will be used: %s", m_socket_path.string().c_str());
+            m_warned_unreachable = true;
+        }
+        m_retry_connect_time = get_seconds() + k_retry_connect_interval;
+    }
+
+    return connection;
+}
+
+void asset_cache_socket_transport::release_connection(std::unique_ptr<local_socket>&& connection)
+{
+    std::scoped_lock lock(m_mutex);
+    m_idle_connections.push_back(std::move(connection));
+}
+
+bool asset_cache_socket_transport::send_request(local_socket& connection, command request, const std::string& key, uint64_t data_size, double compile_time)
+{
+    request_header header;
+    header.magic = k_magic;
+    header.request = request;
+    header.key_length = static_cast<uint32_t>(key.size());
+    header.data_size = data_size;
+    header.compile_time = compile_time;
+
+    return connection.send(&header, sizeof(header)) &&
+           connection.send(key.data(), key.size());
+}
+
+bool asset_cache_socket_transport::fetch(const std::string& key, const char* output_path, double& compile_time)
+{
+    std::unique_ptr<local_socket> connection = acquire_connection();
+    if (!connection)
+    {
+        return false;
+    }
+
+    response_header response;
+    if (!send_request(*connection, command::fetch, key, 0, 0.0) ||
+        !connection->receive(&response, sizeof(response)) ||
+        response.magic != k_magic)
+    {
+        return false;
+    }
+
+    if (response.result != status::ok)
+    {
+        release_connection(std::move(connection));
+        return false;
+    }
+
+    std::unique_ptr<stream> output = virtual_file_system::get().open(output_path, true);
+    
+    // We still need to drain the data from the socket if we fail to write it, or
+    // the connection will be out of sync.
+    std::vector<char> buffer(std::min(static_cast<size_t>(response.data_size), k_chunk_size));
+    bool success = (output != nullptr);
+
+    for (uint64_t remaining = response.data_size; remaining > 0; )
+    {
+        size_t chunk = static_cast<size_t>(std::min(remaining, static_cast<uint64_t>(buffer.size())));
+        if (!connection->receive(buffer.data(), chunk))
+        {
+            output = nullptr;
+            virtual_file_system::get().remove(output_path);
+            return false;
+        }
+
+        if (success && output->write(buffer.data(), chunk) != chunk)
+        {
+            success = false;
+        }
+
+        remaining -= chunk;
+    }
+
+    release_connection(std::move(connection));
+
+    output = nullptr;
+    if (!success)
+    {
+        virtual_file_system::get().remove(output_path);
+        return false;
+    }
+
+    compile_time = response.compile_time;
+    return true;
+}
+
+bool asset_cache_socket_transport::publish(const std::string& key, const char* input_path, double compile_time)
+{
+    std::unique_ptr<stream> input = virtual_file_system::get().open(input_path, false);
+    if (!input)
+    {
+        return false;
+    }
+
+    std::unique_ptr<local_socket> connection = acquire_connection();
+    if (!connection)
+    {
+        return false;
+    }
+
+    size_t length = input->length();
+    if (!send_request(*connection, command::publish, key, length, compile_time))
+    {
+        return false;
+    }
+
+    std::vector<char> buffer(std::min(length, k_chunk_size));
+    for (size_t remaining = length; remaining > 0; )
+    {
+        size_t chunk = std::min(remaining, buffer.size());
+
+        // If the file is shorter than expected the daemon will be left waiting for data, 
+        // so the connection has to be dropped.
+        if (input->read(buffer.data(), chunk) != chunk || 
+            !connection->send(buffer.data(), chunk))
+        {
+            return false;
+        }
+
+        remaining -= chunk;
+    }
+
+    response_header response;
+    if (!connection->receive(&response, sizeof(response)) ||
+        response.magic != k_magic)
+    {
+        return false;
+    }
+
+    release_connection(std::move(connection));
+
+    return (response.result == status::ok);
+}
+
+bool asset_cache_socket_transport::list(std::vector<entry>& entries)
+{
+    std::unique_ptr<local_socket> connection = acquire_connection();
+    if (!connection)
+    {
+        return false;
+    }
+
+    response_header response;
+    if (!send_request(*connection, command::list, "", 0, 0.0) ||
+        !connection->receive(&response, sizeof(response)) ||
+        response.magic != k_magic ||
+        response.result != status::ok)
+    {
+        return false;
+    }
+
+    // data_size holds the number of entries for list responses.
+    for (uint64_t i = 0; i < response.data_size; i++)
+    {
+        list_entry header;
+        if (!connection->receive(&header, sizeof(header)) ||
+            header.key_length > k_max_key_length)
+        {
+            return false;
+        }
+
+        entry& new_entry = entries.emplace_back();
+        new_entry.key.resize(header.key_length);
+        new_entry.size = static_cast<size_t>(header.size);
+        new_entry.compile_time = header.compile_time;
+
+        if (!connection->receive(new_entry.key.data(), header.key_length))
+        {
+            return false;
+        }
+    }
+
+    release_connection(std::move(connection));
+
+    return true;
+}
+
+}; // namespace workshop
@@ -0,0 +1,113 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.assets/asset_cache_transport.h"
+#include "workshop.core/network/local_socket.h"
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ws {
+
+// ================================================================================================
+//  Transport that talks to a shared cache daemon (workshop.asset_cache_server) over a 
+//  local socket.
+// 
+//  Each request is a request_header followed by the key and any data, and is answered by a 
+//  response_header followed by any data. Connections are pooled so concurrent requests
+//  don't serialize on a single socket.
+// 
+//  If the daemon can't be reached no further connections are attempted for a short time, 
+//  so a missing daemon costs little more than a local cache miss.
+// 
+//  This class is thread safe.
+// ================================================================================================
+class asset_cache_socket_transport : public asset_cache_transport
+{
+public:
+
+    static inline constexpr uint32_t k_magic = 0x43435357; // WSCC
+
+    enum class command : uint32_t
+    {
+        fetch,
+        publish,
+        list,
+    };
+
+    enum class status : uint32_t
+    {
+        ok,
+        not_found,
+        failed,
+    };
+
+    struct request_header
+    {
+        uint32_t magic;
+        command request;
+        uint32_t key_length;
+        uint64_t data_size;
+        double compile_time;
+    };
+
+    struct response_header
+    {
+        uint32_t magic;
+        status result;
+        uint64_t data_size;
+        double compile_time;
+    };
+
+    // List responses contain a list_entry followed by the key for each entry.
+    struct list_entry
+    {
+        uint32_t key_length;
+        uint64_t size;
+        double compile_time;
+    };
+
+    // Size of chunks data is streamed to and from sockets in.
+    static inline constexpr size_t k_chunk_size = 256 * 1024;
+
+    // Longest key that will be accepted.
+    static inline constexpr size_t k_max_key_length = 1024;
+
+    asset_cache_socket_transport(const std::filesystem::path& socket_path);
+
+    virtual bool fetch(const std::string& key, const char* output_path, double& compile_time) override;
+    virtual bool publish(const std::string& key, const char* input_path, double compile_time) override;
+    virtual bool list(std::vector<entry>& entries) override;
+
+private:
+
+    // Gets an idle connection from the pool, or makes a new one.
+    std::unique_ptr<local_socket> acquire_connection();
+
+    // Returns a connection to the pool after a successful request. Connections that
+    // failed mid-request should be dropped instead, as their state is unknown.
+    void release_connection(std::unique_ptr<local_socket>&& connection);
+
+    bool send_request(local_socket& connection, command request, const std::string& key, uint64_t data_size, double compile_time);
+
+private:
+
+    std::filesystem::path m_socket_path;
+
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<local_socket>> m_idle_connections;
+
+    double m_retry_connect_time = 0.0;
+    bool m_warned_unreachable = false;
+
+    // How long to wait before trying to connect again after failing.
+    static inline constexpr double k_retry_connect_interval = 10.0;
+
+};
+
+}; // namespace workshop
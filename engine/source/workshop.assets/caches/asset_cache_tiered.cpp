@@ -0,0 +1,300 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.assets/caches/asset_cache_tiered.h"
+#include "workshop.core/filesystem/virtual_file_system.h"
+#include "workshop.core/statistics/statistics_manager.h"
+#include "workshop.core/hashing/guid.h"
+#include "workshop.core/utils/time.h"
+#include "workshop.core/perf/profile.h"
+
+namespace ws {
+
+asset_cache_tiered::asset_cache_tiered(std::unique_ptr<asset_cache>&& local, std::unique_ptr<asset_cache_transport>&& shared, const std::string& staging_path)
+    : m_local(std::move(local))
+    , m_shared(std::move(shared))
+    , m_staging_path(staging_path)
+{
+    virtual_file_system& vfs = virtual_file_system::get();
+    if (!vfs.exists(m_staging_path.c_str()))
+    {
+        vfs.create_directory(m_staging_path.c_str());
+    }
+    clear_staging();
+
+    if (statistics_manager* stats = statistics_manager::try_get())
+    {
+        m_stats_local_hits = stats->find_or_create_channel("asset cache/local hits");
+        m_stats_shared_hits = stats->find_or_create_channel("asset cache/shared hits");
+        m_stats_misses = stats->find_or_create_channel("asset cache/misses");
+        m_stats_hit_rate = stats->find_or_create_channel("asset cache/hit rate");
+    }
+
+    m_worker = std::thread([this]() {
+        worker_thread();
+    });
+}
+
+asset_cache_tiered::~asset_cache_tiered()
+{
+    // Let any outstanding publishes finish before shutting down.
+    {
+        std::unique_lock lock(m_work_mutex);
+        m_worker_active = false;
+    }
+    m_work_convar.notify_all();
+    m_worker.join();
+
+    clear_staging();
+
+    statistics stats = get_statistics();
+    size_t lookups = stats.local_hits + stats.shared_hits + stats.misses;
+    if (lookups > 0)
+    {
+        db_log(asset, "Asset cache: %zi local hits, %zi shared hits, %zi misses (%.1f%% hit rate), %zi published to shared cache (%zi failed).",
+            stats.local_hits,
+            stats.shared_hits,
+            stats.misses,
+            ((stats.local_hits + stats.shared_hits) / static_cast<double>(lookups)) * 100.0,
+            stats.published,
+            stats.publish_failures);
+
+        if (stats.shared_hits > 0)
+        {
+            db_log(asset, "Asset cache: fetching from shared cache took %.2f s, saving %.2f s of compilation.", stats.fetch_time, stats.compile_time_saved);
+        }
+    }
+}
+
+void asset_cache_tiered::clear_staging()
+{
+    virtual_file_system& vfs = virtual_file_system::get();
+
+    for (const std::string& path : vfs.list(m_staging_path.c_str(), virtual_file_system_path_type::file))
+    {
+        vfs.remove(path.c_str());
+    }
+
+    std::scoped_lock lock(m_mutex);
+    m_staged.clear();
+}
+
+bool asset_cache_tiered::get(const asset_cache_key& key, std::string& storage_path)
+{
+    if (m_local->get(key, storage_path))
+    {
+        {
+            std::scoped_lock lock(m_mutex);
+            m_statistics.local_hits++;
+        }
+        submit_statistics();
+        return true;
+    }
+
+    if (!can_use_shared(key))
+    {
+        {
+            std::scoped_lock lock(m_mutex);
+            m_statistics.misses++;
+        }
+        submit_statistics();
+        return false;
+    }
+
+    std::string hash = key.shared_hash();
+    std::string staged_path = m_staging_path + "/" + hash;
+
+    // May have already been fetched and still be waiting to be inserted into the local cache.
+    bool is_staged = false;
+    {
+        std::scoped_lock lock(m_mutex);
+        if (m_staged.contains(hash))
+        {
+            m_statistics.local_hits++;
+            is_staged = true;
+        }
+    }
+
+    if (is_staged)
+    {
+        submit_statistics();
+        storage_path = staged_path;
+        return true;
+    }
+
+    virtual_file_system& vfs = virtual_file_system::get();
+
+    // Fetch to a temporary file so nothing sees a partially written entry.
+    std::string fetch_path = staged_path + string_format(".tmp_%s", to_string(guid::generate()).c_str());
+
+    double start_time = get_seconds();
+    double compile_time = 0.0;
+
+    bool fetched = false;
+    {
+        profile_marker(profile_colors::task, "fetch from shared cache");
+        fetched = m_shared->fetch(hash, fetch_path.c_str(), compile_time) && vfs.rename(fetch_path.c_str(), staged_path.c_str());
+    }
+
+    if (!fetched)
+    {
+        vfs.remove(fetch_path.c_str());
+        {
+            std::scoped_lock lock(m_mutex);
+            m_statistics.misses++;
+            m_miss_times[hash] = get_seconds();
+        }
+        submit_statistics();
+        return false;
+    }
+
+    {
+        std::scoped_lock lock(m_mutex);
+        m_statistics.shared_hits++;
+        m_statistics.fetch_time += get_seconds() - start_time;
+        m_statistics.compile_time_saved += compile_time;
+        m_staged.insert(hash);
+    }
+    submit_statistics();
+
+    db_verbose(asset, "[%s] Fetched compiled asset from shared cache.", key.source.path.c_str());
+
+    // The staged file remains valid until we are destroyed, so it can be used while 
+    // the local cache is populated in the background.
+    if (!m_local->is_read_only())
+    {
+        queue_work([this, key, staged_path]() {
+            m_local->set(key, staged_path.c_str());
+        });
+    }
+
+    storage_path = staged_path;
+    return true;
+}
+
+bool asset_cache_tiered::set(const asset_cache_key& key, const char* temporary_file)
+{
+    if (!can_use_shared(key))
+    {
+        return m_local->set(key, temporary_file);
+    }
+
+    std::string hash = key.shared_hash();
+
+    double compile_time = 0.0;
+    {
+        std::scoped_lock lock(m_mutex);
+        if (auto iter = m_miss_times.find(hash); iter != m_miss_times.end())
+        {
+            compile_time = get_seconds() - iter->second;
+            m_miss_times.erase(iter);
+        }
+    }
+
+    // The caller is free to remove the temporary file once we return, so take a copy of it to publish from.
+    virtual_file_system& vfs = virtual_file_system::get();
+    std::string publish_path = m_staging_path + "/" + hash + string_format(".publish_%s", to_string(guid::generate()).c_str());
+
+    if (vfs.copy(temporary_file, publish_path.c_str()))
+    {
+        queue_work([this, hash, publish_path, compile_time]() {
+            bool success = m_shared->publish(hash, publish_path.c_str(), compile_time);
+            virtual_file_system::get().remove(publish_path.c_str());
+
+            std::scoped_lock lock(m_mutex);
+            if (success)
+            {
+                m_statistics.published++;
+            }
+            else
+            {
+                m_statistics.publish_failures++;
+            }
+        });
+    }
+    else
+    {
+        std::scoped_lock lock(m_mutex);
+        m_statistics.publish_failures++;
+    }
+
+    return m_local->set(key, temporary_file);
+}
+
+bool asset_cache_tiered::is_read_only()
+{
+    return m_local->is_read_only();
+}
+
+asset_cache_tiered::statistics asset_cache_tiered::get_statistics()
+{
+    std::scoped_lock lock(m_mutex);
+    return m_statistics;
+}
+
+void asset_cache_tiered::submit_statistics()
+{
+    if (m_stats_hit_rate == nullptr)
+    {
+        return;
+    }
+
+    statistics stats = get_statistics();
+    size_t lookups = stats.local_hits + stats.shared_hits + stats.misses;
+
+    m_stats_local_hits->submit(stats.local_hits);
+    m_stats_shared_hits->submit(stats.shared_hits);
+    m_stats_misses->submit(stats.misses);
+    m_stats_hit_rate->submit(lookups > 0 ? (stats.local_hits + stats.shared_hits) / static_cast<double>(lookups) : 0.0);
+}
+
+bool asset_cache_tiered::can_use_shared(const asset_cache_key& key)
+{
+    if (key.content_hashed)
+    {
+        return true;
+    }
+
+    if (!m_warned_not_content_hashed.exchange(true))
+    {
+        db_warning(asset, "Asset cache keys are not content hashed, the shared cache will not be used. Enable asset_cache_content_hash to use it.");
+    }
+
+    return false;
+}
+
+void asset_cache_tiered::queue_work(std::function<void()>&& work)
+{
+    {
+        std::unique_lock lock(m_work_mutex);
+        m_work.push_back(std::move(work));
+    }
+    m_work_convar.notify_one();
+}
+
+void asset_cache_tiered::worker_thread()
+{
+    db_set_thread_name("asset cache publisher");
+
+    while (true)
+    {
+        std::function<void()> work;
+        {
+            std::unique_lock lock(m_work_mutex);
+            m_work_convar.wait(lock, [this]() { return !m_work.empty() || !m_worker_active; });
+
+            if (m_work.empty())
+            {
+                break;
+            }
+
+            work = std::move(m_work.front());
+            m_work.pop_front();
+        }
+
+        work();
+    }
+}
+
+}; // namespace workshop
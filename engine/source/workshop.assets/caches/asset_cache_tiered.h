@@ -0,0 +1,117 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.assets/asset_cache.h"
+#include "workshop.assets/asset_cache_transport.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ws {
+
+class statistics_channel;
+
+// ================================================================================================
+//  Composes a local cache with a shared cache accessed through an asset_cache_transport, such 
+//  as a cache daemon shared by every developer and build agent on a machine or network.
+// 
+//  Lookups are read-through. The local cache is searched first, and if the entry is not there
+//  it is fetched from the shared cache into a staging directory and used directly from there. 
+//  The local cache is populated from the staged copy in the background.
+// 
+//  Entries set in the cache are stored in the local cache immediately, and published to the
+//  shared cache in the background.
+// 
+//  Entries are identified in the shared cache by asset_cache_key::shared_hash, so only content 
+//  hashed keys can use it. Anything creating this cache should enable asset_cache_content_hash, 
+//  keys that aren't content hashed only use the local cache.
+// 
+//  This class is thread safe.
+// ================================================================================================
+class asset_cache_tiered : public asset_cache
+{
+public:
+
+    struct statistics
+    {
+        size_t local_hits = 0;
+        size_t shared_hits = 0;
+        size_t misses = 0;
+        size_t published = 0;
+        size_t publish_failures = 0;
+
+        // Total time spent fetching entries from the shared cache.
+        double fetch_time = 0.0;
+
+        // Total time the entries fetched from the shared cache originally took to compile.
+        double compile_time_saved = 0.0;
+    };
+
+    // staging_path is a virtual file system directory that entries fetched from the shared
+    // cache are written to. Anything in it is removed when the cache is created and destroyed.
+    asset_cache_tiered(std::unique_ptr<asset_cache>&& local, std::unique_ptr<asset_cache_transport>&& shared, const std::string& staging_path);
+    virtual ~asset_cache_tiered();
+
+    virtual bool get(const asset_cache_key& key, std::string& storage_path) override;
+    virtual bool set(const asset_cache_key& key, const char* temporary_file) override;
+    virtual bool is_read_only() override;
+
+    // Gets statistics on how lookups have been resolved.
+    statistics get_statistics();
+
+private:
+
+    // Runs the given work on the background thread.
+    void queue_work(std::function<void()>&& work);
+
+    void worker_thread();
+
+    void clear_staging();
+
+    void submit_statistics();
+
+    // Returns true if the key can be looked up in the shared cache, warns once if it can't.
+    bool can_use_shared(const asset_cache_key& key);
+
+private:
+
+    std::unique_ptr<asset_cache> m_local;
+    std::unique_ptr<asset_cache_transport> m_shared;
+    std::string m_staging_path;
+
+    std::mutex m_mutex;
+
+    // Hashes of the entries currently in the staging directory.
+    std::unordered_set<std::string> m_staged;
+
+    // Time at which each missing entry was looked up, used to calculate how long
+    // entries take to compile when they are set.
+    std::unordered_map<std::string, double> m_miss_times;
+
+    statistics m_statistics;
+
+    std::thread m_worker;
+    std::mutex m_work_mutex;
+    std::condition_variable m_work_convar;
+    std::deque<std::function<void()>> m_work;
+    bool m_worker_active = true;
+
+    std::atomic_bool m_warned_not_content_hashed = false;
+
+    statistics_channel* m_stats_local_hits = nullptr;
+    statistics_channel* m_stats_shared_hits = nullptr;
+    statistics_channel* m_stats_misses = nullptr;
+    statistics_channel* m_stats_hit_rate = nullptr;
+
+};
+
+}; // namespace workshop
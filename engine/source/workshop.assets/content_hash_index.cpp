@@ -0,0 +1,210 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.assets/content_hash_index.h"
+#include "workshop.core/filesystem/virtual_file_system.h"
+#include "workshop.core/filesystem/disk_stream.h"
+#include "workshop.core/filesystem/mapped_file.h"
+#include "workshop.core/hashing/guid.h"
+#include "workshop.core/debug/debug.h"
+
+namespace ws {
+
+content_hash_index::content_hash_index(const std::filesystem::path& index_path)
+    : m_index_path(index_path)
+{
+    load();
+}
+
+content_hash_index::~content_hash_index()
+{
+    save();
+}
+
+bool content_hash_index::get_hash(const char* path, hash128& hash)
+{
+    std::string disk_path = virtual_file_system::get().get_disk_location(path);
+    if (disk_path.empty())
+    {
+        return calculate_hash(path, hash);
+    }
+
+    file_identity identity;
+    if (!get_file_identity(disk_path, identity))
+    {
+        return false;
+    }
+
+    {
+        std::scoped_lock lock(m_mutex);
+
+        if (auto iter = m_entries.find(disk_path); iter != m_entries.end() && iter->second.identity == identity)
+        {
+            hash = iter->second.hash;
+            return true;
+        }
+    }
+
+    if (!calculate_disk_hash(disk_path, hash))
+    {
+        return false;
+    }
+
+    // If the file was modified while we were hashing it, don't memoize the result as it may not
+    // match the identity we got beforehand.
+    file_identity new_identity;
+    if (get_file_identity(disk_path, new_identity) && new_identity == identity)
+    {
+        std::scoped_lock lock(m_mutex);
+
+        m_entries[disk_path] = { identity, hash };
+        m_dirty = true;
+    }
+
+    return true;
+}
+
+bool content_hash_index::calculate_hash(const char* path, hash128& hash)
+{
+    std::string disk_path = virtual_file_system::get().get_disk_location(path);
+    if (!disk_path.empty())
+    {
+        return calculate_disk_hash(disk_path, hash);
+    }
+
+    std::unique_ptr<stream> input = virtual_file_system::get().open(path, false);
+    if (!input)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> data(input->length());
+    if (input->read(reinterpret_cast<char*>(data.data()), data.size()) != data.size())
+    {
+        return false;
+    }
+
+    hash = hash128::calculate(data);
+    return true;
+}
+
+bool content_hash_index::calculate_disk_hash(const std::filesystem::path& path, hash128& hash)
+{
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error))
+    {
+        return false;
+    }
+
+    // Empty files can't be mapped.
+    if (std::filesystem::file_size(path, error) == 0 && !error)
+    {
+        hash = hash128::calculate({});
+        return true;
+    }
+
+    std::shared_ptr<mapped_file> file = mapped_file::open(path);
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    hash = hash128::calculate(file->data());
+    return true;
+}
+
+void content_hash_index::load()
+{
+    disk_stream input;
+    if (!input.open(m_index_path, false))
+    {
+        return;
+    }
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t count = 0;
+    stream_serialize(input, magic);
+    stream_serialize(input, version);
+    stream_serialize(input, count);
+
+    if (magic != k_magic || version != k_version)
+    {
+        db_warning(asset, "Content hash index is invalid or an old version, it will be rebuilt: %s", m_index_path.string().c_str());
+        return;
+    }
+
+    std::scoped_lock lock(m_mutex);
+
+    for (uint32_t i = 0; i < count && !input.at_end(); i++)
+    {
+        std::string path;
+        entry value;
+        stream_serialize(input, path);
+        stream_serialize(input, value.identity.inode);
+        stream_serialize(input, value.identity.modified_time);
+        stream_serialize(input, value.identity.size);
+        stream_serialize(input, value.hash.low);
+        stream_serialize(input, value.hash.high);
+
+        m_entries[path] = value;
+    }
+
+    db_log(asset, "Loaded %zi content hashes from index.", m_entries.size());
+}
+
+void content_hash_index::save()
+{
+    std::scoped_lock lock(m_mutex);
+
+    if (!m_dirty)
+    {
+        return;
+    }
+
+    // Other processes (eg. the cooker and editor) can be saving the same index at the same time,
+    // so each write goes to its own temporary file and the last one to be renamed wins.
+    std::filesystem::path temporary_path = m_index_path;
+    temporary_path += string_format(".tmp_%s", to_string(guid::generate()).c_str());
+
+    {
+        disk_stream output;
+        if (!output.open(temporary_path, true))
+        {
+            db_warning(asset, "Failed to write content hash index: %s", temporary_path.string().c_str());
+            return;
+        }
+
+        uint32_t magic = k_magic;
+        uint32_t version = k_version;
+        uint32_t count = static_cast<uint32_t>(m_entries.size());
+        stream_serialize(output, magic);
+        stream_serialize(output, version);
+        stream_serialize(output, count);
+
+        for (auto& [path, value] : m_entries)
+        {
+            std::string key = path;
+            stream_serialize(output, key);
+            stream_serialize(output, value.identity.inode);
+            stream_serialize(output, value.identity.modified_time);
+            stream_serialize(output, value.identity.size);
+            stream_serialize(output, value.hash.low);
+            stream_serialize(output, value.hash.high);
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, m_index_path, error);
+    if (error)
+    {
+        db_warning(asset, "Failed to replace content hash index: %s", m_index_path.string().c_str());
+        std::filesystem::remove(temporary_path, error);
+        return;
+    }
+
+    m_dirty = false;
+}
+
+}; // namespace ws
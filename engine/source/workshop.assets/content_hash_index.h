@@ -0,0 +1,72 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/hashing/hash128.h"
+#include "workshop.core/filesystem/file.h"
+#include "workshop.core/utils/singleton.h"
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace ws {
+
+// ================================================================================================
+//  Calculates hashes of file contents, used to key the asset cache by content rather than
+//  by modification time.
+//
+//  Hashes are memoized per file along with the file's identity (inode, modification time and
+//  size), and persisted to disk, so files are only rehashed when they change.
+//
+//  This class is thread safe.
+// ================================================================================================
+class content_hash_index
+    : public singleton<content_hash_index>
+{
+public:
+
+    content_hash_index(const std::filesystem::path& index_path);
+    ~content_hash_index();
+
+    // Gets the hash of the contents of the file at the given virtual file system path.
+    // Returns false if the file could not be read.
+    bool get_hash(const char* path, hash128& hash);
+
+    // Writes the index to disk if it has changed.
+    void save();
+
+    // Calculates the hash of the contents of the file at the given virtual file system path
+    // without memoizing it.
+    static bool calculate_hash(const char* path, hash128& hash);
+
+private:
+
+    struct entry
+    {
+        file_identity identity;
+        hash128 hash;
+    };
+
+    void load();
+
+    // Calculates the hash of a file on disk.
+    static bool calculate_disk_hash(const std::filesystem::path& path, hash128& hash);
+
+private:
+
+    std::filesystem::path m_index_path;
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, entry> m_entries;
+    bool m_dirty = false;
+
+    static inline constexpr uint32_t k_magic = 0x58444948; // HIDX
+    static inline constexpr uint32_t k_version = 1;
+
+};
+
+}; // namespace ws
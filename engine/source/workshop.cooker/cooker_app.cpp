@@ -0,0 +1,604 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.cooker/cooker_app.h"
+#include "workshop.engine/assets/scene/scene_loader.h"
+#include "workshop.assets/asset_loader.h"
+#include "workshop.assets/caches/asset_cache_disk.h"
+#include "workshop.assets/caches/asset_cache_tiered.h"
+#include "workshop.assets/caches/asset_cache_socket_transport.h"
+#include "workshop.renderer/assets/material/material.h"
+#include "workshop.renderer/assets/shader/shader.h"
+#include "workshop.core/async/task_graph.h"
+#include "workshop.core/filesystem/file.h"
+#include "workshop.core/filesystem/virtual_file_system_disk_handler.h"
+#include "workshop.core/filesystem/virtual_file_system_redirect_handler.h"
+#include "workshop.core/containers/string.h"
+#include "workshop.core/cvar/core_cvars.h"
+#include "workshop.core/platform/platform.h"
+#include "workshop.core/utils/time.h"
+#include "workshop.core/debug/debug.h"
+
+#if defined(WS_WINDOWS)
+#include "workshop.render_interface.dx12/dx12_ri_interface.h"
+#endif
+#if defined(WS_WINDOWS) || defined(WS_LINUX)
+#include "workshop.render_interface.vulkan/vulkan_ri_interface.h"
+#endif
+
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
+std::shared_ptr<ws::app> make_app()
+{
+    return std::make_shared<ws::cooker_app>();
+}
+
+namespace ws {
+
+std::string cooker_app::get_name()
+{
+    return "cooker";
+}
+
+result<void> cooker_app::parse_command_line()
+{
+    const std::vector<std::string>& args = get_command_line();
+
+#if defined(WS_WINDOWS)
+    m_render_interface_type = ri_interface_type::dx12;
+#elif defined(WS_LINUX)
+    m_render_interface_type = ri_interface_type::vulkan;
+#endif
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        const std::string& arg = args[i];
+        bool has_value = (i + 1 < args.size());
+
+        if (arg == "-game" && has_value)
+        {
+            m_game_name = args[++i];
+        }
+        else if (arg == "-workers" && has_value)
+        {
+            result<uint64_t> value = from_string<uint64_t>(args[++i]);
+            if (!value || value.get() == 0)
+            {
+                db_error(core, "Invalid worker count: %s", args[i].c_str());
+                return standard_errors::invalid_parameter;
+            }
+            m_worker_count = static_cast<size_t>(value.get());
+        }
+        else if (arg == "-shared_cache" && has_value)
+        {
+            m_shared_cache_socket = args[++i];
+        }
+        else if (arg == "-content_hash")
+        {
+            m_content_hash = true;
+        }
+#if defined(WS_WINDOWS) || defined(WS_LINUX)
+        else if (arg == "-vulkan")
+        {
+            m_render_interface_type = ri_interface_type::vulkan;
+        }
+#endif
+        else if (!arg.empty() && arg[0] != '-')
+        {
+            m_requested_assets.push_back(arg);
+        }
+        else
+        {
+            db_error(core, "Unknown argument: %s", arg.c_str());
+            db_error(core, "Usage: workshop.cooker [assets...] [-game <name>] [-workers <count>] [-shared_cache <socket>] [-content_hash] [-vulkan]");
+            return standard_errors::invalid_parameter;
+        }
+    }
+
+    if (m_worker_count == 0)
+    {
+        m_worker_count = std::thread::hardware_concurrency();
+    }
+
+    return true;
+}
+
+result<void> cooker_app::start()
+{
+    if (result<void> ret = parse_command_line(); !ret)
+    {
+        return ret;
+    }
+
+    // Nothing else is running so all workers can run loading tasks.
+    task_scheduler::init_state init_state;
+    init_state.worker_count = m_worker_count;
+    init_state.use_work_stealing = true;
+    init_state.pin_workers = true;
+    init_state.queue_weights.fill(1.0f);
+
+    db_log(asset, "Creating task scheduler with %zi workers.", init_state.worker_count);
+    m_task_scheduler = std::make_unique<task_scheduler>(init_state);
+
+    if (result<void> ret = create_filesystem(); !ret)
+    {
+        return ret;
+    }
+
+    if (result<void> ret = create_asset_manager(); !ret)
+    {
+        return ret;
+    }
+
+    return true;
+}
+
+result<void> cooker_app::stop()
+{
+    m_renderer = nullptr;
+    m_input_interface = nullptr;
+    m_window = nullptr;
+    m_render_interface = nullptr;
+    m_asset_manager = nullptr;
+    m_local_cache = nullptr;
+    m_content_hash_index = nullptr;
+    m_filesystem = nullptr;
+    m_task_scheduler = nullptr;
+
+    return true;
+}
+
+result<void> cooker_app::create_filesystem()
+{
+    // Figure out what folders the engine and game assets are stored in, this mirrors
+    // what the engine does so the cache is shared with it.
+    std::filesystem::path root_dir = get_application_path().parent_path();
+    while (root_dir != root_dir.parent_path())
+    {
+        m_engine_asset_dir = root_dir / "engine" / "assets";
+        m_game_asset_dir = root_dir / "games" / m_game_name / "assets";
+        m_asset_cache_dir = root_dir / "intermediate" / "cache";
+
+        if (std::filesystem::exists(m_engine_asset_dir) &&
+            std::filesystem::exists(m_game_asset_dir))
+        {
+            break;
+        }
+
+        root_dir = root_dir.parent_path();
+    }
+
+    if (!std::filesystem::exists(m_engine_asset_dir))
+    {
+        db_error(asset, "Failed to find engine asset directory.");
+        return standard_errors::not_found;
+    }
+    if (!std::filesystem::exists(m_game_asset_dir))
+    {
+        db_error(asset, "Failed to find asset directory for game: %s", m_game_name.c_str());
+        return standard_errors::not_found;
+    }
+    if (!std::filesystem::exists(m_asset_cache_dir))
+    {
+        if (!std::filesystem::create_directories(m_asset_cache_dir))
+        {
+            db_error(asset, "Failed to create asset cache directory: %s", m_asset_cache_dir.string().c_str());
+            return standard_errors::failed;
+        }
+    }
+
+    db_log(asset, "Engine asset directory: %s", m_engine_asset_dir.string().c_str());
+    db_log(asset, "Game asset directory: %s", m_game_asset_dir.string().c_str());
+    db_log(asset, "Asset cache directory: %s", m_asset_cache_dir.string().c_str());
+
+    m_filesystem = std::make_unique<virtual_file_system>();
+    m_filesystem->register_handler("data", 0, std::make_unique<virtual_file_system_disk_handler>(m_engine_asset_dir.string().c_str(), false));
+    m_filesystem->register_handler("data", 1, std::make_unique<virtual_file_system_disk_handler>(m_game_asset_dir.string().c_str(), false));
+    m_filesystem->register_handler("local-cache", 0, std::make_unique<virtual_file_system_disk_handler>(m_asset_cache_dir.string().c_str(), false));
+    m_filesystem->register_handler("cache", 0, std::make_unique<virtual_file_system_redirect_handler>(false));
+    m_filesystem->register_handler("temp", 0, std::make_unique<virtual_file_system_disk_handler>(std::filesystem::temp_directory_path().string().c_str(), false));
+
+    return true;
+}
+
+result<void> cooker_app::create_asset_manager()
+{
+    // Modification times differ between machines, so the shared cache requires content hashing.
+    cvar_asset_cache_content_hash.set(m_content_hash || !m_shared_cache_socket.empty());
+
+    m_content_hash_index = std::make_unique<content_hash_index>(m_asset_cache_dir / "content_hashes.index");
+    m_asset_manager = std::make_unique<asset_manager>(get_platform(), get_config());
+
+    std::unique_ptr<asset_cache_disk> local_cache = std::make_unique<asset_cache_disk>("local-cache", "cache", false);
+    m_local_cache = local_cache.get();
+
+    if (m_shared_cache_socket.empty())
+    {
+        m_asset_manager->register_cache(std::move(local_cache));
+    }
+    else
+    {
+        db_log(asset, "Shared asset cache socket: %s", m_shared_cache_socket.c_str());
+
+        m_asset_manager->register_cache(std::make_unique<asset_cache_tiered>(
+            std::move(local_cache),
+            std::make_unique<asset_cache_socket_transport>(m_shared_cache_socket),
+            "local-cache:staging"
+        ));
+    }
+
+    // The loaders need a render interface and renderer to be constructed, but compiling never
+    // touches the gpu, so neither are initialized.
+    switch (m_render_interface_type)
+    {
+#if defined(WS_WINDOWS)
+    case ri_interface_type::dx12:
+        {
+            m_render_interface = std::make_unique<dx12_render_interface>((size_t)ray_type::COUNT, (size_t)material_domain::COUNT);
+            break;
+        }
+#endif
+#if defined(WS_WINDOWS) || defined(WS_LINUX)
+    case ri_interface_type::vulkan:
+        {
+            m_render_interface = std::make_unique<vulkan_render_interface>((size_t)ray_type::COUNT, (size_t)material_domain::COUNT);
+            break;
+        }
+#endif
+    default:
+        {
+            db_error(asset, "Renderer type requested is not implemented.");
+            return standard_errors::no_implementation;
+        }
+    }
+
+    m_window = std::make_unique<headless_window>();
+    m_input_interface = std::make_unique<headless_input_interface>();
+    m_renderer = std::make_unique<renderer>(*m_render_interface, *m_input_interface, *m_window, *m_asset_manager);
+
+    if (result<void> ret = m_renderer->register_asset_loaders(); !ret)
+    {
+        return ret;
+    }
+
+    m_asset_manager->register_loader(std::make_unique<scene_loader>(*m_asset_manager, nullptr));
+
+    return true;
+}
+
+void cooker_app::gather_references(const YAML::Node& node, std::vector<std::string>& references)
+{
+    switch (node.Type())
+    {
+    case YAML::NodeType::Scalar:
+        {
+            std::string value = node.as<std::string>();
+            if (value.starts_with("data:") && string_ends_with(value, asset_manager::k_asset_extension))
+            {
+                references.push_back(virtual_file_system::normalize(value.c_str()));
+            }
+            break;
+        }
+    case YAML::NodeType::Sequence:
+        {
+            for (const YAML::Node& child : node)
+            {
+                gather_references(child, references);
+            }
+            break;
+        }
+    case YAML::NodeType::Map:
+        {
+            for (auto iter = node.begin(); iter != node.end(); iter++)
+            {
+                gather_references(iter->second, references);
+            }
+            break;
+        }
+    default:
+        {
+            break;
+        }
+    }
+}
+
+void cooker_app::gather_assets()
+{
+    std::vector<std::string> files = virtual_file_system::get().list("data:", virtual_file_system_path_type::file);
+    std::vector<std::vector<std::string>> references;
+
+    for (const std::string& file : files)
+    {
+        if (!string_ends_with(file, asset_manager::k_asset_extension))
+        {
+            continue;
+        }
+
+        std::unique_ptr<stream> stream = virtual_file_system::get().open(file.c_str(), false);
+        if (!stream)
+        {
+            db_warning(asset, "[%s] Failed to open asset descriptor.", file.c_str());
+            continue;
+        }
+
+        YAML::Node node;
+        try
+        {
+            node = YAML::Load(stream->read_all_string());
+        }
+        catch (YAML::ParserException& exception)
+        {
+            db_warning(asset, "[%s] Failed to parse asset descriptor: %s", file.c_str(), exception.what());
+            continue;
+        }
+
+        // Yaml files without a type are not asset descriptors (eg. configs) and are skipped.
+        YAML::Node type_node = node["type"];
+        if (!type_node.IsDefined() || type_node.Type() != YAML::NodeType::Scalar)
+        {
+            continue;
+        }
+
+        std::string type = type_node.as<std::string>();
+
+        asset_loader* loader = m_asset_manager->get_loader_for_descriptor_type(type.c_str());
+        if (loader == nullptr)
+        {
+            db_verbose(asset, "[%s] Skipping, no loader for descriptor type: %s", file.c_str(), type.c_str());
+            continue;
+        }
+
+        cook_entry& entry = m_assets.emplace_back();
+        entry.path = virtual_file_system::normalize(file.c_str());
+        entry.loader = loader;
+
+        gather_references(node, references.emplace_back());
+    }
+
+    std::unordered_map<std::string, size_t> asset_indices;
+    for (size_t i = 0; i < m_assets.size(); i++)
+    {
+        asset_indices[m_assets[i].path] = i;
+    }
+
+    for (size_t i = 0; i < m_assets.size(); i++)
+    {
+        for (const std::string& reference : references[i])
+        {
+            auto iter = asset_indices.find(reference);
+            if (iter == asset_indices.end())
+            {
+                db_warning(asset, "[%s] References asset that does not exist: %s", m_assets[i].path.c_str(), reference.c_str());
+                continue;
+            }
+
+            if (iter->second != i &&
+                std::find(m_assets[i].references.begin(), m_assets[i].references.end(), iter->second) == m_assets[i].references.end())
+            {
+                m_assets[i].references.push_back(iter->second);
+            }
+        }
+    }
+}
+
+result<void> cooker_app::filter_requested_assets()
+{
+    if (m_requested_assets.empty())
+    {
+        return true;
+    }
+
+    std::vector<bool> required(m_assets.size(), false);
+    std::vector<size_t> pending;
+
+    for (const std::string& requested : m_requested_assets)
+    {
+        std::string path = virtual_file_system::normalize(requested.c_str());
+
+        auto iter = std::find_if(m_assets.begin(), m_assets.end(), [&path](const cook_entry& entry) {
+            return entry.path == path;
+        });
+
+        if (iter == m_assets.end())
+        {
+            db_error(asset, "Requested asset does not exist or has no loader: %s", requested.c_str());
+            return standard_errors::not_found;
+        }
+
+        pending.push_back(std::distance(m_assets.begin(), iter));
+    }
+
+    while (!pending.empty())
+    {
+        size_t index = pending.back();
+        pending.pop_back();
+
+        if (required[index])
+        {
+            continue;
+        }
+
+        required[index] = true;
+        pending.insert(pending.end(), m_assets[index].references.begin(), m_assets[index].references.end());
+    }
+
+    // Compact the list and remap the references to the new indices.
+    std::vector<size_t> remap(m_assets.size(), 0);
+    std::vector<cook_entry> filtered;
+
+    for (size_t i = 0; i < m_assets.size(); i++)
+    {
+        if (required[i])
+        {
+            remap[i] = filtered.size();
+            filtered.push_back(std::move(m_assets[i]));
+        }
+    }
+
+    for (cook_entry& entry : filtered)
+    {
+        for (size_t& reference : entry.references)
+        {
+            reference = remap[reference];
+        }
+    }
+
+    m_assets = std::move(filtered);
+
+    return true;
+}
+
+void cooker_app::cook_single_asset(size_t index)
+{
+    cook_entry& entry = m_assets[index];
+
+    double start_time = get_seconds();
+    entry.result = m_asset_manager->cook_asset(entry.path.c_str(), entry.loader);
+    entry.elapsed = get_seconds() - start_time;
+
+    if (entry.result == asset_cook_result::failed)
+    {
+        db_error(asset, "[%s] Failed to cook asset.", entry.path.c_str());
+    }
+    else if (entry.result == asset_cook_result::compiled)
+    {
+        db_log(asset, "[%s] Compiled in %.2f s.", entry.path.c_str(), entry.elapsed);
+    }
+}
+
+bool cooker_app::cook_assets()
+{
+    task_graph graph(task_queue::loading);
+
+    auto build_graph = [this, &graph](bool add_dependencies) {
+        graph.clear();
+
+        for (size_t i = 0; i < m_assets.size(); i++)
+        {
+            graph.add_node(m_assets[i].path.c_str(), [this, i]() {
+                cook_single_asset(i);
+            });
+        }
+
+        if (add_dependencies)
+        {
+            for (size_t i = 0; i < m_assets.size(); i++)
+            {
+                for (size_t reference : m_assets[i].references)
+                {
+                    graph.add_dependency(i, reference);
+                }
+            }
+        }
+
+        return graph.compile();
+    };
+
+    // Assets can legitimately reference each other in a loop, the order only matters for
+    // getting dependencies compiled first so in that case just compile them all in parallel.
+    if (!build_graph(true))
+    {
+        db_warning(asset, "Asset references contain a cycle, cooking without ordering.");
+
+        if (!build_graph(false))
+        {
+            return false;
+        }
+    }
+
+    graph.execute();
+
+    return std::none_of(m_assets.begin(), m_assets.end(), [](const cook_entry& entry) {
+        return entry.result == asset_cook_result::failed;
+    });
+}
+
+void cooker_app::print_summary(double elapsed)
+{
+    struct type_summary
+    {
+        size_t total = 0;
+        size_t compiled = 0;
+        size_t up_to_date = 0;
+        size_t failed = 0;
+        double total_time = 0.0;
+        double max_time = 0.0;
+        const cook_entry* slowest = nullptr;
+    };
+
+    std::map<std::string, type_summary> summaries;
+
+    for (const cook_entry& entry : m_assets)
+    {
+        type_summary& summary = summaries[entry.loader->get_descriptor_type()];
+        summary.total++;
+        summary.total_time += entry.elapsed;
+
+        switch (entry.result)
+        {
+        case asset_cook_result::compiled:   summary.compiled++;     break;
+        case asset_cook_result::up_to_date: summary.up_to_date++;   break;
+        case asset_cook_result::failed:     summary.failed++;       break;
+        }
+
+        if (summary.slowest == nullptr || entry.elapsed > summary.max_time)
+        {
+            summary.max_time = entry.elapsed;
+            summary.slowest = &entry;
+        }
+    }
+
+    db_log(asset, "");
+    db_log(asset, "%-12s %8s %10s %10s %8s %12s %10s  %s", "type", "assets", "compiled", "up to date", "failed", "total time", "max time", "slowest");
+
+    for (auto& [type, summary] : summaries)
+    {
+        db_log(asset, "%-12s %8zi %10zi %10zi %8zi %10.2f s %8.2f s  %s",
+            type.c_str(),
+            summary.total,
+            summary.compiled,
+            summary.up_to_date,
+            summary.failed,
+            summary.total_time,
+            summary.max_time,
+            summary.slowest ? summary.slowest->path.c_str() : "");
+    }
+
+    db_log(asset, "");
+    db_log(asset, "Cooked %zi assets in %.2f s across %zi workers.", m_assets.size(), elapsed, m_task_scheduler->get_worker_count(task_queue::loading));
+}
+
+result<void> cooker_app::loop()
+{
+    double start_time = get_seconds();
+
+    gather_assets();
+
+    if (result<void> ret = filter_requested_assets(); !ret)
+    {
+        return ret;
+    }
+
+    db_log(asset, "Cooking %zi assets.", m_assets.size());
+
+    bool success = cook_assets();
+
+    // Recompiled assets replace their cache entries, which can leave blobs nothing links to.
+    m_local_cache->remove_unreferenced_blobs();
+
+    print_summary(get_seconds() - start_time);
+
+    if (!success)
+    {
+        db_error(asset, "Failed to cook all assets.");
+        return standard_errors::failed;
+    }
+
+    return true;
+}
+
+}; // namespace ws
@@ -0,0 +1,119 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/app/app.h"
+#include "workshop.core/async/task_scheduler.h"
+#include "workshop.core/filesystem/virtual_file_system.h"
+#include "workshop.assets/asset_manager.h"
+#include "workshop.assets/content_hash_index.h"
+#include "workshop.render_interface/ri_interface.h"
+#include "workshop.renderer/renderer.h"
+
+#include "thirdparty/yamlcpp/include/yaml-cpp/yaml.h"
+
+#include "workshop.cooker/cooker_headless.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace ws {
+
+class asset_cache_disk;
+
+// ================================================================================================
+//  Compiles every asset of a game ahead of time without creating a window or a gpu device.
+//
+//  All asset descriptors are enumerated, references between them are resolved and everything
+//  is compiled through the registered asset loaders as a task graph across every worker.
+//  Dependencies are compiled before the assets that reference them. Assets that already have
+//  an up to date entry in the asset cache are skipped, so repeat runs only compile what has
+//  changed. A summary of how long each asset type took is logged once complete.
+//
+//  If any assets are given only they, and the assets they reference, are cooked.
+//
+//  Cache keys are derived from the content of source files if -content_hash is given, this is
+//  always the case when using a shared cache as modification times differ between machines.
+//
+//  Usage: workshop.cooker [assets...] [-game <name>] [-workers <count>] [-shared_cache <socket>]
+//                         [-content_hash] [-vulkan]
+// ================================================================================================
+class cooker_app : public app
+{
+public:
+    virtual std::string get_name() override;
+
+protected:
+    virtual result<void> start() override;
+    virtual result<void> loop() override;
+    virtual result<void> stop() override;
+
+private:
+
+    struct cook_entry
+    {
+        std::string path;
+        asset_loader* loader = nullptr;
+
+        // Indices of the assets this asset references.
+        std::vector<size_t> references;
+
+        // Filled in once cooked.
+        asset_cook_result result = asset_cook_result::failed;
+        double elapsed = 0.0;
+    };
+
+    result<void> parse_command_line();
+
+    result<void> create_filesystem();
+    result<void> create_asset_manager();
+
+    // Finds all the asset descriptors and the references between them.
+    void gather_assets();
+
+    // Recursively collects the paths of all assets referenced by a descriptor.
+    void gather_references(const YAML::Node& node, std::vector<std::string>& references);
+
+    // Removes all assets that are not in the closure of the assets requested on the command line.
+    result<void> filter_requested_assets();
+
+    // Compiles all gathered assets, returns false if any failed.
+    bool cook_assets();
+    void cook_single_asset(size_t index);
+
+    void print_summary(double elapsed);
+
+private:
+
+    std::string m_game_name = "example";
+    std::vector<std::string> m_requested_assets;
+    size_t m_worker_count = 0;
+    std::string m_shared_cache_socket;
+    bool m_content_hash = false;
+    ri_interface_type m_render_interface_type;
+
+    std::filesystem::path m_engine_asset_dir;
+    std::filesystem::path m_game_asset_dir;
+    std::filesystem::path m_asset_cache_dir;
+
+    std::vector<cook_entry> m_assets;
+
+    std::unique_ptr<task_scheduler> m_task_scheduler;
+    std::unique_ptr<virtual_file_system> m_filesystem;
+    std::unique_ptr<content_hash_index> m_content_hash_index;
+    std::unique_ptr<asset_manager> m_asset_manager;
+
+    // Local cache compiled assets are stored in, owned by the asset manager.
+    asset_cache_disk* m_local_cache = nullptr;
+
+    std::unique_ptr<ri_interface> m_render_interface;
+    std::unique_ptr<headless_window> m_window;
+    std::unique_ptr<headless_input_interface> m_input_interface;
+    std::unique_ptr<renderer> m_renderer;
+
+};
+
+}; // namespace ws
@@ -0,0 +1,58 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.window_interface/window.h"
+#include "workshop.input_interface/input_interface.h"
+
+namespace ws {
+
+// ================================================================================================
+//  Window that is never shown. The renderer requires a window to be constructed, but the
+//  cooker only uses it to register asset loaders so nothing is ever presented to it.
+// ================================================================================================
+class headless_window : public window
+{
+public:
+    virtual result<void> apply_changes() override
+    {
+        return true;
+    }
+
+    virtual void* get_platform_handle() override
+    {
+        return nullptr;
+    }
+};
+
+// ================================================================================================
+//  Input interface that never recieves any input.
+// ================================================================================================
+class headless_input_interface : public input_interface
+{
+public:
+    virtual void register_init(init_list& list) override {}
+    virtual void pump_events() override {}
+
+    virtual bool is_key_down(input_key key) override { return false; }
+    virtual bool was_key_pressed(input_key key) override { return false; }
+    virtual bool was_key_released(input_key key) override { return false; }
+    virtual bool was_key_hit(input_key key) override { return false; }
+
+    virtual std::string get_clipboard_text() override { return ""; }
+    virtual void set_clipboard_text(const char* text) override {}
+
+    virtual vector2 get_mouse_position() override { return vector2::zero; }
+    virtual void set_mouse_position(const vector2& pos) override {}
+    virtual float get_mouse_wheel_delta(bool horizontal) override { return 0.0f; }
+    virtual void set_mouse_cursor(input_cursor cursor) override {}
+    virtual void set_mouse_capture(bool capture) override {}
+    virtual bool get_mouse_capture() override { return false; }
+    virtual void set_mouse_hidden(bool hidden) override {}
+
+    virtual std::string get_input() override { return ""; }
+};
+
+}; // namespace ws
@@ -6,8 +6,12 @@
 #include "workshop.core/containers/string.h"
 
 #include <array>
+#include <cstring>
+#include <filesystem>
 #include <sys/prctl.h>
 #include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
 
 // If se async writing will happen on a background thread to avoid spikes when writing to output.
 #define USE_ASYNC_CONSOLE_LOGGING 1
@@ -61,14 +65,73 @@ result<void> db_unload_symbols()
     return true;
 }
 
+size_t db_capture_raw_callstack(void** frames, size_t frame_count, size_t frame_offset)
+{
+    constexpr size_t k_max_frames = 256;
+    std::array<void*, k_max_frames> buffer;
+
+    // backtrace can't skip frames itself, so capture into a local buffer and copy out the ones requested.
+    size_t skip_frames = frame_offset + 1;
+    size_t captured_frames = static_cast<size_t>(backtrace(buffer.data(), static_cast<int>(std::min(frame_count + skip_frames, k_max_frames))));
+    if (captured_frames <= skip_frames)
+    {
+        return 0;
+    }
+
+    size_t result = std::min(captured_frames - skip_frames, frame_count);
+    memcpy(frames, buffer.data() + skip_frames, result * sizeof(void*));
+
+    return result;
+}
+
 std::unique_ptr<db_callstack> db_capture_callstack(size_t frame_offset, size_t frame_count)
 {
-    std::unique_ptr<db_callstack> result = std::make_unique<db_callstack>();
+    constexpr size_t k_max_frames = 256;
+    std::array<void*, k_max_frames> frames;
+
+    size_t captured_frames = db_capture_raw_callstack(frames.data(), std::min(frame_count, k_max_frames), frame_offset + 1);
 
-    void* buffer[256];
+    return db_resolve_callstack(frames.data(), captured_frames);
+}
 
-    // linux-todo: backtrace + backtrace_symbols
-    //int ret = backtrace(, buffer, sizeof(buffer));
+std::unique_ptr<db_callstack> db_resolve_callstack(void* const* frames, size_t captured_frames)
+{
+    std::unique_ptr<db_callstack> result = std::make_unique<db_callstack>();
+    result->frames.resize(captured_frames);
+
+    for (size_t i = 0; i < captured_frames; i++)
+    {
+        db_callstack::frame& frame = result->frames[i];
+        frame.address = reinterpret_cast<size_t>(frames[i]);
+        frame.line = 0;
+
+        // Only exported symbols can be resolved this way, link with -rdynamic to get everything.
+        Dl_info info;
+        if (dladdr(frames[i], &info) == 0)
+        {
+            continue;
+        }
+
+        if (info.dli_fname)
+        {
+            frame.module = std::filesystem::path(info.dli_fname).filename().string();
+        }
+
+        if (info.dli_sname)
+        {
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            if (demangled != nullptr && status == 0)
+            {
+                frame.function = demangled;
+            }
+            else
+            {
+                frame.function = info.dli_sname;
+            }
+            free(demangled);
+        }
+    }
 
     return std::move(result);
 }
@@ -5,6 +5,7 @@
 #include "workshop.core/entry.h"
 #include "workshop.core/memory/memory.h"
 #include "workshop.core/memory/memory_tracker.h"
+#include "workshop.core/memory/memory_profiler.h"
 
 namespace ws
 {
@@ -15,6 +16,7 @@ int main(int argc, char* argv[])
 {
     // Hook memory functions as early as possible.
     ws::memory_tracker mem_tracker;
+    ws::memory_profiler mem_profiler;
     ws::install_memory_hooks();
 
     return ws::entry_point(argc, argv);
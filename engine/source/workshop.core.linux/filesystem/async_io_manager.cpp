@@ -8,75 +8,750 @@
 #include "workshop.core.linux/filesystem/async_io_manager.h"
 #include "workshop.core/memory/memory_tracker.h"
 #include "workshop.core/perf/profile.h"
+#include "workshop.core/cvar/core_cvars.h"
 
 #include <filesystem>
 #include <span>
 #include <mutex>
 #include <cstddef>
+#include <cstring>
+#include <cstdlib>
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
 
 namespace ws {
 
-// linux-todo
+namespace {
+
+int sys_io_uring_setup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+}; // namespace
 
 std::unique_ptr<async_io_manager> async_io_manager::create()
 {
     return std::make_unique<linux_async_io_manager>();
 }
 
-linux_async_io_request::linux_async_io_request(linux_async_io_manager* manager, const char* path, size_t offset, size_t size, async_io_request_options options)
+linux_async_io_request::linux_async_io_request(linux_async_io_manager* manager, const char* path, size_t offset, size_t size, async_io_request_options options, async_io_request_priority priority)
     : m_manager(manager)
     , m_path(path)
     , m_offset(offset)
     , m_size(size)
     , m_options(options)
+    , m_priority(priority)
 {
 }
 
 linux_async_io_request::~linux_async_io_request()
 {
+    if (m_buffer)
+    {
+        m_manager->free_buffer(m_buffer);
+        m_buffer = nullptr;
+    }
 }
 
 bool linux_async_io_request::is_complete()
 {
-    return false;
+    state current_state = m_state.load();
+    return (current_state == state::completed || current_state == state::failed);
 }
 
 bool linux_async_io_request::has_failed()
 {
-    return false;
+    return (m_state.load() == state::failed);
 }
 
 void linux_async_io_request::set_state(state new_state)
 {
+    m_state = new_state;
+
+    if (new_state == state::completed || new_state == state::failed)
+    {
+        raise_completion_callbacks();
+    }
 }
 
 std::span<uint8_t> linux_async_io_request::data()
 {
-    return {};
+    return std::span<uint8_t>(
+        reinterpret_cast<uint8_t*>(m_buffer) + m_buffer_data_offset,
+        m_size
+    );
 }
 
 linux_async_io_manager::linux_async_io_manager()
 {
+    m_wake_event_fd = eventfd(0, EFD_CLOEXEC);
+
+    if (m_wake_event_fd >= 0 && create_ring())
+    {
+        db_log(core, "Using io_uring for async io (%u submission entries, registered files %s).", m_ring.sq_entries, m_ring.files_registered ? "enabled" : "disabled");
+
+        m_uring_available = true;
+        m_threads.push_back(std::make_unique<std::thread>([this]() {
+            uring_worker_thread();
+        }));
+    }
+    else
+    {
+        db_warning(core, "io_uring is unavailable, falling back to %zi pread threads for async io.", k_pread_thread_count);
+
+        for (size_t i = 0; i < k_pread_thread_count; i++)
+        {
+            m_threads.push_back(std::make_unique<std::thread>([this]() {
+                pread_worker_thread();
+            }));
+        }
+    }
 }
 
 linux_async_io_manager::~linux_async_io_manager()
 {
+    m_active = false;
+    signal_worker();
+
+    for (auto& thread : m_threads)
+    {
+        thread->join();
+    }
+    m_threads.clear();
+
+    destroy_ring();
+
+    for (auto& [path, file] : m_files)
+    {
+        close(file.fd);
+    }
+    m_files.clear();
+    m_file_lru.clear();
+
+    if (m_wake_event_fd >= 0)
+    {
+        close(m_wake_event_fd);
+        m_wake_event_fd = -1;
+    }
 }
 
-void linux_async_io_manager::worker_thread()
+bool linux_async_io_manager::create_ring()
+{
+    // Large enough to hold a full queue of reads as well as the wake read.
+    unsigned entries = static_cast<unsigned>(math::round_up_multiple(k_ideal_queue_depth + 1, (size_t)64));
+
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    m_ring.fd = sys_io_uring_setup(entries, &params);
+    if (m_ring.fd < 0)
+    {
+        db_log(core, "io_uring_setup failed with error %i: %s", errno, strerror(errno));
+        m_ring.fd = -1;
+        return false;
+    }
+
+    m_ring.sq_entries = params.sq_entries;
+    m_ring.cq_entries = params.cq_entries;
+
+    m_ring.sq_ptr_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_ring.cq_ptr_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    // Newer kernels let both rings be mapped with a single mmap.
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+    {
+        m_ring.sq_ptr_size = std::max(m_ring.sq_ptr_size, m_ring.cq_ptr_size);
+        m_ring.cq_ptr_size = m_ring.sq_ptr_size;
+    }
+
+    m_ring.sq_ptr = mmap(nullptr, m_ring.sq_ptr_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring.fd, IORING_OFF_SQ_RING);
+    if (m_ring.sq_ptr == MAP_FAILED)
+    {
+        m_ring.sq_ptr = nullptr;
+        destroy_ring();
+        return false;
+    }
+
+    if (single_mmap)
+    {
+        m_ring.cq_ptr = m_ring.sq_ptr;
+    }
+    else
+    {
+        m_ring.cq_ptr = mmap(nullptr, m_ring.cq_ptr_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring.fd, IORING_OFF_CQ_RING);
+        if (m_ring.cq_ptr == MAP_FAILED)
+        {
+            m_ring.cq_ptr = nullptr;
+            destroy_ring();
+            return false;
+        }
+    }
+
+    m_ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, m_ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring.fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        destroy_ring();
+        return false;
+    }
+    m_ring.sqes = reinterpret_cast<io_uring_sqe*>(sqes);
+
+    uint8_t* sq_base = reinterpret_cast<uint8_t*>(m_ring.sq_ptr);
+    m_ring.sq_head = reinterpret_cast<unsigned*>(sq_base + params.sq_off.head);
+    m_ring.sq_tail = reinterpret_cast<unsigned*>(sq_base + params.sq_off.tail);
+    m_ring.sq_mask = reinterpret_cast<unsigned*>(sq_base + params.sq_off.ring_mask);
+    m_ring.sq_array = reinterpret_cast<unsigned*>(sq_base + params.sq_off.array);
+
+    uint8_t* cq_base = reinterpret_cast<uint8_t*>(m_ring.cq_ptr);
+    m_ring.cq_head = reinterpret_cast<unsigned*>(cq_base + params.cq_off.head);
+    m_ring.cq_tail = reinterpret_cast<unsigned*>(cq_base + params.cq_off.tail);
+    m_ring.cq_mask = reinterpret_cast<unsigned*>(cq_base + params.cq_off.ring_mask);
+    m_ring.cqes = reinterpret_cast<io_uring_cqe*>(cq_base + params.cq_off.cqes);
+
+    // Register a sparse file table, files are added to it as they are opened. Fixed files save
+    // the kernel looking up and reference counting the file on every read.
+    std::vector<int> fds(k_max_fixed_files, -1);
+    m_ring.files_registered = (sys_io_uring_register(m_ring.fd, IORING_REGISTER_FILES, fds.data(), static_cast<unsigned>(fds.size())) == 0);
+
+    return true;
+}
+
+void linux_async_io_manager::destroy_ring()
+{
+    if (m_ring.sqes)
+    {
+        munmap(m_ring.sqes, m_ring.sqes_size);
+    }
+    if (m_ring.cq_ptr && m_ring.cq_ptr != m_ring.sq_ptr)
+    {
+        munmap(m_ring.cq_ptr, m_ring.cq_ptr_size);
+    }
+    if (m_ring.sq_ptr)
+    {
+        munmap(m_ring.sq_ptr, m_ring.sq_ptr_size);
+    }
+    if (m_ring.fd >= 0)
+    {
+        close(m_ring.fd);
+    }
+
+    m_ring = {};
+}
+
+void linux_async_io_manager::signal_worker()
+{
+    {
+        std::unique_lock lock(m_request_mutex);
+        m_request_cvar.notify_all();
+    }
+
+    if (m_wake_event_fd >= 0)
+    {
+        uint64_t value = 1;
+        [[maybe_unused]] ssize_t ret = write(m_wake_event_fd, &value, sizeof(value));
+    }
+}
+
+linux_async_io_request::ptr linux_async_io_manager::pop_pending_request()
+{
+    std::unique_lock lock(m_request_mutex);
+
+    for (int priority = static_cast<int>(async_io_request_priority::COUNT) - 1; priority >= 0; priority--)
+    {
+        std::list<linux_async_io_request::ptr>& pending = m_pending_requests[priority];
+        if (!pending.empty())
+        {
+            linux_async_io_request::ptr result = pending.front();
+            pending.pop_front();
+            return result;
+        }
+    }
+
+    return nullptr;
+}
+
+void linux_async_io_manager::uring_worker_thread()
+{
+    db_set_thread_name("async io manager");
+
+    queue_uring_wake();
+
+    while (m_active || !m_outstanding_requests.empty() || m_wake_outstanding)
+    {
+        // Fill up the queue with pending requests, highest priority first.
+        while (m_active && m_outstanding_requests.size() < k_ideal_queue_depth)
+        {
+            linux_async_io_request::ptr request = pop_pending_request();
+            if (!request)
+            {
+                break;
+            }
+
+            if (prepare_request(*request))
+            {
+                queue_uring_read(request);
+            }
+        }
+
+        // Submit everything in a single call and sleep until either a read finishes or
+        // the wake read completes because new requests have been added.
+        submit_uring(true);
+
+        // Reap completions.
+        unsigned head = __atomic_load_n(m_ring.cq_head, __ATOMIC_RELAXED);
+        unsigned tail = __atomic_load_n(m_ring.cq_tail, __ATOMIC_ACQUIRE);
+
+        while (head != tail)
+        {
+            io_uring_cqe& cqe = m_ring.cqes[head & *m_ring.cq_mask];
+            uint64_t user_data = cqe.user_data;
+            int result = cqe.res;
+
+            head++;
+
+            if (user_data == k_wake_user_data)
+            {
+                m_wake_outstanding = false;
+                if (m_active)
+                {
+                    queue_uring_wake();
+                }
+                continue;
+            }
+
+            auto iter = m_outstanding_requests.find(user_data);
+            if (iter == m_outstanding_requests.end())
+            {
+                continue;
+            }
+
+            linux_async_io_request::ptr request = iter->second;
+            m_outstanding_requests.erase(iter);
+
+            if (!complete_request(*request, result))
+            {
+                queue_uring_read(request);
+            }
+        }
+
+        __atomic_store_n(m_ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+void linux_async_io_manager::pread_worker_thread()
 {
     db_set_thread_name("async io manager");
+
+    while (true)
+    {
+        linux_async_io_request::ptr request;
+
+        {
+            std::unique_lock lock(m_request_mutex);
+            m_request_cvar.wait(lock, [this]() {
+                if (!m_active)
+                {
+                    return true;
+                }
+                for (auto& pending : m_pending_requests)
+                {
+                    if (!pending.empty())
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            });
+
+            if (!m_active)
+            {
+                break;
+            }
+        }
+
+        request = pop_pending_request();
+        if (!request || !prepare_request(*request))
+        {
+            continue;
+        }
+
+        profile_marker(profile_colors::task, "Read File");
+
+        while (true)
+        {
+            ssize_t result = pread(
+                request->m_fd,
+                reinterpret_cast<uint8_t*>(request->m_buffer) + request->m_bytes_read,
+                request->m_read_size - request->m_bytes_read,
+                request->m_read_offset + request->m_bytes_read);
+
+            if (result < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (complete_request(*request, result < 0 ? -errno : result))
+            {
+                break;
+            }
+        }
+    }
+}
+
+bool linux_async_io_manager::prepare_request(linux_async_io_request& request)
+{
+    memory_scope scope(memory_type::engine__async_io);
+
+    open_file file = get_file(request.m_path.c_str());
+    if (file.fd < 0)
+    {
+        request.set_state(linux_async_io_request::state::failed);
+        return false;
+    }
+
+    request.m_fd = file.fd;
+    request.m_fixed_file_index = file.fixed_file_index;
+
+    // Offset, size and buffer all need to be aligned for O_DIRECT. We align even when
+    // not using it so the same reads are issued either way.
+    request.m_read_offset = (request.m_offset / k_read_alignment) * k_read_alignment;
+    request.m_buffer_data_offset = request.m_offset - request.m_read_offset;
+    request.m_read_size = math::round_up_multiple(request.m_size + request.m_buffer_data_offset, k_read_alignment);
+    request.m_bytes_read = 0;
+
+    request.m_buffer = alloc_buffer(request.m_read_size);
+    if (request.m_buffer == nullptr)
+    {
+        db_error(core, "Failed to allocate %zi byte buffer for async read: %s", request.m_read_size, request.m_path.c_str());
+        release_file(request.m_path.c_str());
+        request.set_state(linux_async_io_request::state::failed);
+        return false;
+    }
+
+    request.m_start_time = get_seconds();
+    request.set_state(linux_async_io_request::state::outstanding);
+
+    return true;
+}
+
+void linux_async_io_manager::queue_uring_read(linux_async_io_request::ptr request)
+{
+    if (m_ring.to_submit >= m_ring.sq_entries)
+    {
+        submit_uring(false);
+    }
+
+    unsigned tail = __atomic_load_n(m_ring.sq_tail, __ATOMIC_RELAXED);
+    unsigned index = tail & *m_ring.sq_mask;
+
+    request->m_iovec.iov_base = reinterpret_cast<uint8_t*>(request->m_buffer) + request->m_bytes_read;
+    request->m_iovec.iov_len = request->m_read_size - request->m_bytes_read;
+
+    uint64_t user_data = m_next_user_data++;
+
+    io_uring_sqe& sqe = m_ring.sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READV;
+    sqe.addr = reinterpret_cast<uint64_t>(&request->m_iovec);
+    sqe.len = 1;
+    sqe.off = request->m_read_offset + request->m_bytes_read;
+    sqe.user_data = user_data;
+
+    if (request->m_fixed_file_index >= 0)
+    {
+        sqe.fd = request->m_fixed_file_index;
+        sqe.flags |= IOSQE_FIXED_FILE;
+    }
+    else
+    {
+        sqe.fd = request->m_fd;
+    }
+
+    m_ring.sq_array[index] = index;
+    __atomic_store_n(m_ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    m_ring.to_submit++;
+
+    m_outstanding_requests[user_data] = request;
+}
+
+void linux_async_io_manager::queue_uring_wake()
+{
+    if (m_ring.to_submit >= m_ring.sq_entries)
+    {
+        submit_uring(false);
+    }
+
+    unsigned tail = __atomic_load_n(m_ring.sq_tail, __ATOMIC_RELAXED);
+    unsigned index = tail & *m_ring.sq_mask;
+
+    m_wake_iovec.iov_base = &m_wake_event_value;
+    m_wake_iovec.iov_len = sizeof(m_wake_event_value);
+
+    io_uring_sqe& sqe = m_ring.sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = m_wake_event_fd;
+    sqe.addr = reinterpret_cast<uint64_t>(&m_wake_iovec);
+    sqe.len = 1;
+    sqe.user_data = k_wake_user_data;
+
+    m_ring.sq_array[index] = index;
+    __atomic_store_n(m_ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    m_ring.to_submit++;
+
+    m_wake_outstanding = true;
+}
+
+void linux_async_io_manager::submit_uring(bool wait)
+{
+    while (true)
+    {
+        unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+
+        // Don't block if completions are already waiting to be reaped.
+        unsigned min_complete = wait ? 1 : 0;
+        if (__atomic_load_n(m_ring.cq_head, __ATOMIC_RELAXED) != __atomic_load_n(m_ring.cq_tail, __ATOMIC_ACQUIRE))
+        {
+            min_complete = 0;
+        }
+
+        int result = sys_io_uring_enter(m_ring.fd, m_ring.to_submit, min_complete, flags);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            // EBUSY means the completion queue is full, the caller will reap and we will submit next time.
+            if (errno != EBUSY && errno != EAGAIN)
+            {
+                db_error(core, "io_uring_enter failed with error %i: %s", errno, strerror(errno));
+            }
+            return;
+        }
+
+        m_ring.to_submit -= std::min(m_ring.to_submit, static_cast<unsigned>(result));
+        return;
+    }
+}
+
+bool linux_async_io_manager::complete_request(linux_async_io_request& request, ssize_t result)
+{
+    if (result < 0)
+    {
+        db_error(core, "Failed to run async read with error %i (%s): %s", static_cast<int>(-result), strerror(static_cast<int>(-result)), request.m_path.c_str());
+        release_file(request.m_path.c_str());
+        request.set_state(linux_async_io_request::state::failed);
+        return true;
+    }
+
+    request.m_bytes_read += static_cast<size_t>(result);
+
+    size_t required_bytes = request.m_buffer_data_offset + request.m_size;
+    if (request.m_bytes_read >= required_bytes)
+    {
+        // Only count the bytes that were asked for, alignment padding isn't useful bandwidth.
+        double elapsed = get_seconds() - request.m_start_time;
+
+        {
+            std::unique_lock lock(m_bandwidth_mutex);
+            m_bandwidth_average.add(static_cast<double>(request.m_size), elapsed);
+        }
+
+        release_file(request.m_path.c_str());
+        request.set_state(linux_async_io_request::state::completed);
+        return true;
+    }
+
+    // Reached the end of the file before reading everything we wanted.
+    if (result == 0)
+    {
+        db_error(core, "Failed to run async read, got %zi bytes expected at least %zi: %s", request.m_bytes_read - std::min(request.m_bytes_read, request.m_buffer_data_offset), request.m_size, request.m_path.c_str());
+        release_file(request.m_path.c_str());
+        request.set_state(linux_async_io_request::state::failed);
+        return true;
+    }
+
+    // Short read, read the remainder.
+    return false;
 }
 
 float linux_async_io_manager::get_current_bandwidth()
 {
-    return 0.0f;
+    std::unique_lock lock(m_bandwidth_mutex);
+
+    return (float)m_bandwidth_average.get();
 }
 
-async_io_request::ptr linux_async_io_manager::request(const char* path, size_t offset, size_t size, async_io_request_options options)
+async_io_request::ptr linux_async_io_manager::request(const char* path, size_t offset, size_t size, async_io_request_options options, async_io_request_priority priority)
 {
-    db_assert(false);
-    return nullptr;
+    linux_async_io_request::ptr request = std::make_shared<linux_async_io_request>(this, path, offset, size, options, priority);
+
+    {
+        std::unique_lock lock(m_request_mutex);
+        m_pending_requests[static_cast<int>(priority)].push_back(request);
+    }
+
+    signal_worker();
+
+    return request;
+}
+
+void linux_async_io_manager::free_buffer(void* ptr)
+{
+    free(ptr);
+}
+
+void* linux_async_io_manager::alloc_buffer(size_t size)
+{
+    return aligned_alloc(k_read_alignment, size);
+}
+
+linux_async_io_manager::open_file linux_async_io_manager::get_file(const char* path)
+{
+    std::unique_lock lock(m_file_mutex);
+
+    if (auto iter = m_files.find(path); iter != m_files.end())
+    {
+        open_file& file = iter->second;
+        file.in_flight++;
+        m_file_lru.splice(m_file_lru.end(), m_file_lru, file.lru_iter);
+        return file;
+    }
+
+    profile_marker(profile_colors::task, "Open File");
+
+    db_log(core, "Opening file for async io: %s", path);
+
+    open_file file;
+
+    // Not all filesystems support O_DIRECT (eg. tmpfs), fall back to buffered reads for them.
+    if (cvar_async_io_direct.get_bool())
+    {
+        file.fd = open(path, O_RDONLY | O_CLOEXEC | O_DIRECT);
+    }
+    if (file.fd < 0)
+    {
+        file.fd = open(path, O_RDONLY | O_CLOEXEC);
+    }
+
+    if (file.fd < 0)
+    {
+        db_error(core, "Failed to open file for async io with error %i (%s): %s", errno, strerror(errno), path);
+        return file;
+    }
+
+    // Add to the rings registered files if there is space, reusing slots of files that have been closed.
+    if (m_ring.files_registered && (!m_free_fixed_file_indices.empty() || m_next_fixed_file_index < static_cast<int>(k_max_fixed_files)))
+    {
+        int index = m_free_fixed_file_indices.empty() ? m_next_fixed_file_index : m_free_fixed_file_indices.back();
+
+        io_uring_files_update update;
+        memset(&update, 0, sizeof(update));
+        update.offset = static_cast<uint32_t>(index);
+        update.fds = reinterpret_cast<uint64_t>(&file.fd);
+
+        if (sys_io_uring_register(m_ring.fd, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1)
+        {
+            file.fixed_file_index = index;
+
+            if (m_free_fixed_file_indices.empty())
+            {
+                m_next_fixed_file_index++;
+            }
+            else
+            {
+                m_free_fixed_file_indices.pop_back();
+            }
+        }
+    }
+
+    file.in_flight = 1;
+    file.lru_iter = m_file_lru.insert(m_file_lru.end(), path);
+    m_files[path] = file;
+
+    evict_files();
+
+    return file;
+}
+
+void linux_async_io_manager::release_file(const char* path)
+{
+    std::unique_lock lock(m_file_mutex);
+
+    auto iter = m_files.find(path);
+    if (iter == m_files.end())
+    {
+        return;
+    }
+
+    open_file& file = iter->second;
+    db_assert(file.in_flight > 0);
+    file.in_flight--;
+
+    // We may have gone over the limit while every file was busy.
+    if (file.in_flight == 0 && m_files.size() > k_max_open_files)
+    {
+        evict_files();
+    }
+}
+
+void linux_async_io_manager::evict_files()
+{
+    for (auto lru_iter = m_file_lru.begin(); lru_iter != m_file_lru.end() && m_files.size() > k_max_open_files; /* empty */)
+    {
+        auto file_iter = m_files.find(*lru_iter);
+        db_assert(file_iter != m_files.end());
+
+        open_file& file = file_iter->second;
+        if (file.in_flight > 0)
+        {
+            lru_iter++;
+            continue;
+        }
+
+        db_verbose(core, "Closing file for async io: %s", lru_iter->c_str());
+
+        // Nothing is reading from the file so its safe to remove it from the registered file table.
+        if (file.fixed_file_index >= 0)
+        {
+            int invalid_fd = -1;
+
+            io_uring_files_update update;
+            memset(&update, 0, sizeof(update));
+            update.offset = static_cast<uint32_t>(file.fixed_file_index);
+            update.fds = reinterpret_cast<uint64_t>(&invalid_fd);
+
+            if (sys_io_uring_register(m_ring.fd, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1)
+            {
+                m_free_fixed_file_indices.push_back(file.fixed_file_index);
+            }
+        }
+
+        close(file.fd);
+
+        m_files.erase(file_iter);
+        lru_iter = m_file_lru.erase(lru_iter);
+    }
 }
 
 }; // namespace workshop
@@ -13,17 +13,29 @@
 #include <cstddef>
 #include <string>
 #include <unordered_map>
+#include <array>
+#include <list>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
 
 namespace ws {
 
 class linux_async_io_manager;
 
+// Linux implementation of async io request.
 class linux_async_io_request : public async_io_request
 {
 public:
     using ptr = std::shared_ptr<linux_async_io_request>;
 
-    linux_async_io_request(linux_async_io_manager* manager, const char* path, size_t offset, size_t size, async_io_request_options options);
+    linux_async_io_request(linux_async_io_manager* manager, const char* path, size_t offset, size_t size, async_io_request_options options, async_io_request_priority priority);
     virtual ~linux_async_io_request();
 
     virtual bool is_complete() override;
@@ -48,13 +60,36 @@ private:
     size_t m_offset;
     size_t m_size;
     async_io_request_options m_options;
+    async_io_request_priority m_priority;
 
     linux_async_io_manager* m_manager;
 
-    state m_state = state::pending;
+    std::atomic<state> m_state = state::pending;
+
+    // Size and offset aligned to the block size of the file.
+    size_t m_read_offset = 0;
+    size_t m_read_size = 0;
+
+    // Number of bytes read so far, reads can complete short and need to be resubmitted.
+    size_t m_bytes_read = 0;
+
+    size_t m_buffer_data_offset = 0;
+    void* m_buffer = nullptr;
+
+    double m_start_time = 0.0;
+
+    int m_fd = -1;
+    int m_fixed_file_index = -1;
+
+    // Target of the current io_uring read.
+    iovec m_iovec = {};
 
 };
 
+// Linux implementation of async io manager.
+//
+// Reads are submitted in batches through io_uring. If io_uring is unavailable (old kernel, or
+// blocked by a seccomp policy) a small pool of threads servicing reads with pread is used instead.
 class linux_async_io_manager
     : public async_io_manager
 {
@@ -70,14 +105,150 @@ public:
     //
     // No virtualization is performed on the path, this path is expected to be the
     // raw on-disk path.
-    async_io_request::ptr request(const char* path, size_t offset, size_t size, async_io_request_options options);
+    async_io_request::ptr request(const char* path, size_t offset, size_t size, async_io_request_options options, async_io_request_priority priority);
 
 private:
     friend class linux_async_io_request;
 
-    void worker_thread();
+    struct open_file
+    {
+        int fd = -1;
+
+        // Index of the fd in the rings registered file table, or -1 if not registered.
+        int fixed_file_index = -1;
+
+        // Number of requests currently reading from the file, it can't be closed until this is zero.
+        size_t in_flight = 0;
+
+        // Position of the file in m_file_lru.
+        std::list<std::string>::iterator lru_iter;
+    };
+
+    struct ring
+    {
+        int fd = -1;
+
+        void* sq_ptr = nullptr;
+        size_t sq_ptr_size = 0;
+        void* cq_ptr = nullptr;
+        size_t cq_ptr_size = 0;
+        io_uring_sqe* sqes = nullptr;
+        size_t sqes_size = 0;
+
+        // Shared with the kernel, accessed with atomic builtins.
+        unsigned* sq_head = nullptr;
+        unsigned* sq_tail = nullptr;
+        unsigned* sq_mask = nullptr;
+        unsigned* sq_array = nullptr;
+
+        unsigned* cq_head = nullptr;
+        unsigned* cq_tail = nullptr;
+        unsigned* cq_mask = nullptr;
+        io_uring_cqe* cqes = nullptr;
+
+        unsigned sq_entries = 0;
+        unsigned cq_entries = 0;
+
+        // Number of sqes written since the last submit.
+        unsigned to_submit = 0;
+
+        bool files_registered = false;
+    };
+
+    void free_buffer(void* ptr);
+    void* alloc_buffer(size_t size);
+
+    bool create_ring();
+    void destroy_ring();
+
+    void uring_worker_thread();
+    void pread_worker_thread();
+
+    // Pops the highest priority pending request, or nullptr if none are pending.
+    linux_async_io_request::ptr pop_pending_request();
+
+    // Opens and aligns the request ready to be read. Returns false and fails the request on error.
+    bool prepare_request(linux_async_io_request& request);
+
+    // Adds a read for the unread part of the request to the submission queue.
+    void queue_uring_read(linux_async_io_request::ptr request);
+
+    // Adds a read of the wake eventfd to the submission queue.
+    void queue_uring_wake();
+
+    // Submits all queued sqes, optionally waiting for at least one completion.
+    void submit_uring(bool wait);
+
+    // Records the result of a read. Returns false if the request was only partially read and the remainder
+    // needs to be read.
+    bool complete_request(linux_async_io_request& request, ssize_t result);
+
+    void signal_worker();
+
+    // Opens the file, or reuses it if already open, and marks the request as reading from it.
+    open_file get_file(const char* path);
+
+    // Marks a request as no longer reading from the file it got from get_file.
+    void release_file(const char* path);
+
+    // Closes the least recently used files that have no requests reading from them until
+    // no more than k_max_open_files are open. Must be called with m_file_mutex held.
+    void evict_files();
 
 private:
+    std::mutex m_request_mutex;
+    std::condition_variable m_request_cvar;
+
+    std::array<std::list<linux_async_io_request::ptr>, static_cast<int>(async_io_request_priority::COUNT)> m_pending_requests;
+
+    std::vector<std::unique_ptr<std::thread>> m_threads;
+    std::atomic_bool m_active = true;
+
+    ring m_ring;
+    bool m_uring_available = false;
+
+    // Signaled when new requests are added so the io_uring worker wakes up from waiting on completions.
+    int m_wake_event_fd = -1;
+    uint64_t m_wake_event_value = 0;
+    iovec m_wake_iovec = {};
+    bool m_wake_outstanding = false;
+
+    // Requests currently submitted to the ring, indexed by the user data of their sqe.
+    std::unordered_map<uint64_t, linux_async_io_request::ptr> m_outstanding_requests;
+    uint64_t m_next_user_data = k_first_request_user_data;
+
+    std::mutex m_file_mutex;
+    std::unordered_map<std::string, open_file> m_files;
+    int m_next_fixed_file_index = 0;
+    std::vector<int> m_free_fixed_file_indices;
+
+    // Paths of all open files, least recently used first.
+    std::list<std::string> m_file_lru;
+
+    std::mutex m_bandwidth_mutex;
+    rolling_rate<double, 1.0> m_bandwidth_average;
+
+    // Ideal number of requests to keep outstanding at any time to achieve peak
+    // performance and keep memory usage in check.
+    static inline const size_t k_ideal_queue_depth = 96;
+
+    // Size of the registered file table.
+    static inline const size_t k_max_fixed_files = 256;
+
+    // Maximum number of files kept open between requests. This keeps us well clear of the
+    // default fd limit when streaming from thousands of files.
+    static inline const size_t k_max_open_files = 256;
+
+    // Alignment of read offsets, sizes and buffers. Must be a multiple of the logical
+    // block size to use O_DIRECT, 4k covers all common devices.
+    static inline const size_t k_read_alignment = 4096;
+
+    // Number of threads used to service reads when io_uring is unavailable.
+    static inline const size_t k_pread_thread_count = 4;
+
+    // User data of the sqe used to wake the worker.
+    static inline const uint64_t k_wake_user_data = 1;
+    static inline const uint64_t k_first_request_user_data = 2;
 
 };
 
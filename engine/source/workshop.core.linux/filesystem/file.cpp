@@ -4,6 +4,8 @@
 // ================================================================================================
 #include "workshop.core/filesystem/file.h"
 
+#include <sys/stat.h>
+
 namespace ws {
 
 std::filesystem::path get_local_appdata_directory()
@@ -11,4 +13,19 @@ std::filesystem::path get_local_appdata_directory()
     return "~/.local/workshop";
 }
 
+bool get_file_identity(const std::filesystem::path& path, file_identity& identity)
+{
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+    {
+        return false;
+    }
+
+    identity.inode = static_cast<uint64_t>(file_stat.st_ino);
+    identity.modified_time = static_cast<uint64_t>(file_stat.st_mtim.tv_sec) * 1000000000ull + static_cast<uint64_t>(file_stat.st_mtim.tv_nsec);
+    identity.size = static_cast<uint64_t>(file_stat.st_size);
+
+    return true;
+}
+
 }; // namespace workshop
@@ -0,0 +1,67 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.core/filesystem/mapped_file.h"
+#include "workshop.core/debug/debug.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ws {
+
+mapped_file::~mapped_file()
+{
+    if (m_data != nullptr)
+    {
+        munmap(m_data, m_size);
+        m_data = nullptr;
+    }
+}
+
+std::shared_ptr<mapped_file> mapped_file::open(const std::filesystem::path& path, bool sequential)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+
+    size_t size = static_cast<size_t>(file_stat.st_size);
+
+    // Mapped private so writes to the data are copy-on-write and never reach the file.
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+    // The mapping holds its own reference to the file.
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        db_warning(core, "Failed to map file '%s' into memory, error 0x%08x.", path.string().c_str(), errno);
+        return nullptr;
+    }
+
+    madvise(data, size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+    std::shared_ptr<mapped_file> result(new mapped_file());
+    result->m_data = static_cast<uint8_t*>(data);
+    result->m_size = size;
+
+    return result;
+}
+
+std::span<uint8_t> mapped_file::data()
+{
+    return { m_data, m_size };
+}
+
+}; // namespace workshop
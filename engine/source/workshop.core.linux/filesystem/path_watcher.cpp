@@ -4,13 +4,29 @@
 // ================================================================================================
 #include "workshop.core/filesystem/path_watcher.h"
 #include "workshop.core/containers/string.h"
+#include "workshop.core/utils/time.h"
 
 #include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
-namespace ws {
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
 
-// linux-todo
+namespace ws {
 
+// Watches a directory tree with inotify.
+//
+// inotify only watches single directories, so a watch is added for every directory in the
+// tree, all on the same inotify instance. A dedicated thread reads events as they arrive and
+// records which paths changed. Paths only become visible to get_next_change once they have
+// stopped changing for a short interval, so bursts of events (eg. the dozens of IN_MODIFY's
+// from saving a large file) are collapsed into a single change.
 class linux_path_watcher : public path_watcher
 {
 public:
@@ -24,6 +40,59 @@ public:
 
 private:
 
+    struct pending_move
+    {
+        std::string path;
+        bool is_directory;
+    };
+
+    void reader_thread();
+
+    void process_event(const inotify_event& evt);
+
+    // Adds watches to a directory and all the directories below it. If emit_existing is set
+    // all files found are recorded as changed, this is used for directories created or moved
+    // into the tree, whose contents may have changed before the watches were added.
+    void add_watch_recursive(const std::string& path, bool emit_existing);
+    void add_watch(const std::string& path);
+
+    // Removes the watches of a directory, and all the directories below it.
+    void remove_watch_recursive(const std::string& path);
+
+    // Updates the paths of watches on a directory, and all the directories below it, after it has been renamed.
+    void rename_watch_recursive(const std::string& old_path, const std::string& new_path);
+
+    void record_change(const std::string& path);
+
+private:
+    std::string m_root;
+
+    int m_inotify_fd = -1;
+    int m_wake_event_fd = -1;
+
+    std::unique_ptr<std::thread> m_thread;
+    std::atomic_bool m_active = true;
+
+    // Only accessed by the reader thread once initialized.
+    std::unordered_map<int, std::string> m_watches;
+    std::unordered_map<uint32_t, pending_move> m_pending_moves;
+    bool m_watch_limit_warned = false;
+
+    std::mutex m_changes_mutex;
+
+    // Time of the last event seen for each changed path.
+    std::unordered_map<std::string, double> m_pending_changes;
+
+    // Changes that have settled and are ready to be returned.
+    std::vector<event> m_ready_events;
+
+    static inline constexpr uint32_t k_event_mask =
+        IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE |
+        IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+    // How long a path needs to go without changes before its reported.
+    static inline constexpr double k_coalesce_interval = 0.1;
+
 };
 
 linux_path_watcher::linux_path_watcher()
@@ -32,21 +101,312 @@ linux_path_watcher::linux_path_watcher()
 
 bool linux_path_watcher::init(const std::filesystem::path& path)
 {
-    return false;
+    m_root = path.string();
+    while (m_root.size() > 1 && string_ends_with(m_root, "/"))
+    {
+        m_root.pop_back();
+    }
+
+    if (!std::filesystem::is_directory(m_root))
+    {
+        return false;
+    }
+
+    m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify_fd < 0)
+    {
+        db_log(core, "Failed to create inotify instance (errno=%i): %s", errno, m_root.c_str());
+        return false;
+    }
+
+    m_wake_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wake_event_fd < 0)
+    {
+        db_log(core, "Failed to create eventfd for path watcher (errno=%i): %s", errno, m_root.c_str());
+        return false;
+    }
+
+    add_watch_recursive(m_root, false);
+
+    if (m_watches.empty())
+    {
+        return false;
+    }
+
+    m_thread = std::make_unique<std::thread>([this]() {
+        reader_thread();
+    });
+
+    return true;
 }
 
 linux_path_watcher::~linux_path_watcher()
 {
+    if (m_thread)
+    {
+        m_active = false;
+
+        uint64_t value = 1;
+        write(m_wake_event_fd, &value, sizeof(value));
+
+        m_thread->join();
+        m_thread = nullptr;
+    }
+
+    if (m_wake_event_fd >= 0)
+    {
+        close(m_wake_event_fd);
+        m_wake_event_fd = -1;
+    }
+
+    // Closing the instance removes all its watches.
+    if (m_inotify_fd >= 0)
+    {
+        close(m_inotify_fd);
+        m_inotify_fd = -1;
+    }
+}
+
+void linux_path_watcher::reader_thread()
+{
+    db_set_thread_name("path watcher");
+
+    alignas(inotify_event) std::array<char, 64 * 1024> buffer;
+
+    std::array<pollfd, 2> fds = {};
+    fds[0].fd = m_inotify_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_wake_event_fd;
+    fds[1].events = POLLIN;
+
+    while (m_active)
+    {
+        int ret = poll(fds.data(), fds.size(), -1);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            db_error(core, "Failed to poll inotify instance (errno=%i), no longer watching: %s", errno, m_root.c_str());
+            break;
+        }
+
+        if ((fds[0].revents & POLLIN) == 0)
+        {
+            continue;
+        }
+
+        while (true)
+        {
+            ssize_t bytes_read = read(m_inotify_fd, buffer.data(), buffer.size());
+            if (bytes_read <= 0)
+            {
+                break;
+            }
+
+            for (char* ptr = buffer.data(); ptr < buffer.data() + bytes_read; )
+            {
+                const inotify_event* evt = reinterpret_cast<const inotify_event*>(ptr);
+                process_event(*evt);
+                ptr += sizeof(inotify_event) + evt->len;
+            }
+        }
+
+        // Both halves of a rename are queued together, so once the queue is drained anything
+        // still unmatched was moved out of the tree.
+        for (auto& [cookie, move] : m_pending_moves)
+        {
+            if (move.is_directory)
+            {
+                remove_watch_recursive(move.path);
+            }
+        }
+        m_pending_moves.clear();
+    }
+}
+
+void linux_path_watcher::process_event(const inotify_event& evt)
+{
+    if ((evt.mask & IN_Q_OVERFLOW) != 0)
+    {
+        // We've lost events, we don't know what changed so rescan the tree to make sure we at
+        // least pick up any new directories.
+        db_warning(core, "inotify event queue overflowed, some changes may have been missed: %s", m_root.c_str());
+        add_watch_recursive(m_root, false);
+        return;
+    }
+
+    auto iter = m_watches.find(evt.wd);
+    if (iter == m_watches.end())
+    {
+        return;
+    }
+
+    if ((evt.mask & IN_IGNORED) != 0)
+    {
+        m_watches.erase(iter);
+        return;
+    }
+
+    std::string path = iter->second;
+    if (evt.len > 0)
+    {
+        path += "/";
+        path += evt.name;
+    }
+
+    bool is_directory = (evt.mask & IN_ISDIR) != 0;
+
+    if ((evt.mask & IN_MOVED_FROM) != 0)
+    {
+        m_pending_moves[evt.cookie] = { path, is_directory };
+    }
+    else if ((evt.mask & IN_MOVED_TO) != 0)
+    {
+        auto move_iter = m_pending_moves.find(evt.cookie);
+        if (move_iter != m_pending_moves.end() && is_directory)
+        {
+            rename_watch_recursive(move_iter->second.path, path);
+        }
+        else if (is_directory)
+        {
+            add_watch_recursive(path, true);
+        }
+
+        if (move_iter != m_pending_moves.end())
+        {
+            m_pending_moves.erase(move_iter);
+        }
+    }
+    else if ((evt.mask & IN_CREATE) != 0 && is_directory)
+    {
+        add_watch_recursive(path, true);
+    }
+
+    record_change(path);
+}
+
+void linux_path_watcher::add_watch_recursive(const std::string& path, bool emit_existing)
+{
+    add_watch(path);
+
+    std::error_code error;
+    std::filesystem::recursive_directory_iterator iter(path, std::filesystem::directory_options::skip_permission_denied, error);
+    std::filesystem::recursive_directory_iterator end;
+
+    for (; !error && iter != end; iter.increment(error))
+    {
+        std::error_code type_error;
+        if (iter->is_directory(type_error) && !iter->is_symlink(type_error))
+        {
+            add_watch(iter->path().string());
+        }
+        else if (emit_existing)
+        {
+            record_change(iter->path().string());
+        }
+    }
+}
+
+void linux_path_watcher::add_watch(const std::string& path)
+{
+    int wd = inotify_add_watch(m_inotify_fd, path.c_str(), k_event_mask | IN_ONLYDIR | IN_DONT_FOLLOW);
+    if (wd < 0)
+    {
+        if (errno == ENOSPC && !m_watch_limit_warned)
+        {
+            db_warning(core, "Ran out of inotify watches, changes in some directories will not be detected. Consider raising /proc/sys/fs/inotify/max_user_watches.");
+            m_watch_limit_warned = true;
+        }
+        return;
+    }
+
+    // Adding a watch to a directory already being watched returns the existing descriptor,
+    // so this also updates the path if it was renamed.
+    m_watches[wd] = path;
+}
+
+void linux_path_watcher::remove_watch_recursive(const std::string& path)
+{
+    std::string prefix = path + "/";
+
+    for (auto iter = m_watches.begin(); iter != m_watches.end(); )
+    {
+        if (iter->second == path || iter->second.starts_with(prefix))
+        {
+            inotify_rm_watch(m_inotify_fd, iter->first);
+            iter = m_watches.erase(iter);
+        }
+        else
+        {
+            iter++;
+        }
+    }
+}
+
+void linux_path_watcher::rename_watch_recursive(const std::string& old_path, const std::string& new_path)
+{
+    std::string prefix = old_path + "/";
+
+    for (auto& [wd, path] : m_watches)
+    {
+        if (path == old_path || path.starts_with(prefix))
+        {
+            path = new_path + path.substr(old_path.size());
+        }
+    }
+}
+
+void linux_path_watcher::record_change(const std::string& path)
+{
+    std::scoped_lock lock(m_changes_mutex);
+
+    m_pending_changes[path] = get_seconds();
 }
 
 void linux_path_watcher::poll_changes()
 {
+    std::scoped_lock lock(m_changes_mutex);
+
+    if (!m_ready_events.empty())
+    {
+        return;
+    }
 
+    double now = get_seconds();
+
+    for (auto iter = m_pending_changes.begin(); iter != m_pending_changes.end(); )
+    {
+        if (now - iter->second >= k_coalesce_interval)
+        {
+            event& evt = m_ready_events.emplace_back();
+            evt.type = event_type::modified;
+            evt.path = iter->first;
+
+            iter = m_pending_changes.erase(iter);
+        }
+        else
+        {
+            iter++;
+        }
+    }
 }
 
 bool linux_path_watcher::get_next_change(event& out_event)
 {
     poll_changes();
+
+    std::scoped_lock lock(m_changes_mutex);
+
+    if (!m_ready_events.empty())
+    {
+        out_event = m_ready_events.back();
+        m_ready_events.pop_back();
+        return true;
+    }
+
     return false;
 }
 
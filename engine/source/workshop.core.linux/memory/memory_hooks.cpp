@@ -5,11 +5,360 @@
 #include "workshop.core/memory/memory.h"
 #include "workshop.core/memory/memory_tracker.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <malloc.h>
+#include <new>
+#include <unistd.h>
+
+// On linux we don't need to patch anything at runtime. Defining the malloc family in the
+// executable interposes them over glibc's versions for every module in the process, including
+// allocations glibc and other shared libraries make internally. We forward to glibc's
+// implementation through its __libc_ aliases so we never have to look the originals up.
+
+// Every block allocated through these functions has a raw_alloc_tag at the end of it. If
+// the tracker isn't available the tag is written with an invalid magic so the free is ignored.
+// malloc_usable_size is interposed as well so callers that use the full usable size of a block
+// don't overwrite the tag.
+
+// The tracker can allocate while recording (eg. merging asset counters), those allocations
+// come back through here but are always attributed to the tracking overhead without an asset,
+// so the recursion never goes more than one level deep.
+
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+};
+
 namespace ws {
+namespace {
+
+bool g_memory_hooks_installed = false;
+
+// Chunk header flag glibc sets on blocks it allocated directly with mmap.
+constexpr size_t k_glibc_chunk_is_mmapped = 0x2;
+constexpr size_t k_glibc_chunk_flags = 0x7;
+
+memory_tracker* get_hook_tracker()
+{
+    return g_memory_hooks_installed ? memory_tracker::try_get() : nullptr;
+}
+
+void* record_hooked_alloc(void* ptr, size_t alloc_size)
+{
+    if (ptr == nullptr)
+    {
+        return nullptr;
+    }
+
+    if (memory_tracker* tracker = get_hook_tracker())
+    {
+        tracker->record_raw_alloc(ptr, alloc_size);
+    }
+    else
+    {
+        size_t buffer_size = get_raw_usable_size(ptr);
+        memory_tracker::raw_alloc_tag* tag = reinterpret_cast<memory_tracker::raw_alloc_tag*>((uint8_t*)ptr + buffer_size - sizeof(memory_tracker::raw_alloc_tag));
+        tag->magic = 0;
+    }
+
+    return ptr;
+}
+
+void record_hooked_free(void* ptr)
+{
+    if (ptr == nullptr)
+    {
+        return;
+    }
+
+    if (memory_tracker* tracker = get_hook_tracker())
+    {
+        tracker->record_raw_free(ptr);
+    }
+}
+
+bool get_alloc_size(size_t num, size_t size, size_t& alloc_size)
+{
+    if (__builtin_mul_overflow(num, size, &alloc_size) ||
+        __builtin_add_overflow(alloc_size, memory_tracker::k_raw_alloc_tag_size, &alloc_size))
+    {
+        errno = ENOMEM;
+        return false;
+    }
+    return true;
+}
+
+}; // namespace
+
+size_t get_raw_usable_size(void* ptr)
+{
+    // glibc doesn't export an alias for its malloc_usable_size that we could forward to, so 
+    // this does the same thing it does. The size of a chunk and its flags are stored in the word 
+    // before the block, the block can use all of the chunk except its header. Chunks that are 
+    // not mmap'd can also use the first word of the following chunk, which holds our header.
+    size_t header = reinterpret_cast<const size_t*>(ptr)[-1];
+    size_t chunk_size = header & ~k_glibc_chunk_flags;
+    size_t overhead = (header & k_glibc_chunk_is_mmapped) ? sizeof(size_t) * 2 : sizeof(size_t);
+
+    return chunk_size - overhead;
+}
 
 void install_memory_hooks()
 {
-    // linux-todo
+    db_log(core, "Installing memory hooks ...");
+    g_memory_hooks_installed = true;
 }
 
 }; // namespace workshop
+
+// Hook implementations
+extern "C" void* malloc(size_t size)
+{
+    size_t alloc_size;
+    if (!ws::get_alloc_size(1, size, alloc_size))
+    {
+        return nullptr;
+    }
+
+    return ws::record_hooked_alloc(__libc_malloc(alloc_size), alloc_size);
+}
+
+extern "C" void* calloc(size_t num, size_t size)
+{
+    size_t alloc_size;
+    if (!ws::get_alloc_size(num, size, alloc_size))
+    {
+        return nullptr;
+    }
+
+    return ws::record_hooked_alloc(__libc_calloc(1, alloc_size), alloc_size);
+}
+
+extern "C" void* realloc(void* ptr, size_t new_size)
+{
+    if (ptr == nullptr)
+    {
+        return malloc(new_size);
+    }
+
+    if (new_size == 0)
+    {
+        free(ptr);
+        return nullptr;
+    }
+
+    size_t alloc_size;
+    if (!ws::get_alloc_size(1, new_size, alloc_size))
+    {
+        return nullptr;
+    }
+
+    ws::record_hooked_free(ptr);
+
+    void* new_ptr = __libc_realloc(ptr, alloc_size);
+    if (new_ptr == nullptr)
+    {
+        // Original block is still valid, so it needs tracking again.
+        ws::record_hooked_alloc(ptr, ws::get_raw_usable_size(ptr));
+        return nullptr;
+    }
+
+    return ws::record_hooked_alloc(new_ptr, alloc_size);
+}
+
+extern "C" void* reallocarray(void* ptr, size_t num, size_t size)
+{
+    size_t total_size;
+    if (__builtin_mul_overflow(num, size, &total_size))
+    {
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    return realloc(ptr, total_size);
+}
+
+extern "C" void free(void* ptr)
+{
+    ws::record_hooked_free(ptr);
+    __libc_free(ptr);
+}
+
+extern "C" void* memalign(size_t alignment, size_t size)
+{
+    size_t alloc_size;
+    if (!ws::get_alloc_size(1, size, alloc_size))
+    {
+        return nullptr;
+    }
+
+    return ws::record_hooked_alloc(__libc_memalign(alignment, alloc_size), alloc_size);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+extern "C" void* valloc(size_t size)
+{
+    return memalign(static_cast<size_t>(sysconf(_SC_PAGESIZE)), size);
+}
+
+extern "C" void* pvalloc(size_t size)
+{
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    // Rounded up to a whole number of pages, with a minimum of one page.
+    size_t rounded_size;
+    if (__builtin_add_overflow(size, page_size - 1, &rounded_size))
+    {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    rounded_size = std::max(rounded_size & ~(page_size - 1), page_size);
+
+    return memalign(page_size, rounded_size);
+}
+
+extern "C" size_t malloc_usable_size(void* ptr)
+{
+    if (ptr == nullptr)
+    {
+        return 0;
+    }
+
+    // Every block has a tag at its end, which the caller must not be able to write over.
+    size_t buffer_size = ws::get_raw_usable_size(ptr);
+    if (buffer_size < ws::memory_tracker::k_raw_alloc_tag_size)
+    {
+        return 0;
+    }
+
+    return buffer_size - ws::memory_tracker::k_raw_alloc_tag_size;
+}
+
+extern "C" int posix_memalign(void** memptr, size_t alignment, size_t size)
+{
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+
+    void* ptr = memalign(alignment, size);
+    if (ptr == nullptr)
+    {
+        return ENOMEM;
+    }
+
+    *memptr = ptr;
+    return 0;
+}
+
+// Global new/delete, these would reach malloc anyway but routing them directly avoids going
+// through libstdc++'s new_handler loop on every allocation.
+void* operator new(size_t size)
+{
+    void* ptr = malloc(size);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return malloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return malloc(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    void* ptr = memalign(static_cast<size_t>(alignment), size);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return memalign(static_cast<size_t>(alignment), size);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return memalign(static_cast<size_t>(alignment), size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+    free(ptr);
+}
@@ -0,0 +1,182 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.core/network/local_socket.h"
+#include "workshop.core/debug/debug.h"
+
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace ws {
+
+namespace {
+
+bool make_address(const std::filesystem::path& path, sockaddr_un& address)
+{
+    std::string path_string = path.string();
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (path_string.size() >= sizeof(address.sun_path))
+    {
+        db_error(core, "Local socket path is too long: %s", path_string.c_str());
+        return false;
+    }
+
+    memcpy(address.sun_path, path_string.c_str(), path_string.size());
+    return true;
+}
+
+};
+
+local_socket::~local_socket()
+{
+    if (m_handle >= 0)
+    {
+        close(static_cast<int>(m_handle));
+        m_handle = -1;
+    }
+
+    if (!m_bound_path.empty())
+    {
+        unlink(m_bound_path.c_str());
+    }
+}
+
+std::unique_ptr<local_socket> local_socket::connect(const std::filesystem::path& path)
+{
+    sockaddr_un address;
+    if (!make_address(path, address))
+    {
+        return nullptr;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    std::unique_ptr<local_socket> result(new local_socket());
+    result->m_handle = fd;
+    return result;
+}
+
+std::unique_ptr<local_socket> local_socket::listen(const std::filesystem::path& path)
+{
+    sockaddr_un address;
+    if (!make_address(path, address))
+    {
+        return nullptr;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    // Remove the socket file left behind by anything that didn't shut down cleanly.
+    unlink(path.c_str());
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        ::listen(fd, SOMAXCONN) < 0)
+    {
+        db_error(core, "Failed to listen on local socket (errno=%i): %s", errno, path.string().c_str());
+        close(fd);
+        return nullptr;
+    }
+
+    std::unique_ptr<local_socket> result(new local_socket());
+    result->m_handle = fd;
+    result->m_bound_path = path;
+    return result;
+}
+
+std::unique_ptr<local_socket> local_socket::accept()
+{
+    while (true)
+    {
+        int fd = ::accept4(static_cast<int>(m_handle), nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return nullptr;
+        }
+
+        std::unique_ptr<local_socket> result(new local_socket());
+        result->m_handle = fd;
+        return result;
+    }
+}
+
+bool local_socket::send(const void* data, size_t size)
+{
+    const char* ptr = static_cast<const char*>(data);
+
+    while (size > 0)
+    {
+        ssize_t sent = ::send(static_cast<int>(m_handle), ptr, size, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+
+        ptr += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+
+bool local_socket::receive(void* data, size_t size)
+{
+    char* ptr = static_cast<char*>(data);
+
+    while (size > 0)
+    {
+        ssize_t received = ::recv(static_cast<int>(m_handle), ptr, size, 0);
+        if (received < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        else if (received == 0)
+        {
+            return false;
+        }
+
+        ptr += received;
+        size -= received;
+    }
+
+    return true;
+}
+
+void local_socket::shutdown()
+{
+    ::shutdown(static_cast<int>(m_handle), SHUT_RDWR);
+}
+
+}; // namespace workshop
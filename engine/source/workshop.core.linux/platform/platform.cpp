@@ -6,8 +6,73 @@
 
 #include "thirdparty/nativefiledialog/src/include/nfd.h"
 
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+
 namespace ws {
 
+namespace {
+
+const char* k_sysfs_cpu_path = "/sys/devices/system/cpu";
+
+// Reads the first line of a sysfs file, returns an empty string if it dosen't exist.
+std::string read_sysfs_value(const std::string& path)
+{
+    std::ifstream stream(path);
+    std::string line;
+    if (stream.is_open())
+    {
+        std::getline(stream, line);
+    }
+    return string_trim(line, " \t\r\n");
+}
+
+// Parses a cpu list in the format sysfs uses, eg. "0-3,8,10-11".
+std::vector<size_t> parse_cpu_list(const std::string& value)
+{
+    std::vector<size_t> result;
+
+    for (const std::string& range : string_split(value, ","))
+    {
+        if (range.empty())
+        {
+            continue;
+        }
+
+        std::vector<std::string> bounds = string_split(range, "-");
+        size_t start = std::strtoull(bounds[0].c_str(), nullptr, 10);
+        size_t end = bounds.size() > 1 ? std::strtoull(bounds[1].c_str(), nullptr, 10) : start;
+
+        for (size_t i = start; i <= end; i++)
+        {
+            result.push_back(i);
+        }
+    }
+
+    return result;
+}
+
+// Maps arbitrary keys to a dense range of indices in the order they are first seen.
+template <typename key_type>
+size_t get_dense_index(std::map<key_type, size_t>& map, const key_type& key)
+{
+    auto iter = map.find(key);
+    if (iter != map.end())
+    {
+        return iter->second;
+    }
+
+    size_t index = map.size();
+    map[key] = index;
+    return index;
+}
+
+}; // namespace
+
 platform_type get_platform()
 {
     return platform_type::linux;
@@ -44,6 +109,110 @@ size_t get_pagefile_usage()
     return 0;
 }
 
+cpu_topology get_cpu_topology()
+{
+    cpu_topology topology;
+
+    std::vector<size_t> online = parse_cpu_list(read_sysfs_value(string_format("%s/online", k_sysfs_cpu_path)));
+    if (online.empty())
+    {
+        size_t count = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < count; i++)
+        {
+            cpu_logical_processor& processor = topology.processors.emplace_back();
+            processor.index = i;
+            processor.core = i;
+        }
+
+        topology.core_count = count;
+        topology.cache_domain_count = 1;
+        topology.performance_class_count = 1;
+        return topology;
+    }
+
+    std::map<std::pair<std::string, std::string>, size_t> core_map;
+    std::map<std::string, size_t> cache_domain_map;
+    std::vector<size_t> performance;
+
+    for (size_t cpu : online)
+    {
+        std::string cpu_path = string_format("%s/cpu%zi", k_sysfs_cpu_path, cpu);
+
+        cpu_logical_processor& processor = topology.processors.emplace_back();
+        processor.index = cpu;
+
+        // Core ids are only unique within a package.
+        std::string package_id = read_sysfs_value(cpu_path + "/topology/physical_package_id");
+        std::string core_id = read_sysfs_value(cpu_path + "/topology/core_id");
+        if (core_id.empty())
+        {
+            core_id = std::to_string(cpu);
+        }
+        processor.core = get_dense_index(core_map, { package_id, core_id });
+
+        // Processors with the same shared_cpu_list for their L3 share the cache, fall back
+        // to the package if there is no L3 described.
+        std::string cache_key = "package " + package_id;
+        for (size_t i = 0; ; i++)
+        {
+            std::string cache_path = string_format("%s/cache/index%zi", cpu_path.c_str(), i);
+            std::string level = read_sysfs_value(cache_path + "/level");
+            if (level.empty())
+            {
+                break;
+            }
+            if (level == "3")
+            {
+                cache_key = read_sysfs_value(cache_path + "/shared_cpu_list");
+                break;
+            }
+        }
+        processor.cache_domain = get_dense_index(cache_domain_map, cache_key);
+
+        // Hybrid processors expose relative capacity on arm, otherwise use max frequency as a proxy.
+        std::string capacity = read_sysfs_value(cpu_path + "/cpu_capacity");
+        if (capacity.empty())
+        {
+            capacity = read_sysfs_value(cpu_path + "/cpufreq/cpuinfo_max_freq");
+        }
+        performance.push_back(std::strtoull(capacity.c_str(), nullptr, 10));
+    }
+
+    // Rank performance so the fastest processors are class 0.
+    std::vector<size_t> performance_levels = performance;
+    std::sort(performance_levels.begin(), performance_levels.end(), std::greater<size_t>());
+    performance_levels.erase(std::unique(performance_levels.begin(), performance_levels.end()), performance_levels.end());
+
+    std::vector<bool> core_seen(core_map.size(), false);
+    for (size_t i = 0; i < topology.processors.size(); i++)
+    {
+        cpu_logical_processor& processor = topology.processors[i];
+        processor.performance_class = std::find(performance_levels.begin(), performance_levels.end(), performance[i]) - performance_levels.begin();
+        processor.is_smt_sibling = core_seen[processor.core];
+        core_seen[processor.core] = true;
+    }
+
+    topology.core_count = core_map.size();
+    topology.cache_domain_count = cache_domain_map.size();
+    topology.performance_class_count = performance_levels.size();
+
+    return topology;
+}
+
+bool set_thread_affinity(size_t processor_index)
+{
+    if (processor_index >= CPU_SETSIZE)
+    {
+        return false;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(processor_index, &set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
 void message_dialog(const char* text, message_dialog_type type)
 {
     // linux-todo
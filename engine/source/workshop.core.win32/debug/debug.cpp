@@ -98,17 +98,27 @@ result<void> db_unload_symbols()
     return result;
 }
 
+size_t db_capture_raw_callstack(void** frames, size_t frame_count, size_t frame_offset)
+{
+    return RtlCaptureStackBackTrace(
+        static_cast<ULONG>(frame_offset + 1), 
+        static_cast<ULONG>(std::min<size_t>(frame_count, USHRT_MAX)),
+        frames,
+        nullptr);
+}
+
 std::unique_ptr<db_callstack> db_capture_callstack(size_t frame_offset, size_t frame_count)
 {
     constexpr size_t k_max_frames = 256;
     std::array<void*, k_max_frames> frames;
 
-    USHORT captured_frames = RtlCaptureStackBackTrace(
-        static_cast<ULONG>(frame_offset + 1), 
-        static_cast<ULONG>(std::min(frame_count, k_max_frames)),
-        frames.data(),
-        nullptr);
+    size_t captured_frames = db_capture_raw_callstack(frames.data(), std::min(frame_count, k_max_frames), frame_offset + 1);
 
+    return db_resolve_callstack(frames.data(), captured_frames);
+}
+
+std::unique_ptr<db_callstack> db_resolve_callstack(void* const* frames, size_t captured_frames)
+{
     std::unique_ptr<db_callstack> result = std::make_unique<db_callstack>();
     result->frames.resize(captured_frames);
 
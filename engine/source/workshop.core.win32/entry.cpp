@@ -6,6 +6,7 @@
 #include "workshop.core.win32/utils/windows_headers.h"
 #include "workshop.core/memory/memory.h"
 #include "workshop.core/memory/memory_tracker.h"
+#include "workshop.core/memory/memory_profiler.h"
 
 namespace ws
 {
@@ -27,6 +28,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
     // Hook memory functions as early as possible.
     ws::memory_tracker mem_tracker;
+    ws::memory_profiler mem_profiler;
 #ifndef WS_DEBUG // We use the crt debug heap in debug, the hooks complicate things so we just don't use them here.
     ws::install_memory_hooks();
 #endif
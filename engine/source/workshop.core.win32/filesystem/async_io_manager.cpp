@@ -9,6 +9,7 @@
 #include "workshop.core.win32/filesystem/async_io_manager.h"
 #include "workshop.core/memory/memory_tracker.h"
 #include "workshop.core/perf/profile.h"
+#include "workshop.core/cvar/core_cvars.h"
 
 #include <filesystem>
 #include <span>
@@ -22,12 +23,13 @@ std::unique_ptr<async_io_manager> async_io_manager::create()
     return std::make_unique<win32_async_io_manager>();
 }
 
-win32_async_io_request::win32_async_io_request(win32_async_io_manager* manager, const char* path, size_t offset, size_t size, async_io_request_options options)
+win32_async_io_request::win32_async_io_request(win32_async_io_manager* manager, const char* path, size_t offset, size_t size, async_io_request_options options, async_io_request_priority priority)
     : m_manager(manager)
     , m_path(path)
     , m_offset(offset)
     , m_size(size)
     , m_options(options)
+    , m_priority(priority)
 {
 }
 
@@ -53,6 +55,11 @@ bool win32_async_io_request::has_failed()
 void win32_async_io_request::set_state(state new_state)
 {
     m_state = new_state;
+
+    if (new_state == state::completed || new_state == state::failed)
+    {
+        raise_completion_callbacks();
+    }
 }
 
 std::span<uint8_t> win32_async_io_request::data()
@@ -100,7 +107,10 @@ void win32_async_io_manager::worker_thread()
             std::unique_lock lock(m_request_mutex);
 
             // Insert new requests.
-            m_pending_requests.insert(m_pending_requests.end(), m_new_requests.begin(), m_new_requests.end());
+            for (win32_async_io_request::ptr& request : m_new_requests)
+            {
+                m_pending_requests[static_cast<int>(request->m_priority)].push_back(request);
+            }
             m_new_requests.clear();
 
             // Free any pending buffers.
@@ -112,15 +122,20 @@ void win32_async_io_manager::worker_thread()
         }
 
         {
-            // If there are any pending requests and we have space in the queue, push it in.
-            while (m_outstanding_requests.size() < k_ideal_queue_depth && !m_pending_requests.empty())
+            // If there are any pending requests and we have space in the queue, push it in, highest priority first.
+            for (int priority = static_cast<int>(async_io_request_priority::COUNT) - 1; priority >= 0; priority--)
             {
-                win32_async_io_request::ptr ret = m_pending_requests.front();
-                m_pending_requests.erase(m_pending_requests.begin());
+                std::list<win32_async_io_request::ptr>& pending = m_pending_requests[priority];
 
-                if (start_request(ret))
+                while (m_outstanding_requests.size() < k_ideal_queue_depth && !pending.empty())
                 {
-                    m_outstanding_requests.push_back(ret);
+                    win32_async_io_request::ptr ret = pending.front();
+                    pending.erase(pending.begin());
+
+                    if (start_request(ret))
+                    {
+                        m_outstanding_requests.push_back(ret);
+                    }
                 }
             }
 
@@ -156,11 +171,11 @@ float win32_async_io_manager::get_current_bandwidth()
     return (float)m_bandwidth_average.get();
 }
 
-async_io_request::ptr win32_async_io_manager::request(const char* path, size_t offset, size_t size, async_io_request_options options)
+async_io_request::ptr win32_async_io_manager::request(const char* path, size_t offset, size_t size, async_io_request_options options, async_io_request_priority priority)
 {
     std::unique_lock lock(m_request_mutex);
 
-    win32_async_io_request::ptr request = std::make_shared<win32_async_io_request>(this, path, offset, size, options);
+    win32_async_io_request::ptr request = std::make_shared<win32_async_io_request>(this, path, offset, size, options, priority);
 
     m_new_requests.push_back(request);
     ReleaseSemaphore(m_request_sempahore, 1, nullptr);
@@ -314,7 +329,7 @@ HANDLE win32_async_io_manager::open_file(const char* path)
         FILE_SHARE_READ,
         nullptr,
         OPEN_EXISTING,
-        FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING,
+        FILE_FLAG_OVERLAPPED | (cvar_async_io_direct.get_bool() ? FILE_FLAG_NO_BUFFERING : 0),
         nullptr);
 
     if (file == INVALID_HANDLE_VALUE)
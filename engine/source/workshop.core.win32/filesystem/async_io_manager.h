@@ -13,6 +13,7 @@
 #include <mutex>
 #include <cstddef>
 #include <unordered_map>
+#include <array>
 
 namespace ws {
 
@@ -25,7 +26,7 @@ public:
 
     using ptr = std::shared_ptr<win32_async_io_request>;
 
-    win32_async_io_request(win32_async_io_manager* manager, const char* path, size_t offset, size_t size, async_io_request_options options);
+    win32_async_io_request(win32_async_io_manager* manager, const char* path, size_t offset, size_t size, async_io_request_options options, async_io_request_priority priority);
     virtual ~win32_async_io_request();
 
     virtual bool is_complete() override;
@@ -50,6 +51,7 @@ private:
     size_t m_offset;
     size_t m_size;
     async_io_request_options m_options;
+    async_io_request_priority m_priority;
 
     win32_async_io_manager* m_manager;
 
@@ -85,7 +87,7 @@ public:
     // 
     // No virtualization is performed on the path, this path is expected to be the 
     // raw on-disk path.
-    async_io_request::ptr request(const char* path, size_t offset, size_t size, async_io_request_options options);
+    async_io_request::ptr request(const char* path, size_t offset, size_t size, async_io_request_options options, async_io_request_priority priority);
 
 private:
     friend class win32_async_io_request;
@@ -106,7 +108,7 @@ private:
     HANDLE m_request_sempahore;
     
     std::list<win32_async_io_request::ptr> m_outstanding_requests;
-    std::list<win32_async_io_request::ptr> m_pending_requests;
+    std::array<std::list<win32_async_io_request::ptr>, static_cast<int>(async_io_request_priority::COUNT)> m_pending_requests;
     std::list<win32_async_io_request::ptr> m_new_requests;
     std::list<void*> m_pending_free;
 
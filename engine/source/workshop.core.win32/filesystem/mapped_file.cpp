@@ -0,0 +1,74 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.core/filesystem/mapped_file.h"
+#include "workshop.core/debug/debug.h"
+#include "workshop.core.win32/utils/windows_headers.h"
+
+namespace ws {
+
+mapped_file::~mapped_file()
+{
+    if (m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+
+    if (m_handle != nullptr)
+    {
+        CloseHandle(m_handle);
+        m_handle = nullptr;
+    }
+}
+
+std::shared_ptr<mapped_file> mapped_file::open(const std::filesystem::path& path, bool sequential)
+{
+    HANDLE file_handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | (sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS), nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart <= 0)
+    {
+        CloseHandle(file_handle);
+        return nullptr;
+    }
+
+    HANDLE mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+
+    // The mapping holds its own reference to the file.
+    CloseHandle(file_handle);
+
+    if (mapping_handle == nullptr)
+    {
+        db_warning(core, "Failed to create file mapping for '%s', error 0x%08x.", path.string().c_str(), GetLastError());
+        return nullptr;
+    }
+
+    // Mapped as copy-on-write so writes to the data never reach the file.
+    void* data = MapViewOfFile(mapping_handle, FILE_MAP_COPY, 0, 0, 0);
+    if (data == nullptr)
+    {
+        db_warning(core, "Failed to map view of file '%s', error 0x%08x.", path.string().c_str(), GetLastError());
+        CloseHandle(mapping_handle);
+        return nullptr;
+    }
+
+    std::shared_ptr<mapped_file> result(new mapped_file());
+    result->m_data = static_cast<uint8_t*>(data);
+    result->m_size = static_cast<size_t>(file_size.QuadPart);
+    result->m_handle = mapping_handle;
+
+    return result;
+}
+
+std::span<uint8_t> mapped_file::data()
+{
+    return { m_data, m_size };
+}
+
+}; // namespace workshop
@@ -0,0 +1,184 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.core/network/local_socket.h"
+#include "workshop.core/debug/debug.h"
+#include "workshop.core.win32/utils/windows_headers.h"
+
+#include <afunix.h>
+#include <mutex>
+
+namespace ws {
+
+namespace {
+
+std::once_flag g_winsock_init_flag;
+
+void init_winsock()
+{
+    std::call_once(g_winsock_init_flag, []() {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+        {
+            db_error(core, "Failed to initialize winsock, error 0x%08x.", WSAGetLastError());
+        }
+    });
+}
+
+bool make_address(const std::filesystem::path& path, sockaddr_un& address)
+{
+    std::string path_string = path.string();
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (path_string.size() >= sizeof(address.sun_path))
+    {
+        db_error(core, "Local socket path is too long: %s", path_string.c_str());
+        return false;
+    }
+
+    memcpy(address.sun_path, path_string.c_str(), path_string.size());
+    return true;
+}
+
+};
+
+local_socket::~local_socket()
+{
+    if (m_handle != static_cast<intptr_t>(INVALID_SOCKET))
+    {
+        closesocket(static_cast<SOCKET>(m_handle));
+        m_handle = static_cast<intptr_t>(INVALID_SOCKET);
+    }
+
+    if (!m_bound_path.empty())
+    {
+        DeleteFileW(m_bound_path.c_str());
+    }
+}
+
+std::unique_ptr<local_socket> local_socket::connect(const std::filesystem::path& path)
+{
+    init_winsock();
+
+    sockaddr_un address;
+    if (!make_address(path, address))
+    {
+        return nullptr;
+    }
+
+    SOCKET handle = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (handle == INVALID_SOCKET)
+    {
+        return nullptr;
+    }
+
+    if (::connect(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR)
+    {
+        closesocket(handle);
+        return nullptr;
+    }
+
+    std::unique_ptr<local_socket> result(new local_socket());
+    result->m_handle = static_cast<intptr_t>(handle);
+    return result;
+}
+
+std::unique_ptr<local_socket> local_socket::listen(const std::filesystem::path& path)
+{
+    init_winsock();
+
+    sockaddr_un address;
+    if (!make_address(path, address))
+    {
+        return nullptr;
+    }
+
+    SOCKET handle = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (handle == INVALID_SOCKET)
+    {
+        return nullptr;
+    }
+
+    // Remove the socket file left behind by anything that didn't shut down cleanly.
+    DeleteFileW(path.c_str());
+
+    if (bind(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+        ::listen(handle, SOMAXCONN) == SOCKET_ERROR)
+    {
+        db_error(core, "Failed to listen on local socket, error 0x%08x: %s", WSAGetLastError(), path.string().c_str());
+        closesocket(handle);
+        return nullptr;
+    }
+
+    std::unique_ptr<local_socket> result(new local_socket());
+    result->m_handle = static_cast<intptr_t>(handle);
+    result->m_bound_path = path;
+    return result;
+}
+
+std::unique_ptr<local_socket> local_socket::accept()
+{
+    SOCKET handle = ::accept(static_cast<SOCKET>(m_handle), nullptr, nullptr);
+    if (handle == INVALID_SOCKET)
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<local_socket> result(new local_socket());
+    result->m_handle = static_cast<intptr_t>(handle);
+    return result;
+}
+
+bool local_socket::send(const void* data, size_t size)
+{
+    const char* ptr = static_cast<const char*>(data);
+
+    while (size > 0)
+    {
+        int chunk = static_cast<int>(std::min(size, static_cast<size_t>(INT_MAX)));
+        int sent = ::send(static_cast<SOCKET>(m_handle), ptr, chunk, 0);
+        if (sent == SOCKET_ERROR)
+        {
+            return false;
+        }
+
+        ptr += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+
+bool local_socket::receive(void* data, size_t size)
+{
+    char* ptr = static_cast<char*>(data);
+
+    while (size > 0)
+    {
+        int chunk = static_cast<int>(std::min(size, static_cast<size_t>(INT_MAX)));
+        int received = ::recv(static_cast<SOCKET>(m_handle), ptr, chunk, 0);
+        if (received == SOCKET_ERROR || received == 0)
+        {
+            return false;
+        }
+
+        ptr += received;
+        size -= received;
+    }
+
+    return true;
+}
+
+void local_socket::shutdown()
+{
+    ::shutdown(static_cast<SOCKET>(m_handle), SD_BOTH);
+
+    // Closing the socket is the only way to unblock accept on windows.
+    closesocket(static_cast<SOCKET>(m_handle));
+    m_handle = static_cast<intptr_t>(INVALID_SOCKET);
+}
+
+}; // namespace workshop
@@ -10,6 +10,9 @@
 #include <psapi.h>
 #include <sysinfoapi.h>
 
+#include <algorithm>
+#include <thread>
+
 namespace ws {
 
 platform_type get_platform()
@@ -51,6 +54,106 @@ size_t get_pagefile_usage()
     return counters.QuotaPagedPoolUsage;
 }
 
+cpu_topology get_cpu_topology()
+{
+    cpu_topology topology;
+
+    DWORD buffer_size = 0;
+    GetLogicalProcessorInformationEx(RelationAll, nullptr, &buffer_size);
+
+    std::vector<uint8_t> buffer(buffer_size);
+    if (buffer_size == 0 || !GetLogicalProcessorInformationEx(RelationAll, reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data()), &buffer_size))
+    {
+        size_t count = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < count; i++)
+        {
+            cpu_logical_processor& processor = topology.processors.emplace_back();
+            processor.index = i;
+            processor.core = i;
+        }
+
+        topology.core_count = count;
+        topology.cache_domain_count = 1;
+        topology.performance_class_count = 1;
+        return topology;
+    }
+
+    // Only the first processor group is considered, which covers up to 64 logical processors.
+    std::vector<KAFFINITY> core_masks;
+    std::vector<BYTE> core_efficiency;
+    std::vector<KAFFINITY> cache_masks;
+
+    for (size_t offset = 0; offset < buffer_size; )
+    {
+        SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+        if (info->Relationship == RelationProcessorCore && info->Processor.GroupMask[0].Group == 0)
+        {
+            core_masks.push_back(info->Processor.GroupMask[0].Mask);
+            core_efficiency.push_back(info->Processor.EfficiencyClass);
+        }
+        else if (info->Relationship == RelationCache && info->Cache.Level == 3 && info->Cache.GroupMask.Group == 0)
+        {
+            cache_masks.push_back(info->Cache.GroupMask.Mask);
+        }
+        offset += info->Size;
+    }
+
+    // Efficiency class is higher for faster cores, rank them so the fastest are class 0.
+    std::vector<BYTE> efficiency_levels = core_efficiency;
+    std::sort(efficiency_levels.begin(), efficiency_levels.end(), std::greater<BYTE>());
+    efficiency_levels.erase(std::unique(efficiency_levels.begin(), efficiency_levels.end()), efficiency_levels.end());
+
+    for (size_t core = 0; core < core_masks.size(); core++)
+    {
+        bool first = true;
+        for (size_t i = 0; i < sizeof(KAFFINITY) * 8; i++)
+        {
+            KAFFINITY bit = static_cast<KAFFINITY>(1) << i;
+            if ((core_masks[core] & bit) == 0)
+            {
+                continue;
+            }
+
+            cpu_logical_processor& processor = topology.processors.emplace_back();
+            processor.index = i;
+            processor.core = core;
+            processor.is_smt_sibling = !first;
+            processor.performance_class = std::find(efficiency_levels.begin(), efficiency_levels.end(), core_efficiency[core]) - efficiency_levels.begin();
+
+            for (size_t cache = 0; cache < cache_masks.size(); cache++)
+            {
+                if ((cache_masks[cache] & bit) != 0)
+                {
+                    processor.cache_domain = cache;
+                    break;
+                }
+            }
+
+            first = false;
+        }
+    }
+
+    std::sort(topology.processors.begin(), topology.processors.end(), [](const cpu_logical_processor& a, const cpu_logical_processor& b) {
+        return a.index < b.index;
+    });
+
+    topology.core_count = core_masks.size();
+    topology.cache_domain_count = std::max<size_t>(1, cache_masks.size());
+    topology.performance_class_count = std::max<size_t>(1, efficiency_levels.size());
+
+    return topology;
+}
+
+bool set_thread_affinity(size_t processor_index)
+{
+    if (processor_index >= sizeof(DWORD_PTR) * 8)
+    {
+        return false;
+    }
+
+    return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << processor_index) != 0;
+}
+
 void message_dialog(const char* text, message_dialog_type type)
 {
     std::string caption = "";
@@ -14,4 +14,27 @@ task_handle async(const char* name, task_queue queue, task_scheduler::task_funct
     return handle;
 }
 
+task_handle async(const char* name, task_queue queue, task_priority priority, task_scheduler::task_function work)
+{
+    task_handle handle = task_scheduler::get().create_task(name, queue, std::move(work));
+    handle.set_priority(priority);
+    handle.dispatch();
+    return handle;
+}
+
+task_handle async(const char* name, task_queue queue, coroutine_task&& work)
+{
+    task_handle handle = create_coroutine_task(name, queue, std::move(work));
+    handle.dispatch();
+    return handle;
+}
+
+task_handle async(const char* name, task_queue queue, task_priority priority, coroutine_task&& work)
+{
+    task_handle handle = create_coroutine_task(name, queue, std::move(work));
+    handle.set_priority(priority);
+    handle.dispatch();
+    return handle;
+}
+
 }; // namespace workshop
@@ -5,10 +5,15 @@
 #pragma once
 
 #include "workshop.core/async/task_scheduler.h"
+#include "workshop.core/async/task_coroutine.h"
 #include "workshop.core/perf/profile.h"
 
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <functional>
+#include <iterator>
+#include <optional>
 #include <vector>
 
 namespace ws {
@@ -19,69 +24,370 @@ namespace ws {
 // ================================================================================================
 task_handle async(const char* name, task_queue queue, task_scheduler::task_function work);
 
+// ================================================================================================
+//  Same as above but runs the task at the given priority rather than inheriting it.
+// ================================================================================================
+task_handle async(const char* name, task_queue queue, task_priority priority, task_scheduler::task_function work);
+
+// ================================================================================================
+//  Runs a coroutine asyncronously in the task_scheduler worker pool. The coroutine releases its
+//  worker whenever it co_awaits something that has not completed yet.
+// ================================================================================================
+task_handle async(const char* name, task_queue queue, coroutine_task&& work);
+
+// ================================================================================================
+//  Same as above but runs the coroutine at the given priority rather than inheriting it.
+// ================================================================================================
+task_handle async(const char* name, task_queue queue, task_priority priority, coroutine_task&& work);
+
+// ================================================================================================
+//  Half-open range of indices passed to the range based parallel primitives below.
+// ================================================================================================
+struct parallel_range
+{
+    size_t begin = 0;
+    size_t end = 0;
+
+    size_t size() const
+    {
+        return end - begin;
+    }
+};
+
+namespace detail {
+
+// Deep enough to halve any range down to a single element.
+inline constexpr size_t k_max_parallel_split_depth = 64;
+
+// Number of leaf ranges to aim for per worker when picking a grain size automatically. Having
+// more leaves than workers gives idle workers something to steal when work is uneven.
+inline constexpr size_t k_parallel_leaves_per_worker = 4;
+
+// Smallest automatic grain size for parallel_sort, below this std::sort beats the overhead of a task.
+inline constexpr size_t k_min_parallel_sort_grain = 2048;
+
+// Returns the grain size to use for a range of the given size, a grain of 0 picks 
+// one automatically based on the number of workers.
+inline size_t get_parallel_grain_size(task_queue queue, size_t count, size_t grain)
+{
+    if (grain > 0)
+    {
+        return grain;
+    }
+
+    size_t leaf_count = task_scheduler::get().get_worker_count(queue) * k_parallel_leaves_per_worker;
+    return std::max(size_t{1}, (count + leaf_count - 1) / leaf_count);
+}
+
+template <typename work_t>
+struct parallel_for_context
+{
+    const char* name;
+    task_queue queue;
+    size_t grain;
+    work_t* work;
+};
+
+// Repeatedly halves the range, dispatching the upper half as a task each time until what
+// is left fits in the grain, which is then run on the calling thread. When work stealing is
+// enabled the upper halves land in the callers local deque, so idle workers steal the 
+// largest ranges first while the caller works through the smallest.
+template <typename work_t>
+void parallel_for_split(const parallel_for_context<work_t>& context, parallel_range range, bool can_help_while_waiting)
+{
+    task_scheduler& scheduler = task_scheduler::get();
+
+    std::array<task_handle, k_max_parallel_split_depth> handles;
+    size_t handle_count = 0;
+
+    while (range.size() > context.grain)
+    {
+        size_t middle = range.begin + (range.size() / 2);
+        parallel_range upper = { middle, range.end };
+        range.end = middle;
+
+        task_handle& handle = handles[handle_count++];
+        handle = scheduler.create_task(context.name, context.queue, [&context, upper]() {
+            parallel_for_split(context, upper, true);
+        });
+        handle.dispatch();
+    }
+
+    (*context.work)(range);
+
+    // Wait on the smallest ranges first, they are the most likely to have completed.
+    std::reverse(handles.begin(), handles.begin() + handle_count);
+    scheduler.wait_for_tasks({ handles.data(), handle_count }, can_help_while_waiting);
+}
+
+template <typename value_t, typename reduce_t, typename combine_t>
+struct parallel_reduce_context
+{
+    const char* name;
+    task_queue queue;
+    size_t grain;
+    const value_t* identity;
+    reduce_t* reduce;
+    combine_t* combine;
+};
+
+// Same splitting as parallel_for_split, the result of each upper half is combined
+// onto the result of the lower half once complete.
+template <typename value_t, typename reduce_t, typename combine_t>
+value_t parallel_reduce_split(const parallel_reduce_context<value_t, reduce_t, combine_t>& context, parallel_range range)
+{
+    task_scheduler& scheduler = task_scheduler::get();
+
+    std::array<task_handle, k_max_parallel_split_depth> handles;
+    std::array<std::optional<value_t>, k_max_parallel_split_depth> results;
+    size_t handle_count = 0;
+
+    while (range.size() > context.grain)
+    {
+        size_t middle = range.begin + (range.size() / 2);
+        parallel_range upper = { middle, range.end };
+        range.end = middle;
+
+        std::optional<value_t>& upper_result = results[handle_count];
+
+        task_handle& handle = handles[handle_count++];
+        handle = scheduler.create_task(context.name, context.queue, [&context, &upper_result, upper]() {
+            upper_result = parallel_reduce_split(context, upper);
+        });
+        handle.dispatch();
+    }
+
+    value_t result = (*context.reduce)(range, *context.identity);
+
+    // Combine in order from the nearest range outwards, so combine only needs to be associative.
+    for (size_t i = handle_count; i > 0; i--)
+    {
+        handles[i - 1].wait(true);
+        result = (*context.combine)(std::move(result), std::move(*results[i - 1]));
+    }
+
+    return result;
+}
+
+}; // namespace detail
+
+// ================================================================================================
+//  Runs work over the index range [begin, end) in parallel. The range is recursively halved 
+//  until each piece is no larger than grain, and each piece is passed to work as a parallel_range.
+//  The calling thread runs the first piece itself.
+// 
+//  A grain of 0 picks a grain size automatically based on the number of workers. Prefer this
+//  over parallel_for when the work per index is small, it avoids a call per index.
+// 
+//  Example:
+//      parallel_for_range("update", task_queue::standard, 0, items.size(), 0, [&](const parallel_range& range) {
+//          for (size_t i = range.begin; i < range.end; i++) { ... }
+//      });
+// ================================================================================================
+template <typename work_t>
+void parallel_for_range(const char* name, task_queue queue, size_t begin, size_t end, size_t grain, work_t work, bool can_help_while_waiting = true)
+{
+    profile_marker(profile_colors::task, "%s [parallel]", name);
+
+    if (begin >= end)
+    {
+        return;
+    }
+
+    detail::parallel_for_context<work_t> context;
+    context.name = name;
+    context.queue = queue;
+    context.grain = detail::get_parallel_grain_size(queue, end - begin, grain);
+    context.work = &work;
+
+    detail::parallel_for_split(context, { begin, end }, can_help_while_waiting);
+}
+
 // ================================================================================================
 //  A for loop that runs in parallel. Executing different blocks of the loop on different workers.
 //  Work is expected to be homogenous to spread the execution optimally.
+// 
+//  If do_not_chunk is set every index can be picked up by a different worker, use this when the 
+//  work per index is large.
 // ================================================================================================
 template <typename work_t>
 void parallel_for(const char* name, task_queue queue, size_t count, work_t work, bool do_not_chunk = false, bool can_help_while_waiting = true)
+{
+    parallel_for_range(name, queue, 0, count, do_not_chunk ? 1 : 0, [&work](const parallel_range& range) {
+        for (size_t i = range.begin; i < range.end; i++)
+        {
+            work(i);
+        }
+    }, can_help_while_waiting);
+}
+
+// ================================================================================================
+//  Reduces the index range [begin, end) to a single value in parallel. The range is split the 
+//  same way as parallel_for_range.
+// 
+//  reduce(const parallel_range& range, value_t initial) is called for each piece of the range and
+//  should return initial with the range accumulated onto it. combine(value_t lower, value_t upper)
+//  merges the results of two adjacent pieces and must be associative. identity is the initial 
+//  value passed to each piece, eg. 0 for a sum.
+// ================================================================================================
+template <typename value_t, typename reduce_t, typename combine_t>
+value_t parallel_reduce(const char* name, task_queue queue, size_t begin, size_t end, size_t grain, const value_t& identity, reduce_t reduce, combine_t combine)
 {
     profile_marker(profile_colors::task, "%s [parallel]", name);
 
-    if (count == 0)
+    if (begin >= end)
     {
-        return;
+        return identity;
     }
 
-    constexpr size_t k_chunks_per_task = 2;
+    detail::parallel_reduce_context<value_t, reduce_t, combine_t> context;
+    context.name = name;
+    context.queue = queue;
+    context.grain = detail::get_parallel_grain_size(queue, end - begin, grain);
+    context.identity = &identity;
+    context.reduce = &reduce;
+    context.combine = &combine;
 
-    task_scheduler& scheduler = task_scheduler::get();
+    return detail::parallel_reduce_split(context, { begin, end });
+}
 
-    size_t worker_count = scheduler.get_worker_count(queue);
-    size_t task_count = std::min(worker_count, count);
-    size_t chunk_size = std::max(size_t{1}, count / task_count / k_chunks_per_task);
+// ================================================================================================
+//  Calculates a prefix scan over the index range [0, count) in parallel, returning the total.
+// 
+//  scan(const parallel_range& range, value_t prefix, bool is_final) should return prefix with
+//  the range accumulated onto it. When is_final is true it should also write out the running 
+//  values for each index in the range. Each piece of the range is scanned once without is_final
+//  to calculate its total and then once with is_final, except the first which only needs one pass.
+// 
+//  combine(value_t lower, value_t upper) merges the totals of two adjacent pieces and must be
+//  associative.
+// ================================================================================================
+template <typename value_t, typename scan_t, typename combine_t>
+value_t parallel_scan(const char* name, task_queue queue, size_t count, size_t grain, const value_t& identity, scan_t scan, combine_t combine)
+{
+    profile_marker(profile_colors::task, "%s [parallel]", name);
 
-    // For very small amount of threads allocate them individually so every worker gets something.
-    if (do_not_chunk || count < worker_count * 2)
+    grain = detail::get_parallel_grain_size(queue, count, grain);
+
+    size_t block_count = (count + grain - 1) / grain;
+    if (block_count <= 1)
     {
-        chunk_size = 1;
+        return scan(parallel_range{ 0, count }, identity, true);
     }
 
-    std::atomic_size_t next_chunk = 0;
+    auto get_block_range = [count, grain](size_t block_index) {
+        return parallel_range{ block_index * grain, std::min(count, (block_index + 1) * grain) };
+    };
+
+    // Calculate the total of each block, the first block can be written out straight away
+    // as its prefix is already known.
+    std::vector<value_t> block_prefix(block_count, identity);
+
+    parallel_for_range(name, queue, 0, block_count, 1, [&](const parallel_range& range) {
+        for (size_t i = range.begin; i < range.end; i++)
+        {
+            block_prefix[i] = scan(get_block_range(i), identity, i == 0);
+        }
+    });
 
-    std::vector<task_handle> handles = scheduler.create_tasks(task_count, name, queue, [&next_chunk, &work, chunk_size, count]() {
+    // Turn the block totals into the prefix for each block.
+    value_t total = identity;
+    for (size_t i = 0; i < block_count; i++)
+    {
+        value_t block_total = std::move(block_prefix[i]);
+        block_prefix[i] = total;
+        total = combine(std::move(total), std::move(block_total));
+    }
 
-        while (true)
+    // Write out the remaining blocks now we know their prefixes.
+    parallel_for_range(name, queue, 1, block_count, 1, [&](const parallel_range& range) {
+        for (size_t i = range.begin; i < range.end; i++)
         {
-            size_t range_start = next_chunk.fetch_add(chunk_size);
-            if (range_start >= count)
-            {
-                break;
-            }
-
-            size_t remaining = count - range_start;
-            size_t range_length = std::min(chunk_size, remaining);
-
-            // TODO: Might just want to pass the range into the work as a parameter
-            //       less overhead.
-            for (size_t i = 0; i < range_length; i++)
-            {
-                work(range_start + i);
-            }
+            scan(get_block_range(i), block_prefix[i], true);
         }
+    });
+
+    return total;
+}
+
+// ================================================================================================
+//  Sorts the range [begin, end) in parallel using a merge sort. Blocks of the range are sorted 
+//  with std::sort in parallel and then merged together in parallel passes.
+// 
+//  Requires random access iterators, and the value type must be default constructible and
+//  movable as merging goes through a temporary buffer.
+// ================================================================================================
+template <typename iterator_t, typename compare_t = std::less<>>
+void parallel_sort(const char* name, task_queue queue, iterator_t begin, iterator_t end, compare_t compare = compare_t(), size_t grain = 0)
+{
+    using value_t = typename std::iterator_traits<iterator_t>::value_type;
+
+    profile_marker(profile_colors::task, "%s [parallel]", name);
+
+    size_t count = static_cast<size_t>(std::distance(begin, end));
+    if (grain == 0)
+    {
+        grain = std::max(detail::k_min_parallel_sort_grain, detail::get_parallel_grain_size(queue, count, 0));
+    }
 
+    if (count <= grain)
+    {
+        std::sort(begin, end, compare);
+        return;
+    }
+
+    // Sort each block.
+    size_t block_count = (count + grain - 1) / grain;
+    parallel_for_range(name, queue, 0, block_count, 1, [&](const parallel_range& range) {
+        for (size_t i = range.begin; i < range.end; i++)
+        {
+            std::sort(begin + (i * grain), begin + std::min(count, (i + 1) * grain), compare);
+        }
     });
 
-    // Dispatch all tasks.
+    // Merge pairs of sorted runs, ping-ponging between the input and a buffer.
+    std::vector<value_t> buffer(count);
+    bool in_buffer = false;
+
+    for (size_t width = grain; width < count; width *= 2)
     {
-        profile_marker(profile_colors::task, "dispatch tasks");
-        scheduler.dispatch_tasks(handles);
+        size_t pair_count = (count + (width * 2) - 1) / (width * 2);
+
+        auto merge_runs = [&](auto source, auto destination) {
+            parallel_for_range(name, queue, 0, pair_count, 1, [&](const parallel_range& range) {
+                for (size_t i = range.begin; i < range.end; i++)
+                {
+                    size_t run_start = i * width * 2;
+                    size_t run_middle = std::min(count, run_start + width);
+                    size_t run_end = std::min(count, run_start + (width * 2));
+
+                    std::merge(
+                        std::make_move_iterator(source + run_start), std::make_move_iterator(source + run_middle),
+                        std::make_move_iterator(source + run_middle), std::make_move_iterator(source + run_end),
+                        destination + run_start, 
+                        compare
+                    );
+                }
+            });
+        };
+
+        if (in_buffer)
+        {
+            merge_runs(buffer.begin(), begin);
+        }
+        else
+        {
+            merge_runs(begin, buffer.begin());
+        }
+
+        in_buffer = !in_buffer;
     }
 
-    // Wait for all tasks to complete.
+    if (in_buffer)
     {
-        profile_marker(profile_colors::task, "waiting for tasks");
-        scheduler.wait_for_tasks(handles, can_help_while_waiting);
+        parallel_for_range(name, queue, 0, count, 0, [&](const parallel_range& range) {
+            std::move(buffer.begin() + range.begin, buffer.begin() + range.end, begin + range.begin);
+        });
     }
 }
 
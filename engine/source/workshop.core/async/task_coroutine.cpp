@@ -0,0 +1,133 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.core/async/task_coroutine.h"
+#include "workshop.core/debug/debug.h"
+
+namespace ws {
+
+coroutine_task coroutine_task::promise_type::get_return_object()
+{
+    return coroutine_task(handle_type::from_promise(*this));
+}
+
+void coroutine_task::promise_type::unhandled_exception()
+{
+    db_fatal(core, "Unhandled exception thrown from coroutine task.");
+}
+
+coroutine_task::coroutine_task(handle_type handle)
+    : m_handle(handle)
+{
+}
+
+coroutine_task::coroutine_task(coroutine_task&& other)
+    : m_handle(other.m_handle)
+{
+    other.m_handle = nullptr;
+}
+
+coroutine_task::~coroutine_task()
+{
+    // If we never got scheduled the frame is still ours to destroy.
+    if (m_handle)
+    {
+        m_handle.destroy();
+        m_handle = nullptr;
+    }
+}
+
+coroutine_task& coroutine_task::operator=(coroutine_task&& other)
+{
+    if (m_handle)
+    {
+        m_handle.destroy();
+    }
+
+    m_handle = other.m_handle;
+    other.m_handle = nullptr;
+
+    return *this;
+}
+
+coroutine_task::handle_type coroutine_task::release()
+{
+    handle_type result = m_handle;
+    m_handle = nullptr;
+    return result;
+}
+
+bool task_handle_awaiter::await_ready()
+{
+    return handle.is_complete();
+}
+
+bool task_handle_awaiter::await_suspend(std::coroutine_handle<> coroutine)
+{
+    return task_scheduler::get().suspend_until_complete({ &handle, 1 }, { &continuation, 1 });
+}
+
+bool task_when_all_awaiter::await_ready()
+{
+    for (task_handle& handle : handles)
+    {
+        if (!handle.is_complete())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool task_when_all_awaiter::await_suspend(std::coroutine_handle<> coroutine)
+{
+    continuations.resize(handles.size());
+    return task_scheduler::get().suspend_until_complete(handles, continuations);
+}
+
+bool async_io_awaiter::await_ready()
+{
+    return request->is_complete();
+}
+
+bool async_io_awaiter::await_suspend(std::coroutine_handle<> coroutine)
+{
+    task_scheduler& scheduler = task_scheduler::get();
+
+    task_index_t index = scheduler.begin_suspend_task(1);
+    request->add_completion_callback([&scheduler, index]() {
+        scheduler.resume_suspended_task(index);
+    });
+
+    return scheduler.end_suspend_task(index);
+}
+
+task_handle create_coroutine_task(const char* name, task_queue queue, coroutine_task&& coroutine)
+{
+    coroutine_task::handle_type handle = coroutine.release();
+    db_assert(handle);
+
+    // Each time the task is run (or resumed after a suspend) it continues the coroutine
+    // from where it left off.
+    return task_scheduler::get().create_task(name, queue, [handle]() {
+        handle.resume();
+    });
+}
+
+task_handle_awaiter operator co_await(const task_handle& handle)
+{
+    return task_handle_awaiter{ handle };
+}
+
+async_io_awaiter operator co_await(const async_io_request::ptr& request)
+{
+    return async_io_awaiter{ request };
+}
+
+task_when_all_awaiter when_all(std::vector<task_handle> handles)
+{
+    return task_when_all_awaiter{ std::move(handles) };
+}
+
+}; // namespace workshop
@@ -0,0 +1,142 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/async/task_scheduler.h"
+#include "workshop.core/filesystem/async_io_manager.h"
+
+#include <coroutine>
+#include <vector>
+
+namespace ws {
+
+// ================================================================================================
+//  Return type for coroutines that run as tasks in the task_scheduler.
+//
+//  Rather than blocking a worker while waiting, a coroutine task can co_await a task_handle,
+//  when_all(...) or an async_io_request. The task is suspended, releasing the worker to run
+//  other tasks, and is resumed on whichever worker completes the last thing it was waiting on.
+//
+//  The coroutine does not start running until it has been passed to create_coroutine_task
+//  (or async) and dispatched. The task handle returned is not complete until the coroutine
+//  has returned.
+//
+//  Example:
+//
+//      coroutine_task load_things(std::vector<task_handle> loads)
+//      {
+//          co_await when_all(loads);
+//          ...
+//      }
+//
+//      async("load things", task_queue::loading, load_things(loads));
+// ================================================================================================
+class coroutine_task
+{
+public:
+
+    struct promise_type
+    {
+        coroutine_task get_return_object();
+
+        // Don't start running until the task is scheduled.
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        // Frame is destroyed on completion, the task completes when the resume returns.
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {
+        }
+
+        void unhandled_exception();
+    };
+
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    coroutine_task() = default;
+    coroutine_task(coroutine_task&& other);
+    coroutine_task(const coroutine_task& other) = delete;
+    ~coroutine_task();
+
+    coroutine_task& operator=(coroutine_task&& other);
+    coroutine_task& operator=(const coroutine_task& other) = delete;
+
+    // Releases ownership of the coroutine frame to the caller.
+    handle_type release();
+
+private:
+    explicit coroutine_task(handle_type handle);
+
+private:
+    handle_type m_handle = nullptr;
+
+};
+
+// ================================================================================================
+//  Awaits completion of a single task.
+// ================================================================================================
+struct task_handle_awaiter
+{
+    task_handle handle;
+    task_continuation continuation;
+
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> coroutine);
+    void await_resume() {}
+};
+
+// ================================================================================================
+//  Awaits completion of multiple tasks.
+// ================================================================================================
+struct task_when_all_awaiter
+{
+    std::vector<task_handle> handles;
+    std::vector<task_continuation> continuations;
+
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> coroutine);
+    void await_resume() {}
+};
+
+// ================================================================================================
+//  Awaits completion of an async io request. The request may have failed, so
+//  check has_failed once resumed.
+// ================================================================================================
+struct async_io_awaiter
+{
+    async_io_request::ptr request;
+
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> coroutine);
+    void await_resume() {}
+};
+
+// Creates a task that runs the given coroutine. The task will not start running
+// until it is dispatched.
+task_handle create_coroutine_task(const char* name, task_queue queue, coroutine_task&& coroutine);
+
+// Allows a coroutine task to co_await a task_handle.
+task_handle_awaiter operator co_await(const task_handle& handle);
+
+// Allows a coroutine task to co_await an async io request.
+async_io_awaiter operator co_await(const async_io_request::ptr& request);
+
+// Creates an awaitable that completes once all the given tasks have completed.
+task_when_all_awaiter when_all(std::vector<task_handle> handles);
+
+template <typename... handle_types>
+task_when_all_awaiter when_all(const task_handle& first, const handle_types&... others)
+{
+    return when_all(std::vector<task_handle>{ first, others... });
+}
+
+}; // namespace workshop
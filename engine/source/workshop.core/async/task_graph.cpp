@@ -0,0 +1,207 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.core/async/task_graph.h"
+#include "workshop.core/debug/debug.h"
+#include "workshop.core/perf/profile.h"
+
+namespace ws {
+
+task_graph::task_graph(task_queue queue, task_priority priority)
+    : m_queue(queue)
+    , m_priority(priority)
+{
+}
+
+task_graph::node_index_t task_graph::add_node(const char* name, node_function work)
+{
+    node& new_node = m_nodes.emplace_back();
+    new_node.name = name;
+    new_node.work = std::move(work);
+
+    m_compiled = false;
+
+    return m_nodes.size() - 1;
+}
+
+void task_graph::add_dependency(node_index_t node, node_index_t dependency)
+{
+    db_assert(node < m_nodes.size());
+    db_assert(dependency < m_nodes.size());
+
+    m_edges.push_back({ node, dependency });
+
+    m_compiled = false;
+}
+
+void task_graph::clear()
+{
+    m_nodes.clear();
+    m_edges.clear();
+    m_dependents.clear();
+    m_roots.clear();
+    m_pending_dependencies.reset();
+    m_compiled = false;
+}
+
+bool task_graph::is_compiled()
+{
+    return m_compiled;
+}
+
+size_t task_graph::get_node_count()
+{
+    return m_nodes.size();
+}
+
+bool task_graph::compile()
+{
+    m_compiled = false;
+    m_roots.clear();
+
+    for (node& entry : m_nodes)
+    {
+        entry.dependency_count = 0;
+        entry.dependents_count = 0;
+    }
+
+    // Count edges in each direction.
+    for (auto& [node_index, dependency_index] : m_edges)
+    {
+        m_nodes[node_index].dependency_count++;
+        m_nodes[dependency_index].dependents_count++;
+    }
+
+    // Lay out the dependents of each node contiguously.
+    size_t offset = 0;
+    for (node& entry : m_nodes)
+    {
+        entry.dependents_offset = offset;
+        offset += entry.dependents_count;
+        entry.dependents_count = 0;
+    }
+
+    m_dependents.resize(offset);
+    for (auto& [node_index, dependency_index] : m_edges)
+    {
+        node& dependency = m_nodes[dependency_index];
+        m_dependents[dependency.dependents_offset + dependency.dependents_count] = node_index;
+        dependency.dependents_count++;
+    }
+
+    // Walk the graph in dependency order, if we can't reach every node there is a cycle.
+    std::vector<size_t> remaining(m_nodes.size());
+    std::vector<node_index_t> ready;
+
+    for (size_t i = 0; i < m_nodes.size(); i++)
+    {
+        remaining[i] = m_nodes[i].dependency_count;
+        if (remaining[i] == 0)
+        {
+            ready.push_back(i);
+            m_roots.push_back(i);
+        }
+    }
+
+    size_t visited = 0;
+    while (!ready.empty())
+    {
+        node_index_t index = ready.back();
+        ready.pop_back();
+        visited++;
+
+        node& entry = m_nodes[index];
+        for (size_t i = 0; i < entry.dependents_count; i++)
+        {
+            node_index_t dependent = m_dependents[entry.dependents_offset + i];
+            if (--remaining[dependent] == 0)
+            {
+                ready.push_back(dependent);
+            }
+        }
+    }
+
+    if (visited != m_nodes.size())
+    {
+        for (size_t i = 0; i < m_nodes.size(); i++)
+        {
+            if (remaining[i] > 0)
+            {
+                db_error(core, "Task graph contains a dependency cycle involving '%s'.", m_nodes[i].name.c_str());
+                break;
+            }
+        }
+
+        m_roots.clear();
+        return false;
+    }
+
+    m_pending_dependencies = std::make_unique<std::atomic_size_t[]>(m_nodes.size());
+    m_compiled = true;
+
+    return true;
+}
+
+void task_graph::execute(bool can_help_while_waiting)
+{
+    db_assert_message(m_compiled, "Task graph must be compiled before it is executed.");
+
+    if (m_nodes.empty())
+    {
+        return;
+    }
+
+    task_scheduler& scheduler = task_scheduler::get();
+
+    // Not dispatched until the last node completes, gives us something to wait on.
+    m_complete_task = scheduler.create_task("task graph complete", m_queue, []() {});
+    m_complete_task.set_priority(m_priority);
+
+    for (size_t i = 0; i < m_nodes.size(); i++)
+    {
+        m_pending_dependencies[i].store(m_nodes[i].dependency_count, std::memory_order_relaxed);
+    }
+    m_remaining_nodes.store(m_nodes.size());
+
+    for (node_index_t index : m_roots)
+    {
+        launch_node(index);
+    }
+
+    m_complete_task.wait(can_help_while_waiting);
+    m_complete_task.reset();
+}
+
+void task_graph::launch_node(node_index_t index)
+{
+    task_handle handle = task_scheduler::get().create_task(m_nodes[index].name.c_str(), m_queue, [this, index]() {
+        run_node(index);
+    });
+    handle.set_priority(m_priority);
+    handle.dispatch();
+}
+
+void task_graph::run_node(node_index_t index)
+{
+    node& entry = m_nodes[index];
+    entry.work();
+
+    for (size_t i = 0; i < entry.dependents_count; i++)
+    {
+        node_index_t dependent = m_dependents[entry.dependents_offset + i];
+        if (m_pending_dependencies[dependent].fetch_sub(1) == 1)
+        {
+            launch_node(dependent);
+        }
+    }
+
+    // Once the complete task is dispatched the executing thread can return, so we
+    // must not touch the graph after this.
+    if (m_remaining_nodes.fetch_sub(1) == 1)
+    {
+        m_complete_task.dispatch();
+    }
+}
+
+}; // namespace ws
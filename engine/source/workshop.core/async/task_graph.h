@@ -0,0 +1,102 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/async/task_scheduler.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ws {
+
+// ================================================================================================
+//  A reusable graph of work with dependencies between nodes.
+//
+//  The graph is built and compiled once, then executed as many times as needed. Compiling
+//  validates there are no cycles and flattens the dependencies into tables. Executing only
+//  resets a counter per node and creates a task for each node once its dependencies have
+//  completed, so a compiled graph can be run every frame without any heap allocation.
+//
+//  The graph must not be modified while it is executing.
+// ================================================================================================
+class task_graph
+{
+public:
+
+    using node_index_t = size_t;
+    using node_function = task_scheduler::task_function;
+
+    task_graph(task_queue queue = task_queue::standard, task_priority priority = task_priority::normal);
+
+    // Adds a node which runs the given work when executed. Invalidates any previous compile.
+    node_index_t add_node(const char* name, node_function work);
+
+    // Makes the given node wait for dependency to complete before it runs. Invalidates any
+    // previous compile.
+    void add_dependency(node_index_t node, node_index_t dependency);
+
+    // Removes all nodes and dependencies.
+    void clear();
+
+    // Validates the graph and builds the tables needed to execute it. Returns false if
+    // the graph contains a cycle.
+    bool compile();
+
+    // Returns true if the graph has been successfully compiled since it was last modified.
+    bool is_compiled();
+
+    // Gets the number of nodes in the graph.
+    size_t get_node_count();
+
+    // Runs all nodes in the graph, respecting dependencies, blocking until they are all
+    // complete. The graph must have been compiled.
+    void execute(bool can_help_while_waiting = true);
+
+private:
+
+    struct node
+    {
+        std::string name;
+        node_function work;
+
+        // Number of nodes that have to complete before this one can run.
+        size_t dependency_count = 0;
+
+        // Range in m_dependents of the nodes waiting on this one.
+        size_t dependents_offset = 0;
+        size_t dependents_count = 0;
+    };
+
+    // Creates and dispatches a task to run the given node.
+    void launch_node(node_index_t index);
+
+    // Runs a nodes work and launches any dependents that are now ready.
+    void run_node(node_index_t index);
+
+private:
+
+    task_queue m_queue;
+    task_priority m_priority;
+
+    std::vector<node> m_nodes;
+
+    // Dependencies as added, as pairs of (node, dependency).
+    std::vector<std::pair<node_index_t, node_index_t>> m_edges;
+
+    // Built by compile.
+    std::vector<node_index_t> m_dependents;
+    std::vector<node_index_t> m_roots;
+    std::unique_ptr<std::atomic_size_t[]> m_pending_dependencies;
+    bool m_compiled = false;
+
+    // State for the current execution.
+    std::atomic_size_t m_remaining_nodes = 0;
+    task_handle m_complete_task;
+
+};
+
+}; // namespace ws
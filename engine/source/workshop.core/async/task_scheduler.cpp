@@ -6,12 +6,14 @@
 #include "workshop.core/debug/debug.h"
 #include "workshop.core/containers/string.h"
 #include "workshop.core/perf/profile.h"
+#include "workshop.core/platform/platform.h"
 
 #include <algorithm>
-#include <cstdio>
+#include <cstring>
 #include <thread>
 #include <future>
 #include <array>
+#include <tuple>
 #include <unordered_set>
 
 namespace ws {
@@ -85,6 +87,13 @@ bool task_handle::is_dispatched()
     return m_task_scheduler->get_task_run_state(m_index) != task_scheduler::task_run_state::pending_dispatch;
 }
 
+void task_handle::set_priority(task_priority priority)
+{
+    db_assert(is_valid() && !is_dispatched());
+
+    m_task_scheduler->set_task_priority(m_index, priority);
+}
+
 void task_handle::add_dependency(const task_handle& other)
 {
     db_assert(is_valid() && !is_dispatched());
@@ -169,11 +178,7 @@ void task_handle::increment_ref()
 
 void task_handle::decrement_ref()
 {
-    task_scheduler::task_state& state = m_task_scheduler->get_task_state(m_index);
-    if (state.references.fetch_sub(1) == 1)
-    {
-       m_task_scheduler->try_release_task(m_index);
-    }
+    m_task_scheduler->release_task_reference(m_index);
 }
 
 task_index_t task_handle::get_task_index() const
@@ -181,19 +186,54 @@ task_index_t task_handle::get_task_index() const
     return m_index;
 }
 
+namespace {
+
+// Simple xorshift generator used to pick steal victims, it doesn't need to be 
+// high quality, just cheap and different per-thread.
+uint32_t next_steal_random(uint32_t& state)
+{
+    uint32_t value = state;
+    value ^= value << 13;
+    value ^= value >> 17;
+    value ^= value << 5;
+    state = value;
+    return value;
+}
+
+thread_local uint32_t t_external_steal_seed = 0x9E3779B9u;
+
+// Copies a task name into its fixed size buffer, truncating if required.
+template <size_t buffer_size>
+void copy_task_name(char (&output)[buffer_size], const char* name)
+{
+    size_t length = strnlen(name, buffer_size - 1);
+    memcpy(output, name, length);
+    output[length] = '\0';
+}
+
+};
 
 task_scheduler::task_scheduler(init_state& states)
+    : m_use_work_stealing(states.use_work_stealing)
 {
     db_assert(states.worker_count > 0);
 
     m_workers.resize(states.worker_count);
-
-    // Mark all task indices as free.
-    for (size_t i = 0; i < k_max_tasks; i++)
+    for (size_t i = 0; i < states.worker_count; i++)
     {
-        m_free_task_indices.push((uint32_t)i);
+        m_workers[i] = std::make_unique<worker_state>();
+        m_workers[i]->index = i;
+        m_workers[i]->steal_seed = static_cast<uint32_t>((i + 1) * 2654435761u) | 1;
     }
 
+    // Allocate task storage up front, everything is recycled through the free lists
+    // so creating tasks never needs to touch the heap.
+    m_tasks = std::make_unique<task_state[]>(states.max_tasks);
+    m_free_task_indices.reset(states.max_tasks);
+
+    m_dependency_nodes = std::make_unique<dependency_node[]>(states.max_task_dependencies);
+    m_free_dependency_nodes.reset(states.max_task_dependencies);
+
     // Assign queues to workers.
     //size_t nextWorkerIndex = 0;
     for (size_t i = 0; i < static_cast<int>(task_queue::COUNT); i++)
@@ -207,25 +247,45 @@ task_scheduler::task_scheduler(init_state& states)
 
         for (size_t j = 0; j < worker_count; j++)
         {
-            m_workers[j].queues.insert(&m_queues[i]);
+            m_workers[j]->queues[i] = true;
+            if (m_use_work_stealing)
+            {
+                for (size_t k = 0; k < k_priority_count; k++)
+                {
+                    m_workers[j]->local_queues[i][k] = std::make_unique<local_queue>();
+                }
+            }
             //nextWorkerIndex = (nextWorkerIndex + 1) % states.worker_count;
         }
     }
 
+    place_workers(states);
+
     // Start threads for each worker.
     for (size_t i = 0; i < states.worker_count; i++)
     {
-        worker_state& worker = m_workers[i];
+        worker_state& worker = *m_workers[i];
         worker.thread = std::make_unique<std::thread>([=, this, &worker]() {
             
             std::string queue_string;
-            for (auto& value : worker.queues)
+            for (size_t j = 0; j < worker.queues.size(); j++)
             {
+                if (!worker.queues[j])
+                {
+                    continue;
+                }
                 if (!queue_string.empty())
                 {
                     queue_string.append(", ");
                 }
-                queue_string += task_queue_strings[(int)value->queue_type];
+                queue_string += task_queue_strings[j];
+            }
+
+            t_current_worker = &worker;
+
+            if (worker.processor != k_unpinned_processor && !set_thread_affinity(worker.processor))
+            {
+                db_warning(core, "Failed to pin task worker %zi to processor %zi.", i, worker.processor);
             }
 
             db_set_thread_name(string_format("Task Worker %zi (%s)", i, queue_string.c_str()));
@@ -234,7 +294,12 @@ task_scheduler::task_scheduler(init_state& states)
         });
     }
 
-    db_log(core, "Task scheduler memory usage: %.2f mb", sizeof(*this) / (1024.0f * 1024.0f));
+    size_t memory_usage = sizeof(*this) + 
+                          (sizeof(task_state) * states.max_tasks) + 
+                          (sizeof(dependency_node) * states.max_task_dependencies);
+
+    db_log(core, "Task scheduler memory usage: %.2f mb", memory_usage / (1024.0f * 1024.0f));
+    db_log(core, "Task scheduler work stealing: %s", m_use_work_stealing ? "enabled" : "disabled");
 }
 
 task_scheduler::~task_scheduler()
@@ -242,7 +307,7 @@ task_scheduler::~task_scheduler()
     m_shutting_down = true;
     for (size_t i = 0; i < m_workers.size(); i++)
     {
-        worker_state& worker = m_workers[i];
+        worker_state& worker = *m_workers[i];
         worker.work_sempahore.release();
         worker.thread->join();        
         worker.thread.reset();
@@ -254,39 +319,72 @@ size_t task_scheduler::get_worker_count(task_queue queue)
     return m_queues[static_cast<int>(queue)].worker_count;
 }
 
+size_t task_scheduler::get_current_worker_index()
+{
+    return t_current_worker != nullptr ? t_current_worker->index : k_not_a_worker;
+}
+
+task_scheduler::statistics task_scheduler::get_statistics()
+{
+    statistics result;
+
+    auto accumulate = [&result](thread_statistics& stats) {
+        result.tasks_executed += stats.tasks_executed.load(std::memory_order_relaxed);
+        result.local_pops += stats.local_pops.load(std::memory_order_relaxed);
+        result.shared_pops += stats.shared_pops.load(std::memory_order_relaxed);
+        result.steal_attempts += stats.steal_attempts.load(std::memory_order_relaxed);
+        result.steals += stats.steals.load(std::memory_order_relaxed);
+        result.steal_contention += stats.steal_contention.load(std::memory_order_relaxed);
+        result.lock_contention += stats.lock_contention.load(std::memory_order_relaxed);
+        result.yielded_tasks += stats.yielded_tasks.load(std::memory_order_relaxed);
+        result.boxed_tasks += stats.boxed_tasks.load(std::memory_order_relaxed);
+
+        for (size_t i = 0; i < k_priority_count; i++)
+        {
+            double max_latency = stats.queue_latency_max_ns[i].load(std::memory_order_relaxed) / 1'000'000'000.0;
+
+            result.queued_tasks[i] += stats.queued_tasks[i].load(std::memory_order_relaxed);
+            result.queue_latency_total[i] += stats.queue_latency_total_ns[i].load(std::memory_order_relaxed) / 1'000'000'000.0;
+            result.queue_latency_max[i] = std::max(result.queue_latency_max[i], max_latency);
+        }
+    };
+
+    for (auto& worker : m_workers)
+    {
+        accumulate(worker->stats);
+    }
+    accumulate(m_external_stats);
+
+    return result;
+}
+
 task_handle task_scheduler::create_task(const char* name, task_queue queue, task_scheduler::task_function workload)
 {
-    task_index_t index = alloc_task_index();
-    task_state& state = m_tasks[index];
+    task_index_t index = alloc_task(name, queue);
+    m_tasks[index].work = std::move(workload);
 
-    snprintf(state.name, sizeof(state.name), "%s", name);
-    state.index = index;
-    state.queue = queue;
-    state.state = task_run_state::pending_dispatch;
-    state.work = workload;
-    state.dependents.clear();
+    if (m_tasks[index].work.is_boxed())
+    {
+        get_thread_statistics().boxed_tasks.fetch_add(1, std::memory_order_relaxed);
+    }
 
     return task_handle(this, index);
 }
 
-std::vector<task_handle> task_scheduler::create_tasks(size_t count, const char* name, task_queue queue, task_function workload)
+std::vector<task_handle> task_scheduler::create_tasks(size_t count, const char* name, task_queue queue, const task_function& workload)
 {
-    std::unique_lock lock(m_task_allocation_mutex);
-
     std::vector<task_handle> result;
     result.resize(count);
 
-    for (size_t i = 0; i < count; i++)
+    if (workload.is_boxed())
     {
-        task_index_t index = alloc_task_index_lockless();
-        task_state& state = m_tasks[index];
+        get_thread_statistics().boxed_tasks.fetch_add(count, std::memory_order_relaxed);
+    }
 
-        snprintf(state.name, sizeof(state.name), "%s", name);
-        state.index = index;
-        state.queue = queue;
-        state.state = task_run_state::pending_dispatch;
-        state.work = workload;
-        state.dependents.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        task_index_t index = alloc_task(name, queue);
+        m_tasks[index].work = workload;
 
         result[i] = task_handle(this, index);
     }
@@ -296,66 +394,73 @@ std::vector<task_handle> task_scheduler::create_tasks(size_t count, const char*
 
 void task_scheduler::drain()
 {
-    std::unique_lock lock(m_task_mutex);
-
     while (true)
     {
-        bool is_drained = true;
-
-        for (size_t i = 0; i < m_tasks.size(); i++)
-        {
-            if (m_tasks[i].state == task_run_state::pending_dispatch ||
-                m_tasks[i].state == task_run_state::pending_run)
-            {
-                is_drained = false;
-            }
-        }
+        uint32_t change_counter = m_task_changed_counter.load();
 
-        if (is_drained)
+        if (m_outstanding_tasks.load() == 0)
         {
             break;
         }
 
-        m_task_changed_convar.wait(lock);
+        m_task_changed_counter.wait(change_counter);
     }
 }
 
-task_index_t task_scheduler::alloc_task_index()
+task_index_t task_scheduler::alloc_task(const char* name, task_queue queue)
 {
-    std::unique_lock lock(m_task_allocation_mutex);
-    return alloc_task_index_lockless();
-}
+    task_index_t index = m_free_task_indices.alloc();
+    db_assert_message(index != atomic_free_list::k_invalid_index, "Ran out of task slots, increase task_scheduler::init_state::max_tasks.");
 
-task_index_t task_scheduler::alloc_task_index_lockless()
-{
-    db_assert(!m_free_task_indices.empty());
+    task_state& state = m_tasks[index];
+    copy_task_name(state.name, name);
+    state.index = index;
+    state.queue = queue;
+    state.state = task_run_state::pending_dispatch;
+    state.dependents = atomic_free_list::k_invalid_index;
+
+    // Inherit priority from the task creating this one.
+    if (t_current_task != k_invalid_task_index)
+    {
+        state.priority = m_tasks[t_current_task].priority;
+    }
+    else
+    {
+        state.priority = task_priority::normal;
+    }
+
+    state.references = 1;
+    state.outstanding_dependencies = 1;
+    state.continuations = nullptr;
 
-    task_index_t index = m_free_task_indices.front();
-    m_free_task_indices.pop();
+    m_outstanding_tasks.fetch_add(1);
 
     return index;
 }
 
 void task_scheduler::free_task_index(task_index_t task_index)
 {
-    std::unique_lock lock(m_task_allocation_mutex);
-    m_tasks[task_index].state = task_run_state::unallocated;
-    // TODO: Change this to a linked list, with a pool of preallocated nodes, to save the memory churn.
-    m_tasks[task_index].dependents.clear();
-    m_tasks[task_index].dependents.shrink_to_fit();
-    m_free_task_indices.push(task_index);
+    task_state& state = m_tasks[task_index];
+    state.state = task_run_state::unallocated;
+    free_dependents(state);
+    m_free_task_indices.free(task_index);
 }
 
-void task_scheduler::try_release_task(task_index_t index)
+void task_scheduler::free_dependents(task_state& state)
 {
-    std::unique_lock lock(m_task_mutex);
-    try_release_task_lockless(index);
+    uint32_t node_index = state.dependents;
+    while (node_index != atomic_free_list::k_invalid_index)
+    {
+        uint32_t next_index = m_dependency_nodes[node_index].next;
+        m_free_dependency_nodes.free(node_index);
+        node_index = next_index;
+    }
+    state.dependents = atomic_free_list::k_invalid_index;
 }
 
-void task_scheduler::try_release_task_lockless(task_index_t index)
+void task_scheduler::release_task_reference(task_index_t index)
 {
-    if (m_tasks[index].state == task_run_state::complete &&
-        m_tasks[index].references.load() == 0)
+    if (m_tasks[index].references.fetch_sub(1) == 1)
     {
         free_task_index(index);
     }
@@ -373,125 +478,189 @@ void task_scheduler::add_task_dependency(task_index_t task_index, task_index_t d
     db_assert(state.state == task_run_state::pending_dispatch);
     db_assert(dependencyState.state == task_run_state::pending_dispatch);
 
-    dependencyState.dependents.push_back(task_index);
+    uint32_t node_index = m_free_dependency_nodes.alloc();
+    db_assert_message(node_index != atomic_free_list::k_invalid_index, "Ran out of task dependency nodes, increase task_scheduler::init_state::max_task_dependencies.");
+
+    dependency_node& node = m_dependency_nodes[node_index];
+    node.task_index = task_index;
+    node.next = dependencyState.dependents;
+    dependencyState.dependents = node_index;
+
     state.outstanding_dependencies++;
 }
 
-void task_scheduler::dispatch_task(task_index_t index)
+void task_scheduler::set_task_priority(task_index_t task_index, task_priority priority)
 {
-    std::scoped_lock lock(m_task_dispatch_mutex);
+    task_state& state = m_tasks[task_index];
+    db_assert(state.state == task_run_state::pending_dispatch);
 
-    std::vector<task_index_t> indices;
-    indices.push_back(index);
+    state.priority = priority;
+}
 
-    dispatch_tasks_lockless(indices);
+void task_scheduler::dispatch_task(task_index_t index)
+{
+    dispatch_tasks_internal({ &index, 1 });
 }
 
-void task_scheduler::dispatch_tasks_lockless(const std::vector<task_index_t>& indices)
+void task_scheduler::dispatch_tasks_internal(std::span<const task_index_t> indices)
 {
-    std::array<bool, static_cast<int>(task_queue::COUNT)> queues_used = {};
+    queue_counts pushed_counts = {};
 
     for (task_index_t index : indices)
     {
         task_state& state = m_tasks[index];
-        db_assert(state.state == task_run_state::pending_dispatch ||
-                  state.state == task_run_state::pending_dependencies);
+        db_assert(state.state == task_run_state::pending_dispatch);
 
-        // If we are pending dependencies we will be dispatched when they are complete.
-        if (state.outstanding_dependencies > 0)
+        // Release the count held for dispatch, if dependencies are still outstanding the 
+        // last one to complete will queue the task instead.
+        state.state = task_run_state::pending_dependencies;
+        if (state.outstanding_dependencies.fetch_sub(1) == 1)
         {
-            state.state = task_run_state::pending_dependencies;
-            continue;
+            enqueue_task(index, pushed_counts);
         }
+    }
 
-        queue_state& queue_state = m_queues[static_cast<int>(state.queue)];
-    
+    wake_workers(pushed_counts);
+
+    // Notify any helpers that a task has been queued.
+    notify_task_changed();
+}
+
+void task_scheduler::dispatch_tasks(std::span<const task_handle> handles)
+{
+    std::vector<task_index_t> indices;
+    indices.reserve(handles.size());
+
+    for (const task_handle& handle : handles)
+    {
+        indices.push_back(handle.get_task_index());
+    }
+
+    dispatch_tasks_internal(indices);
+}
+
+void task_scheduler::enqueue_task(task_index_t index, queue_counts& pushed_counts)
+{
+    task_state& state = m_tasks[index];
+    size_t queue_index = static_cast<size_t>(state.queue);
+    size_t priority_index = static_cast<size_t>(state.priority);
+
+    // Must be set before pushing, the task may be picked up immediately.
+    state.state = task_run_state::pending_run;
+    state.queued_time = std::chrono::steady_clock::now();
+    pushed_counts[queue_index]++;
+
+    // Also incremented before pushing, so anything that see's the task will see the count.
+    m_queues[queue_index].pending[priority_index].fetch_add(1);
+
+    // Workers push onto their own deque if they are allowed to run the task, it
+    // keeps dependent work on the same core and avoids the shared lock.
+    if (m_use_work_stealing && t_current_worker != nullptr)
+    {
+        local_queue* queue = t_current_worker->local_queues[queue_index][priority_index].get();
+        if (queue != nullptr && queue->push(index))
         {
-            std::unique_lock lock(queue_state.work_mutex);
-            queue_state.work.push(index);
-            state.state = task_run_state::pending_run;
+            return;
         }
+    }
+
+    shared_queue& queue = m_queues[queue_index].shared[priority_index];
+    thread_statistics& stats = get_thread_statistics();
 
-        queues_used[static_cast<int>(state.queue)] = true;
+    std::unique_lock lock(queue.work_mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        stats.lock_contention.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
     }
 
-    // Wake up all workers that can process the queue the task was pushed into.
-    for (size_t i = 0; i < m_workers.size(); i++)
+    queue.work.push(index);
+    queue.work_count.fetch_add(1);
+}
+
+void task_scheduler::wake_workers(const queue_counts& pushed_counts)
+{
+    if (!m_use_work_stealing)
     {
-        worker_state& worker = m_workers[i];
+        // Wake up all workers that can process the queue the task was pushed into.
+        for (size_t i = 0; i < m_workers.size(); i++)
+        {
+            worker_state& worker = *m_workers[i];
 
-        for (size_t j = 0; j < queues_used.size(); j++)
+            for (size_t j = 0; j < pushed_counts.size(); j++)
+            {
+                if (pushed_counts[j] == 0)
+                {
+                    continue;
+                }
+
+                if (worker.queues[j])
+                {
+                    // TODO: This bad boy is slow as fuck when we have a couple of dozen workers, we need to rejig this.
+                    worker.work_sempahore.release();
+                }
+            }
+        }
+
+        return;
+    }
+
+    // Pairs with the fence in worker_entry, either the worker sees the pushed task 
+    // or we see its sleeping flag.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Only wake as many sleeping workers as there are new tasks, anything already
+    // awake will pick up or steal the work itself.
+    for (size_t j = 0; j < pushed_counts.size(); j++)
+    {
+        size_t wake_count = pushed_counts[j];
+
+        for (size_t i = 0; i < m_workers.size() && wake_count > 0; i++)
         {
-            if (!queues_used[j])
+            worker_state& worker = *m_workers[i];
+            if (!worker.queues[j] || !worker.sleeping.load(std::memory_order_relaxed))
             {
                 continue;
             }
 
-            queue_state& queue_state = m_queues[j];
-            if (worker.queues.contains(&queue_state))
+            if (worker.sleeping.exchange(false))
             {
-                // TODO: This bad boy is slow as fuck when we have a couple of dozen workers, we need to rejig this.
                 worker.work_sempahore.release();
+                wake_count--;
             }
         }
     }
-
-    // Notify any helpers that a task has been queued.
-    {
-        std::unique_lock lock(m_task_mutex);    
-        m_task_changed_convar.notify_all();
-    }
 }
 
-void task_scheduler::dispatch_tasks(const std::vector<task_handle>& handles)
+void task_scheduler::notify_task_changed()
 {
-    std::scoped_lock lock(m_task_dispatch_mutex);
-
-    std::vector< task_index_t> indices;
-    for (const task_handle& handle : handles)
-    {
-        indices.push_back(handle.get_task_index());
-    }
-
-    dispatch_tasks_lockless(indices);
+    m_task_changed_counter.fetch_add(1);
+    m_task_changed_counter.notify_all();
 }
 
 void task_scheduler::wait_for_task(task_index_t index, bool can_help)
 {
-    std::vector<task_index_t> indicies;
-    indicies.push_back(index);
-
     if (can_help)
     {
-        wait_for_tasks_helping(indicies);
+        wait_for_tasks_helping({ &index, 1 });
     }
     else
     {
-        wait_for_tasks_no_help(indicies);
+        wait_for_tasks_no_help({ &index, 1 });
     }
 }
 
-void task_scheduler::wait_for_tasks(const std::vector<task_handle>& handles, bool can_help)
+void task_scheduler::wait_for_tasks(std::span<const task_handle> handles, bool can_help)
 {
-    std::vector<task_index_t> indicies;
-    indicies.resize(handles.size());
-
-    for (size_t i = 0; i < handles.size(); i++)
-    {
-        indicies[i] = handles[i].get_task_index();
-    }
-
-    if (can_help)
-    {
-        wait_for_tasks_helping(indicies);
-    }
-    else
+    // Waiting on each in turn is equivilent to waiting on them all, and saves
+    // having to build a list of indices.
+    for (const task_handle& handle : handles)
     {
-        wait_for_tasks_no_help(indicies);
+        wait_for_task(handle.get_task_index(), can_help);
     }
 }
 
-bool task_scheduler::are_tasks_complete(const std::vector<task_index_t>& handles)
+bool task_scheduler::are_tasks_complete(std::span<const task_index_t> handles)
 {
     bool all_completed = true;
 
@@ -510,131 +679,579 @@ bool task_scheduler::are_tasks_complete(const std::vector<task_index_t>& handles
     return all_completed;
 }
 
-void task_scheduler::wait_for_tasks_no_help(const std::vector<task_index_t>& handles)
+void task_scheduler::wait_for_tasks_no_help(std::span<const task_index_t> handles)
 {
-    std::unique_lock lock(m_task_mutex);
-
     while (true)
     {
+        uint32_t change_counter = m_task_changed_counter.load();
+
         if (are_tasks_complete(handles))
         {
             return;
         }
         
-        m_task_changed_convar.wait(lock);
+        m_task_changed_counter.wait(change_counter);
     }
 }
 
-void task_scheduler::wait_for_tasks_helping(const std::vector<task_index_t>& handles)
+void task_scheduler::wait_for_tasks_helping(std::span<const task_index_t> handles)
 {
     // Only help with queues that the tasks we are waiting for are contained within.
     // Saves us picking up some long running tasks from a loading queue, while waiting
     // for a tiny task on the stnadard queue.
-    std::unordered_set<queue_state*> help_queues;
+    queue_mask help_queues = {};
     
     for (const task_index_t& handle : handles)
     {
         task_state& state = get_task_state(handle);
-        help_queues.insert(&m_queues[static_cast<int>(state.queue)]);
+        help_queues[static_cast<int>(state.queue)] = true;
     }
 
     while (true)
     {
-        task_index_t task;
+        // Check if any tasks are complete.
+        uint32_t change_counter = m_task_changed_counter.load();
+        if (are_tasks_complete(handles))
+        {
+            return;
+        }
+
+        // Otherwise try to pick up existing work.
+        task_index_t task = find_work(help_queues);
+        if (task == k_invalid_task_index)
+        {
+            m_task_changed_counter.wait(change_counter);
+        }
+        else
+        {
+            // Run the task we are helping with.
+            run_task(task);
+        }
+    }
+}
+
+task_scheduler::task_state& task_scheduler::get_task_state(task_index_t index)
+{
+    return m_tasks[index];
+}
+
+task_scheduler::thread_statistics& task_scheduler::get_thread_statistics()
+{
+    if (t_current_worker != nullptr)
+    {
+        return t_current_worker->stats;
+    }
+    return m_external_stats;
+}
+
+task_index_t task_scheduler::find_work(const queue_mask& queues, size_t priority_limit)
+{
+    worker_state* worker = t_current_worker;
+    thread_statistics& stats = get_thread_statistics();
 
+    // Priorities are searched first, so critical work in any queue is always taken
+    // before normal work in the queues ahead of it.
+    for (size_t priority = 0; priority < priority_limit; priority++)
+    {
+        for (size_t i = 0; i < queues.size(); i++)
         {
-            // Check if any tasks are complete.
-            std::unique_lock lock(m_task_mutex);
-            if (are_tasks_complete(handles))
+            if (!queues[i])
             {
-                return;
+                continue;
             }
 
-            // Otherwise try to pick up existing work.
-            task = find_work(help_queues);
-            if (task == k_invalid_task_index)
+            std::atomic_size_t& pending = m_queues[i].pending[priority];
+            if (pending.load() == 0)
             {
-                m_task_changed_convar.wait(lock);
+                continue;
             }
-        }
 
-        // Run the task we are helping with.
-        if (task != k_invalid_task_index)
-        {
-            run_task(task);
+            task_index_t task_index = k_invalid_task_index;
+
+            // Prefer our own most recently pushed work, its likely still warm in the cache.
+            local_queue* queue = (m_use_work_stealing && worker != nullptr) ? worker->local_queues[i][priority].get() : nullptr;
+            if (queue != nullptr && queue->pop(task_index))
+            {
+                stats.local_pops.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                task_index = pop_shared_queue(m_queues[i].shared[priority], stats);
+                if (task_index == k_invalid_task_index && m_use_work_stealing)
+                {
+                    task_index = steal_work(i, priority, stats);
+                }
+            }
+
+            if (task_index != k_invalid_task_index)
+            {
+                pending.fetch_sub(1);
+                return task_index;
+            }
         }
     }
+
+    return k_invalid_task_index;
 }
 
-task_scheduler::task_state& task_scheduler::get_task_state(task_index_t index)
+task_index_t task_scheduler::pop_shared_queue(shared_queue& queue, thread_statistics& stats)
 {
-    return m_tasks[index];
+    if (queue.work_count.load() == 0)
+    {
+        return k_invalid_task_index;
+    }
+
+    std::unique_lock lock(queue.work_mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        stats.lock_contention.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
+    }
+
+    if (queue.work.empty())
+    {
+        return k_invalid_task_index;
+    }
+
+    task_index_t task_index = queue.work.front();
+    queue.work.pop();
+    queue.work_count.fetch_sub(1);
+
+    stats.shared_pops.fetch_add(1, std::memory_order_relaxed);
+
+    return task_index;
+}
+
+task_index_t task_scheduler::steal_work(size_t queue_index, size_t priority_index, thread_statistics& stats)
+{
+    if (t_current_worker == nullptr)
+    {
+        return steal_work_from(m_external_steal_victims, queue_index, priority_index, stats);
+    }
+
+    // Try workers that share our cache first, their data is more likely to still be warm.
+    std::span<worker_state* const> victims = t_current_worker->steal_victims;
+    size_t local_count = t_current_worker->local_victim_count;
+
+    task_index_t task_index = steal_work_from(victims.first(local_count), queue_index, priority_index, stats);
+    if (task_index == k_invalid_task_index)
+    {
+        task_index = steal_work_from(victims.subspan(local_count), queue_index, priority_index, stats);
+    }
+
+    return task_index;
 }
 
-task_index_t task_scheduler::find_work(std::unordered_set<queue_state*>& queues)
+task_index_t task_scheduler::steal_work_from(std::span<worker_state* const> victims, size_t queue_index, size_t priority_index, thread_statistics& stats)
 {
-    for (queue_state* queue : queues)
+    size_t victim_count = victims.size();
+    if (victim_count == 0)
+    {
+        return k_invalid_task_index;
+    }
+
+    uint32_t& seed = (t_current_worker != nullptr ? t_current_worker->steal_seed : t_external_steal_seed);
+    size_t start_index = next_steal_random(seed) % victim_count;
+
+    for (size_t i = 0; i < victim_count; i++)
     {
-        std::unique_lock lock(queue->work_mutex);
-        if (!queue->work.empty())
+        worker_state& victim = *victims[(start_index + i) % victim_count];
+
+        local_queue* victim_queue = victim.local_queues[queue_index][priority_index].get();
+        if (victim_queue == nullptr)
         {
-            task_index_t task_index = queue->work.front();
-            queue->work.pop();
-            return task_index;
+            continue;
+        }
+
+        // Losing a race means there was work there, so keep trying until its empty.
+        while (true)
+        {
+            stats.steal_attempts.fetch_add(1, std::memory_order_relaxed);
+
+            task_index_t task_index;
+            local_queue::steal_result result = victim_queue->steal(task_index);
+            if (result == local_queue::steal_result::success)
+            {
+                stats.steals.fetch_add(1, std::memory_order_relaxed);
+                return task_index;
+            }
+            else if (result == local_queue::steal_result::empty)
+            {
+                break;
+            }
+
+            stats.steal_contention.fetch_add(1, std::memory_order_relaxed);
         }
     }
 
     return k_invalid_task_index;
 }
 
+void task_scheduler::place_workers(const init_state& states)
+{
+    size_t worker_count = m_workers.size();
+
+    if (states.pin_workers)
+    {
+        cpu_topology topology = get_cpu_topology();
+
+        db_log(core, "CPU topology: %zi logical processors, %zi cores, %zi cache domains, %zi performance classes.", 
+            topology.processors.size(), topology.core_count, topology.cache_domain_count, topology.performance_class_count);
+
+        // Fastest processors first. When isolating SMT siblings we keep siblings next to each other
+        // so whole cores can be handed out, otherwise we use every physical core before doubling up.
+        std::vector<const cpu_logical_processor*> order;
+        for (const cpu_logical_processor& processor : topology.processors)
+        {
+            order.push_back(&processor);
+        }
+
+        auto get_sort_key = [&states](const cpu_logical_processor* processor) {
+            size_t cache_domain = states.group_by_cache_domain ? processor->cache_domain : 0;
+            if (states.isolate_smt_siblings)
+            {
+                return std::make_tuple(processor->performance_class, cache_domain, processor->core, (size_t)processor->is_smt_sibling, processor->index);
+            }
+            else
+            {
+                return std::make_tuple(processor->performance_class, cache_domain, (size_t)processor->is_smt_sibling, processor->core, processor->index);
+            }
+        };
+
+        std::stable_sort(order.begin(), order.end(), [&get_sort_key](const cpu_logical_processor* a, const cpu_logical_processor* b) {
+            return get_sort_key(a) < get_sort_key(b);
+        });
+
+        // Workers that can run loading or background work are always the lowest indices, so
+        // when isolating we just need to avoid sharing a core across the boundary. Any siblings
+        // skipped at the boundary are only used if we run out of other processors.
+        size_t non_critical_worker_count = 0;
+        if (states.isolate_smt_siblings)
+        {
+            for (size_t i = 0; i < worker_count; i++)
+            {
+                if (m_workers[i]->queues[static_cast<int>(task_queue::loading)] || m_workers[i]->queues[static_cast<int>(task_queue::background)])
+                {
+                    non_critical_worker_count = i + 1;
+                }
+            }
+        }
+
+        std::vector<const cpu_logical_processor*> deferred;
+        size_t next_processor = 0;
+
+        for (size_t i = 0; i < worker_count; i++)
+        {
+            if (i > 0 && i == non_critical_worker_count)
+            {
+                size_t boundary_core = order[(next_processor - 1) % order.size()]->core;
+                while (next_processor < order.size() && order[next_processor]->core == boundary_core)
+                {
+                    deferred.push_back(order[next_processor]);
+                    next_processor++;
+                }
+            }
+
+            const cpu_logical_processor* processor = nullptr;
+            if (next_processor < order.size())
+            {
+                processor = order[next_processor];
+            }
+            else if (next_processor - order.size() < deferred.size())
+            {
+                processor = deferred[next_processor - order.size()];
+            }
+            else
+            {
+                processor = order[(next_processor - order.size() - deferred.size()) % order.size()];
+            }
+            next_processor++;
+
+            worker_state& worker = *m_workers[i];
+            worker.processor = processor->index;
+            worker.cache_domain = states.group_by_cache_domain ? processor->cache_domain : 0;
+
+            db_log(core, "Task worker %zi: processor %zi, core %zi, cache domain %zi, performance class %zi%s%s",
+                i,
+                processor->index,
+                processor->core,
+                processor->cache_domain,
+                processor->performance_class,
+                processor->is_smt_sibling ? ", smt sibling" : "",
+                i < non_critical_worker_count ? ", non-critical" : "");
+        }
+
+        if (worker_count > topology.processors.size())
+        {
+            db_warning(core, "More task workers than logical processors, some processors will run multiple workers.");
+        }
+    }
+    else
+    {
+        db_log(core, "Task workers are not pinned, placement is left to the os.");
+    }
+
+    // Build the order each worker steals in, workers in the same cache domain come first.
+    m_external_steal_victims.clear();
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        m_external_steal_victims.push_back(m_workers[i].get());
+    }
+
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        worker_state& worker = *m_workers[i];
+        worker.steal_victims.clear();
+
+        for (size_t j = 0; j < worker_count; j++)
+        {
+            if (j != i && m_workers[j]->cache_domain == worker.cache_domain)
+            {
+                worker.steal_victims.push_back(m_workers[j].get());
+            }
+        }
+        worker.local_victim_count = worker.steal_victims.size();
+
+        for (size_t j = 0; j < worker_count; j++)
+        {
+            if (j != i && m_workers[j]->cache_domain != worker.cache_domain)
+            {
+                worker.steal_victims.push_back(m_workers[j].get());
+            }
+        }
+    }
+}
+
+void task_scheduler::record_queue_latency(task_state& state)
+{
+    thread_statistics& stats = get_thread_statistics();
+    size_t priority_index = static_cast<size_t>(state.priority);
+
+    uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - state.queued_time).count();
+
+    stats.queued_tasks[priority_index].fetch_add(1, std::memory_order_relaxed);
+    stats.queue_latency_total_ns[priority_index].fetch_add(latency, std::memory_order_relaxed);
+
+    // Only this thread writes its counters, so no need for a compare exchange.
+    if (latency > stats.queue_latency_max_ns[priority_index].load(std::memory_order_relaxed))
+    {
+        stats.queue_latency_max_ns[priority_index].store(latency, std::memory_order_relaxed);
+    }
+}
+
+void task_scheduler::yield()
+{
+    worker_state* worker = t_current_worker;
+    if (worker == nullptr || t_current_task == k_invalid_task_index)
+    {
+        return;
+    }
+
+    // Only run work with a higher priority than our own, anything else can wait until we're done.
+    size_t priority_limit = static_cast<size_t>(m_tasks[t_current_task].priority);
+    if (priority_limit == 0)
+    {
+        return;
+    }
+
+    while (true)
+    {
+        task_index_t task_index = find_work(worker->queues, priority_limit);
+        if (task_index == k_invalid_task_index)
+        {
+            break;
+        }
+
+        worker->stats.yielded_tasks.fetch_add(1, std::memory_order_relaxed);
+        run_task(task_index);
+    }
+}
+
 void task_scheduler::run_task(task_index_t task_index)
 {
     task_state& state = m_tasks[task_index];
     db_assert(state.state == task_run_state::pending_run);
 
     state.state = task_run_state::running;
+    record_queue_latency(state);
+
+    // Tasks can be nested if we help while waiting, so store the outer task.
+    task_index_t previous_task = t_current_task;
+    bool previous_task_suspended = t_current_task_suspended;
+    t_current_task = task_index;
+    t_current_task_suspended = false;
+
     state.work();
 
-    // Reduce dependent counts and dispatch if they hit zero.
-    for (task_index_t dependent_index : state.dependents)
+    bool suspended = t_current_task_suspended;
+    t_current_task = previous_task;
+    t_current_task_suspended = previous_task_suspended;
+
+    // If the task suspended itself it may already have been resumed on another
+    // thread, so we can no longer touch its state.
+    if (suspended)
+    {
+        return;
+    }
+
+    get_thread_statistics().tasks_executed.fetch_add(1, std::memory_order_relaxed);
+
+    // Release anything captured by the work now rather than when the slot is reused.
+    state.work.reset();
+
+    // Reduce dependent counts and queue them if they hit zero.
+    queue_counts pushed_counts = {};
+    for (uint32_t node_index = state.dependents; node_index != atomic_free_list::k_invalid_index; node_index = m_dependency_nodes[node_index].next)
     {
+        task_index_t dependent_index = m_dependency_nodes[node_index].task_index;
         task_state& dependent_state = m_tasks[dependent_index];        
         if (dependent_state.outstanding_dependencies.fetch_sub(1) == 1)            
         {
-            std::scoped_lock lock(m_task_dispatch_mutex);
-
-            // May not have been dispatched yet, dispatch will handle in this case.            
-            if (dependent_state.state == task_run_state::pending_dependencies) 
-            {
-                dispatch_task(dependent_index);
-            }
+            enqueue_task(dependent_index, pushed_counts);
         }
     }
+    wake_workers(pushed_counts);
+    free_dependents(state);
 
     // Complete task and notify anyone waiting.
+    state.state = task_run_state::complete;
+    resume_continuations(task_index);
+    m_outstanding_tasks.fetch_sub(1);
+    notify_task_changed();
+
+    // Drop the reference the scheduler was holding while the task was in flight.
+    release_task_reference(task_index);
+}
+
+bool task_scheduler::add_task_continuation(task_index_t task_index, task_continuation& continuation)
+{
+    task_state& state = m_tasks[task_index];
+
+    task_continuation* head = state.continuations.load();
+    do
     {
-        std::unique_lock lock(m_task_mutex);
-        state.state = task_run_state::complete;
-        try_release_task_lockless(task_index);
+        if (head == &s_closed_continuations)
+        {
+            return false;
+        }
 
-        m_task_changed_convar.notify_all();
+        continuation.next = head;
     }
+    while (!state.continuations.compare_exchange_weak(head, &continuation));
+
+    return true;
+}
+
+void task_scheduler::resume_continuations(task_index_t task_index)
+{
+    task_state& state = m_tasks[task_index];
+
+    task_continuation* continuation = state.continuations.exchange(&s_closed_continuations);
+    while (continuation != nullptr)
+    {
+        // Read the next node before resuming, the resumed task owns the node
+        // and may destroy it immediately.
+        task_continuation* next = continuation->next;
+        resume_suspended_task(continuation->task_index);
+        continuation = next;
+    }
+}
+
+task_index_t task_scheduler::begin_suspend_task(size_t wait_count)
+{
+    db_assert_message(t_current_task != k_invalid_task_index, "Tasks can only be suspended from inside a running task.");
+
+    // One extra count is held until end_suspend_task so the task can't be 
+    // resumed before we have finished suspending it.
+    task_state& state = m_tasks[t_current_task];
+    state.outstanding_dependencies = wait_count + 1;
+
+    return t_current_task;
+}
+
+bool task_scheduler::end_suspend_task(task_index_t index)
+{
+    task_state& state = m_tasks[index];
+    db_assert(index == t_current_task);
+
+    // Must be marked before releasing our count, another thread may resume us immediately after.
+    state.state = task_run_state::suspended;
+    t_current_task_suspended = true;
+
+    if (state.outstanding_dependencies.fetch_sub(1) == 1)
+    {
+        // Everything we were waiting on has already finished, keep running.
+        state.state = task_run_state::running;
+        t_current_task_suspended = false;
+        return false;
+    }
+
+    return true;
+}
+
+void task_scheduler::resume_suspended_task(task_index_t index)
+{
+    task_state& state = m_tasks[index];
+
+    if (state.outstanding_dependencies.fetch_sub(1) == 1)
+    {
+        queue_counts pushed_counts = {};
+        enqueue_task(index, pushed_counts);
+        wake_workers(pushed_counts);
+        notify_task_changed();
+    }
+}
+
+bool task_scheduler::suspend_until_complete(std::span<const task_handle> handles, std::span<task_continuation> continuations)
+{
+    db_assert(handles.size() == continuations.size());
+
+    task_index_t index = begin_suspend_task(handles.size());
+
+    for (size_t i = 0; i < handles.size(); i++)
+    {
+        continuations[i].task_index = index;
+
+        // Already complete, release the wait ourselves. This can never resume the 
+        // task as we are still holding the count from begin_suspend_task.
+        if (!add_task_continuation(handles[i].get_task_index(), continuations[i]))
+        {
+            resume_suspended_task(index);
+        }
+    }
+
+    return end_suspend_task(index);
 }
 
 void task_scheduler::worker_entry(task_scheduler::worker_state& state)
 {
     while (!m_shutting_down)
     {
-        while (!m_shutting_down)
+        task_index_t task_index = find_work(state.queues);
+        if (task_index != k_invalid_task_index)
         {
-            task_index_t task_index = find_work(state.queues);
+            run_task(task_index);
+            continue;
+        }
+
+        if (m_use_work_stealing)
+        {
+            // Flag that we are going to sleep before checking for work one last time, anything
+            // pushed after this point will see the flag and wake us up.
+            state.sleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            task_index = find_work(state.queues);
             if (task_index != k_invalid_task_index)
             {
+                // If someone already cleared the flag they have also released the semaphore, so consume it.
+                if (!state.sleeping.exchange(false))
+                {
+                    state.work_sempahore.acquire();
+                }
+
                 run_task(task_index);
-            }
-            else
-            {
-                break;
+                continue;
             }
         }
 
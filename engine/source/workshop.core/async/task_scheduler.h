@@ -5,6 +5,9 @@
 #pragma once
 
 #include "workshop.core/utils/singleton.h"
+#include "workshop.core/containers/work_stealing_deque.h"
+#include "workshop.core/containers/atomic_free_list.h"
+#include "workshop.core/utils/inplace_function.h"
 
 #include <thread>
 #include <string>
@@ -12,10 +15,10 @@
 #include <array>
 #include <queue>
 #include <mutex>
-#include <condition_variable>
-#include <functional>
+#include <atomic>
 #include <semaphore>
-#include <unordered_set>
+#include <span>
+#include <chrono>
 
 namespace ws {
 
@@ -45,6 +48,31 @@ inline const char* task_queue_strings[(int)task_queue::COUNT] = {
     "background"
 };
 
+// Identifies how urgently a task needs to run. Workers always run the highest priority
+// work they can find, regardless of which task_queue it is in.
+//
+// Tasks created while another task is running inherit its priority, so work spawned by
+// a critical task (eg. a parallel_for) is also critical.
+enum class task_priority : uint8_t
+{
+    // Work that has to complete within the current frame, eg. simulation and rendering.
+    critical,
+
+    // Default priority for anything created outside of a task.
+    normal,
+
+    // Work that can be delayed as long as required, eg. asset loading and texture encoding.
+    low,
+
+    COUNT
+};
+
+inline const char* task_priority_strings[(int)task_priority::COUNT] = {
+    "critical",
+    "normal",
+    "low"
+};
+
 // ================================================================================================
 //  Holds a reference to a task that has been previously created
 //  by the task scheduler. Can be used to query the current state.
@@ -71,6 +99,11 @@ public:
     // Determines if the task has been dispatched yet.
     bool is_dispatched();
 
+    // Overrides the priority the task runs at.
+    // 
+    // Must be called before dispatching task.
+    void set_priority(task_priority priority);
+
     // Adds a dependency which will have to execute first before 
     // the task this points to can execute.
     // 
@@ -107,6 +140,16 @@ private:
 
 };
 
+// ================================================================================================
+//  Intrusive node used to resume a suspended task when another task completes. These are 
+//  owned by whatever is awaiting, so no allocation is required to suspend.
+// ================================================================================================
+struct task_continuation
+{
+    task_index_t task_index = 0;
+    task_continuation* next = nullptr;
+};
+
 // ================================================================================================
 //  This is the task scheduler. 
 // 
@@ -118,6 +161,11 @@ private:
 //  Tasks are placed into several queues, depending on the task_queue type they are created with. 
 //  Different workers will prioritize different queues to balance workload. This prevents issues
 //  such as batch loading assets saturating all available cores.
+// 
+//  When work stealing is enabled each worker owns a lock-free deque per queue it can process. 
+//  Tasks dispatched from a worker are pushed to its own deque and popped in LIFO order, idle 
+//  workers steal from the other end of random victims deques. Tasks dispatched from threads 
+//  that are not workers go into a shared queue that all eligible workers pull from.
 // ================================================================================================
 class task_scheduler 
     : public singleton<task_scheduler>
@@ -126,7 +174,12 @@ public:
 
     static inline constexpr uint32_t k_invalid_task_index = std::numeric_limits<uint32_t>::max();
 
-    using task_function = std::function<void()>;
+    // Size of the inline storage for a tasks work. Captures larger than this are still 
+    // supported but require a heap allocation each time a task is created, these are
+    // counted in statistics::boxed_tasks.
+    static inline constexpr size_t k_task_function_size = 48;
+
+    using task_function = inplace_function<void(), k_task_function_size>;
 
     struct init_state
     {
@@ -138,6 +191,68 @@ public:
         //  1.0f = All workers can run tasks from the queue.
         //  0.0f = A single worker can run tasks from the queue (minimum is always one worker).
         std::array<float, static_cast<int>(task_queue::COUNT)> queue_weights = { 1.0f };
+
+        // If true each worker gets its own lock-free deque that other workers can steal from. 
+        // If false all tasks go through a single locked queue per task_queue.
+        bool use_work_stealing = false;
+
+        // If true each worker is pinned to its own logical processor rather than being left for
+        // the os to move around.
+        bool pin_workers = false;
+
+        // If true, when pinning, workers are packed onto processors that share an L3 cache and
+        // prefer to steal from workers in the same cache domain before looking further afield.
+        bool group_by_cache_domain = true;
+
+        // If true, when pinning, workers that can run loading or background tasks are never placed
+        // on an SMT sibling of a worker that only runs frame critical (standard) tasks.
+        bool isolate_smt_siblings = false;
+
+        // Maximum number of tasks we can have handles to at any one time.
+        // Important to note, this isn't the maximum number of tasks pending or running, but the maximum number
+        // of handles. Tasks that have completed but have a handle to them, still take up a slot.
+        size_t max_tasks = 50'000;
+
+        // Maximum number of dependencies that can exist between tasks that have not yet completed.
+        size_t max_task_dependencies = 100'000;
+    };
+
+    // Cumulative counters describing how work has been distributed between workers. 
+    struct statistics
+    {
+        // Number of tasks that have been executed.
+        size_t tasks_executed = 0;
+
+        // Number of tasks a worker popped from its own local deque.
+        size_t local_pops = 0;
+
+        // Number of tasks popped from one of the shared queues.
+        size_t shared_pops = 0;
+
+        // Number of times a thread attempted to steal from another workers deque.
+        size_t steal_attempts = 0;
+
+        // Number of tasks successfully stolen from another workers deque.
+        size_t steals = 0;
+
+        // Number of steals that lost a race to another thread.
+        size_t steal_contention = 0;
+
+        // Number of times a thread had to block to acquire a shared queue lock.
+        size_t lock_contention = 0;
+
+        // Number of higher priority tasks run by lower priority tasks calling yield.
+        size_t yielded_tasks = 0;
+
+        // Number of tasks created with work too large to store inline, which had to be heap allocated.
+        size_t boxed_tasks = 0;
+
+        // Number of tasks of each priority that have started running.
+        std::array<size_t, static_cast<int>(task_priority::COUNT)> queued_tasks = {};
+
+        // Total and longest time tasks of each priority spent queued before starting to run.
+        std::array<double, static_cast<int>(task_priority::COUNT)> queue_latency_total = {};
+        std::array<double, static_cast<int>(task_priority::COUNT)> queue_latency_max = {};
     };
     
     task_scheduler(init_state& states);
@@ -146,21 +261,59 @@ public:
     // Gets number of workers that can process the given queue.
     size_t get_worker_count(task_queue queue);
 
+    // Value returned by get_current_worker_index when not called from a worker.
+    static inline constexpr size_t k_not_a_worker = std::numeric_limits<size_t>::max();
+
+    // Gets the index of the worker the calling thread is running, or k_not_a_worker.
+    static size_t get_current_worker_index();
+
+    // Gets a snapshot of the scheduling counters. Values are cumulative since
+    // the scheduler was created.
+    statistics get_statistics();
+
     // Creates a new task that is placed in the given task queue. The task will not
     // start running until dispatch is called on it.
     task_handle create_task(const char* name, task_queue queue, task_function workload);
 
     // Same as create_task but can create multiple at once to reduce overhead.
-    std::vector<task_handle> create_tasks(size_t count, const char* name, task_queue queue, task_function workload);
+    std::vector<task_handle> create_tasks(size_t count, const char* name, task_queue queue, const task_function& workload);
 
-    // Blocks until all pending tasks have completed.
+    // Blocks until all tasks that have been created have completed.
     void drain();
 
     // Waits for all the given tasks, useful to reduce overhead.
-    void wait_for_tasks(const std::vector<task_handle>& handles, bool can_help = false);
+    void wait_for_tasks(std::span<const task_handle> handles, bool can_help = false);
 
     // Dispatches multiple tasks at once, useful to reduce overhead.
-    void dispatch_tasks(const std::vector<task_handle>& handles);
+    void dispatch_tasks(std::span<const task_handle> handles);
+
+    // Cooperative checkpoint for long running tasks. If work with a higher priority than the 
+    // calling task is waiting, and the calling worker can run it, it is run before returning.
+    void yield();
+
+public:
+
+    // The functions below are used to implement coroutine awaiters (see task_coroutine.h) and
+    // are not intended to be called directly.
+
+    // Suspends the currently running task until resume_suspended_task has been called
+    // wait_count times. Returns the index of the suspended task. 
+    // 
+    // Must be followed by a call to end_suspend_task once everything that can resume the 
+    // task has been registered.
+    task_index_t begin_suspend_task(size_t wait_count);
+
+    // Completes a suspend started by begin_suspend_task. Returns false if the task has already
+    // been resumed, in which case the caller should continue running rather than suspending.
+    bool end_suspend_task(task_index_t index);
+
+    // Releases one of the waits a suspended task is blocked on. Once all are released the 
+    // task is queued on the calling worker so it can continue running.
+    void resume_suspended_task(task_index_t index);
+
+    // Suspends the currently running task until all the given tasks have completed. Returns 
+    // false if they have all completed already and the caller should continue running.
+    bool suspend_until_complete(std::span<const task_handle> handles, std::span<task_continuation> continuations);
 
 protected:
 
@@ -173,33 +326,104 @@ protected:
         pending_dependencies,
         pending_run,
         running,
+        suspended,
         complete
     };
 
-    struct task_state
+    using queue_mask = std::array<bool, static_cast<int>(task_queue::COUNT)>;
+    using queue_counts = std::array<size_t, static_cast<int>(task_queue::COUNT)>;
+
+    // Node in a tasks intrusive list of dependents, allocated from a fixed pool.
+    struct dependency_node
+    {
+        task_index_t task_index = k_invalid_task_index;
+        uint32_t next = atomic_free_list::k_invalid_index;
+    };
+
+    // Aligned to avoid false sharing between tasks being run on different workers.
+    struct alignas(64) task_state
     {
-        std::vector<task_index_t> dependents;
         task_function work;
 
+        // Head of the list of tasks waiting on this one in m_dependency_nodes.
+        uint32_t dependents = atomic_free_list::k_invalid_index;
+
+        // The scheduler holds a reference to each task until it completes, so
+        // the task is freed when this reaches zero.
         std::atomic_size_t references = 0;
+
+        // Includes one extra count that is released on dispatch, so the task is
+        // queued by whichever of dispatch or the last dependency finishes last.
         std::atomic_size_t outstanding_dependencies = 0;
 
         task_index_t index = 0;
 
         task_queue queue = task_queue::standard;
-        task_run_state state = task_run_state::unallocated;
+        task_priority priority = task_priority::normal;
+        std::atomic<task_run_state> state = task_run_state::unallocated;
+
+        // When the task was last pushed into a queue, used to measure queueing latency.
+        std::chrono::steady_clock::time_point queued_time;
+
+        // Suspended tasks that should be resumed when this task completes. Set to
+        // s_closed_continuations once the task has completed.
+        std::atomic<task_continuation*> continuations = nullptr;
 
         char name[64];
     };
 
-    struct queue_state
+    static inline constexpr size_t k_queue_count = static_cast<size_t>(task_queue::COUNT);
+    static inline constexpr size_t k_priority_count = static_cast<size_t>(task_priority::COUNT);
+
+    struct shared_queue
     {
-        task_queue queue_type;
         std::queue<task_index_t> work;
         std::mutex work_mutex;
+
+        // Number of tasks in the work queue, allows checking for work without taking the lock.
+        std::atomic_size_t work_count = 0;
+    };
+
+    struct queue_state
+    {
+        task_queue queue_type;
         size_t worker_count;
+
+        // Tasks pushed from threads that are not workers, or that overflowed a local deque.
+        std::array<shared_queue, k_priority_count> shared;
+
+        // Number of tasks of each priority waiting to run, either in the shared queue or in
+        // a workers local deque. Lets workers skip empty priorities without touching every deque.
+        std::array<std::atomic_size_t, k_priority_count> pending = {};
     };
 
+    // Per-thread scheduling counters, kept on their own cache line as they are
+    // written constantly by their owning thread.
+    struct alignas(64) thread_statistics
+    {
+        std::atomic_size_t tasks_executed = 0;
+        std::atomic_size_t local_pops = 0;
+        std::atomic_size_t shared_pops = 0;
+        std::atomic_size_t steal_attempts = 0;
+        std::atomic_size_t steals = 0;
+        std::atomic_size_t steal_contention = 0;
+        std::atomic_size_t lock_contention = 0;
+        std::atomic_size_t yielded_tasks = 0;
+        std::atomic_size_t boxed_tasks = 0;
+
+        std::array<std::atomic_size_t, k_priority_count> queued_tasks = {};
+        std::array<std::atomic_uint64_t, k_priority_count> queue_latency_total_ns = {};
+        std::array<std::atomic_uint64_t, k_priority_count> queue_latency_max_ns = {};
+    };
+
+    // Maximum number of tasks that can sit in a single workers local deque before 
+    // they overflow into the shared queue.
+    inline static constexpr size_t k_local_queue_capacity = 4096;
+
+    using local_queue = work_stealing_deque<task_index_t, k_local_queue_capacity>;
+
+    inline static constexpr size_t k_unpinned_processor = std::numeric_limits<size_t>::max();
+
     struct worker_state
     {
         worker_state()
@@ -207,25 +431,41 @@ protected:
         {
         }
 
-        worker_state(worker_state&& other)
-            : work_sempahore(0)
-            , queues(other.queues)
-            , thread(std::move(other.thread))
-        {
-        }
-
-        std::unordered_set<queue_state*> queues;
+        size_t index = 0;
+        queue_mask queues = {};
         std::unique_ptr<std::thread> thread;
         std::counting_semaphore<std::numeric_limits<uint32_t>::max()> work_sempahore;
+
+        // One deque per priority for each queue, only allocated for queues this worker is allowed to process.
+        std::array<std::array<std::unique_ptr<local_queue>, k_priority_count>, k_queue_count> local_queues;
+
+        // Set while the worker is blocked waiting for work.
+        std::atomic<bool> sleeping = false;
+
+        // State of the random number generator used to pick steal victims.
+        uint32_t steal_seed = 0;
+
+        // Logical processor the worker is pinned to, or k_unpinned_processor.
+        size_t processor = k_unpinned_processor;
+
+        // Group of workers sharing a cache that this worker belongs to.
+        size_t cache_domain = 0;
+
+        // Other workers in the order they should be stolen from. The first local_victim_count
+        // share this workers cache domain.
+        std::vector<worker_state*> steal_victims;
+        size_t local_victim_count = 0;
+
+        thread_statistics stats;
     };
 
     // Waits for the given task.
     void wait_for_task(task_index_t index, bool can_help = false);
-    void wait_for_tasks_no_help(const std::vector<task_index_t>& handles);
-    void wait_for_tasks_helping(const std::vector<task_index_t>& handles);
+    void wait_for_tasks_no_help(std::span<const task_index_t> handles);
+    void wait_for_tasks_helping(std::span<const task_index_t> handles);
 
     // Determines if a list of tasks are all completed yet.
-    bool are_tasks_complete(const std::vector<task_index_t>& handles);
+    bool are_tasks_complete(std::span<const task_index_t> handles);
 
     // Gets the task state from the given index.
     task_state& get_task_state(task_index_t index);
@@ -233,10 +473,8 @@ protected:
     // Core function all workers threads execute.
     void worker_entry(worker_state& state);
 
-    // Tries to free a task. Will succeed when refcount is 0
-    // and task has finished running.
-    void try_release_task(task_index_t index);
-    void try_release_task_lockless(task_index_t index);
+    // Releases a reference to a task, freeing it when no references remain.
+    void release_task_reference(task_index_t index);
 
     // Returns if the given task index has completed.
     task_run_state get_task_run_state(task_index_t task_index);
@@ -245,49 +483,107 @@ protected:
     // The dependent task will always run first.
     void add_task_dependency(task_index_t task_index, task_index_t dependency_index);
 
+    // Changes the priority of a task that has not been dispatched yet.
+    void set_task_priority(task_index_t task_index, task_priority priority);
+
     // Queues the task so it can be picked up and run.
     void dispatch_task(task_index_t index);
-    void dispatch_tasks_lockless(const std::vector<task_index_t>& indices);
+    void dispatch_tasks_internal(std::span<const task_index_t> indices);
 
 private:
 
-    // Allocates the next free task index in the m_tasks 
+    // Allocates and initializes the next free task in the m_tasks 
     // list. Asserts on failure.
-    task_index_t alloc_task_index();
-    task_index_t alloc_task_index_lockless();
+    task_index_t alloc_task(const char* name, task_queue queue);
 
     // Releases a task index previously allocated by
-    // alloc_task_index.
+    // alloc_task.
     void free_task_index(task_index_t task_index);
 
-    // Finds a task the given worker state can execute and 
-    // pops it from the queue. The worker is expected to
-    // run this task on return.
-    task_index_t find_work(std::unordered_set<queue_state*>& queues);
+    // Returns all the dependency nodes in a tasks dependents list to the pool.
+    void free_dependents(task_state& state);
+
+    // Pushes a task whose dependencies have all completed into a queue so it can
+    // be picked up by a worker. pushed_counts is incremented for the queue used.
+    void enqueue_task(task_index_t index, queue_counts& pushed_counts);
+
+    // Wakes up workers after tasks have been pushed into the given queues.
+    void wake_workers(const queue_counts& pushed_counts);
+
+    // Notifies anything waiting on task state that something has changed.
+    void notify_task_changed();
+
+    // Finds a task the calling thread can execute and pops it from the queue. Only 
+    // priorities before priority_limit are searched. The caller is expected to run 
+    // this task on return.
+    task_index_t find_work(const queue_mask& queues, size_t priority_limit = k_priority_count);
+
+    // Attempts to pop a task from the shared queue.
+    task_index_t pop_shared_queue(shared_queue& queue, thread_statistics& stats);
+
+    // Attempts to steal a task from any worker that can process the given queue and priority.
+    task_index_t steal_work(size_t queue_index, size_t priority_index, thread_statistics& stats);
+
+    // Attempts to steal a task from one of the given workers, starting from a random one.
+    task_index_t steal_work_from(std::span<worker_state* const> victims, size_t queue_index, size_t priority_index, thread_statistics& stats);
+
+    // Decides which processor each worker runs on and the order they steal from each other.
+    void place_workers(const init_state& states);
+
+    // Gets the counters the calling thread should write to.
+    thread_statistics& get_thread_statistics();
+
+    // Records how long a task was queued before it started running.
+    void record_queue_latency(task_state& state);
 
     // Executes the given task index.
     void run_task(task_index_t task_index);
 
+    // Adds a continuation to be resumed when the given task completes. Returns false
+    // if the task has already completed.
+    bool add_task_continuation(task_index_t task_index, task_continuation& continuation);
+
+    // Resumes all continuations waiting on a task, called when it completes.
+    void resume_continuations(task_index_t task_index);
+
 private:
 
-    // Maximum number of tasks we can have handles to at any one time.
-    // Important to note, this isn't the maximum number of tasks pending or running, but the maximum number
-    // of handles. Tasks that have completed but have a handle to them, still take up a slot.
-    inline static constexpr size_t k_max_tasks = 50'000;
+    std::unique_ptr<task_state[]> m_tasks;
+    atomic_free_list m_free_task_indices;
 
-    std::mutex m_task_allocation_mutex;
-    std::array<task_state, k_max_tasks> m_tasks;
-    std::queue<uint32_t> m_free_task_indices;
+    std::unique_ptr<dependency_node[]> m_dependency_nodes;
+    atomic_free_list m_free_dependency_nodes;
 
-    std::recursive_mutex m_task_dispatch_mutex;
+    // Number of tasks that have been created but not yet completed.
+    std::atomic_size_t m_outstanding_tasks = 0;
 
-    std::array<queue_state, static_cast<int>(task_queue::COUNT)> m_queues;
-    std::vector<worker_state> m_workers;
+    std::array<queue_state, k_queue_count> m_queues;
+    std::vector<std::unique_ptr<worker_state>> m_workers;
+
+    // All workers, used when a thread that isn't a worker needs to steal.
+    std::vector<worker_state*> m_external_steal_victims;
+
+    bool m_use_work_stealing = false;
 
     std::atomic<bool> m_shutting_down = false;
 
-    std::condition_variable m_task_changed_convar;
-    std::mutex m_task_mutex;
+    // Incremented each time a task is queued or completed, threads waiting
+    // on tasks block on this changing.
+    std::atomic<uint32_t> m_task_changed_counter = 0;
+
+    // Counters for threads that are not workers, eg. the main thread helping.
+    thread_statistics m_external_stats;
+
+    // Worker the calling thread is running, or null if its not a worker.
+    inline static thread_local worker_state* t_current_worker = nullptr;
+
+    // Task the calling thread is currently running, and whether it has suspended
+    // itself while running.
+    inline static thread_local task_index_t t_current_task = k_invalid_task_index;
+    inline static thread_local bool t_current_task_suspended = false;
+
+    // Marker stored in a tasks continuation list once it has completed.
+    inline static task_continuation s_closed_continuations;
 
 };
 
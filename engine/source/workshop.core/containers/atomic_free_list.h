@@ -0,0 +1,125 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace ws {
+
+// ================================================================================================
+//  Lock-free pool of indices in the range [0, capacity).
+//
+//  Free indices are kept as an intrusive stack threaded through a parallel array of
+//  next links. The head is tagged with a counter that is incremented on every pop to
+//  avoid the ABA problem when an index is popped and pushed back concurrently.
+// ================================================================================================
+class atomic_free_list
+{
+public:
+
+    static inline constexpr uint32_t k_invalid_index = std::numeric_limits<uint32_t>::max();
+
+    atomic_free_list() = default;
+    atomic_free_list(size_t capacity);
+
+    // Resizes the list and marks every index as free. Not thread safe.
+    void reset(size_t capacity);
+
+    // Pops a free index, or returns k_invalid_index if none are available.
+    uint32_t alloc();
+
+    // Returns a previously allocated index to the list.
+    void free(uint32_t index);
+
+    // Gets the number of indices managed by this list.
+    size_t capacity() const;
+
+private:
+
+    static uint64_t pack(uint32_t index, uint32_t tag)
+    {
+        return (static_cast<uint64_t>(tag) << 32) | index;
+    }
+
+    static uint32_t unpack_index(uint64_t value)
+    {
+        return static_cast<uint32_t>(value);
+    }
+
+    static uint32_t unpack_tag(uint64_t value)
+    {
+        return static_cast<uint32_t>(value >> 32);
+    }
+
+private:
+    alignas(64) std::atomic<uint64_t> m_head = pack(k_invalid_index, 0);
+
+    std::unique_ptr<std::atomic<uint32_t>[]> m_next;
+    size_t m_capacity = 0;
+
+};
+
+inline atomic_free_list::atomic_free_list(size_t capacity)
+{
+    reset(capacity);
+}
+
+inline void atomic_free_list::reset(size_t capacity)
+{
+    m_capacity = capacity;
+    m_next = std::make_unique<std::atomic<uint32_t>[]>(capacity);
+
+    // Lowest indices are handed out first, keeps things tightly packed.
+    for (size_t i = 0; i < capacity; i++)
+    {
+        m_next[i].store(i + 1 < capacity ? static_cast<uint32_t>(i + 1) : k_invalid_index, std::memory_order_relaxed);
+    }
+
+    m_head.store(pack(capacity > 0 ? 0 : k_invalid_index, 0));
+}
+
+inline uint32_t atomic_free_list::alloc()
+{
+    uint64_t head = m_head.load(std::memory_order_acquire);
+    while (true)
+    {
+        uint32_t index = unpack_index(head);
+        if (index == k_invalid_index)
+        {
+            return k_invalid_index;
+        }
+
+        // If another thread pops this index before us the next link may be stale, but the
+        // tag will have changed so the exchange fails and we retry.
+        uint32_t next = m_next[index].load(std::memory_order_relaxed);
+        if (m_head.compare_exchange_weak(head, pack(next, unpack_tag(head) + 1), std::memory_order_acquire, std::memory_order_acquire))
+        {
+            return index;
+        }
+    }
+}
+
+inline void atomic_free_list::free(uint32_t index)
+{
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    while (true)
+    {
+        m_next[index].store(unpack_index(head), std::memory_order_relaxed);
+        if (m_head.compare_exchange_weak(head, pack(index, unpack_tag(head)), std::memory_order_release, std::memory_order_relaxed))
+        {
+            return;
+        }
+    }
+}
+
+inline size_t atomic_free_list::capacity() const
+{
+    return m_capacity;
+}
+
+}; // namespace ws
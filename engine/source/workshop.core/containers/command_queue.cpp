@@ -3,25 +3,90 @@
 //  Copyright (C) 2021 Tim Leonard
 // ================================================================================================
 #include "workshop.core/containers/command_queue.h"
+#include "workshop.core/containers/string.h"
 #include "workshop.core/memory/memory_tracker.h"
+#include "workshop.core/statistics/statistics_manager.h"
 
 #include <cstring>
 
 namespace ws {
 
-command_queue::command_queue(size_t capacity)
+command_queue::command_queue(const char* name, size_t chunk_size)
+    : m_name(name)
+    , m_chunk_size(chunk_size)
 {
-    memory_scope scope(memory_type::engine__command_queue, memory_scope::k_ignore_asset);
-    m_buffer.resize(capacity);
+    std::unique_ptr<chunk> initial_chunk = create_chunk(m_chunk_size);
+    m_current_chunk = initial_chunk.get();
+    m_used_chunks.push_back(std::move(initial_chunk));
 }
 
 command_queue::~command_queue()
 {
+    db_verbose(core, "Command queue '%s' peaked at %zu bytes.", m_name.c_str(), m_peak_size_bytes);
+}
+
+std::unique_ptr<command_queue::chunk> command_queue::create_chunk(size_t size)
+{
+    memory_scope scope(memory_type::engine__command_queue, memory_scope::k_ignore_asset);
+
+    std::unique_ptr<chunk> result = std::make_unique<chunk>();
+    result->data = std::make_unique<uint8_t[]>(size);
+    result->size = size;
+
+    return result;
 }
 
 void command_queue::reset()
 {
-    m_write_offset = 0;
+    std::scoped_lock lock(m_chunk_mutex);
+
+    // Record how much this queue was used before we throw it away.
+    size_t used_bytes = 0;
+    for (auto& chunk : m_used_chunks)
+    {
+        used_bytes += std::min(chunk->offset.load(), chunk->size);
+    }
+    m_peak_size_bytes = std::max(m_peak_size_bytes, used_bytes);
+
+    if (m_stats_size_bytes == nullptr && statistics_manager::try_get() != nullptr)
+    {
+        m_stats_size_bytes = statistics_manager::get().find_or_create_channel(string_format("command queue/%s", m_name.c_str()).c_str());
+    }
+    if (m_stats_size_bytes)
+    {
+        m_stats_size_bytes->submit(used_bytes);
+    }
+
+    // Release any chunks that haven't been needed for a while.
+    for (auto iter = m_free_chunks.begin(); iter != m_free_chunks.end(); /* empty */)
+    {
+        if (++(*iter)->idle_resets > k_max_idle_resets)
+        {
+            iter = m_free_chunks.erase(iter);
+        }
+        else
+        {
+            iter++;
+        }
+    }
+
+    // Recycle everything used since the last reset. Oversized chunks are only kept for the
+    // allocation that needed them. Pushed in reverse so the first chunk used ends up on top.
+    for (auto iter = m_used_chunks.rbegin(); iter != m_used_chunks.rend(); iter++)
+    {
+        if ((*iter)->size == m_chunk_size)
+        {
+            (*iter)->offset = 0;
+            (*iter)->idle_resets = 0;
+            m_free_chunks.push_back(std::move(*iter));
+        }
+    }
+    m_used_chunks.clear();
+
+    m_used_chunks.push_back(std::move(m_free_chunks.back()));
+    m_free_chunks.pop_back();
+    m_current_chunk = m_used_chunks.back().get();
+
     m_command_head.store(nullptr);
     m_command_tail.store(nullptr);
 }
@@ -33,17 +98,107 @@ bool command_queue::empty()
 
 size_t command_queue::size_bytes()
 {
-    return m_write_offset.load();
+    std::scoped_lock lock(m_chunk_mutex);
+
+    size_t result = 0;
+    for (auto& chunk : m_used_chunks)
+    {
+        result += std::min(chunk->offset.load(), chunk->size);
+    }
+    return result;
+}
+
+size_t command_queue::peak_size_bytes()
+{
+    std::scoped_lock lock(m_chunk_mutex);
+    return m_peak_size_bytes;
+}
+
+size_t command_queue::capacity_bytes()
+{
+    std::scoped_lock lock(m_chunk_mutex);
+
+    size_t result = 0;
+    for (auto& chunk : m_used_chunks)
+    {
+        result += chunk->size;
+    }
+    for (auto& chunk : m_free_chunks)
+    {
+        result += chunk->size;
+    }
+    return result;
 }
 
 std::span<uint8_t> command_queue::allocate_raw(size_t size)
 {
-    size_t offset = m_write_offset.fetch_add(size);
-    if (offset + size > m_buffer.size())
+    size_t aligned_size = (size + k_alignment - 1) & ~(k_alignment - 1);
+
+    while (true)
     {
-        db_fatal(core, "Ran out of space in command queue.");
+        chunk* current = m_current_chunk.load(std::memory_order_acquire);
+
+        size_t offset = current->offset.fetch_add(aligned_size, std::memory_order_relaxed);
+
+        if (offset + aligned_size <= current->size)
+        {
+            return { current->data.get() + offset, size };
+        }
+
+        // Chunk is full, add a new one and try again. If the allocation is larger than a chunk
+        // it gets a chunk of its own.
+        std::scoped_lock lock(m_chunk_mutex);
+
+        if (aligned_size > m_chunk_size)
+        {
+            std::unique_ptr<chunk> oversized_chunk = create_chunk(aligned_size);
+            oversized_chunk->offset = aligned_size;
+
+            std::span<uint8_t> result = { oversized_chunk->data.get(), size };
+            m_used_chunks.push_back(std::move(oversized_chunk));
+
+            return result;
+        }
+
+        // Another thread may have already added a chunk while we were waiting for the lock.
+        if (m_current_chunk.load() != current)
+        {
+            continue;
+        }
+
+        std::unique_ptr<chunk> new_chunk;
+        if (!m_free_chunks.empty())
+        {
+            new_chunk = std::move(m_free_chunks.back());
+            m_free_chunks.pop_back();
+        }
+        else
+        {
+            new_chunk = create_chunk(m_chunk_size);
+        }
+
+        m_current_chunk.store(new_chunk.get(), std::memory_order_release);
+        m_used_chunks.push_back(std::move(new_chunk));
+    }
+}
+
+void command_queue::commit_command(command_header* header)
+{
+    command_header* last = m_command_tail.exchange(header);
+
+    if (last)
+    {
+        last->next = header;
+    }
+    else
+    {
+        m_command_head = header;
     }
-    return { m_buffer.data() + offset, size };
+}
+
+std::span<uint8_t> command_queue::allocate(size_t size)
+{
+    return allocate_raw(size);
 }
 
 const char* command_queue::allocate_copy(const char* value)
@@ -6,13 +6,19 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <span>
+#include <string>
 #include <utility>
 #include <vector>
 
 namespace ws {
 
+class statistics_channel;
+
 // ================================================================================================
 //  A base struct to derive comamnd_queue submitted commands from. This is purely for 
 //  to show expected use, this class is expected to always be empty.
@@ -29,6 +35,11 @@ struct command
 //  for all commands until the reset is called. This is important to be aware of as reading
 //  from the queue will not free any memory.
 // 
+//  Storage is made up of fixed size chunks that are bump allocated from without locking. When
+//  a chunk fills up another is added, so there is no hard limit on the size of the queue. On
+//  reset all chunks are recycled for the next use, chunks that have gone unused for a while are
+//  released so a single burst of commands doesn't hold onto memory forever.
+// 
 //  Multiple threads can write to the queue at the same time.
 //  Multiple threads can -NOT- read from the queue at a time.
 //  Concurrent writes and reads are not valid. If this is required consider double buffering.
@@ -40,7 +51,7 @@ struct command
 class command_queue
 {
 public:
-    command_queue(size_t capacity);
+    command_queue(const char* name, size_t chunk_size);
     ~command_queue();
 
     // Resets the queue back to its original state and erases all commands contained within it.
@@ -52,6 +63,12 @@ public:
     // Gets the size in bytes that are actively in use in the queue.
     size_t size_bytes();
 
+    // Gets the largest size in bytes the queue has reached between two resets.
+    size_t peak_size_bytes();
+
+    // Gets the number of bytes allocated for chunks, whether in use or waiting to be recycled.
+    size_t capacity_bytes();
+
     // Writes a command of the given type into the queue.
     // Name is used to describe the command. Its lifetime needs to remain until the command is executed
     // so use a literal, or allocate_copy a string for it.
@@ -68,11 +85,6 @@ public:
     // Allocates a block of data that can contain the given primitive data and copies the value into it.
     const char* allocate_copy(const char* value);
 
-private:
-
-    // Allocates a raw block of data without a data command header.
-    std::span<uint8_t> allocate_raw(size_t size);
-
 private:
 
     using execute_function_t = void (*)(void* data);
@@ -85,8 +97,50 @@ private:
         command_header* next;
     };
 
-    std::atomic_size_t m_write_offset = 0;    
-    std::vector<uint8_t> m_buffer;
+    struct chunk
+    {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size = 0;
+        std::atomic_size_t offset = 0;
+
+        // Number of resets since this chunk was last used.
+        size_t idle_resets = 0;
+    };
+
+    // Allocates a raw block of data without a data command header.
+    std::span<uint8_t> allocate_raw(size_t size);
+
+    // Creates a new chunk with at least the given size.
+    std::unique_ptr<chunk> create_chunk(size_t size);
+
+    // Links a command header onto the end of the command list.
+    void commit_command(command_header* header);
+
+private:
+
+    // All allocations are aligned to this so commands can store any type.
+    static inline constexpr size_t k_alignment = alignof(std::max_align_t);
+
+    // Number of resets a recycled chunk can go unused before its memory is released.
+    static inline constexpr size_t k_max_idle_resets = 120;
+
+    std::string m_name;
+    size_t m_chunk_size;
+
+    std::atomic<chunk*> m_current_chunk = nullptr;
+
+    // Guards the chunk lists, only taken when a chunk fills up or the queue is reset.
+    std::mutex m_chunk_mutex;
+
+    // Chunks written to since the last reset, in the order they were used.
+    std::vector<std::unique_ptr<chunk>> m_used_chunks;
+
+    // Chunks waiting to be reused.
+    std::vector<std::unique_ptr<chunk>> m_free_chunks;
+
+    size_t m_peak_size_bytes = 0;
+
+    statistics_channel* m_stats_size_bytes = nullptr;
 
     std::atomic<command_header*> m_command_head;
     std::atomic<command_header*> m_command_tail;
@@ -96,13 +150,15 @@ private:
 template<typename lambda_type>
 void command_queue::queue_command(const char* name, lambda_type&& lambda)
 {
-    // Allocate and move lambda into our buffer.
-    std::span<uint8_t> lambda_data = allocate_raw(sizeof(lambda_type));
-    lambda_type* placed_lambda = new(lambda_data.data()) lambda_type(std::move(lambda));
+    // Allocate space for the lambda and its header in one go.
+    constexpr size_t header_offset = (sizeof(lambda_type) + k_alignment - 1) & ~(k_alignment - 1);
+    std::span<uint8_t> data = allocate_raw(header_offset + sizeof(command_header));
+
+    // Move lambda into our buffer.
+    lambda_type* placed_lambda = new(data.data()) lambda_type(std::move(lambda));
 
-    // Allocate a new command header.
-    std::span<uint8_t> command_header_data = allocate_raw(sizeof(command_header));
-    command_header* header = new(command_header_data.data()) command_header;
+    // Setup the command header.
+    command_header* header = new(data.data() + header_offset) command_header;
     header->name = name;
     header->next = nullptr;
     header->lambda_pointer = placed_lambda;
@@ -112,23 +168,7 @@ void command_queue::queue_command(const char* name, lambda_type&& lambda)
         strong_type->~lambda_type();
     };
 
-    // Commit command header.
-    while (true)
-    {
-        command_header* last = m_command_tail.load();
-        if (m_command_tail.compare_exchange_strong(last, header))
-        {
-            if (last)
-            {
-                last->next = header;
-            }
-            else
-            {
-                m_command_head = header;
-            }
-            break;
-        }
-    }
+    commit_command(header);
 }
 
 }; // namespace workshop
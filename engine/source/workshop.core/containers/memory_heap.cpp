@@ -4,120 +4,279 @@
 // ================================================================================================
 #include "workshop.core/containers/memory_heap.h"
 
+#include <algorithm>
+#include <bit>
+
 namespace ws {
 
 memory_heap::memory_heap(size_t size)
 {
+    for (auto& lists : m_free_lists)
+    {
+        lists.fill(k_invalid_block);
+    }
+
     m_remaining = size;
-    m_blocks.push_back({ 0, size, false });
+
+    if (size > 0)
+    {
+        block_index_t index = alloc_block();
+        m_blocks[index].offset = 0;
+        m_blocks[index].size = size;
+        insert_free_block(index);
+    }
 }
 
 memory_heap::~memory_heap()
 {
 }
 
-bool memory_heap::alloc(size_t size, size_t alignment, size_t& offset)
+void memory_heap::get_list_index(size_t size, size_t& first_level, size_t& second_level)
+{
+    if (size < k_small_block_size)
+    {
+        first_level = 0;
+        second_level = size;
+    }
+    else
+    {
+        size_t most_significant_bit = std::bit_width(size) - 1;
+        first_level = most_significant_bit - k_second_level_bits + 1;
+        second_level = (size >> (most_significant_bit - k_second_level_bits)) - k_second_level_count;
+    }
+}
+
+memory_heap::block_index_t memory_heap::find_free_block(size_t size)
 {
-    for (size_t i = 0; i < m_blocks.size(); i++)
+    // Round up to the next list boundary so any block we find in the list is guaranteed to fit.
+    if (size >= k_small_block_size)
+    {
+        size_t most_significant_bit = std::bit_width(size) - 1;
+        size += (1ull << (most_significant_bit - k_second_level_bits)) - 1;
+    }
+
+    size_t first_level, second_level;
+    get_list_index(size, first_level, second_level);
+
+    if (first_level >= k_first_level_count)
+    {
+        return k_invalid_block;
+    }
+
+    // Look for a list in the same first level that is large enough, otherwise move
+    // up to the smallest non-empty first level.
+    uint32_t second_level_map = m_second_level_bitmap[first_level] & (~0u << second_level);
+    if (second_level_map == 0)
     {
-        block& curr_block = m_blocks[i];
-        if (!curr_block.used && curr_block.size >= size)
+        uint64_t first_level_map = (first_level + 1 < 64) ? (m_first_level_bitmap & (~0ull << (first_level + 1))) : 0;
+        if (first_level_map == 0)
         {
-            size_t alignment_padding = math::round_up_multiple(curr_block.offset, alignment) - curr_block.offset;
-            size_t size_required = size + alignment_padding;
-            if (curr_block.size >= size_required)
-            {
-                offset = curr_block.offset + alignment_padding;
-                curr_block.used = true;
+            return k_invalid_block;
+        }
 
-                if (curr_block.size > size_required)
-                {
-                    block new_block;
-                    new_block.offset = curr_block.offset + size_required;
-                    new_block.size = curr_block.size - size_required;
-                    new_block.used = false;
+        first_level = std::countr_zero(first_level_map);
+        second_level_map = m_second_level_bitmap[first_level];
+    }
 
-                    curr_block.size = size_required;
+    second_level = std::countr_zero(second_level_map);
 
-                    m_blocks.insert(m_blocks.begin() + i + 1, new_block);
-                }
+    return m_free_lists[first_level][second_level];
+}
 
-                m_remaining -= size_required;
+void memory_heap::insert_free_block(block_index_t index)
+{
+    block& entry = m_blocks[index];
 
-                return true;
-            }
-        }
+    size_t first_level, second_level;
+    get_list_index(entry.size, first_level, second_level);
+
+    block_index_t& head = m_free_lists[first_level][second_level];
+
+    entry.prev_free = k_invalid_block;
+    entry.next_free = head;
+    if (head != k_invalid_block)
+    {
+        m_blocks[head].prev_free = index;
     }
+    head = index;
 
-    return false;
+    m_first_level_bitmap |= (1ull << first_level);
+    m_second_level_bitmap[first_level] |= (1u << second_level);
 }
 
-bool memory_heap::get_block_index(size_t offset, size_t& index)
+void memory_heap::remove_free_block(block_index_t index)
 {
-    for (size_t i = 0; i < m_blocks.size(); i++)
+    block& entry = m_blocks[index];
+
+    size_t first_level, second_level;
+    get_list_index(entry.size, first_level, second_level);
+
+    if (entry.prev_free != k_invalid_block)
+    {
+        m_blocks[entry.prev_free].next_free = entry.next_free;
+    }
+    else
     {
-        block& block = m_blocks[i];
-        if (offset >= block.offset && offset < block.offset + block.size && block.used)
+        m_free_lists[first_level][second_level] = entry.next_free;
+    }
+
+    if (entry.next_free != k_invalid_block)
+    {
+        m_blocks[entry.next_free].prev_free = entry.prev_free;
+    }
+
+    entry.prev_free = k_invalid_block;
+    entry.next_free = k_invalid_block;
+
+    if (m_free_lists[first_level][second_level] == k_invalid_block)
+    {
+        m_second_level_bitmap[first_level] &= ~(1u << second_level);
+        if (m_second_level_bitmap[first_level] == 0)
         {
-            index = i;
-            return true;
+            m_first_level_bitmap &= ~(1ull << first_level);
         }
     }
-    return false;
 }
 
-bool memory_heap::empty()
+memory_heap::block_index_t memory_heap::split_block(block_index_t index, size_t size)
+{
+    // Allocating may reallocate the block array, so don't hold references across it.
+    block_index_t remainder_index = alloc_block();
+
+    block& entry = m_blocks[index];
+    block& remainder = m_blocks[remainder_index];
+
+    remainder.offset = entry.offset + size;
+    remainder.size = entry.size - size;
+    remainder.used = false;
+    remainder.prev_physical = index;
+    remainder.next_physical = entry.next_physical;
+
+    if (entry.next_physical != k_invalid_block)
+    {
+        m_blocks[entry.next_physical].prev_physical = remainder_index;
+    }
+
+    entry.size = size;
+    entry.next_physical = remainder_index;
+
+    return remainder_index;
+}
+
+void memory_heap::merge_next_block(block_index_t index)
 {
-    return (m_blocks.size() == 1 && !m_blocks[0].used);
+    block& entry = m_blocks[index];
+    block_index_t next_index = entry.next_physical;
+    block& next = m_blocks[next_index];
+
+    entry.size += next.size;
+    entry.next_physical = next.next_physical;
+
+    if (next.next_physical != k_invalid_block)
+    {
+        m_blocks[next.next_physical].prev_physical = index;
+    }
+
+    free_block(next_index);
 }
 
-void memory_heap::coalesce(size_t index)
+memory_heap::block_index_t memory_heap::alloc_block()
 {
-    // Compact current block into previous block.
-    while (index > 0 && index < m_blocks.size())
+    if (!m_unused_blocks.empty())
     {
-        block& prev_block = m_blocks[index - 1];
-        block& curr_block = m_blocks[index];
+        block_index_t index = m_unused_blocks.back();
+        m_unused_blocks.pop_back();
+        m_blocks[index] = block();
+        return index;
+    }
 
-        if (!prev_block.used && !curr_block.used)
-        {
-            prev_block.size += curr_block.size;
-            m_blocks.erase(m_blocks.begin() + index);
-        }
-        else
-        {
-            break;
-        }
+    m_blocks.emplace_back();
+    return static_cast<block_index_t>(m_blocks.size() - 1);
+}
+
+void memory_heap::free_block(block_index_t index)
+{
+    m_unused_blocks.push_back(index);
+}
+
+bool memory_heap::alloc(size_t size, size_t alignment, size_t& offset)
+{
+    size = std::max<size_t>(size, 1);
+    alignment = std::max<size_t>(alignment, 1);
+
+    // Search for enough space to align the start of the block within it.
+    block_index_t index = find_free_block(size + alignment - 1);
+    if (index == k_invalid_block)
+    {
+        return false;
     }
 
-    // Compact current block into next block.
-    while (index >= 0 && index < m_blocks.size() - 1)
+    remove_free_block(index);
+
+    // Return any padding before the aligned offset to the heap.
+    size_t alignment_padding = math::round_up_multiple(m_blocks[index].offset, alignment) - m_blocks[index].offset;
+    if (alignment_padding > 0)
     {
-        block& curr_block = m_blocks[index];
-        block& next_block = m_blocks[index + 1];
+        block_index_t aligned_index = split_block(index, alignment_padding);
+        insert_free_block(index);
+        index = aligned_index;
+    }
 
-        if (!curr_block.used && !next_block.used)
-        {
-            curr_block.size += next_block.size;
-            m_blocks.erase(m_blocks.begin() + index + 1);
-        }
-        else
-        {
-            break;
-        }
+    // Return any excess after the block to the heap.
+    if (m_blocks[index].size > size)
+    {
+        block_index_t remainder_index = split_block(index, size);
+        insert_free_block(remainder_index);
     }
+
+    block& entry = m_blocks[index];
+    entry.used = true;
+
+    m_used_blocks[entry.offset] = index;
+    m_remaining -= entry.size;
+
+    offset = entry.offset;
+
+    return true;
 }
 
 void memory_heap::free(size_t offset)
 {
-    size_t index;
-    if (get_block_index(offset, index))
+    auto iter = m_used_blocks.find(offset);
+    if (iter == m_used_blocks.end())
     {
-        m_remaining += m_blocks[index].size;
+        return;
+    }
 
-        m_blocks[index].used = false;
-        coalesce(index);
+    block_index_t index = iter->second;
+    m_used_blocks.erase(iter);
+
+    block& entry = m_blocks[index];
+    entry.used = false;
+    m_remaining += entry.size;
+
+    // Merge with any free neighbours, free blocks are never left adjacent to each other.
+    block_index_t next_index = entry.next_physical;
+    if (next_index != k_invalid_block && !m_blocks[next_index].used)
+    {
+        remove_free_block(next_index);
+        merge_next_block(index);
+    }
+
+    block_index_t prev_index = m_blocks[index].prev_physical;
+    if (prev_index != k_invalid_block && !m_blocks[prev_index].used)
+    {
+        remove_free_block(prev_index);
+        merge_next_block(prev_index);
+        index = prev_index;
     }
+
+    insert_free_block(index);
+}
+
+bool memory_heap::empty()
+{
+    return m_used_blocks.empty();
 }
 
 size_t memory_heap::get_remaining()
@@ -10,18 +10,21 @@
 #include <string>
 #include <array>
 #include <vector>
+#include <limits>
+#include <unordered_map>
 
 namespace ws {
 
 // ================================================================================================
-//  Partitions an arbitrary numeric range into a heap and allows allocation/freeing of 
+//  Partitions an arbitrary numeric range into a heap and allows allocation/freeing of
 //  said range as though it was a memory heap, eg. with alloc/free.
-// 
+//
 //  As this doesn't actually point to physical memory, but just a numeric range, you can use it
 //  for tracking things such as gpu memory where you may have a size but not an actual pointer.
-// 
-//  TODO: This is pretty jankily implemented at the moment, its not efficient for large
-//        numbers of allocations and shouldn't be used for time sensitive applications.
+//
+//  Implemented as a two-level segregated fit (TLSF) allocator. Free blocks are bucketed by
+//  size class with a bitmap per level, so finding a suitable block, splitting it and merging
+//  it back with its neighbours on free are all constant time regardless of fragmentation.
 // ================================================================================================
 class memory_heap
 {
@@ -44,18 +47,67 @@ public:
     size_t get_remaining();
 
 private:
-    bool get_block_index(size_t offset, size_t& index);
 
-    void coalesce(size_t index);
+    using block_index_t = uint32_t;
+
+    static inline constexpr block_index_t k_invalid_block = std::numeric_limits<block_index_t>::max();
+
+    // Number of bits of the size used to pick a second level list, each first level
+    // (power of two) range is split into 1 << k_second_level_bits lists.
+    static inline constexpr size_t k_second_level_bits = 5;
+    static inline constexpr size_t k_second_level_count = 1ull << k_second_level_bits;
+
+    // Sizes below this all go in the first level 0 lists, with one second level list per size.
+    static inline constexpr size_t k_small_block_size = k_second_level_count;
+
+    static inline constexpr size_t k_first_level_count = 64 - k_second_level_bits + 1;
 
     struct block
     {
-        size_t offset;
-        size_t size;
+        size_t offset = 0;
+        size_t size = 0;
         bool used = false;
+
+        // Neighbouring blocks in the heap's range.
+        block_index_t prev_physical = k_invalid_block;
+        block_index_t next_physical = k_invalid_block;
+
+        // Neighbouring blocks in the same free list.
+        block_index_t prev_free = k_invalid_block;
+        block_index_t next_free = k_invalid_block;
     };
 
+    // Gets the free list a block of the given size belongs in.
+    void get_list_index(size_t size, size_t& first_level, size_t& second_level);
+
+    // Finds a free block at least the given size. Returns k_invalid_block if none exist.
+    block_index_t find_free_block(size_t size);
+
+    // Adds/removes a block from the free list for its size.
+    void insert_free_block(block_index_t index);
+    void remove_free_block(block_index_t index);
+
+    // Splits the block so it is exactly size long, putting the remainder into a new free block
+    // that follows it. Returns the new block.
+    block_index_t split_block(block_index_t index, size_t size);
+
+    // Merges the next physical block into the given block.
+    void merge_next_block(block_index_t index);
+
+    block_index_t alloc_block();
+    void free_block(block_index_t index);
+
+private:
+
     std::vector<block> m_blocks;
+    std::vector<block_index_t> m_unused_blocks;
+
+    uint64_t m_first_level_bitmap = 0;
+    std::array<uint32_t, k_first_level_count> m_second_level_bitmap = {};
+    std::array<std::array<block_index_t, k_second_level_count>, k_first_level_count> m_free_lists;
+
+    // Maps the offset of each allocated block to its index.
+    std::unordered_map<size_t, block_index_t> m_used_blocks;
 
     size_t m_remaining = 0;
 
@@ -469,31 +469,50 @@ void oct_tree<element_type>::get_elements(intersect_result& result, intersect_fu
 
     std::atomic_size_t total_results = 0;
 
-    auto callback = [&result, &total_results, coarse, &insersect_function](size_t i) mutable {
+    auto callback = [&result, &total_results, coarse, &insersect_function](const parallel_range& range) mutable {
 
-        const cell& cell = *result.cells[i];
-        for (size_t j = 0; j < cell.elements.size(); j++)
+        // Matches are batched up locally so we only need to touch the shared counter once per batch.
+        constexpr size_t k_batch_size = 64;
+        std::array<const entry*, k_batch_size> batch;
+        size_t batch_count = 0;
+
+        auto flush_batch = [&]() {
+            size_t result_index = total_results.fetch_add(batch_count);
+            for (size_t k = 0; k < batch_count; k++)
+            {
+                result.entries[result_index + k] = batch[k];
+                result.elements[result_index + k] = batch[k]->value;
+            }
+            batch_count = 0;
+        };
+
+        for (size_t i = range.begin; i < range.end; i++)
         {
-            const entry& entry = cell.elements[j];
-            if (coarse || insersect_function(entry.bounds))
+            const cell& cell = *result.cells[i];
+            for (size_t j = 0; j < cell.elements.size(); j++)
             {
-                size_t result_index = total_results.fetch_add(1);
-                result.entries[result_index] = &entry;
-                result.elements[result_index] = entry.value;
+                const entry& entry = cell.elements[j];
+                if (coarse || insersect_function(entry.bounds))
+                {
+                    batch[batch_count++] = &entry;
+                    if (batch_count == k_batch_size)
+                    {
+                        flush_batch();
+                    }
+                }
             }
         }
+
+        flush_batch();
     };
 
     if (parallel)
     {
-        parallel_for("octtree gather", task_queue::standard, result.cells.size(), callback, true);
+        parallel_for_range("octtree gather", task_queue::standard, 0, result.cells.size(), 0, callback);
     }
     else
     {
-        for (size_t i = 0; i < result.cells.size(); i++)
-        {
-            callback(i);
-        }
+        callback(parallel_range{ 0, result.cells.size() });
     }
 
     result.elements.resize(total_results);
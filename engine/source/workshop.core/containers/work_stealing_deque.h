@@ -0,0 +1,155 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+
+namespace ws {
+
+// ================================================================================================
+//  Fixed capacity lock-free Chase-Lev work stealing deque.
+//
+//  A single owner thread pushes and pops from the bottom of the deque in LIFO order, any
+//  number of other threads can steal from the top of the deque in FIFO order.
+//
+//  Element types should be small trivially copyable values (eg. indices), as they are stored
+//  and loaded as atomics.
+// ================================================================================================
+template <typename element_type, size_t capacity_elements>
+class work_stealing_deque
+{
+public:
+
+    static_assert((capacity_elements & (capacity_elements - 1)) == 0, "Capacity must be a power of two.");
+
+    // Result of a steal operation.
+    enum class steal_result
+    {
+        // An element was successfully stolen.
+        success,
+
+        // The deque was empty.
+        empty,
+
+        // Another thread won the race for the element, it may be worth retrying.
+        contended
+    };
+
+    work_stealing_deque() = default;
+
+    // Pushes an element onto the bottom of the deque. Returns false if the deque is full.
+    // Only the owning thread may call this.
+    bool push(const element_type& value);
+
+    // Pops an element from the bottom of the deque. Returns false if the deque is empty.
+    // Only the owning thread may call this.
+    bool pop(element_type& output);
+
+    // Steals an element from the top of the deque. Can be called from any thread.
+    steal_result steal(element_type& output);
+
+    // Gets an approximate count of the elements in the deque. This is only a
+    // hint and may be out of date by the time it returns.
+    size_t size_approx() const;
+
+    // Gets the maximum number of elements the deque can hold.
+    constexpr size_t capacity() const
+    {
+        return capacity_elements;
+    }
+
+private:
+    static inline constexpr int64_t k_mask = static_cast<int64_t>(capacity_elements) - 1;
+
+    // Top and bottom are kept on seperate cache lines as they are written by
+    // different threads.
+    alignas(64) std::atomic<int64_t> m_top = 0;
+    alignas(64) std::atomic<int64_t> m_bottom = 0;
+
+    alignas(64) std::array<std::atomic<element_type>, capacity_elements> m_buffer;
+
+};
+
+template <typename element_type, size_t capacity_elements>
+inline bool work_stealing_deque<element_type, capacity_elements>::push(const element_type& value)
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+
+    if (bottom - top >= static_cast<int64_t>(capacity_elements))
+    {
+        return false;
+    }
+
+    m_buffer[bottom & k_mask].store(value, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+
+    return true;
+}
+
+template <typename element_type, size_t capacity_elements>
+inline bool work_stealing_deque<element_type, capacity_elements>::pop(element_type& output)
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    // Deque was empty, restore the bottom.
+    if (top > bottom)
+    {
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    output = m_buffer[bottom & k_mask].load(std::memory_order_relaxed);
+
+    // More than one element left, no race with stealers is possible.
+    if (top != bottom)
+    {
+        return true;
+    }
+
+    // Last element, race any stealers for it.
+    bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+
+    return won;
+}
+
+template <typename element_type, size_t capacity_elements>
+inline typename work_stealing_deque<element_type, capacity_elements>::steal_result work_stealing_deque<element_type, capacity_elements>::steal(element_type& output)
+{
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+    if (top >= bottom)
+    {
+        return steal_result::empty;
+    }
+
+    element_type value = m_buffer[top & k_mask].load(std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+        return steal_result::contended;
+    }
+
+    output = value;
+    return steal_result::success;
+}
+
+template <typename element_type, size_t capacity_elements>
+inline size_t work_stealing_deque<element_type, capacity_elements>::size_approx() const
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+    return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+}
+
+}; // namespace ws
@@ -14,6 +14,15 @@ void register_core_cvars()
     cvar_platform.register_self();
     cvar_config.register_self();
     cvar_cpu_memory.register_self();
+    cvar_async_io_direct.register_self();
+    cvar_disk_stream_buffer_size.register_self();
+    cvar_asset_cache_content_hash.register_self();
+    cvar_asset_cache_shared_socket.register_self();
+    cvar_asset_load_trace.register_self();
+    cvar_memory_budgets.register_self();
+    cvar_asset_keep_alive_budget.register_self();
+    cvar_asset_keep_alive_max_count.register_self();
+    cvar_asset_keep_alive_timeout.register_self();
 }
 
 }; // namespace ws
@@ -36,4 +36,75 @@ inline cvar<int> cvar_cpu_memory(
     "Number of megabytes of ram installed on the machine."
 );
 
+// ================================================================================================
+//  IO
+// ================================================================================================
+
+inline cvar<bool> cvar_async_io_direct(
+    cvar_flag::none,
+    true,
+    "async_io_direct",
+    "If set, async io reads bypass the os file cache where the platform and filesystem support it."
+);
+
+inline cvar<int> cvar_disk_stream_buffer_size(
+    cvar_flag::none,
+    256,
+    "disk_stream_buffer_size",
+    "Size in kilobytes of the buffer disk streams read ahead into and gather writes in. Reads and writes larger than this bypass the buffer. Set to 0 to disable buffering."
+);
+
+inline cvar<bool> cvar_asset_cache_content_hash(
+    cvar_flag::none,
+    false,
+    "asset_cache_content_hash",
+    "If set, asset cache keys are derived from the content of source files rather than their modification times, so caches can be shared between machines and survive files being touched."
+);
+
+inline cvar<std::string> cvar_asset_cache_shared_socket(
+    cvar_flag::machine_specific,
+    "",
+    "asset_cache_shared_socket",
+    "Path to the socket of a workshop.asset_cache_server daemon to use as a shared asset cache. Compiled assets missing from the local cache are fetched from it, and newly compiled assets are published to it."
+);
+
+inline cvar<bool> cvar_asset_load_trace(
+    cvar_flag::none,
+    false,
+    "asset_load_trace",
+    "If set, world loads record how long each asset spent in each phase of loading. A summary of the critical path and slowest asset types is logged, and a chrome trace is written to temp:asset_load_trace.json."
+);
+
+// ================================================================================================
+//  Memory
+// ================================================================================================
+
+inline cvar<std::string> cvar_memory_budgets(
+    cvar_flag::none,
+    "",
+    "memory_budgets",
+    "Comma seperated list of memory budgets in the format path=soft:hard, limits are in megabytes. The path matches any memory type that starts with it."
+);
+
+inline cvar<int> cvar_asset_keep_alive_budget(
+    cvar_flag::none,
+    128,
+    "asset_keep_alive_budget",
+    "Megabytes of memory that assets which are no longer referenced can hold while being kept loaded in case they are requested again. Set to 0 to unload assets as soon as they are unreferenced."
+);
+
+inline cvar<int> cvar_asset_keep_alive_max_count(
+    cvar_flag::none,
+    256,
+    "asset_keep_alive_max_count",
+    "Maximum number of unreferenced assets kept loaded when asset memory usage is not being tracked, in which case asset_keep_alive_budget cannot be applied."
+);
+
+inline cvar<float> cvar_asset_keep_alive_timeout(
+    cvar_flag::none,
+    30.0f,
+    "asset_keep_alive_timeout",
+    "Seconds an unreferenced asset is kept loaded for before being unloaded."
+);
+
 }; // namespace ws
@@ -79,6 +79,18 @@ result<void> db_unload_symbols();
 // ================================================================================================
 std::unique_ptr<db_callstack> db_capture_callstack(size_t frame_offset = 0, size_t frame_count = INT_MAX);
 
+// ================================================================================================
+// Captures the raw return addresses of the current callstack without resolving any symbols. This
+// does not allocate, so is safe to call from inside memory hooks. Returns the number of frames
+// written to the frames buffer.
+// ================================================================================================
+size_t db_capture_raw_callstack(void** frames, size_t frame_count, size_t frame_offset = 0);
+
+// ================================================================================================
+// Resolves the symbols for a set of addresses previously captured with db_capture_raw_callstack.
+// ================================================================================================
+std::unique_ptr<db_callstack> db_resolve_callstack(void* const* frames, size_t frame_count);
+
 // ================================================================================================
 // Moves the console output to the given desktop coordinates. Only does anything on platforms with
 // a seperate console window.
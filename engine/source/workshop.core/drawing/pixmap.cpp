@@ -457,6 +457,9 @@ std::unique_ptr<pixmap> pixmap::block_encode(pixmap_format new_format, const enc
             size_t output_offset = (y * row_output_stride) + (x * output_block_size);
             block_callback(output_data.data() + output_offset, pixels_rgba.data());
         }
+
+        // Encoding large textures can take a long time, give any more urgent work a chance to run.
+        task_scheduler::get().yield();
       
 #if PIXMAP_PARALLEL_ENCODE
     });
@@ -6,4 +6,39 @@
 
 namespace ws {
 
+void async_io_request::add_completion_callback(completion_callback callback)
+{
+    {
+        std::scoped_lock lock(m_completion_mutex);
+        if (!m_completion_raised)
+        {
+            m_completion_callbacks.push_back(callback);
+            return;
+        }
+    }
+
+    callback();
+}
+
+void async_io_request::raise_completion_callbacks()
+{
+    std::vector<completion_callback> callbacks;
+
+    {
+        std::scoped_lock lock(m_completion_mutex);
+        if (m_completion_raised)
+        {
+            return;
+        }
+
+        m_completion_raised = true;
+        callbacks.swap(m_completion_callbacks);
+    }
+
+    for (completion_callback& callback : callbacks)
+    {
+        callback();
+    }
+}
+
 }; // namespace workshop
@@ -10,6 +10,9 @@
 
 #include <span>
 #include <memory>
+#include <mutex>
+#include <vector>
+#include <functional>
 
 namespace ws {
 
@@ -22,6 +25,18 @@ enum class async_io_request_options
     // This is here for future expansion, its empty for now.
 };
 
+// Determines the order in which queued requests are dispatched to the disk. Higher priority requests
+// are always dispatched before lower priority ones, requests of the same priority are dispatched in
+// the order they were made.
+enum class async_io_request_priority
+{
+    low,
+    normal,
+    high,
+
+    COUNT
+};
+
 // ================================================================================================
 //  Represents an outstanding IO request.
 // ================================================================================================
@@ -30,6 +45,9 @@ class async_io_request
 public:
 
     using ptr = std::shared_ptr<async_io_request>;
+    using completion_callback = std::function<void()>;
+
+    virtual ~async_io_request() = default;
 
     // Returns true once this request has completed.
     virtual bool is_complete() = 0;
@@ -40,6 +58,22 @@ public:
     // Gets the that was loaded from disk.
     virtual std::span<uint8_t> data() = 0;
 
+    // Registers a callback that is invoked once the request has completed or failed. If the
+    // request has already completed the callback is invoked immediately on the calling thread.
+    //
+    // Callbacks are run on the io thread, so should do as little work as possible.
+    void add_completion_callback(completion_callback callback);
+
+protected:
+
+    // Should be called by implementations once the request has completed or failed.
+    void raise_completion_callbacks();
+
+private:
+    std::mutex m_completion_mutex;
+    std::vector<completion_callback> m_completion_callbacks;
+    bool m_completion_raised = false;
+
 };
 
 // ================================================================================================
@@ -62,7 +96,7 @@ public:
     // 
     // No virtualization is performed on the path, this path is expected to be the 
     // raw on-disk path.
-    virtual async_io_request::ptr request(const char* path, size_t offset, size_t size, async_io_request_options options) = 0;
+    virtual async_io_request::ptr request(const char* path, size_t offset, size_t size, async_io_request_options options, async_io_request_priority priority = async_io_request_priority::normal) = 0;
 
 };
 
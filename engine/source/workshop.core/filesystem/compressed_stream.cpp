@@ -0,0 +1,648 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.core/filesystem/compressed_stream.h"
+#include "workshop.core/async/async.h"
+#include "workshop.core/async/task_scheduler.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace ws {
+
+namespace {
+
+// ================================================================================================
+//  Async read of a range of a compressed stream. The stored chunks overlapping the range are
+//  read with the async io manager, then decompressed on the task scheduler.
+// ================================================================================================
+class compressed_async_io_request
+    : public async_io_request
+    , public std::enable_shared_from_this<compressed_async_io_request>
+{
+public:
+
+    compressed_async_io_request(std::shared_ptr<compressed_stream_index> index, size_t offset, size_t size)
+        : m_index(index)
+        , m_offset(offset)
+        , m_size(size)
+    {
+    }
+
+    void start(async_io_request_priority priority)
+    {
+        size_t chunk_size = m_index->get_chunk_size();
+
+        m_first_chunk = m_offset / chunk_size;
+        m_chunk_count = ((m_offset + m_size + chunk_size - 1) / chunk_size) - m_first_chunk;
+
+        const compressed_stream_index::chunk& first = m_index->get_chunk(m_first_chunk);
+        const compressed_stream_index::chunk& last = m_index->get_chunk(m_first_chunk + m_chunk_count - 1);
+        size_t stored_size = (last.offset + last.stored_size) - first.offset;
+
+        m_raw_request = async_io_manager::get().request(
+            m_index->get_async_path().c_str(),
+            m_index->get_async_offset() + first.offset,
+            stored_size,
+            async_io_request_options::none,
+            priority
+        );
+
+        // Completion callbacks run on the io thread, so hand decompression off to the workers.
+        std::weak_ptr<compressed_async_io_request> weak_this = shared_from_this();
+        m_raw_request->add_completion_callback([weak_this]() {
+            if (std::shared_ptr<compressed_async_io_request> self = weak_this.lock())
+            {
+                async("Decompress Async Read", task_queue::loading, [self]() {
+                    self->decompress();
+                });
+            }
+        });
+    }
+
+    virtual bool is_complete() override
+    {
+        return m_complete.load();
+    }
+
+    virtual bool has_failed() override
+    {
+        return m_failed.load();
+    }
+
+    virtual std::span<uint8_t> data() override
+    {
+        return m_data;
+    }
+
+private:
+
+    void decompress()
+    {
+        bool success = !m_raw_request->has_failed();
+
+        if (success)
+        {
+            size_t uncompressed_size = 0;
+            for (size_t i = 0; i < m_chunk_count; i++)
+            {
+                uncompressed_size += m_index->get_chunk_uncompressed_size(m_first_chunk + i);
+            }
+
+            m_buffer.resize(uncompressed_size);
+            success = m_index->decompress_chunks(m_first_chunk, m_chunk_count, m_raw_request->data(), m_buffer);
+
+            size_t range_offset = m_offset - (m_first_chunk * m_index->get_chunk_size());
+            m_data = std::span<uint8_t>(m_buffer.data() + range_offset, m_size);
+        }
+
+        // The stored data is no longer needed.
+        m_raw_request = nullptr;
+
+        m_failed = !success;
+        m_complete = true;
+
+        raise_completion_callbacks();
+    }
+
+private:
+
+    std::shared_ptr<compressed_stream_index> m_index;
+    size_t m_offset;
+    size_t m_size;
+
+    size_t m_first_chunk = 0;
+    size_t m_chunk_count = 0;
+
+    async_io_request::ptr m_raw_request;
+
+    std::vector<uint8_t> m_buffer;
+    std::span<uint8_t> m_data;
+
+    std::atomic_bool m_complete = false;
+    std::atomic_bool m_failed = false;
+
+};
+
+};
+
+std::shared_ptr<compressed_stream_index> compressed_stream_index::read(stream& input)
+{
+    std::string async_path = input.get_async_path();
+    size_t async_offset = async_path.empty() ? 0 : input.get_async_offset();
+    size_t stream_offset = input.position();
+    size_t stream_length = input.length() - std::min(stream_offset, input.length());
+
+    header stream_header;
+    if (input.read(reinterpret_cast<char*>(&stream_header), sizeof(stream_header)) != sizeof(stream_header) ||
+        stream_header.magic != k_magic)
+    {
+        return nullptr;
+    }
+
+    if (stream_header.version != k_version || stream_header.chunk_size == 0)
+    {
+        db_error(core, "Compressed stream has unsupported version %u.", stream_header.version);
+        return nullptr;
+    }
+
+    // Everything in the header is validated before its used, a corrupt or truncated file shouldn't
+    // be able to make us allocate huge amounts of memory or read out of bounds.
+    uint64_t expected_chunk_count = (stream_header.uncompressed_size / stream_header.chunk_size) + ((stream_header.uncompressed_size % stream_header.chunk_size) != 0 ? 1 : 0);
+    if (stream_header.chunk_count != expected_chunk_count)
+    {
+        db_error(core, "Compressed stream has %u chunks, expected %llu for %llu bytes of data.", stream_header.chunk_count, static_cast<unsigned long long>(expected_chunk_count), static_cast<unsigned long long>(stream_header.uncompressed_size));
+        return nullptr;
+    }
+
+    size_t table_size = static_cast<size_t>(stream_header.chunk_count) * sizeof(chunk);
+    if (table_size > stream_length - sizeof(stream_header))
+    {
+        db_error(core, "Compressed stream chunk table is larger than the stream, the stream is likely truncated.");
+        return nullptr;
+    }
+
+    std::shared_ptr<compressed_stream_index> index = std::make_shared<compressed_stream_index>();
+    index->m_header = stream_header;
+    index->m_chunks.resize(stream_header.chunk_count);
+    index->m_async_path = async_path;
+    index->m_async_offset = async_offset;
+    index->m_stream_offset = stream_offset;
+
+    if (input.read(reinterpret_cast<char*>(index->m_chunks.data()), table_size) != table_size)
+    {
+        db_error(core, "Failed to read compressed stream chunk table.");
+        return nullptr;
+    }
+
+    // Chunks need to be stored in order after the table and within the stream, reading runs of
+    // chunks relies on them being contiguous.
+    uint64_t min_offset = sizeof(stream_header) + table_size;
+    for (const chunk& stored_chunk : index->m_chunks)
+    {
+        if (stored_chunk.offset < min_offset || 
+            stored_chunk.offset > stream_length || 
+            stored_chunk.stored_size > stream_length - stored_chunk.offset)
+        {
+            db_error(core, "Compressed stream chunk table is corrupt.");
+            return nullptr;
+        }
+
+        min_offset = stored_chunk.offset + stored_chunk.stored_size;
+    }
+
+    return index;
+}
+
+size_t compressed_stream_index::get_uncompressed_size()
+{
+    return m_header.uncompressed_size;
+}
+
+size_t compressed_stream_index::get_chunk_size()
+{
+    return m_header.chunk_size;
+}
+
+size_t compressed_stream_index::get_chunk_count()
+{
+    return m_chunks.size();
+}
+
+const compressed_stream_index::chunk& compressed_stream_index::get_chunk(size_t index)
+{
+    return m_chunks[index];
+}
+
+size_t compressed_stream_index::get_chunk_uncompressed_size(size_t index)
+{
+    size_t start = index * m_header.chunk_size;
+    return std::min(static_cast<size_t>(m_header.chunk_size), m_header.uncompressed_size - start);
+}
+
+bool compressed_stream_index::decompress_chunk(size_t index, std::span<const uint8_t> stored, std::span<uint8_t> output)
+{
+    const chunk& stored_chunk = m_chunks[index];
+    db_assert(stored.size() == stored_chunk.stored_size);
+    db_assert(output.size() == get_chunk_uncompressed_size(index));
+
+    if (stored_chunk.flags != chunk_flags::compressed)
+    {
+        if (stored.size() != output.size())
+        {
+            return false;
+        }
+
+        memcpy(output.data(), stored.data(), output.size());
+        return true;
+    }
+
+    uLongf output_size = static_cast<uLongf>(output.size());
+    int ret = uncompress(output.data(), &output_size, stored.data(), static_cast<uLong>(stored.size()));
+    if (ret != Z_OK || output_size != output.size())
+    {
+        db_error(core, "Failed to decompress chunk %zi of compressed stream, error %i.", index, ret);
+        return false;
+    }
+
+    return true;
+}
+
+bool compressed_stream_index::decompress_chunks(size_t first, size_t count, std::span<const uint8_t> stored, std::span<uint8_t> output)
+{
+    size_t stored_start = m_chunks[first].offset;
+    std::atomic_bool success = true;
+
+    auto decompress = [this, first, stored_start, &stored, &output, &success](size_t i) {
+        size_t index = first + i;
+        const chunk& stored_chunk = m_chunks[index];
+
+        size_t stored_offset = stored_chunk.offset - stored_start;
+        size_t output_offset = i * m_header.chunk_size;
+
+        if (stored_offset + stored_chunk.stored_size > stored.size() ||
+            output_offset + get_chunk_uncompressed_size(index) > output.size() ||
+            !decompress_chunk(index, stored.subspan(stored_offset, stored_chunk.stored_size), output.subspan(output_offset, get_chunk_uncompressed_size(index))))
+        {
+            success = false;
+        }
+    };
+
+    if (count > 1 && task_scheduler::try_get() != nullptr)
+    {
+        parallel_for("Decompress Chunks", task_queue::loading, count, decompress, true);
+    }
+    else
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            decompress(i);
+        }
+    }
+
+    return success.load();
+}
+
+const std::string& compressed_stream_index::get_async_path()
+{
+    return m_async_path;
+}
+
+size_t compressed_stream_index::get_async_offset()
+{
+    return m_async_offset;
+}
+
+size_t compressed_stream_index::get_stream_offset()
+{
+    return m_stream_offset;
+}
+
+async_io_request::ptr compressed_stream_index::request_async(size_t offset, size_t size, async_io_request_priority priority)
+{
+    db_assert(!m_async_path.empty());
+    db_assert(size > 0 && offset + size <= m_header.uncompressed_size);
+
+    std::shared_ptr<compressed_async_io_request> request = std::make_shared<compressed_async_io_request>(shared_from_this(), offset, size);
+    request->start(priority);
+
+    return request;
+}
+
+compressed_stream::compressed_stream(std::unique_ptr<stream> output, int compression_level, size_t chunk_size)
+    : m_inner(std::move(output))
+    , m_can_write(true)
+    , m_compression_level(compression_level)
+    , m_chunk_size(chunk_size)
+{
+    db_assert(m_inner->can_write());
+    db_assert(m_chunk_size > 0 && m_chunk_size <= std::numeric_limits<uint32_t>::max());
+}
+
+compressed_stream::compressed_stream(std::unique_ptr<stream> input, std::shared_ptr<compressed_stream_index> index)
+    : m_inner(std::move(input))
+    , m_index(index)
+    , m_can_write(false)
+{
+}
+
+compressed_stream::~compressed_stream()
+{
+    close();
+}
+
+std::unique_ptr<stream> compressed_stream::open_for_reading(std::unique_ptr<stream> input)
+{
+    if (!input)
+    {
+        return nullptr;
+    }
+
+    size_t start_position = input->position();
+
+    std::shared_ptr<compressed_stream_index> index = compressed_stream_index::read(*input);
+    if (!index)
+    {
+        input->seek(start_position);
+        return input;
+    }
+
+    return std::make_unique<compressed_stream>(std::move(input), index);
+}
+
+bool compressed_stream::finish()
+{
+    if (m_closed)
+    {
+        return !m_write_failed;
+    }
+
+    if (m_can_write)
+    {
+        m_write_failed = !write_compressed();
+    }
+
+    m_inner->close();
+    m_closed = true;
+
+    return !m_write_failed;
+}
+
+void compressed_stream::close()
+{
+    finish();
+}
+
+void compressed_stream::flush()
+{
+    // Nothing is written until the stream is closed as chunks can change until then.
+}
+
+bool compressed_stream::can_write()
+{
+    return m_can_write;
+}
+
+size_t compressed_stream::position()
+{
+    return m_position;
+}
+
+size_t compressed_stream::length()
+{
+    return m_can_write ? m_write_buffer.size() : m_index->get_uncompressed_size();
+}
+
+void compressed_stream::seek(size_t position)
+{
+    if (m_can_write && position > m_write_buffer.size())
+    {
+        m_write_buffer.resize(position);
+    }
+
+    m_position = std::min(position, length());
+}
+
+size_t compressed_stream::write(const char* data, size_t size)
+{
+    if (!m_can_write)
+    {
+        db_assert_message(false, "Attempt to write to read only compressed stream.");
+        return 0;
+    }
+
+    size_t end_size = m_position + size;
+    if (end_size > m_write_buffer.size())
+    {
+        m_write_buffer.resize(end_size);
+    }
+
+    memcpy(m_write_buffer.data() + m_position, data, size);
+    m_position += size;
+
+    return size;
+}
+
+size_t compressed_stream::read(char* data, size_t size)
+{
+    if (m_can_write)
+    {
+        db_assert_message(false, "Attempt to read from write only compressed stream.");
+        return 0;
+    }
+
+    size = std::min(size, length() - m_position);
+
+    size_t chunk_size = m_index->get_chunk_size();
+    size_t bytes_read = 0;
+
+    while (bytes_read < size)
+    {
+        size_t chunk_index = m_position / chunk_size;
+        size_t chunk_offset = m_position % chunk_size;
+        size_t remaining = size - bytes_read;
+
+        // Whole chunks are decompressed directly into the output, in parallel if there are several.
+        if (chunk_offset == 0 &&
+            chunk_index != m_chunk_buffer_index &&
+            remaining >= m_index->get_chunk_uncompressed_size(chunk_index))
+        {
+            size_t run_count = 0;
+            size_t run_size = 0;
+
+            while (chunk_index + run_count < m_index->get_chunk_count())
+            {
+                size_t next_size = m_index->get_chunk_uncompressed_size(chunk_index + run_count);
+                if (run_size + next_size > remaining)
+                {
+                    break;
+                }
+
+                run_size += next_size;
+                run_count++;
+            }
+
+            if (!read_chunks(chunk_index, run_count, std::span<uint8_t>(reinterpret_cast<uint8_t*>(data + bytes_read), run_size)))
+            {
+                break;
+            }
+
+            bytes_read += run_size;
+            m_position += run_size;
+            continue;
+        }
+
+        // Otherwise copy out of the chunk the position is in.
+        if (!load_chunk(chunk_index))
+        {
+            break;
+        }
+
+        size_t copy_size = std::min(remaining, m_chunk_buffer.size() - chunk_offset);
+        memcpy(data + bytes_read, m_chunk_buffer.data() + chunk_offset, copy_size);
+
+        bytes_read += copy_size;
+        m_position += copy_size;
+    }
+
+    return bytes_read;
+}
+
+std::string compressed_stream::get_async_path()
+{
+    return "";
+}
+
+size_t compressed_stream::get_async_offset()
+{
+    return 0;
+}
+
+std::shared_ptr<compressed_stream_index> compressed_stream::get_index()
+{
+    return m_index;
+}
+
+bool compressed_stream::load_chunk(size_t index)
+{
+    if (m_chunk_buffer_index == index)
+    {
+        return true;
+    }
+
+    m_chunk_buffer.resize(m_index->get_chunk_uncompressed_size(index));
+
+    if (!read_chunks(index, 1, m_chunk_buffer))
+    {
+        m_chunk_buffer_index = k_no_chunk;
+        return false;
+    }
+
+    m_chunk_buffer_index = index;
+    return true;
+}
+
+bool compressed_stream::read_chunks(size_t first, size_t count, std::span<uint8_t> output)
+{
+    const compressed_stream_index::chunk& first_chunk = m_index->get_chunk(first);
+    const compressed_stream_index::chunk& last_chunk = m_index->get_chunk(first + count - 1);
+    size_t stored_size = (last_chunk.offset + last_chunk.stored_size) - first_chunk.offset;
+
+    m_inner->seek(m_index->get_stream_offset() + first_chunk.offset);
+
+    // Avoid copying the stored data if the underlying stream is memory backed.
+    std::vector<uint8_t> stored_buffer;
+    std::span<uint8_t> stored = m_inner->read_view(stored_size);
+    if (stored.empty() && stored_size > 0)
+    {
+        stored_buffer.resize(stored_size);
+        if (m_inner->read(reinterpret_cast<char*>(stored_buffer.data()), stored_size) != stored_size)
+        {
+            db_error(core, "Failed to read stored chunks from compressed stream.");
+            return false;
+        }
+        stored = stored_buffer;
+    }
+
+    return m_index->decompress_chunks(first, count, stored, output);
+}
+
+bool compressed_stream::write_compressed()
+{
+    size_t chunk_count = (m_write_buffer.size() + m_chunk_size - 1) / m_chunk_size;
+
+    std::vector<compressed_stream_index::chunk> chunks(chunk_count);
+    std::vector<std::vector<uint8_t>> compressed_chunks(chunk_count);
+
+    auto compress_chunk = [this, &chunks, &compressed_chunks](size_t i) {
+        size_t offset = i * m_chunk_size;
+        size_t size = std::min(m_chunk_size, m_write_buffer.size() - offset);
+
+        compressed_stream_index::chunk& output_chunk = chunks[i];
+        output_chunk.flags = compressed_stream_index::chunk_flags::none;
+        output_chunk.stored_size = static_cast<uint32_t>(size);
+
+        if (m_compression_level <= 0)
+        {
+            return;
+        }
+
+        std::vector<uint8_t>& compressed = compressed_chunks[i];
+
+        uLongf compressed_size = compressBound(static_cast<uLong>(size));
+        compressed.resize(compressed_size);
+
+        int ret = compress2(compressed.data(), &compressed_size, m_write_buffer.data() + offset, static_cast<uLong>(size), m_compression_level);
+
+        // Chunks that don't shrink are stored as-is so reading them is just a copy.
+        if (ret == Z_OK && compressed_size < size)
+        {
+            compressed.resize(compressed_size);
+            output_chunk.flags = compressed_stream_index::chunk_flags::compressed;
+            output_chunk.stored_size = static_cast<uint32_t>(compressed_size);
+        }
+        else
+        {
+            compressed.clear();
+        }
+    };
+
+    if (chunk_count > 1 && task_scheduler::try_get() != nullptr)
+    {
+        parallel_for("Compress Chunks", task_queue::loading, chunk_count, compress_chunk, true);
+    }
+    else
+    {
+        for (size_t i = 0; i < chunk_count; i++)
+        {
+            compress_chunk(i);
+        }
+    }
+
+    compressed_stream_index::header stream_header = {};
+    stream_header.magic = compressed_stream_index::k_magic;
+    stream_header.version = compressed_stream_index::k_version;
+    stream_header.chunk_size = static_cast<uint32_t>(m_chunk_size);
+    stream_header.chunk_count = static_cast<uint32_t>(chunk_count);
+    stream_header.uncompressed_size = m_write_buffer.size();
+
+    size_t offset = sizeof(stream_header) + (chunk_count * sizeof(compressed_stream_index::chunk));
+    for (compressed_stream_index::chunk& output_chunk : chunks)
+    {
+        output_chunk.offset = offset;
+        offset += output_chunk.stored_size;
+    }
+
+    size_t table_size = chunks.size() * sizeof(compressed_stream_index::chunk);
+
+    bool success =
+        m_inner->write(reinterpret_cast<const char*>(&stream_header), sizeof(stream_header)) == sizeof(stream_header) &&
+        m_inner->write(reinterpret_cast<const char*>(chunks.data()), table_size) == table_size;
+
+    for (size_t i = 0; i < chunk_count && success; i++)
+    {
+        std::span<const uint8_t> stored = compressed_chunks[i];
+        if (chunks[i].flags != compressed_stream_index::chunk_flags::compressed)
+        {
+            stored = std::span<const uint8_t>(m_write_buffer.data() + (i * m_chunk_size), chunks[i].stored_size);
+        }
+
+        success = (m_inner->write(reinterpret_cast<const char*>(stored.data()), stored.size()) == stored.size());
+    }
+
+    if (!success)
+    {
+        db_error(core, "Failed to write compressed stream.");
+    }
+
+    m_write_buffer.clear();
+    m_write_buffer.shrink_to_fit();
+
+    return success;
+}
+
+}; // namespace ws
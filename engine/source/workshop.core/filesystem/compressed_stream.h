@@ -0,0 +1,200 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/filesystem/stream.h"
+#include "workshop.core/filesystem/async_io_manager.h"
+
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ws {
+
+// ================================================================================================
+//  Describes the layout of the chunks in a compressed_stream.
+//
+//  This is shared between all streams reading the data, and anything that needs to read parts
+//  of it after the stream has been closed, such as texture streaming reading individual mips.
+//
+//  This class is thread safe.
+// ================================================================================================
+class compressed_stream_index
+    : public std::enable_shared_from_this<compressed_stream_index>
+{
+public:
+
+    static inline constexpr uint32_t k_magic = 0x53435357; // WSCS
+    static inline constexpr uint32_t k_version = 1;
+
+    enum class chunk_flags : uint32_t
+    {
+        none = 0,
+        compressed = 1,
+    };
+
+    struct header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t chunk_size;
+        uint32_t chunk_count;
+        uint64_t uncompressed_size;
+    };
+
+    struct chunk
+    {
+        // Offset from the start of the compressed data (ie. the start of the header).
+        uint64_t offset;
+        uint32_t stored_size;
+        chunk_flags flags;
+    };
+
+    // Reads the index from the current position of the given stream. Returns nullptr if the stream
+    // does not contain compressed data at that position, or if the index is corrupt.
+    static std::shared_ptr<compressed_stream_index> read(stream& input);
+
+    // Gets the size of the data when decompressed.
+    size_t get_uncompressed_size();
+
+    // Gets the number of bytes each chunk holds when decompressed, the last chunk may be smaller.
+    size_t get_chunk_size();
+
+    // Gets the number of chunks the data is split into.
+    size_t get_chunk_count();
+
+    // Gets the layout of the given chunk.
+    const chunk& get_chunk(size_t index);
+
+    // Gets the number of bytes the given chunk holds when decompressed.
+    size_t get_chunk_uncompressed_size(size_t index);
+
+    // Decompresses the stored data of a chunk into output, which must be get_chunk_uncompressed_size bytes.
+    bool decompress_chunk(size_t index, std::span<const uint8_t> stored, std::span<uint8_t> output);
+
+    // Decompresses a contiguous run of chunks into output. stored should contain the stored data
+    // of all the chunks, starting at the first. The chunks are decompressed in parallel on the
+    // task scheduler if there is more than one.
+    bool decompress_chunks(size_t first, size_t count, std::span<const uint8_t> stored, std::span<uint8_t> output);
+
+    // Gets the on-disk path and offset of the compressed data, for async reads. The path
+    // is empty if the data doesn't exist as-is on disk.
+    const std::string& get_async_path();
+    size_t get_async_offset();
+
+    // Gets the offset of the compressed data within the stream the index was read from.
+    size_t get_stream_offset();
+
+    // Starts an async read of the given range of the decompressed data. Only the chunks
+    // overlapping the range are read, they are decompressed on the task scheduler once read.
+    async_io_request::ptr request_async(size_t offset, size_t size, async_io_request_priority priority);
+
+private:
+
+    header m_header;
+    std::vector<chunk> m_chunks;
+
+    std::string m_async_path;
+    size_t m_async_offset = 0;
+
+    size_t m_stream_offset = 0;
+
+};
+
+// ================================================================================================
+//  A stream that compresses data written to it, and decompresses data read from it, in
+//  independently compressed chunks with zlib.
+//
+//  Layout:
+//      header
+//      chunk table
+//      chunk data
+//
+//  The compressed data doesn't need to start at the beginning of the stream it's written to,
+//  anything written to the stream beforehand (such as a file header) is left uncompressed.
+//
+//  As each chunk is independent the stream can be seeked anywhere by only decompressing the
+//  chunk holding that position. Reads that cover multiple chunks decompress them in parallel
+//  on the task scheduler. Chunks that don't shrink when compressed are stored as-is.
+//
+//  When writing, data is held in memory until the stream is finished or closed, at which point
+//  all chunks are compressed in parallel and written out.
+// ================================================================================================
+class compressed_stream : public stream
+{
+public:
+
+    static inline constexpr size_t k_default_chunk_size = 128 * 1024;
+
+    // Creates a stream that compresses everything written to it into output.
+    // A compression level of 0 stores the chunks without compressing them.
+    compressed_stream(std::unique_ptr<stream> output, int compression_level, size_t chunk_size = k_default_chunk_size);
+
+    // Creates a stream that decompresses input using the index previously read from it.
+    compressed_stream(std::unique_ptr<stream> input, std::shared_ptr<compressed_stream_index> index);
+
+    virtual ~compressed_stream();
+
+    // If input contains compressed data at its current position it's wrapped in a compressed_stream
+    // to read it, otherwise input is returned as-is at its original position.
+    static std::unique_ptr<stream> open_for_reading(std::unique_ptr<stream> input);
+
+    // Compresses and writes out everything written to the stream, then closes it. Returns false if
+    // any of it failed to be written. close does the same but can't report failure, so when writing
+    // this should be called explicitly.
+    bool finish();
+
+    virtual void close() override;
+    virtual void flush() override;
+    virtual bool can_write() override;
+    virtual size_t position() override;
+    virtual size_t length() override;
+    virtual void seek(size_t position) override;
+    virtual size_t write(const char* data, size_t size) override;
+    virtual size_t read(char* data, size_t size) override;
+
+    // The compressed data can't be async read directly, use the index's request_async instead.
+    virtual std::string get_async_path() override;
+    virtual size_t get_async_offset() override;
+
+    // Gets the index describing the compressed data, only available when reading.
+    std::shared_ptr<compressed_stream_index> get_index();
+
+private:
+
+    // Decompresses the given chunk into m_chunk_buffer if its not already there.
+    bool load_chunk(size_t index);
+
+    // Decompresses a run of whole chunks directly into output.
+    bool read_chunks(size_t first, size_t count, std::span<uint8_t> output);
+
+    // Compresses everything written and writes it to the output stream.
+    bool write_compressed();
+
+private:
+
+    std::unique_ptr<stream> m_inner;
+    std::shared_ptr<compressed_stream_index> m_index;
+
+    bool m_can_write = false;
+    bool m_closed = false;
+    bool m_write_failed = false;
+    size_t m_position = 0;
+
+    // Reading
+    static inline constexpr size_t k_no_chunk = std::numeric_limits<size_t>::max();
+    std::vector<uint8_t> m_chunk_buffer;
+    size_t m_chunk_buffer_index = k_no_chunk;
+
+    // Writing
+    std::vector<uint8_t> m_write_buffer;
+    int m_compression_level = 0;
+    size_t m_chunk_size = k_default_chunk_size;
+
+};
+
+}; // namespace workshop
@@ -3,6 +3,11 @@
 //  Copyright (C) 2021 Tim Leonard
 // ================================================================================================
 #include "workshop.core/filesystem/disk_stream.h"
+#include "workshop.core/cvar/core_cvars.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
 
 #ifdef WS_LINUX
 #define _fseeki64 fseeko
@@ -33,11 +38,26 @@ result<void> disk_stream::open(const std::filesystem::path& path, bool for_writi
         return false;
     }
 
+    // We do our own buffering, so disable the runtime's. This has to happen before any other
+    // operation on the file.
+    m_buffer_capacity = static_cast<size_t>(std::max(0, cvar_disk_stream_buffer_size.get_int())) * 1024;
+    if (m_buffer_capacity > 0)
+    {
+        setvbuf(m_file, nullptr, _IONBF, 0);
+
+        m_buffer = static_cast<uint8_t*>(::operator new(m_buffer_capacity, std::align_val_t(k_buffer_alignment)));
+    }
+
     // Cache the length of the file up front.
     _fseeki64(m_file, 0, SEEK_END);
     m_length = _ftelli64(m_file);
     _fseeki64(m_file, 0, SEEK_SET);
 
+    m_position = 0;
+    m_file_position = 0;
+    m_buffer_offset = 0;
+    m_buffer_size = 0;
+
     return true;
 }
 
@@ -45,14 +65,23 @@ void disk_stream::close()
 {
     db_assert(m_file != nullptr);
 
+    flush_buffer();
+
     fclose(m_file);
     m_file = nullptr;
+
+    if (m_buffer != nullptr)
+    {
+        ::operator delete(m_buffer, std::align_val_t(k_buffer_alignment));
+        m_buffer = nullptr;
+    }
 }
 
 void disk_stream::flush()
 {
     db_assert(m_file != nullptr);
 
+    flush_buffer();
     fflush(m_file);
 }
 
@@ -65,7 +94,7 @@ size_t disk_stream::position()
 {
     db_assert(m_file != nullptr);
 
-    return _ftelli64(m_file);
+    return m_position;
 }
 
 size_t disk_stream::length()
@@ -79,21 +108,178 @@ void disk_stream::seek(size_t position)
 {
     db_assert(m_file != nullptr);
 
-    _fseeki64(m_file, position, SEEK_SET);
+    // Pending writes are for the old position.
+    if (m_can_write && position != m_position)
+    {
+        flush_buffer();
+    }
+
+    m_position = position;
 }
 
 size_t disk_stream::write(const char* data, size_t size)
 {
     db_assert(m_file != nullptr);
 
-    return fwrite(data, size, 1, m_file) * size;
+    // Gather the data if it fits in the buffer.
+    if (size < m_buffer_capacity)
+    {
+        if (m_buffer_size + size > m_buffer_capacity)
+        {
+            if (!flush_buffer())
+            {
+                return 0;
+            }
+        }
+
+        if (m_buffer_size == 0)
+        {
+            m_buffer_offset = m_position;
+        }
+
+        memcpy(m_buffer + m_buffer_size, data, size);
+        m_buffer_size += size;
+    }
+    else
+    {
+        if (!flush_buffer())
+        {
+            return 0;
+        }
+
+        seek_file(m_position);
+
+        if (fwrite(data, size, 1, m_file) != 1)
+        {
+            return 0;
+        }
+
+        m_file_position += size;
+    }
+
+    m_position += size;
+    m_length = std::max(m_length, static_cast<uint64_t>(m_position));
+
+    return size;
 }
 
 size_t disk_stream::read(char* data, size_t size)
 {
     db_assert(m_file != nullptr);
 
-    return fread(data, size, 1, m_file) * size;
+    if (m_position + size > m_length)
+    {
+        return 0;
+    }
+
+    size_t bytes_read = 0;
+
+    // Copy anything we already have buffered.
+    if (m_position >= m_buffer_offset && m_position < m_buffer_offset + m_buffer_size)
+    {
+        size_t buffer_position = m_position - m_buffer_offset;
+        size_t to_copy = std::min(size, m_buffer_size - buffer_position);
+
+        memcpy(data, m_buffer + buffer_position, to_copy);
+        m_position += to_copy;
+        bytes_read += to_copy;
+    }
+
+    if (bytes_read == size)
+    {
+        return size;
+    }
+
+    // Large spans are read straight into the destination.
+    size_t remaining = size - bytes_read;
+    if (remaining >= m_buffer_capacity)
+    {
+        if (read_direct(data + bytes_read, remaining) != remaining)
+        {
+            m_position -= bytes_read;
+            return 0;
+        }
+        return size;
+    }
+
+    // Read ahead as much as the buffer can hold.
+    size_t to_buffer = std::min(m_buffer_capacity, static_cast<size_t>(m_length - m_position));
+
+    seek_file(m_position);
+
+    if (fread(m_buffer, to_buffer, 1, m_file) != 1)
+    {
+        m_buffer_size = 0;
+        m_position -= bytes_read;
+        return 0;
+    }
+
+    m_file_position += to_buffer;
+    m_buffer_offset = m_position;
+    m_buffer_size = to_buffer;
+
+    memcpy(data + bytes_read, m_buffer, remaining);
+    m_position += remaining;
+
+    return size;
+}
+
+size_t disk_stream::read_direct(char* data, size_t size)
+{
+    db_assert(m_file != nullptr);
+    db_assert(!m_can_write);
+
+    if (m_position + size > m_length)
+    {
+        return 0;
+    }
+
+    seek_file(m_position);
+
+    if (fread(data, size, 1, m_file) != 1)
+    {
+        // The file position is unknown after a failed read.
+        m_file_position = static_cast<size_t>(_ftelli64(m_file));
+        return 0;
+    }
+
+    m_file_position += size;
+    m_position += size;
+
+    return size;
+}
+
+bool disk_stream::flush_buffer()
+{
+    if (!m_can_write || m_buffer_size == 0)
+    {
+        return true;
+    }
+
+    seek_file(m_buffer_offset);
+
+    bool success = (fwrite(m_buffer, m_buffer_size, 1, m_file) == 1);
+    if (success)
+    {
+        m_file_position += m_buffer_size;
+    }
+    else
+    {
+        m_file_position = static_cast<size_t>(_ftelli64(m_file));
+    }
+
+    m_buffer_size = 0;
+
+    return success;
+}
+
+void disk_stream::seek_file(size_t offset)
+{
+    if (m_file_position != offset)
+    {
+        _fseeki64(m_file, offset, SEEK_SET);
+        m_file_position = offset;
+    }
 }
 
 std::string disk_stream::get_async_path()
@@ -14,6 +14,10 @@ namespace ws {
 
 // ================================================================================================
 //  A stream that reads or writes to a file on disk
+//
+//  Reads and writes go through a large buffer (sized by the disk_stream_buffer_size cvar) so
+//  serializing lots of small values doesn't result in a call into the os for each one. The
+//  position is tracked locally rather than queried from the file.
 // ================================================================================================
 class disk_stream : public stream
 {
@@ -35,14 +39,40 @@ public:
     virtual std::string get_async_path() override;
     virtual size_t get_async_offset() override;
 
+    // Reads directly from the file into data, bypassing the buffer. This is done implicitly
+    // by read for spans larger than the buffer.
+    size_t read_direct(char* data, size_t size);
+
+private:
+
+    // Writes out any data gathered in the buffer.
+    bool flush_buffer();
+
+    // Moves the file to the given offset if its not already there.
+    void seek_file(size_t offset);
+
 private:
-    FILE* m_file;
+    FILE* m_file = nullptr;
 
     std::filesystem::path m_path;
 
     bool m_can_write = false;
 
-    uint64_t m_length;
+    uint64_t m_length = 0;
+
+    // Position of the stream, and of the underlying file.
+    size_t m_position = 0;
+    size_t m_file_position = 0;
+
+    uint8_t* m_buffer = nullptr;
+    size_t m_buffer_capacity = 0;
+
+    // Offset in the file the buffer starts at, and how many bytes in it are valid. When
+    // writing this is the number of bytes waiting to be written.
+    size_t m_buffer_offset = 0;
+    size_t m_buffer_size = 0;
+
+    static inline constexpr size_t k_buffer_alignment = 4096;
 
 };
 
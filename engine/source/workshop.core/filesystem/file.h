@@ -87,6 +87,25 @@ int get_option_int(const char* name, int default_value);
 // ================================================================================================
 std::filesystem::path get_local_appdata_directory();
 
+// ================================================================================================
+//  Identifies the state of a file on disk. If any of these change the contents of the file
+//  should be assumed to have changed.
+// ================================================================================================
+struct file_identity
+{
+    // Inode or file index, identifies the file on its volume.
+    uint64_t inode = 0;
+    uint64_t modified_time = 0;
+    uint64_t size = 0;
+
+    auto operator<=>(const file_identity& other) const = default;
+};
+
+// ================================================================================================
+//  Gets the identity of a file on disk. Returns false if the file could not be found.
+// ================================================================================================
+bool get_file_identity(const std::filesystem::path& path, file_identity& identity);
+
 // ================================================================================================
 //  Gets the drive letter from the given path. If path is relative or not
 //  drive rooted then null is returned.
@@ -0,0 +1,46 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <span>
+
+namespace ws {
+
+// ================================================================================================
+//  A read-only file mapped into memory.
+//
+//  The mapping is copy-on-write, so the data can be handed to apis that take mutable
+//  spans without affecting the file on disk.
+// ================================================================================================
+class mapped_file
+{
+public:
+    ~mapped_file();
+
+    // Maps the entire file at the given path. Returns nullptr if the file could not be
+    // opened or mapped (empty files can't be mapped).
+    //
+    // sequential hints that the file will be read front to back, otherwise random access
+    // is assumed.
+    static std::shared_ptr<mapped_file> open(const std::filesystem::path& path, bool sequential = true);
+
+    // Gets the mapped contents of the file.
+    std::span<uint8_t> data();
+
+private:
+    mapped_file() = default;
+
+private:
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+
+    // Platform specific handle to the mapping.
+    void* m_handle = nullptr;
+
+};
+
+}; // namespace workshop
@@ -0,0 +1,113 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.core/filesystem/mmap_stream.h"
+
+#include <cstring>
+
+namespace ws {
+
+result<void> mmap_stream::open(const std::filesystem::path& path)
+{
+    db_assert(m_file == nullptr);
+
+    m_path = path;
+
+    m_file = mapped_file::open(path);
+    if (m_file == nullptr)
+    {
+        return false;
+    }
+
+    m_data = m_file->data();
+    m_position = 0;
+
+    return true;
+}
+
+void mmap_stream::close()
+{
+    db_assert(m_file != nullptr);
+
+    // Any views handed out keep their own reference to the mapping.
+    m_file = nullptr;
+    m_data = {};
+}
+
+void mmap_stream::flush()
+{
+}
+
+bool mmap_stream::can_write()
+{
+    return false;
+}
+
+size_t mmap_stream::position()
+{
+    return m_position;
+}
+
+size_t mmap_stream::length()
+{
+    return m_data.size();
+}
+
+void mmap_stream::seek(size_t position)
+{
+    m_position = std::min(position, m_data.size());
+}
+
+size_t mmap_stream::write(const char* data, size_t size)
+{
+    db_assert_message(false, "Attempted to write to read-only memory mapped stream.");
+    return 0;
+}
+
+size_t mmap_stream::read(char* data, size_t size)
+{
+    db_assert(m_file != nullptr);
+
+    if (size > remaining())
+    {
+        return 0;
+    }
+
+    memcpy(data, m_data.data() + m_position, size);
+    m_position += size;
+
+    return size;
+}
+
+std::span<uint8_t> mmap_stream::read_view(size_t size)
+{
+    db_assert(m_file != nullptr);
+
+    if (size > remaining())
+    {
+        return {};
+    }
+
+    std::span<uint8_t> result = m_data.subspan(m_position, size);
+    m_position += size;
+
+    return result;
+}
+
+std::shared_ptr<void> mmap_stream::get_view_owner()
+{
+    return m_file;
+}
+
+std::string mmap_stream::get_async_path()
+{
+    return m_path.string().c_str();
+}
+
+size_t mmap_stream::get_async_offset()
+{
+    return position();
+}
+
+}; // namespace workshop
@@ -0,0 +1,51 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/filesystem/stream.h"
+#include "workshop.core/filesystem/mapped_file.h"
+#include "workshop.core/utils/result.h"
+
+#include <filesystem>
+
+namespace ws {
+
+// ================================================================================================
+//  A read-only stream that reads from a file mapped into memory.
+//
+//  Reads are simple copies out of the mapping, and read_view can be used to reference
+//  data in the mapping without copying it at all.
+// ================================================================================================
+class mmap_stream : public stream
+{
+public:
+
+    result<void> open(const std::filesystem::path& path);
+
+    virtual void close() override;
+    virtual void flush() override;
+    virtual bool can_write() override;
+    virtual size_t position() override;
+    virtual size_t length() override;
+    virtual void seek(size_t position) override;
+    virtual size_t write(const char* data, size_t size) override;
+    virtual size_t read(char* data, size_t size) override;
+    virtual std::span<uint8_t> read_view(size_t size) override;
+    virtual std::shared_ptr<void> get_view_owner() override;
+
+    virtual std::string get_async_path() override;
+    virtual size_t get_async_offset() override;
+
+private:
+    std::shared_ptr<mapped_file> m_file;
+    std::span<uint8_t> m_data;
+
+    std::filesystem::path m_path;
+
+    size_t m_position = 0;
+
+};
+
+}; // namespace workshop
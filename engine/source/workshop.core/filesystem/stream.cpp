@@ -45,6 +45,16 @@ bool stream::copy_to(stream& destination)
     return true;
 }
 
+std::span<uint8_t> stream::read_view(size_t size)
+{
+    return {};
+}
+
+std::shared_ptr<void> stream::get_view_owner()
+{
+    return nullptr;
+}
+
 size_t stream::remaining()
 {
     return length() - position();
@@ -8,6 +8,9 @@
 
 #include <string>
 #include <unordered_map>
+#include <memory>
+#include <span>
+#include <vector>
 
 namespace ws {
 
@@ -57,6 +60,15 @@ public:
     // at the current stream position.
     virtual size_t get_async_offset() = 0;
 
+    // Returns a view of the next size bytes in the stream without copying them and
+    // advances the position past them. Streams that are not backed by memory return an
+    // empty span and the data has to be read instead.
+    virtual std::span<uint8_t> read_view(size_t size);
+
+    // Gets an object that keeps the memory referenced by read_view alive after the
+    // stream is closed.
+    virtual std::shared_ptr<void> get_view_owner();
+
 public:
 
     // Helper functions
@@ -201,6 +213,40 @@ inline void stream_serialize_list_primitive(stream& out, std::vector<type>& list
     }
 }
 
+// Same as stream_serialize_list_primitive, but when reading from a memory backed stream the
+// list is left empty and view references the data directly, with owner keeping it alive.
+// Otherwise the data is read into the list and view references that. Views into the stream
+// are not guaranteed to be aligned to the type.
+template<typename type>
+inline void stream_serialize_list_view(stream& out, std::vector<type>& list, std::span<type>& view, std::shared_ptr<void>& owner)
+{
+    if (out.can_write())
+    {
+        stream_serialize_list_primitive(out, list);
+        view = list;
+        return;
+    }
+
+    size_t start_position = out.position();
+
+    uint32_t list_size = 0;
+    stream_serialize(out, list_size);
+
+    std::span<uint8_t> data = out.read_view(list_size * sizeof(type));
+    if (!data.empty() || list_size == 0)
+    {
+        list.clear();
+        view = std::span<type>(reinterpret_cast<type*>(data.data()), list_size);
+        owner = out.get_view_owner();
+        return;
+    }
+
+    out.seek(start_position);
+    stream_serialize_list_primitive(out, list);
+    view = list;
+    owner = nullptr;
+}
+
 template<> inline void stream_serialize_list(stream& out, std::vector<uint8_t>& value)  { stream_serialize_list_primitive(out, value); }
 template<> inline void stream_serialize_list(stream& out, std::vector<uint16_t>& value) { stream_serialize_list_primitive(out, value); }
 template<> inline void stream_serialize_list(stream& out, std::vector<uint32_t>& value) { stream_serialize_list_primitive(out, value); }
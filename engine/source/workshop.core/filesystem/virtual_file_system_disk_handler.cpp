@@ -5,6 +5,8 @@
 #include "workshop.core/filesystem/virtual_file_system_disk_handler.h"
 #include "workshop.core/filesystem/virtual_file_system.h"
 #include "workshop.core/filesystem/disk_stream.h"
+#include "workshop.core/filesystem/mmap_stream.h"
+#include "workshop.core/containers/string.h"
 #include "workshop.core/filesystem/path_watcher.h"
 
 #include <algorithm>
@@ -61,6 +63,17 @@ std::unique_ptr<stream> virtual_file_system_disk_handler::open(const char* path,
     {
         if (std::filesystem::is_regular_file(fspath))
         {
+            // Compiled assets are mapped into memory so their payloads can be referenced
+            // in place rather than copied out of the file.
+            if (string_ends_with(fspath.string(), ".compiled"))
+            {
+                std::unique_ptr<mmap_stream> stream = std::make_unique<mmap_stream>();
+                if (stream->open(fspath))
+                {
+                    return stream;
+                }
+            }
+
             std::unique_ptr<disk_stream> stream = std::make_unique<disk_stream>();
             if (stream->open(fspath, for_writing))
             {
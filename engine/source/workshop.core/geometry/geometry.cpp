@@ -185,7 +185,7 @@ size_t geometry::get_vertex_count()
     }
 
     geometry_vertex_stream& stream = m_streams[0];
-    return stream.data.size() / stream.element_size;
+    return stream.get_data().size() / stream.element_size;
 }
 
 std::vector<geometry_vertex_stream>& geometry::get_vertex_streams()
@@ -213,6 +213,8 @@ void geometry::clear_vertex_stream_data(geometry_vertex_stream_type type)
         {
             stream.data.clear();
             stream.data.shrink_to_fit();
+            stream.data_view = {};
+            stream.data_view_owner = nullptr;
         }
     }
 }
@@ -14,6 +14,7 @@
 #include "workshop.core/math/matrix4.h"
 #include "workshop.core/math/aabb.h"
 
+#include <memory>
 #include <vector>
 #include <span>
 
@@ -128,6 +129,17 @@ struct geometry_vertex_stream
 
 	// Buffer containing the vertex stream data, reinterpret this to the expected type.
 	std::vector<uint8_t> data;
+
+    // If the stream data is held in an external buffer, such as the compiled model it was loaded
+    // from, this points to it and data is left empty. data_view_owner keeps the buffer alive.
+    std::span<uint8_t> data_view;
+    std::shared_ptr<void> data_view_owner;
+
+    // Gets the stream data from whichever of data or data_view holds it.
+    std::span<uint8_t> get_data()
+    {
+        return data_view_owner ? data_view : std::span<uint8_t>(data);
+    }
 };
 
 // Represents an individual texture held in a geometry instance.
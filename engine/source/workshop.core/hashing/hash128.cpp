@@ -0,0 +1,109 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.core/hashing/hash128.h"
+
+#include <cstring>
+
+namespace ws {
+
+namespace {
+
+inline uint64_t rotl64(uint64_t x, int8_t r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+inline uint64_t read_block(const uint8_t* data)
+{
+    // Input isn't guaranteed to be aligned.
+    uint64_t result;
+    memcpy(&result, data, sizeof(result));
+    return result;
+}
+
+}; // namespace
+
+hash128 hash128::calculate(std::span<const uint8_t> data, uint64_t seed)
+{
+    const uint8_t* bytes = data.data();
+    const size_t length = data.size();
+    const size_t block_count = length / 16;
+
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+
+    const uint64_t c1 = 0x87c37b91114253d5ull;
+    const uint64_t c2 = 0x4cf5ad432745937full;
+
+    for (size_t i = 0; i < block_count; i++)
+    {
+        uint64_t k1 = read_block(bytes + (i * 16));
+        uint64_t k2 = read_block(bytes + (i * 16) + 8);
+
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+
+        h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+
+        h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const uint8_t* tail = bytes + (block_count * 16);
+
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+
+    switch (length & 15)
+    {
+    case 15: k2 ^= static_cast<uint64_t>(tail[14]) << 48; [[fallthrough]];
+    case 14: k2 ^= static_cast<uint64_t>(tail[13]) << 40; [[fallthrough]];
+    case 13: k2 ^= static_cast<uint64_t>(tail[12]) << 32; [[fallthrough]];
+    case 12: k2 ^= static_cast<uint64_t>(tail[11]) << 24; [[fallthrough]];
+    case 11: k2 ^= static_cast<uint64_t>(tail[10]) << 16; [[fallthrough]];
+    case 10: k2 ^= static_cast<uint64_t>(tail[9]) << 8;   [[fallthrough]];
+    case  9: k2 ^= static_cast<uint64_t>(tail[8]) << 0;
+             k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+             [[fallthrough]];
+    case  8: k1 ^= static_cast<uint64_t>(tail[7]) << 56; [[fallthrough]];
+    case  7: k1 ^= static_cast<uint64_t>(tail[6]) << 48; [[fallthrough]];
+    case  6: k1 ^= static_cast<uint64_t>(tail[5]) << 40; [[fallthrough]];
+    case  5: k1 ^= static_cast<uint64_t>(tail[4]) << 32; [[fallthrough]];
+    case  4: k1 ^= static_cast<uint64_t>(tail[3]) << 24; [[fallthrough]];
+    case  3: k1 ^= static_cast<uint64_t>(tail[2]) << 16; [[fallthrough]];
+    case  2: k1 ^= static_cast<uint64_t>(tail[1]) << 8;  [[fallthrough]];
+    case  1: k1 ^= static_cast<uint64_t>(tail[0]) << 0;
+             k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    };
+
+    h1 ^= static_cast<uint64_t>(length);
+    h2 ^= static_cast<uint64_t>(length);
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    hash128 result;
+    result.low = h1;
+    result.high = h2;
+    return result;
+}
+
+}; // namespace workshop
@@ -0,0 +1,46 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/containers/string.h"
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace ws {
+
+// ================================================================================================
+//  A 128 bit non-cryptographic hash of a block of data (MurmurHash3 x64 128).
+//
+//  Hashes are stable across machines and runs, so are suitable for identifying content.
+// ================================================================================================
+struct hash128
+{
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    auto operator<=>(const hash128& other) const = default;
+
+    // Calculates the hash of the given data.
+    static hash128 calculate(std::span<const uint8_t> data, uint64_t seed = 0);
+};
+
+template <>
+inline std::string to_string(const hash128& input)
+{
+    return string_format("%016llx%016llx", static_cast<unsigned long long>(input.high), static_cast<unsigned long long>(input.low));
+}
+
+}; // namespace workshop
+
+template<>
+struct std::hash<ws::hash128>
+{
+    std::size_t operator()(const ws::hash128& k) const
+    {
+        return static_cast<size_t>(k.low ^ k.high);
+    }
+};
@@ -27,21 +27,23 @@ public:
         }
 
         data_type value_sum = {};
-        data_type elapsed_sum = {};
-
-        data_type min_time = std::numeric_limits<data_type>::max();
-        data_type max_time = std::numeric_limits<data_type>::min();
+        data_type start_time = std::numeric_limits<data_type>::max();
 
         for (sample& sample : m_samples)
         {
             value_sum += sample.value;
-            elapsed_sum += sample.elapsed_time;
 
-            min_time = std::min(sample.time, min_time);
-            max_time = std::max(sample.time, max_time);
+            // Samples cover the time the work was in progress, not just when it was added.
+            start_time = std::min(sample.time - sample.elapsed_time, start_time);
         }
 
-        data_type elapsed_time = max_time - min_time;
+        // Rate is measured over the time since the oldest sample started, up to the window size,
+        // so overlapping samples don't inflate the result and a single sample doesn't divide by zero.
+        data_type elapsed_time = std::min((data_type)get_seconds() - start_time, window);
+        if (elapsed_time <= data_type{})
+        {
+            return {};
+        }
 
         return value_sum / elapsed_time;
     }
@@ -27,4 +27,10 @@ size_t get_page_size();
 // Installs memory allocation hooks to force all allocations to go through the memory tracker.
 extern void install_memory_hooks();
 
+#ifdef WS_LINUX
+// Gets the usable size of a block returned by malloc, including the tag the memory hooks place
+// at the end of it. The hooked malloc_usable_size excludes the tag so callers can't overwrite it.
+size_t get_raw_usable_size(void* ptr);
+#endif
+
 }; // namespace ws::math
\ No newline at end of file
@@ -0,0 +1,224 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.core/memory/memory_budgets.h"
+#include "workshop.core/cvar/core_cvars.h"
+#include "workshop.core/containers/string.h"
+#include "workshop.core/statistics/statistics_manager.h"
+#include "workshop.core/debug/debug.h"
+
+namespace ws {
+
+bool memory_budgets::budget_state::contains(memory_type type) const
+{
+    std::string type_path = memory_type_names[static_cast<int>(type)];
+    if (!string_starts_with(type_path, path))
+    {
+        return false;
+    }
+
+    // Make sure we are matching whole path components, "asset" shouldn't match "assets/...".
+    return type_path.size() == path.size() || type_path[path.size()] == '/';
+}
+
+size_t memory_budgets::get_release_threshold(size_t limit)
+{
+    return static_cast<size_t>(limit * k_pressure_release_fraction);
+}
+
+memory_budgets::memory_budgets()
+{
+    set_budgets(cvar_memory_budgets.get_string());
+
+    m_cvar_changed_delegate = cvar_memory_budgets.on_changed.add_shared([this](cvar_base::value_storage_t old_value) {
+        set_budgets(cvar_memory_budgets.get_string());
+    });
+}
+
+memory_budgets::~memory_budgets()
+{
+    m_cvar_changed_delegate = nullptr;
+}
+
+void memory_budgets::set_budgets(const char* config)
+{
+    std::vector<budget> new_budgets;
+
+    std::vector<std::string> entries = string_split(config, ",");
+    for (std::string& entry : entries)
+    {
+        std::string trimmed = string_trim(entry, " \t");
+        if (trimmed.empty())
+        {
+            continue;
+        }
+
+        std::vector<std::string> fragments = string_split(trimmed, "=");
+        std::vector<std::string> limits;
+        if (fragments.size() == 2)
+        {
+            limits = string_split(fragments[1], ":");
+        }
+
+        if (limits.size() != 2)
+        {
+            db_warning(core, "Memory budget '%s' is malformed, expected format is path=soft:hard.", trimmed.c_str());
+            continue;
+        }
+
+        result<uint64_t> soft_limit = from_string<uint64_t>(string_trim(limits[0], " \t"));
+        result<uint64_t> hard_limit = from_string<uint64_t>(string_trim(limits[1], " \t"));
+        if (!soft_limit || !hard_limit)
+        {
+            db_warning(core, "Memory budget '%s' has invalid limits, expected values in megabytes.", trimmed.c_str());
+            continue;
+        }
+
+        budget& new_budget = new_budgets.emplace_back();
+        new_budget.state.path = string_trim(fragments[0], " \t");
+        new_budget.state.soft_limit = static_cast<size_t>(soft_limit.get()) * 1024 * 1024;
+        new_budget.state.hard_limit = static_cast<size_t>(std::max(soft_limit.get(), hard_limit.get())) * 1024 * 1024;
+
+        for (size_t i = 0; i < static_cast<size_t>(memory_type::COUNT); i++)
+        {
+            if (new_budget.state.contains(static_cast<memory_type>(i)))
+            {
+                new_budget.types.push_back(static_cast<memory_type>(i));
+            }
+        }
+
+        if (new_budget.types.empty())
+        {
+            db_warning(core, "Memory budget '%s' does not match any memory types.", new_budget.state.path.c_str());
+        }
+
+        if (statistics_manager* stats = statistics_manager::try_get())
+        {
+            new_budget.stats_used_bytes = stats->find_or_create_channel(string_format("memory budget/%s/used", new_budget.state.path.c_str()).c_str());
+            new_budget.stats_overrun_bytes = stats->find_or_create_channel(string_format("memory budget/%s/overrun", new_budget.state.path.c_str()).c_str());
+        }
+    }
+
+    std::scoped_lock lock(m_mutex);
+    m_budgets = std::move(new_budgets);
+}
+
+void memory_budgets::update()
+{
+    memory_tracker* tracker = memory_tracker::try_get();
+    if (tracker == nullptr)
+    {
+        return;
+    }
+
+    std::vector<budget_state> pressured;
+
+    {
+        std::scoped_lock lock(m_mutex);
+
+        for (budget& entry : m_budgets)
+        {
+            budget_state& state = entry.state;
+
+            size_t used_bytes = 0;
+            for (memory_type type : entry.types)
+            {
+                used_bytes += tracker->get_memory_used_bytes(type);
+            }
+
+            memory_pressure old_pressure = state.pressure;
+
+            state.used_bytes = used_bytes;
+            state.peak_bytes = std::max(state.peak_bytes, used_bytes);
+
+            memory_pressure pressure = memory_pressure::none;
+            if (used_bytes > state.hard_limit)
+            {
+                pressure = memory_pressure::hard;
+            }
+            else if (used_bytes > state.soft_limit)
+            {
+                pressure = memory_pressure::soft;
+            }
+
+            // Only leave a pressure level once usage has dropped comfortably below its limit, otherwise
+            // anything that frees memory in response (eg. dropping texture mips) will immediately
+            // reload it, trip the limit again and thrash between the two levels.
+            if (old_pressure == memory_pressure::hard && pressure < memory_pressure::hard && used_bytes > get_release_threshold(state.hard_limit))
+            {
+                pressure = memory_pressure::hard;
+            }
+            if (old_pressure >= memory_pressure::soft && pressure < memory_pressure::soft && used_bytes > get_release_threshold(state.soft_limit))
+            {
+                pressure = memory_pressure::soft;
+            }
+
+            state.pressure = pressure;
+
+            if (state.pressure != old_pressure)
+            {
+                db_log(core, "Memory budget '%s' pressure changed from %s to %s (%.2f MB used, soft limit %.2f MB, hard limit %.2f MB).",
+                    state.path.c_str(),
+                    memory_pressure_strings[static_cast<int>(old_pressure)],
+                    memory_pressure_strings[static_cast<int>(state.pressure)],
+                    used_bytes / (1024.0f * 1024.0f),
+                    state.soft_limit / (1024.0f * 1024.0f),
+                    state.hard_limit / (1024.0f * 1024.0f));
+            }
+
+            if (entry.stats_used_bytes)
+            {
+                entry.stats_used_bytes->submit(used_bytes);
+            }
+            if (entry.stats_overrun_bytes)
+            {
+                entry.stats_overrun_bytes->submit(used_bytes > state.soft_limit ? used_bytes - state.soft_limit : 0);
+            }
+
+            if (state.pressure != memory_pressure::none || old_pressure != memory_pressure::none)
+            {
+                pressured.push_back(state);
+            }
+        }
+    }
+
+    // Broadcast outside the lock so listeners are free to query the budgets.
+    for (budget_state& state : pressured)
+    {
+        on_pressure.broadcast(state);
+    }
+}
+
+std::vector<memory_budgets::budget_state> memory_budgets::get_budgets()
+{
+    std::scoped_lock lock(m_mutex);
+
+    std::vector<budget_state> result;
+    result.reserve(m_budgets.size());
+
+    for (budget& entry : m_budgets)
+    {
+        result.push_back(entry.state);
+    }
+
+    return result;
+}
+
+memory_pressure memory_budgets::get_pressure(memory_type type)
+{
+    std::scoped_lock lock(m_mutex);
+
+    memory_pressure result = memory_pressure::none;
+    for (budget& entry : m_budgets)
+    {
+        if (std::find(entry.types.begin(), entry.types.end(), type) != entry.types.end())
+        {
+            result = std::max(result, entry.state.pressure);
+        }
+    }
+
+    return result;
+}
+
+}; // namespace ws
@@ -0,0 +1,118 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/utils/singleton.h"
+#include "workshop.core/utils/event.h"
+#include "workshop.core/memory/memory_tracker.h"
+#include "workshop.core/cvar/cvar.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ws {
+
+class statistics_channel;
+
+// How close a budget is to being exhausted.
+enum class memory_pressure
+{
+    // Under the soft limit.
+    none,
+
+    // Over the soft limit, systems should release anything they can easily rebuild.
+    soft,
+
+    // Over the hard limit, systems should release everything they can.
+    hard,
+
+    COUNT
+};
+
+inline static const char* memory_pressure_strings[static_cast<int>(memory_pressure::COUNT)] = {
+    "none",
+    "soft",
+    "hard"
+};
+
+// ================================================================================================
+//  Applies soft and hard limits to the memory used by groups of memory_type's.
+//
+//  Budgets are configured through the memory_budgets cvar as a comma seperated list of
+//  "path=soft:hard" entries, with limits in megabytes. The path is matched against the start
+//  of each memory_type's path, so "rendering/vram" covers every vram type.
+//
+//  Each update the usage of every budget is compared with its limits and subsystems are told
+//  through on_pressure so they can free memory they don't strictly need. A budget only drops out
+//  of a pressure level once usage falls below k_pressure_release_fraction of that level's limit.
+// ================================================================================================
+class memory_budgets
+    : public singleton<memory_budgets>
+{
+public:
+
+    struct budget_state
+    {
+        std::string path;
+
+        size_t soft_limit = 0;
+        size_t hard_limit = 0;
+
+        size_t used_bytes = 0;
+        size_t peak_bytes = 0;
+
+        memory_pressure pressure = memory_pressure::none;
+
+        // Returns true if the given memory type counts towards this budget.
+        bool contains(memory_type type) const;
+    };
+
+    memory_budgets();
+    virtual ~memory_budgets();
+
+    // Replaces all budgets with those described by the given configuration string.
+    void set_budgets(const char* config);
+
+    // Recalculates the usage of each budget and raises on_pressure for those over their limits.
+    // Expected to be called once per frame.
+    void update();
+
+    // Gets the current state of all budgets.
+    std::vector<budget_state> get_budgets();
+
+    // Gets the highest pressure of any budget the memory type counts towards.
+    memory_pressure get_pressure(memory_type type);
+
+    // Called every update for each budget over its soft limit, and once more when it drops back under it.
+    event<const budget_state&> on_pressure;
+
+private:
+
+    // Fraction of a limit that usage must fall below before a budget leaves that pressure level.
+    static inline constexpr float k_pressure_release_fraction = 0.9f;
+
+    static size_t get_release_threshold(size_t limit);
+
+    struct budget
+    {
+        budget_state state;
+
+        std::vector<memory_type> types;
+
+        statistics_channel* stats_used_bytes = nullptr;
+        statistics_channel* stats_overrun_bytes = nullptr;
+    };
+
+private:
+
+    std::mutex m_mutex;
+    std::vector<budget> m_budgets;
+
+    event<cvar_base::value_storage_t>::delegate_ptr m_cvar_changed_delegate;
+
+};
+
+}; // namespace ws
@@ -0,0 +1,386 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.core/memory/memory_profiler.h"
+#include "workshop.core/memory/memory_tracker.h"
+#include "workshop.core/hashing/hash.h"
+#include "workshop.core/containers/string.h"
+#include "workshop.core/utils/time.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ws {
+namespace {
+
+// Set while a thread is inside the profiler. Anything the profiler allocates itself goes back
+// through the hooks, this stops those allocations being sampled and re-entering the lock.
+thread_local bool t_in_profiler = false;
+
+// Number of bytes left to allocate before this thread takes its next sample.
+thread_local int64_t t_bytes_until_sample = 0;
+thread_local bool t_sampler_initialized = false;
+
+// Per-thread random state for picking sample distances, avoids sharing a generator between threads.
+thread_local uint64_t t_random_state = 0;
+
+// Number of frames between the hooked allocation function and the profiler that aren't worth keeping.
+constexpr size_t k_skipped_frames = 2;
+
+struct profiler_scope
+{
+	profiler_scope()
+		: m_memory_scope(memory_type::memory_tracking__profiler, memory_scope::k_ignore_asset)
+		, m_was_in_profiler(t_in_profiler)
+	{
+		t_in_profiler = true;
+	}
+
+	~profiler_scope()
+	{
+		t_in_profiler = m_was_in_profiler;
+	}
+
+	memory_scope m_memory_scope;
+	bool m_was_in_profiler;
+};
+
+};
+
+memory_profiler::memory_profiler(size_t sample_interval)
+	: m_sample_interval(sample_interval)
+{
+	profiler_scope scope;
+
+	// Capturing a callstack the first time can load libraries and allocate, so get that out of the
+	// way now rather than doing it inside an allocation.
+	std::array<void*, k_max_frames> frames;
+	db_capture_raw_callstack(frames.data(), frames.size());
+}
+
+memory_profiler::~memory_profiler()
+{
+}
+
+void memory_profiler::set_sample_interval(size_t interval)
+{
+	m_sample_interval = interval;
+}
+
+size_t memory_profiler::get_sample_interval()
+{
+	return m_sample_interval;
+}
+
+int64_t memory_profiler::get_next_sample_distance()
+{
+	if (t_random_state == 0)
+	{
+		t_random_state = reinterpret_cast<uint64_t>(&t_random_state) | 1;
+	}
+
+	// xorshift64, quality isn't important we just need to avoid aliasing with allocation patterns.
+	t_random_state ^= t_random_state << 13;
+	t_random_state ^= t_random_state >> 7;
+	t_random_state ^= t_random_state << 17;
+
+	// Exponentially distributed so every byte allocated has the same chance of being sampled.
+	double uniform = static_cast<double>((t_random_state >> 11) + 1) / static_cast<double>(1ull << 53);
+	double distance = -std::log(uniform) * static_cast<double>(m_sample_interval.load(std::memory_order_relaxed));
+
+	return static_cast<int64_t>(distance) + 1;
+}
+
+bool memory_profiler::record_alloc(void* ptr, size_t size)
+{
+	if (t_in_profiler || size == 0)
+	{
+		return false;
+	}
+
+	size_t interval = m_sample_interval.load(std::memory_order_relaxed);
+	if (interval == 0)
+	{
+		return false;
+	}
+
+	if (!t_sampler_initialized)
+	{
+		t_bytes_until_sample = get_next_sample_distance();
+		t_sampler_initialized = true;
+	}
+
+	t_bytes_until_sample -= static_cast<int64_t>(size);
+	if (t_bytes_until_sample > 0)
+	{
+		return false;
+	}
+
+	t_bytes_until_sample = get_next_sample_distance();
+
+	profiler_scope scope;
+
+	stack_record record;
+	record.frame_count = db_capture_raw_callstack(record.frames.data(), record.frames.size(), k_skipped_frames);
+
+	size_t id = 0;
+	for (size_t i = 0; i < record.frame_count; i++)
+	{
+		hash_combine(id, record.frames[i]);
+	}
+
+	// Weight the sample by the inverse of the chance an allocation of this size had of being sampled.
+	double probability = 1.0 - std::exp(-static_cast<double>(size) / static_cast<double>(interval));
+	size_t estimated_bytes = static_cast<size_t>(static_cast<double>(size) / probability);
+	size_t estimated_count = std::max<size_t>(1, static_cast<size_t>(1.0 / probability + 0.5));
+
+	std::scoped_lock lock(m_mutex);
+
+	// Hash collisions just merge two callstacks together, rare enough not to be worth handling.
+	auto [iter, inserted] = m_stacks.try_emplace(id, record);
+	stack_stats& stats = iter->second.stats;
+	stats.id = id;
+	stats.live_bytes += estimated_bytes;
+	stats.live_count += estimated_count;
+	stats.total_bytes += estimated_bytes;
+	stats.total_count += estimated_count;
+
+	m_live_allocations[ptr] = { id, estimated_bytes, estimated_count };
+
+	return true;
+}
+
+void memory_profiler::record_free(void* ptr)
+{
+	profiler_scope scope;
+
+	std::scoped_lock lock(m_mutex);
+
+	auto iter = m_live_allocations.find(ptr);
+	if (iter == m_live_allocations.end())
+	{
+		return;
+	}
+
+	stack_stats& stats = m_stacks[iter->second.id].stats;
+	stats.live_bytes -= iter->second.bytes;
+	stats.live_count -= iter->second.count;
+
+	m_live_allocations.erase(iter);
+}
+
+memory_profiler::snapshot memory_profiler::capture_snapshot(const char* name)
+{
+	profiler_scope scope;
+
+	snapshot result;
+	result.name = name;
+	result.time = get_seconds();
+
+	{
+		std::scoped_lock lock(m_mutex);
+
+		result.stacks.reserve(m_stacks.size());
+		for (auto& [id, record] : m_stacks)
+		{
+			result.stacks.push_back(record.stats);
+		}
+	}
+
+	std::sort(result.stacks.begin(), result.stacks.end(), [](const stack_stats& a, const stack_stats& b) {
+		return a.id < b.id;
+	});
+
+	return result;
+}
+
+void memory_profiler::take_snapshot(const char* name)
+{
+	snapshot snap = capture_snapshot(name);
+
+	db_log(core, "Taken memory snapshot: %s", name);
+
+	profiler_scope scope;
+	std::scoped_lock lock(m_mutex);
+
+	if (m_snapshots.size() >= k_max_snapshots)
+	{
+		m_snapshots.erase(m_snapshots.begin());
+	}
+	m_snapshots.push_back(std::move(snap));
+}
+
+std::vector<memory_profiler::snapshot> memory_profiler::get_snapshots()
+{
+	profiler_scope scope;
+	std::scoped_lock lock(m_mutex);
+
+	return m_snapshots;
+}
+
+void memory_profiler::clear_snapshots()
+{
+	profiler_scope scope;
+	std::scoped_lock lock(m_mutex);
+
+	m_snapshots.clear();
+}
+
+std::vector<memory_profiler::stack_diff> memory_profiler::diff_snapshots(const snapshot& from, const snapshot& to)
+{
+	std::vector<stack_diff> result;
+
+	auto add_diff = [&result](stack_id id, const stack_stats* from_stats, const stack_stats* to_stats) {
+		static const stack_stats empty = {};
+		if (from_stats == nullptr)
+		{
+			from_stats = &empty;
+		}
+		if (to_stats == nullptr)
+		{
+			to_stats = &empty;
+		}
+
+		stack_diff diff;
+		diff.id = id;
+		diff.from_live_bytes = from_stats->live_bytes;
+		diff.to_live_bytes = to_stats->live_bytes;
+		diff.live_bytes_delta = static_cast<int64_t>(to_stats->live_bytes) - static_cast<int64_t>(from_stats->live_bytes);
+		diff.live_count_delta = static_cast<int64_t>(to_stats->live_count) - static_cast<int64_t>(from_stats->live_count);
+		diff.allocated_bytes = to_stats->total_bytes - std::min(to_stats->total_bytes, from_stats->total_bytes);
+		diff.allocated_count = to_stats->total_count - std::min(to_stats->total_count, from_stats->total_count);
+
+		if (diff.live_bytes_delta != 0 || diff.allocated_bytes != 0)
+		{
+			result.push_back(diff);
+		}
+	};
+
+	// Both snapshots are sorted by id so we can walk them together.
+	size_t from_index = 0;
+	size_t to_index = 0;
+	while (from_index < from.stacks.size() || to_index < to.stacks.size())
+	{
+		const stack_stats* from_stats = from_index < from.stacks.size() ? &from.stacks[from_index] : nullptr;
+		const stack_stats* to_stats = to_index < to.stacks.size() ? &to.stacks[to_index] : nullptr;
+
+		if (to_stats == nullptr || (from_stats != nullptr && from_stats->id < to_stats->id))
+		{
+			add_diff(from_stats->id, from_stats, nullptr);
+			from_index++;
+		}
+		else if (from_stats == nullptr || to_stats->id < from_stats->id)
+		{
+			add_diff(to_stats->id, nullptr, to_stats);
+			to_index++;
+		}
+		else
+		{
+			add_diff(to_stats->id, from_stats, to_stats);
+			from_index++;
+			to_index++;
+		}
+	}
+
+	std::sort(result.begin(), result.end(), [](const stack_diff& a, const stack_diff& b) {
+		return a.live_bytes_delta > b.live_bytes_delta;
+	});
+
+	return result;
+}
+
+std::unique_ptr<db_callstack> memory_profiler::resolve_stack(stack_id id)
+{
+	std::array<void*, k_max_frames> frames;
+	size_t frame_count = 0;
+
+	{
+		profiler_scope scope;
+		std::scoped_lock lock(m_mutex);
+
+		auto iter = m_stacks.find(id);
+		if (iter != m_stacks.end())
+		{
+			frames = iter->second.frames;
+			frame_count = iter->second.frame_count;
+		}
+	}
+
+	return db_resolve_callstack(frames.data(), frame_count);
+}
+
+std::string memory_profiler::get_collapsed_frames(stack_id id, std::unordered_map<stack_id, std::string>& cache)
+{
+	if (auto iter = cache.find(id); iter != cache.end())
+	{
+		return iter->second;
+	}
+
+	std::unique_ptr<db_callstack> callstack = resolve_stack(id);
+
+	std::string result;
+	for (auto iter = callstack->frames.rbegin(); iter != callstack->frames.rend(); iter++)
+	{
+		std::string frame;
+		if (!iter->function.empty())
+		{
+			frame = iter->function;
+		}
+		else
+		{
+			frame = string_format("%s+0x%zx", iter->module.empty() ? "unknown" : iter->module.c_str(), iter->address);
+		}
+
+		// Semicolons and spaces are delimiters in the format, templated function names can contain both.
+		std::replace(frame.begin(), frame.end(), ' ', '_');
+		std::replace(frame.begin(), frame.end(), ';', '_');
+
+		if (!result.empty())
+		{
+			result += ";";
+		}
+		result += frame;
+	}
+
+	if (result.empty())
+	{
+		result = "unknown";
+	}
+
+	cache[id] = result;
+	return result;
+}
+
+std::string memory_profiler::export_collapsed(const snapshot& snap)
+{
+	std::unordered_map<stack_id, std::string> cache;
+	std::string result;
+
+	for (const stack_stats& stats : snap.stacks)
+	{
+		if (stats.live_bytes == 0)
+		{
+			continue;
+		}
+
+		result += string_format("%s %zu\n", get_collapsed_frames(stats.id, cache).c_str(), stats.live_bytes);
+	}
+
+	return result;
+}
+
+std::string memory_profiler::export_collapsed(const std::vector<stack_diff>& diff)
+{
+	std::unordered_map<stack_id, std::string> cache;
+	std::string result;
+
+	for (const stack_diff& entry : diff)
+	{
+		result += string_format("%s %zu %zu\n", get_collapsed_frames(entry.id, cache).c_str(), entry.from_live_bytes, entry.to_live_bytes);
+	}
+
+	return result;
+}
+
+}; // namespace ws
@@ -0,0 +1,163 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/utils/singleton.h"
+#include "workshop.core/debug/debug.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ws {
+
+// ================================================================================================
+//  Sampling allocation profiler that sits on top of the memory hooks.
+//
+//  Rather than tracking every allocation, a callstack is captured on average once for every
+//  sample interval of bytes allocated. Each sample is weighted by the inverse of the chance it
+//  had of being picked, so the totals aggregated per callstack are an unbiased estimate of the
+//  real allocations made from it, while allocations that aren't sampled only cost a thread-local
+//  counter decrement.
+//
+//  Snapshots of the aggregated state can be taken at any point and diffed against each other
+//  to see what changed between them, eg. before and after loading a world.
+// ================================================================================================
+class memory_profiler
+	: public singleton<memory_profiler>
+{
+public:
+
+	// Maximum number of frames captured for each sampled allocation.
+	static constexpr size_t k_max_frames = 32;
+
+	// Average number of bytes allocated between each sample.
+	static constexpr size_t k_default_sample_interval = 256 * 1024;
+
+	// Maximum number of snapshots kept before the oldest are discarded.
+	static constexpr size_t k_max_snapshots = 16;
+
+	using stack_id = size_t;
+
+	// Estimated allocation statistics for a single callstack.
+	struct stack_stats
+	{
+		stack_id id;
+
+		// Allocations that are still alive.
+		size_t live_bytes = 0;
+		size_t live_count = 0;
+
+		// All allocations ever made, including those that have been freed.
+		size_t total_bytes = 0;
+		size_t total_count = 0;
+	};
+
+	// State of every sampled callstack at a given point in time.
+	struct snapshot
+	{
+		std::string name;
+		double time = 0.0;
+
+		// Sorted by id.
+		std::vector<stack_stats> stacks;
+	};
+
+	// Change in a callstacks statistics between two snapshots.
+	struct stack_diff
+	{
+		stack_id id;
+
+		size_t from_live_bytes = 0;
+		size_t to_live_bytes = 0;
+		int64_t live_bytes_delta = 0;
+		int64_t live_count_delta = 0;
+
+		// Bytes allocated between the two snapshots, regardless of if they have since been freed.
+		size_t allocated_bytes = 0;
+		size_t allocated_count = 0;
+	};
+
+	memory_profiler(size_t sample_interval = k_default_sample_interval);
+	virtual ~memory_profiler();
+
+	// Sets the average number of bytes allocated between each sample. A value of 0 disables sampling.
+	void set_sample_interval(size_t interval);
+	size_t get_sample_interval();
+
+	// Decides if an allocation should be sampled and records it if so. If this returns true then
+	// record_free must be called when the allocation is freed.
+	// This shouldn't be called directly, its here for the memory tracker to invoke.
+	bool record_alloc(void* ptr, size_t size);
+
+	// Records the free of an allocation that record_alloc returned true for.
+	void record_free(void* ptr);
+
+	// Captures the current state and adds it to the list of snapshots.
+	void take_snapshot(const char* name);
+
+	// Gets all the snapshots that have been taken, oldest first.
+	std::vector<snapshot> get_snapshots();
+
+	// Removes all previously taken snapshots.
+	void clear_snapshots();
+
+	// Captures the current state without storing it in the snapshot list.
+	snapshot capture_snapshot(const char* name);
+
+	// Works out what changed for each callstack between two snapshots. Callstacks that have not
+	// changed are not included. Results are sorted by largest growth in live bytes first.
+	static std::vector<stack_diff> diff_snapshots(const snapshot& from, const snapshot& to);
+
+	// Resolves the symbols of the frames of the given callstack.
+	std::unique_ptr<db_callstack> resolve_stack(stack_id id);
+
+	// Exports the live bytes of each callstack in the collapsed-stack format (one "frame;frame;frame value"
+	// line per callstack, outermost frame first) that flamegraph.pl, speedscope and pprof can all import.
+	std::string export_collapsed(const snapshot& snap);
+
+	// Exports a diff in the differential collapsed-stack format ("frame;frame;frame before after")
+	// that flamegraph.pl can render directly.
+	std::string export_collapsed(const std::vector<stack_diff>& diff);
+
+private:
+
+	struct stack_record
+	{
+		std::array<void*, k_max_frames> frames;
+		size_t frame_count = 0;
+
+		stack_stats stats;
+	};
+
+	struct live_allocation
+	{
+		stack_id id;
+		size_t bytes;
+		size_t count;
+	};
+
+	// Gets the number of bytes that should be allocated before the calling thread takes its next sample.
+	int64_t get_next_sample_distance();
+
+	// Builds the ; seperated frame list for a callstack, outermost frame first.
+	std::string get_collapsed_frames(stack_id id, std::unordered_map<stack_id, std::string>& cache);
+
+private:
+
+	std::atomic_size_t m_sample_interval;
+
+	std::mutex m_mutex;
+	std::unordered_map<stack_id, stack_record> m_stacks;
+	std::unordered_map<void*, live_allocation> m_live_allocations;
+	std::vector<snapshot> m_snapshots;
+
+};
+
+}; // namespace ws
@@ -3,11 +3,12 @@
 //  Copyright (C) 2021 Tim Leonard
 // ================================================================================================
 #include "workshop.core/memory/memory_tracker.h"
+#include "workshop.core/memory/memory_profiler.h"
+#include "workshop.core/memory/memory.h"
 #include "workshop.core/debug/debug.h"
 
 #ifdef WS_LINUX
-#include <malloc.h>
-#define _msize malloc_usable_size
+#define _msize ws::get_raw_usable_size
 #endif
 
 namespace ws {
@@ -101,36 +102,269 @@ string_hash memory_scope::get_asset_id()
     return m_asset_id;
 }
 
+// Frees the calling threads counters when it exits.
+struct thread_state_releaser
+{
+	memory_tracker* tracker = nullptr;
+	memory_tracker::thread_state* state = nullptr;
+
+	~thread_state_releaser()
+	{
+		if (state != nullptr && memory_tracker::try_get() == tracker)
+		{
+			tracker->release_thread_state(state);
+		}
+	}
+};
+
+namespace {
+
+thread_local thread_state_releaser g_tls_thread_state_releaser;
+
+};
+
+memory_tracker::memory_tracker()
+{
+	m_threads = std::make_unique<thread_state[]>(k_max_threads);
+}
+
+memory_tracker::~memory_tracker()
+{
+}
+
+memory_tracker::thread_state* memory_tracker::get_thread_state()
+{
+	if (t_thread_tracker == this)
+	{
+		return t_thread_state;
+	}
+
+	// Reuse a state from a thread that has exited if we can, otherwise claim a new one.
+	thread_state* state = &m_overflow_state;
+
+	size_t high_water_mark = m_thread_high_water_mark.load();
+	for (size_t i = 0; i < high_water_mark; i++)
+	{
+		bool expected = false;
+		if (m_threads[i].in_use.compare_exchange_strong(expected, true))
+		{
+			state = &m_threads[i];
+			break;
+		}
+	}
+
+	// The slot becomes visible to the scan above as soon as the high water mark is bumped, so
+	// another thread can claim it before we do. Claim it the same way and move on if we lose.
+	while (state == &m_overflow_state)
+	{
+		size_t index = m_thread_high_water_mark.fetch_add(1);
+		if (index >= k_max_threads)
+		{
+			m_thread_high_water_mark.store(k_max_threads);
+			break;
+		}
+
+		bool expected = false;
+		if (m_threads[index].in_use.compare_exchange_strong(expected, true))
+		{
+			state = &m_threads[index];
+		}
+	}
+
+	t_thread_tracker = this;
+	t_thread_state = state;
+
+	// Registering the thread_local destructor can allocate, by this point that will
+	// just take the fast path above.
+	if (state != &m_overflow_state)
+	{
+		g_tls_thread_state_releaser.tracker = this;
+		g_tls_thread_state_releaser.state = state;
+	}
+
+	return state;
+}
+
+void memory_tracker::release_thread_state(thread_state* state)
+{
+	// Counters are left as they are, they still contribute to the totals and whichever
+	// thread claims this state next will carry on from them.
+	merge_asset_changes(*state);
+
+	// Anything allocated after this point as the thread shuts down goes to the shared counters.
+	t_thread_state = &m_overflow_state;
+
+	state->in_use = false;
+}
+
+void memory_tracker::record_change(memory_type type, string_hash asset_id, int64_t count, int64_t bytes)
+{
+	thread_state* state = get_thread_state();
+	type_counters& counters = state->types[static_cast<int>(type)];
+
+	// Shared by multiple threads so we can't use the fast path.
+	if (state == &m_overflow_state)
+	{
+		counters.allocation_count.fetch_add(count, std::memory_order_relaxed);
+		counters.allocation_bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+		if (asset_id != string_hash::empty)
+		{
+			// Same as in merge_asset_changes, allocations made by the table must not re-enter this lock.
+			memory_scope scope(memory_type::memory_tracking__overhead, memory_scope::k_ignore_asset);
+
+			std::scoped_lock lock(m_asset_mutex);
+
+			asset_bucket& bucket = m_assets[static_cast<int>(type)][asset_id];
+			bucket.allocation_count += count;
+			bucket.allocation_bytes += bytes;
+		}
+
+		return;
+	}
+
+	counters.allocation_count.store(counters.allocation_count.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+	counters.allocation_bytes.store(counters.allocation_bytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+
+	if (asset_id == string_hash::empty)
+	{
+		return;
+	}
+
+	pending_asset_change* change = nullptr;
+	for (size_t i = 0; i < state->pending_asset_count; i++)
+	{
+		pending_asset_change& pending = state->pending_assets[i];
+		if (pending.type == type && pending.asset_id == asset_id)
+		{
+			change = &pending;
+			break;
+		}
+	}
+
+	if (change == nullptr)
+	{
+		if (state->pending_asset_count == k_max_pending_asset_changes)
+		{
+			merge_asset_changes(*state);
+		}
+
+		change = &state->pending_assets[state->pending_asset_count++];
+		change->type = type;
+		change->asset_id = asset_id;
+		change->allocation_count = 0;
+		change->allocation_bytes = 0;
+	}
+
+	change->allocation_count += count;
+	change->allocation_bytes += bytes;
+
+	if (++state->pending_asset_records >= k_asset_merge_interval)
+	{
+		merge_asset_changes(*state);
+	}
+}
+
+void memory_tracker::merge_asset_changes(thread_state& state)
+{
+	if (state.pending_asset_count == 0)
+	{
+		return;
+	}
+
+	// Inserting into the table can allocate, make sure those allocations aren't attributed
+	// to an asset or they would end up back in the list we are merging.
+	memory_scope scope(memory_type::memory_tracking__overhead, memory_scope::k_ignore_asset);
+
+	std::scoped_lock lock(m_asset_mutex);
+
+	for (size_t i = 0; i < state.pending_asset_count; i++)
+	{
+		pending_asset_change& change = state.pending_assets[i];
+
+		std::unordered_map<string_hash, asset_bucket>& assets = m_assets[static_cast<int>(change.type)];
+		auto iter = assets.try_emplace(change.asset_id).first;
+		iter->second.allocation_count += change.allocation_count;
+		iter->second.allocation_bytes += change.allocation_bytes;
+
+		// Frees can be merged before the allocations they match if they happen on a different
+		// thread, so only remove the bucket once everything has balanced out.
+		if (iter->second.allocation_count == 0 && iter->second.allocation_bytes == 0)
+		{
+			assets.erase(iter);
+		}
+	}
+
+	state.pending_asset_count = 0;
+	state.pending_asset_records = 0;
+}
+
 size_t memory_tracker::get_memory_allocation_count(memory_type type)
 {
-	type_bucket& bucket = m_types[static_cast<int>(type)];
-	return bucket.allocation_count.load();
+	int64_t total = m_overflow_state.types[static_cast<int>(type)].allocation_count.load(std::memory_order_relaxed);
+
+	size_t thread_count = std::min(m_thread_high_water_mark.load(), k_max_threads);
+	for (size_t i = 0; i < thread_count; i++)
+	{
+		total += m_threads[i].types[static_cast<int>(type)].allocation_count.load(std::memory_order_relaxed);
+	}
+
+	return static_cast<size_t>(std::max<int64_t>(total, 0));
 }
 
 size_t memory_tracker::get_memory_used_bytes(memory_type type)
 {
-	type_bucket& bucket = m_types[static_cast<int>(type)];
-	return bucket.allocation_bytes.load();
+	int64_t total = m_overflow_state.types[static_cast<int>(type)].allocation_bytes.load(std::memory_order_relaxed);
+
+	size_t thread_count = std::min(m_thread_high_water_mark.load(), k_max_threads);
+	for (size_t i = 0; i < thread_count; i++)
+	{
+		total += m_threads[i].types[static_cast<int>(type)].allocation_bytes.load(std::memory_order_relaxed);
+	}
+
+	return static_cast<size_t>(std::max<int64_t>(total, 0));
 }
 
 std::vector<memory_tracker::asset_state> memory_tracker::get_assets(memory_type type)
 {
-	type_bucket& bucket = m_types[static_cast<int>(type)];
-
 	std::scoped_lock lock(m_asset_mutex);
 	std::vector<memory_tracker::asset_state> result;
 
-	for (auto& pair : bucket.assets)
+	for (auto& [id, bucket] : m_assets[static_cast<int>(type)])
 	{
+		// Can be transiently negative while other threads have unmerged changes.
+		if (bucket.allocation_count <= 0 || bucket.allocation_bytes <= 0)
+		{
+			continue;
+		}
+
 		memory_tracker::asset_state& state = result.emplace_back();
-		state.id = pair.first;
-		state.allocation_count = pair.second.allocation_count.load();
-		state.used_bytes = pair.second.allocation_bytes.load();
+		state.id = id;
+		state.allocation_count = static_cast<size_t>(bucket.allocation_count);
+		state.used_bytes = static_cast<size_t>(bucket.allocation_bytes);
 	}
 
 	return result;
 }
 
+size_t memory_tracker::get_asset_used_bytes(string_hash asset_id)
+{
+	std::scoped_lock lock(m_asset_mutex);
+
+	int64_t used_bytes = 0;
+
+	for (size_t i = 0; i < (size_t)memory_type::COUNT; i++)
+	{
+		if (auto iter = m_assets[i].find(asset_id); iter != m_assets[i].end())
+		{
+			used_bytes += iter->second.allocation_bytes;
+		}
+	}
+
+	// Can be transiently negative while other threads have unmerged changes.
+	return used_bytes > 0 ? static_cast<size_t>(used_bytes) : 0;
+}
+
 std::unordered_map<string_hash, memory_tracker::asset_breakdown> memory_tracker::get_asset_breakdown()
 {
 	std::unordered_map<string_hash, asset_breakdown> result;
@@ -139,19 +373,24 @@ std::unordered_map<string_hash, memory_tracker::asset_breakdown> memory_tracker:
 
 	for (size_t i = 0; i < (size_t)memory_type::COUNT; i++)
 	{
-		memory_type type = static_cast<memory_type>(memory_type::COUNT);
-		type_bucket& bucket = m_types[i];
+		memory_type type = static_cast<memory_type>(i);
 
-		for (auto& [id, state] : bucket.assets)
+		for (auto& [id, bucket] : m_assets[i])
 		{
+			if (bucket.allocation_count <= 0 || bucket.allocation_bytes <= 0)
+			{
+				continue;
+			}
+
 			asset_breakdown& breakdown = result[id];
 			breakdown.aggregate.id = id;
-			breakdown.aggregate.allocation_count += state.allocation_count;
-			breakdown.aggregate.used_bytes += state.allocation_bytes;
+			breakdown.aggregate.allocation_count += bucket.allocation_count;
+			breakdown.aggregate.used_bytes += bucket.allocation_bytes;
 
 			asset_state& type_state = breakdown.by_type[type];
-			type_state.allocation_count += state.allocation_count;
-			type_state.used_bytes += state.allocation_bytes;
+			type_state.id = id;
+			type_state.allocation_count += bucket.allocation_count;
+			type_state.used_bytes += bucket.allocation_bytes;
 		}
 	}
 
@@ -160,8 +399,6 @@ std::unordered_map<string_hash, memory_tracker::asset_breakdown> memory_tracker:
 
 void memory_tracker::record_alloc(memory_type type, string_hash asset_id, size_t size)
 {
-	type_bucket& bucket = m_types[static_cast<int>(type)];
-
     if (size == 0)
     {
         return;
@@ -172,46 +409,17 @@ void memory_tracker::record_alloc(memory_type type, string_hash asset_id, size_t
         db_break();
     }
 
-	bucket.allocation_count.fetch_add(1);
-	bucket.allocation_bytes.fetch_add(size);
-
-	if (asset_id != string_hash::empty)
-	{
-		std::scoped_lock lock(m_asset_mutex);
-
-		asset_bucket& asset_bucket = bucket.assets[asset_id];
-		asset_bucket.allocation_count.fetch_add(1);
-		asset_bucket.allocation_bytes.fetch_add(size);
-	}
+	record_change(type, asset_id, 1, static_cast<int64_t>(size));
 }
 
 void memory_tracker::record_free(memory_type type, string_hash asset_id, size_t size)
 {
-	type_bucket& bucket = m_types[static_cast<int>(type)];
-
     if (size == 0)
     {
         return;
     }
 
-	bucket.allocation_count.fetch_sub(1);
-	bucket.allocation_bytes.fetch_sub(size);
-
-	if (asset_id != string_hash::empty)
-	{
-		std::scoped_lock lock(m_asset_mutex);
-
-		auto iter = bucket.assets.find(asset_id);
-
-		asset_bucket& asset_bucket = iter->second;
-		asset_bucket.allocation_bytes.fetch_sub(size);
-
-		size_t result = asset_bucket.allocation_count.fetch_sub(1);
-		if (result == 1)
-		{
-			bucket.assets.erase(iter);
-		}
-	}
+	record_change(type, asset_id, -1, -static_cast<int64_t>(size));
 }
 
 void memory_tracker::record_raw_alloc(void* ptr, size_t size)
@@ -225,6 +433,14 @@ void memory_tracker::record_raw_alloc(void* ptr, size_t size)
     tag->asset_id = scope ? scope->get_asset_id() : string_hash::empty;
     tag->size = (uint32_t)size;
 
+    if (memory_profiler* profiler = memory_profiler::try_get())
+    {
+        if (profiler->record_alloc(ptr, size - sizeof(raw_alloc_tag)))
+        {
+            tag->magic = k_raw_alloc_tag_sampled_magic;
+        }
+    }
+
     record_alloc((memory_type)tag->type, tag->asset_id, tag->size - sizeof(raw_alloc_tag));
     record_alloc(memory_type::memory_tracking__overhead, string_hash::empty, sizeof(raw_alloc_tag));
     record_alloc(memory_type::memory_tracking__waste, string_hash::empty, buffer_size - tag->size);
@@ -239,11 +455,19 @@ void memory_tracker::record_raw_free(void* ptr)
     }
 
     raw_alloc_tag* tag = reinterpret_cast<raw_alloc_tag*>((uint8_t*)ptr + buffer_size - sizeof(raw_alloc_tag));
-    if (tag->magic != k_raw_alloc_tag_magic)
+    if ((tag->magic != k_raw_alloc_tag_magic && tag->magic != k_raw_alloc_tag_sampled_magic) || tag->type >= static_cast<uint16_t>(memory_type::COUNT) || tag->size > buffer_size)
     {
         return;
     }
 
+    if (tag->magic == k_raw_alloc_tag_sampled_magic)
+    {
+        if (memory_profiler* profiler = memory_profiler::try_get())
+        {
+            profiler->record_free(ptr);
+        }
+    }
+
     record_free((memory_type)tag->type, tag->asset_id, tag->size - sizeof(raw_alloc_tag));
     record_free(memory_type::memory_tracking__overhead, string_hash::empty, sizeof(raw_alloc_tag));
     record_free(memory_type::memory_tracking__waste, string_hash::empty, buffer_size - tag->size);
@@ -10,6 +10,7 @@
 #include <array>
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -103,6 +104,9 @@ public:
     // Magic number for sanity checking allocation tags.
     static constexpr uint16_t k_raw_alloc_tag_magic = 0xBEAD;
 
+    // Magic number used instead of k_raw_alloc_tag_magic for allocations the memory_profiler has sampled.
+    static constexpr uint16_t k_raw_alloc_tag_sampled_magic = 0xBEAE;
+
 	// State of a given asset, as provided by get_assets.
 	struct asset_state
 	{
@@ -131,6 +135,9 @@ public:
 	// Gets all assets with their memory usage broken down by type.
 	std::unordered_map<string_hash, asset_breakdown> get_asset_breakdown();
 
+	// Gets the number of bytes currently active for the given asset, across all types.
+	size_t get_asset_used_bytes(string_hash asset_id);
+
     // Records a raw malloc allocation by placing the memory type at the end of the allocation.
     // This shouldn't be called directly, its here for memory hooks to invoke.
     // Size of allocation should always include raw_alloc_tag_size 
@@ -139,6 +146,9 @@ public:
     // Records a raw free of an allocation previously record with record_raw_alloc.
     void record_raw_free(void* ptr);
 
+	memory_tracker();
+	virtual ~memory_tracker();
+
 private:
 
 	friend class memory_scope;
@@ -154,22 +164,78 @@ private:
 
 private:
 
-	struct asset_bucket
+	// Maximum number of threads that can have their own counters at once. Any more share a set
+	// of counters that are updated atomically.
+	static constexpr size_t k_max_threads = 256;
+
+	// Number of distinct asset/type pairs a thread can accumulate changes for before they are
+	// merged into the shared asset table.
+	static constexpr size_t k_max_pending_asset_changes = 32;
+
+	// Number of asset allocations/frees a thread can make before its changes are merged.
+	static constexpr size_t k_asset_merge_interval = 256;
+
+	struct type_counters
 	{
-		std::atomic_size_t allocation_count = 0;
-		std::atomic_size_t allocation_bytes = 0;
+		std::atomic<int64_t> allocation_count = 0;
+		std::atomic<int64_t> allocation_bytes = 0;
 	};
 
-	struct type_bucket
+	struct pending_asset_change
 	{
-		std::atomic_size_t allocation_count = 0;
-		std::atomic_size_t allocation_bytes = 0;
-		std::unordered_map<string_hash, asset_bucket> assets;
+		memory_type type;
+		string_hash asset_id;
+		int64_t allocation_count;
+		int64_t allocation_bytes;
 	};
 
-	std::recursive_mutex m_asset_mutex;
+	// Counters owned by a single thread. Only the owning thread writes to them so they can be
+	// updated without any atomic read-modify-write, readers sum the counters of every thread.
+	struct thread_state
+	{
+		std::array<type_counters, static_cast<int>(memory_type::COUNT)> types;
+
+		std::array<pending_asset_change, k_max_pending_asset_changes> pending_assets;
+		size_t pending_asset_count = 0;
+		size_t pending_asset_records = 0;
+
+		std::atomic<bool> in_use = false;
+	};
+
+	struct asset_bucket
+	{
+		int64_t allocation_count = 0;
+		int64_t allocation_bytes = 0;
+	};
+
+	// Gets the counters for the calling thread, claiming a set if it dosen't have one yet.
+	thread_state* get_thread_state();
+
+	// Returns the calling threads counters to the pool, called when the thread exits.
+	void release_thread_state(thread_state* state);
+
+	// Adds an allocation (or free if negative) to the calling threads counters.
+	void record_change(memory_type type, string_hash asset_id, int64_t count, int64_t bytes);
+
+	// Merges a threads pending asset changes into the shared asset table.
+	void merge_asset_changes(thread_state& state);
+
+	friend struct thread_state_releaser;
+
+private:
+
+	// Plain pointers so the fast path dosen't need to go through the thread_local initialization guard.
+	inline static thread_local memory_tracker* t_thread_tracker = nullptr;
+	inline static thread_local thread_state* t_thread_state = nullptr;
+
+	std::unique_ptr<thread_state[]> m_threads;
+	std::atomic_size_t m_thread_high_water_mark = 0;
+
+	// Used by threads once all the thread states have been claimed.
+	thread_state m_overflow_state;
 
-	std::array<type_bucket, static_cast<int>(memory_type::COUNT)> m_types;
+	std::mutex m_asset_mutex;
+	std::array<std::unordered_map<string_hash, asset_bucket>, static_cast<int>(memory_type::COUNT)> m_assets;
 
 };
 
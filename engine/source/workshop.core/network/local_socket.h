@@ -0,0 +1,56 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include <filesystem>
+#include <memory>
+
+namespace ws {
+
+// ================================================================================================
+//  A blocking stream socket for communicating with other processes on the same machine. This 
+//  is implemented with unix domain sockets, which are addressed by a path on disk.
+//
+//  Reads and writes to a socket from multiple threads need to be externally synchronized.
+// ================================================================================================
+class local_socket
+{
+public:
+    ~local_socket();
+
+    // Connects to a socket listening at the given path. Returns nullptr if the connection could not
+    // be made.
+    static std::unique_ptr<local_socket> connect(const std::filesystem::path& path);
+
+    // Creates a socket listening for connections at the given path. Any stale socket file at the 
+    // path is replaced. Returns nullptr if the socket could not be created.
+    static std::unique_ptr<local_socket> listen(const std::filesystem::path& path);
+
+    // Blocks until a client connects to a listening socket. Returns nullptr if the socket 
+    // is shutdown or fails.
+    std::unique_ptr<local_socket> accept();
+
+    // Sends exactly size bytes. Returns false if the connection was closed or failed.
+    bool send(const void* data, size_t size);
+
+    // Receives exactly size bytes. Returns false if the connection was closed or failed.
+    bool receive(void* data, size_t size);
+
+    // Shuts down the socket, any threads blocked in accept or receive will return failure.
+    void shutdown();
+
+private:
+    local_socket() = default;
+
+private:
+    // Platform specific socket handle.
+    intptr_t m_handle = -1;
+
+    // Path the socket is bound to if listening, removed when the socket is destroyed.
+    std::filesystem::path m_bound_path;
+
+};
+
+}; // namespace workshop
@@ -56,6 +56,43 @@ size_t get_memory_usage();
 // Gets the amount, in bytes,  of the page file currently being used.
 size_t get_pagefile_usage();
 
+// Describes a single logical processor that threads can be scheduled on.
+struct cpu_logical_processor
+{
+    // Index the os uses to identify the processor, this is what should be passed to set_thread_affinity.
+    size_t index = 0;
+
+    // Physical core the processor belongs to. Processors that share a core are SMT siblings.
+    size_t core = 0;
+
+    // Group of processors that share the same last level (L3) cache.
+    size_t cache_domain = 0;
+
+    // Relative performance of the core, 0 is the fastest. On hybrid (big/little) processors
+    // the efficiency cores will have a higher value than the performance cores.
+    size_t performance_class = 0;
+
+    // True if this is not the first processor on its physical core.
+    bool is_smt_sibling = false;
+};
+
+// Describes the layout of the processors in the machine.
+struct cpu_topology
+{
+    std::vector<cpu_logical_processor> processors;
+
+    size_t core_count = 0;
+    size_t cache_domain_count = 0;
+    size_t performance_class_count = 0;
+};
+
+// Probes the processors in the machine and the caches they share. If the topology cannot
+// be determined every processor is reported as its own core in a single cache domain.
+cpu_topology get_cpu_topology();
+
+// Restricts the calling thread to only run on the given logical processor.
+bool set_thread_affinity(size_t processor_index);
+
 // Type of message dialog to display when calling message_dialog, this dictates
 // the title/icon/etc that is shown in the dialog.
 enum class message_dialog_type
@@ -0,0 +1,276 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ws {
+
+template <typename signature, size_t capacity_bytes>
+class inplace_function;
+
+// ================================================================================================
+//  Callable wrapper similar to std::function, but with a fixed footprint. Callables that fit
+//  into capacity_bytes are stored inline, so constructing or copying one does not touch
+//  the heap.
+//
+//  Callables larger than the inline buffer (or that are not nothrow movable) still work, but are
+//  boxed in a heap allocation each time they are constructed or copied. This is deliberate, so
+//  rare large captures don't need rewriting, but on hot paths keep captures small (pointers,
+//  handles, indices). Use static_assert(fits_inline<T>()) where a callable must never be boxed,
+//  and is_boxed() to detect the fallback at runtime.
+// ================================================================================================
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+class inplace_function<return_type(argument_types...), capacity_bytes>
+{
+public:
+
+    inplace_function() = default;
+    inplace_function(std::nullptr_t);
+    inplace_function(const inplace_function& other);
+    inplace_function(inplace_function&& other);
+    ~inplace_function();
+
+    template <typename callable_type,
+              typename = std::enable_if_t<!std::is_same_v<std::decay_t<callable_type>, inplace_function> &&
+                                          std::is_invocable_r_v<return_type, std::decay_t<callable_type>&, argument_types...>>>
+    inplace_function(callable_type&& callable);
+
+    inplace_function& operator=(const inplace_function& other);
+    inplace_function& operator=(inplace_function&& other);
+    inplace_function& operator=(std::nullptr_t);
+
+    return_type operator()(argument_types... args);
+
+    explicit operator bool() const;
+
+    // Destroys the stored callable.
+    void reset();
+
+    // Returns true if the stored callable was too large to fit inline and lives on the heap.
+    bool is_boxed() const;
+
+    // Returns true if the callable type will be stored inline rather than on the heap.
+    template <typename callable_type>
+    static constexpr bool fits_inline();
+
+private:
+
+    // Table of type-erased operations, one static instance exists per stored type.
+    struct operations
+    {
+        return_type (*invoke)(void* storage, argument_types&&... args);
+        void (*copy)(void* destination, const void* source);
+        void (*move)(void* destination, void* source);
+        void (*destroy)(void* storage);
+        bool boxed;
+    };
+
+    template <typename callable_type>
+    struct inline_operations;
+
+    template <typename callable_type>
+    struct boxed_operations;
+
+private:
+    alignas(std::max_align_t) std::byte m_storage[capacity_bytes];
+    const operations* m_operations = nullptr;
+
+};
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+template <typename callable_type>
+struct inplace_function<return_type(argument_types...), capacity_bytes>::inline_operations
+{
+    static return_type invoke(void* storage, argument_types&&... args)
+    {
+        return (*static_cast<callable_type*>(storage))(std::forward<argument_types>(args)...);
+    }
+
+    static void copy(void* destination, const void* source)
+    {
+        new (destination) callable_type(*static_cast<const callable_type*>(source));
+    }
+
+    static void move(void* destination, void* source)
+    {
+        new (destination) callable_type(std::move(*static_cast<callable_type*>(source)));
+        static_cast<callable_type*>(source)->~callable_type();
+    }
+
+    static void destroy(void* storage)
+    {
+        static_cast<callable_type*>(storage)->~callable_type();
+    }
+
+    static inline constexpr operations table = { &invoke, &copy, &move, &destroy, false };
+};
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+template <typename callable_type>
+struct inplace_function<return_type(argument_types...), capacity_bytes>::boxed_operations
+{
+    static callable_type*& get(void* storage)
+    {
+        return *static_cast<callable_type**>(storage);
+    }
+
+    static return_type invoke(void* storage, argument_types&&... args)
+    {
+        return (*get(storage))(std::forward<argument_types>(args)...);
+    }
+
+    static void copy(void* destination, const void* source)
+    {
+        new (destination) callable_type*(new callable_type(**static_cast<callable_type* const*>(source)));
+    }
+
+    static void move(void* destination, void* source)
+    {
+        new (destination) callable_type*(get(source));
+        get(source) = nullptr;
+    }
+
+    static void destroy(void* storage)
+    {
+        delete get(storage);
+    }
+
+    static inline constexpr operations table = { &invoke, &copy, &move, &destroy, true };
+};
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+template <typename callable_type>
+inline constexpr bool inplace_function<return_type(argument_types...), capacity_bytes>::fits_inline()
+{
+    return sizeof(callable_type) <= capacity_bytes &&
+           alignof(callable_type) <= alignof(std::max_align_t) &&
+           std::is_nothrow_move_constructible_v<callable_type>;
+}
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+inline inplace_function<return_type(argument_types...), capacity_bytes>::inplace_function(std::nullptr_t)
+{
+}
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+template <typename callable_type, typename>
+inline inplace_function<return_type(argument_types...), capacity_bytes>::inplace_function(callable_type&& callable)
+{
+    using stored_type = std::decay_t<callable_type>;
+
+    if constexpr (fits_inline<stored_type>())
+    {
+        new (m_storage) stored_type(std::forward<callable_type>(callable));
+        m_operations = &inline_operations<stored_type>::table;
+    }
+    else
+    {
+        static_assert(sizeof(stored_type*) <= capacity_bytes, "Inline buffer must be able to hold at least a pointer.");
+
+        new (m_storage) stored_type*(new stored_type(std::forward<callable_type>(callable)));
+        m_operations = &boxed_operations<stored_type>::table;
+    }
+}
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+inline inplace_function<return_type(argument_types...), capacity_bytes>::inplace_function(const inplace_function& other)
+{
+    if (other.m_operations)
+    {
+        other.m_operations->copy(m_storage, other.m_storage);
+        m_operations = other.m_operations;
+    }
+}
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+inline inplace_function<return_type(argument_types...), capacity_bytes>::inplace_function(inplace_function&& other)
+{
+    if (other.m_operations)
+    {
+        other.m_operations->move(m_storage, other.m_storage);
+        m_operations = other.m_operations;
+        other.m_operations = nullptr;
+    }
+}
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+inline inplace_function<return_type(argument_types...), capacity_bytes>::~inplace_function()
+{
+    reset();
+}
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+inline inplace_function<return_type(argument_types...), capacity_bytes>& inplace_function<return_type(argument_types...), capacity_bytes>::operator=(const inplace_function& other)
+{
+    if (this != &other)
+    {
+        reset();
+
+        if (other.m_operations)
+        {
+            other.m_operations->copy(m_storage, other.m_storage);
+            m_operations = other.m_operations;
+        }
+    }
+    return *this;
+}
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+inline inplace_function<return_type(argument_types...), capacity_bytes>& inplace_function<return_type(argument_types...), capacity_bytes>::operator=(inplace_function&& other)
+{
+    if (this != &other)
+    {
+        reset();
+
+        if (other.m_operations)
+        {
+            other.m_operations->move(m_storage, other.m_storage);
+            m_operations = other.m_operations;
+            other.m_operations = nullptr;
+        }
+    }
+    return *this;
+}
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+inline inplace_function<return_type(argument_types...), capacity_bytes>& inplace_function<return_type(argument_types...), capacity_bytes>::operator=(std::nullptr_t)
+{
+    reset();
+    return *this;
+}
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+inline return_type inplace_function<return_type(argument_types...), capacity_bytes>::operator()(argument_types... args)
+{
+    return m_operations->invoke(m_storage, std::forward<argument_types>(args)...);
+}
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+inline inplace_function<return_type(argument_types...), capacity_bytes>::operator bool() const
+{
+    return m_operations != nullptr;
+}
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+inline void inplace_function<return_type(argument_types...), capacity_bytes>::reset()
+{
+    if (m_operations)
+    {
+        m_operations->destroy(m_storage);
+        m_operations = nullptr;
+    }
+}
+
+template <typename return_type, typename... argument_types, size_t capacity_bytes>
+inline bool inplace_function<return_type(argument_types...), capacity_bytes>::is_boxed() const
+{
+    return m_operations != nullptr && m_operations->boxed;
+}
+
+}; // namespace ws
@@ -7,6 +7,7 @@
 #include "workshop.editor/editor/windows/editor_loading_window.h"
 #include "workshop.editor/editor/windows/editor_log_window.h"
 #include "workshop.editor/editor/windows/editor_memory_window.h"
+#include "workshop.editor/editor/windows/editor_memory_snapshot_window.h"
 #include "workshop.editor/editor/windows/editor_performance_window.h"
 #include "workshop.editor/editor/windows/editor_scene_tree_window.h"
 #include "workshop.editor/editor/windows/editor_properties_window.h"
@@ -283,6 +284,7 @@ result<void> editor::create_windows(init_list& list)
     create_window<editor_assets_window>(this, &m_engine.get_asset_manager(), &m_engine.get_asset_database());
     create_window<editor_log_window>();
     create_window<editor_memory_window>();
+    create_window<editor_memory_snapshot_window>();
     create_window<editor_cvar_window>();
     create_window<editor_performance_window>();
     create_window<editor_progress_popup>();
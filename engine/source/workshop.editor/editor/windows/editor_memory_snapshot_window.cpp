@@ -0,0 +1,221 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.editor/editor/windows/editor_memory_snapshot_window.h"
+#include "workshop.core/containers/string.h"
+#include "workshop.core/filesystem/file.h"
+#include "workshop.core/platform/platform.h"
+
+#include "thirdparty/imgui/imgui.h"
+
+namespace ws {
+
+editor_memory_snapshot_window::editor_memory_snapshot_window()
+{
+    m_open = false;
+}
+
+db_callstack& editor_memory_snapshot_window::get_callstack(memory_profiler::stack_id id)
+{
+    auto iter = m_callstack_cache.find(id);
+    if (iter == m_callstack_cache.end())
+    {
+        iter = m_callstack_cache.emplace(id, memory_profiler::get().resolve_stack(id)).first;
+    }
+    return *iter->second;
+}
+
+void editor_memory_snapshot_window::export_diff(const std::vector<memory_profiler::stack_diff>& diff)
+{
+    std::vector<file_dialog_filter> filter;
+    file_dialog_filter& collapsed_filter = filter.emplace_back();
+    collapsed_filter.name = "Collapsed Stacks";
+    collapsed_filter.extensions.push_back("folded");
+
+    std::string path = save_file_dialog("Export Memory Diff", filter);
+    if (path.empty())
+    {
+        return;
+    }
+
+    if (!write_all_text(path, memory_profiler::get().export_collapsed(diff)))
+    {
+        db_error(core, "Failed to write memory diff to: %s", path.c_str());
+    }
+}
+
+void editor_memory_snapshot_window::draw_diff(const std::vector<memory_profiler::stack_diff>& diff)
+{
+    ImGui::BeginChild("MemorySnapshotTableView");
+    if (ImGui::BeginTable("MemorySnapshotTable", 4, ImGuiTableFlags_Resizable))
+    {
+        ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthStretch, 0.55f);
+        ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthStretch, 0.15f);
+        ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthStretch, 0.15f);
+        ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthStretch, 0.15f);
+
+        ImGui::TableNextColumn(); ImGui::TableHeader("Callstack");
+        ImGui::TableNextColumn(); ImGui::TableHeader("Live Memory Change");
+        ImGui::TableNextColumn(); ImGui::TableHeader("Live Allocation Change");
+        ImGui::TableNextColumn(); ImGui::TableHeader("Allocated Between");
+
+        for (size_t i = 0; i < diff.size() && i < k_max_displayed_stacks; i++)
+        {
+            const memory_profiler::stack_diff& entry = diff[i];
+            db_callstack& callstack = get_callstack(entry.id);
+
+            ImGui::TableNextRow();
+
+            // Callstack
+            ImGui::TableNextColumn();
+
+            std::string name = "unknown";
+            if (!callstack.frames.empty())
+            {
+                db_callstack::frame& frame = callstack.frames[0];
+                name = frame.function.empty() ? string_format("%s+0x%zx", frame.module.c_str(), frame.address) : frame.function;
+            }
+
+            ImGui::PushID(static_cast<int>(i));
+            bool expanded = ImGui::CollapsingHeader(name.c_str(), ImGuiTreeNodeFlags_None);
+            ImGui::PopID();
+
+            if (expanded)
+            {
+                ImGui::Indent(10.0f);
+                for (db_callstack::frame& frame : callstack.frames)
+                {
+                    if (frame.function.empty())
+                    {
+                        ImGui::Text("%s+0x%zx", frame.module.c_str(), frame.address);
+                    }
+                    else if (frame.filename.empty())
+                    {
+                        ImGui::Text("%s", frame.function.c_str());
+                    }
+                    else
+                    {
+                        ImGui::Text("%s (%s:%zi)", frame.function.c_str(), frame.filename.c_str(), frame.line);
+                    }
+                }
+                ImGui::Unindent(10.0f);
+            }
+
+            // Live Memory Change
+            ImGui::TableNextColumn(); ImGui::Text("%+.2f MB", static_cast<float>(entry.live_bytes_delta) / (1024.0f * 1024.0f));
+
+            // Live Allocation Change
+            ImGui::TableNextColumn(); ImGui::Text("%+lli", static_cast<long long>(entry.live_count_delta));
+
+            // Allocated Between
+            ImGui::TableNextColumn(); ImGui::Text("%.2f MB", static_cast<float>(entry.allocated_bytes) / (1024.0f * 1024.0f));
+        }
+
+        ImGui::EndTable();
+    }
+    ImGui::EndChild();
+}
+
+void editor_memory_snapshot_window::draw()
+{
+    if (m_open)
+    {
+        if (ImGui::Begin(get_window_id(), &m_open))
+        {
+            memory_profiler* profiler = memory_profiler::try_get();
+            if (profiler == nullptr)
+            {
+                ImGui::Text("Memory profiler is not running.");
+                ImGui::End();
+                return;
+            }
+
+            if (ImGui::Button("Take Snapshot"))
+            {
+                profiler->take_snapshot(string_format("Manual %zi", profiler->get_snapshots().size()).c_str());
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Clear Snapshots"))
+            {
+                profiler->clear_snapshots();
+                m_from_index = 0;
+                m_to_index = -1;
+            }
+
+            // The last entry in the to list is always the current state, so you can watch changes live.
+            std::vector<memory_profiler::snapshot> snapshots = profiler->get_snapshots();
+            snapshots.push_back(profiler->capture_snapshot("Current"));
+
+            std::vector<std::string> names;
+            std::vector<const char*> name_ptrs;
+            for (memory_profiler::snapshot& snap : snapshots)
+            {
+                names.push_back(string_format("%s (%.1fs)", snap.name.c_str(), snap.time));
+            }
+            for (std::string& name : names)
+            {
+                name_ptrs.push_back(name.c_str());
+            }
+
+            int snapshot_count = static_cast<int>(snapshots.size());
+            m_from_index = std::min(m_from_index, snapshot_count - 1);
+            int to_index = (m_to_index < 0 || m_to_index >= snapshot_count) ? snapshot_count - 1 : m_to_index;
+
+            ImGui::SameLine();
+            ImGui::Text("From");
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(250.0f);
+            ImGui::PushID("From");
+            ImGui::Combo("", &m_from_index, name_ptrs.data(), snapshot_count);
+            ImGui::PopID();
+
+            ImGui::SameLine();
+            ImGui::Text("To");
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(250.0f);
+            ImGui::PushID("To");
+            if (ImGui::Combo("", &to_index, name_ptrs.data(), snapshot_count))
+            {
+                m_to_index = (to_index == snapshot_count - 1) ? -1 : to_index;
+            }
+            ImGui::PopID();
+
+            std::vector<memory_profiler::stack_diff> diff = memory_profiler::diff_snapshots(snapshots[m_from_index], snapshots[to_index]);
+
+            ImGui::SameLine();
+            if (ImGui::Button("Export"))
+            {
+                export_diff(diff);
+            }
+
+            int64_t total_delta = 0;
+            size_t total_allocated = 0;
+            for (memory_profiler::stack_diff& entry : diff)
+            {
+                total_delta += entry.live_bytes_delta;
+                total_allocated += entry.allocated_bytes;
+            }
+
+            ImGui::Text("Sample Interval: %zi KB    Live Memory Change: %+.2f MB    Allocated Between: %.2f MB",
+                profiler->get_sample_interval() / 1024,
+                static_cast<float>(total_delta) / (1024.0f * 1024.0f),
+                static_cast<float>(total_allocated) / (1024.0f * 1024.0f));
+
+            draw_diff(diff);
+        }
+        ImGui::End();
+    }
+}
+
+const char* editor_memory_snapshot_window::get_window_id()
+{
+    return "Memory Snapshots";
+}
+
+editor_window_layout editor_memory_snapshot_window::get_layout()
+{
+    return editor_window_layout::bottom_left;
+}
+
+}; // namespace ws
@@ -0,0 +1,46 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.editor/editor/editor_window.h"
+#include "workshop.core/memory/memory_profiler.h"
+
+#include <unordered_map>
+
+namespace ws {
+
+// ================================================================================================
+//  Window that shows the difference in sampled allocations between two memory_profiler snapshots.
+// ================================================================================================
+class editor_memory_snapshot_window
+    : public editor_window
+{
+public:
+    editor_memory_snapshot_window();
+
+    virtual void draw() override;
+    virtual const char* get_window_id() override;
+    virtual editor_window_layout get_layout() override;
+
+private:
+    void draw_diff(const std::vector<memory_profiler::stack_diff>& diff);
+    void export_diff(const std::vector<memory_profiler::stack_diff>& diff);
+
+    db_callstack& get_callstack(memory_profiler::stack_id id);
+
+private:
+
+    // Maximum number of callstacks shown in the table, largest growth first.
+    static constexpr size_t k_max_displayed_stacks = 200;
+
+    int m_from_index = 0;
+    // -1 compares against the current state.
+    int m_to_index = -1;
+
+    std::unordered_map<memory_profiler::stack_id, std::unique_ptr<db_callstack>> m_callstack_cache;
+
+};
+
+}; // namespace ws
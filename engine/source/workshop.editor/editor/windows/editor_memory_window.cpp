@@ -5,6 +5,7 @@
 #include "workshop.editor/editor/windows/editor_memory_window.h"
 #include "workshop.core/containers/string.h"
 #include "workshop.core/memory/memory_tracker.h"
+#include "workshop.core/memory/memory_budgets.h"
 #include "workshop.core/utils/string_formatter.h"
 
 #include "thirdparty/imgui/imgui.h"
@@ -132,6 +133,79 @@ void editor_memory_window::draw_tree()
     draw_node(m_allocation_tree.get_root(), 0, m_allocation_tree.get_root());
 }
 
+void editor_memory_window::draw_budgets()
+{
+    memory_budgets* budgets = memory_budgets::try_get();
+    if (budgets == nullptr)
+    {
+        return;
+    }
+
+    std::vector<memory_budgets::budget_state> states = budgets->get_budgets();
+    if (states.empty())
+    {
+        return;
+    }
+
+    if (!ImGui::CollapsingHeader("Budgets", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        return;
+    }
+
+    if (ImGui::BeginTable("MemoryBudgetTable", 5, ImGuiTableFlags_Resizable))
+    {
+        ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthStretch, 0.35f);
+        ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthStretch, 0.35f);
+        ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthStretch, 0.1f);
+        ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthStretch, 0.1f);
+        ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthStretch, 0.1f);
+
+        ImGui::TableNextColumn(); ImGui::TableHeader("Path");
+        ImGui::TableNextColumn(); ImGui::TableHeader("Used");
+        ImGui::TableNextColumn(); ImGui::TableHeader("Soft Limit");
+        ImGui::TableNextColumn(); ImGui::TableHeader("Hard Limit");
+        ImGui::TableNextColumn(); ImGui::TableHeader("Pressure");
+
+        for (memory_budgets::budget_state& state : states)
+        {
+            ImGui::TableNextRow();
+
+            // Path
+            ImGui::TableNextColumn(); ImGui::Text("%s", state.path.c_str());
+
+            // Used, shown as a fraction of the hard limit.
+            ImGui::TableNextColumn();
+
+            string_formatter used_overlay;
+            used_overlay.format("%.1f MB (peak %.1f MB)", static_cast<float>(state.used_bytes) / (1024.0f * 1024.0f), static_cast<float>(state.peak_bytes) / (1024.0f * 1024.0f));
+
+            float fraction = state.hard_limit > 0 ? static_cast<float>(state.used_bytes) / static_cast<float>(state.hard_limit) : 1.0f;
+            ImGui::ProgressBar(std::min(fraction, 1.0f), ImVec2(-FLT_MIN, 0), used_overlay.c_str());
+
+            // Soft Limit
+            ImGui::TableNextColumn(); ImGui::Text("%.1f MB", static_cast<float>(state.soft_limit) / (1024.0f * 1024.0f));
+
+            // Hard Limit
+            ImGui::TableNextColumn(); ImGui::Text("%.1f MB", static_cast<float>(state.hard_limit) / (1024.0f * 1024.0f));
+
+            // Pressure
+            ImGui::TableNextColumn();
+            ImVec4 color = ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
+            if (state.pressure == memory_pressure::hard)
+            {
+                color = ImVec4(1.0f, 0.3f, 0.3f, 1.0f);
+            }
+            else if (state.pressure == memory_pressure::soft)
+            {
+                color = ImVec4(1.0f, 0.8f, 0.3f, 1.0f);
+            }
+            ImGui::TextColored(color, "%s", memory_pressure_strings[static_cast<int>(state.pressure)]);
+        }
+
+        ImGui::EndTable();
+    }
+}
+
 void editor_memory_window::draw()
 {
     if (m_open)
@@ -151,6 +225,8 @@ void editor_memory_window::draw()
                 m_allocation_tree.filter(m_filter_buffer);
             }
 
+            draw_budgets();
+
             ImGui::BeginChild("MemoryTableView");
             if (ImGui::BeginTable("MemoryTable", 5, ImGuiTableFlags_Resizable))
             {
@@ -29,6 +29,7 @@ private:
 
     void draw_node(const allocation_tree::node& node, size_t depth, const allocation_tree::node& root_node);
     void draw_tree();
+    void draw_budgets();
 
 private:
     allocation_tree m_allocation_tree;
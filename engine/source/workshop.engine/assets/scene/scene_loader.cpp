@@ -32,7 +32,11 @@ constexpr size_t k_scene_asset_descriptor_minimum_version = 1;
 constexpr size_t k_scene_asset_descriptor_current_version = 1;
 
 // Bump if compiled format ever changes.
-constexpr size_t k_scene_asset_compiled_version = 11;
+constexpr size_t k_scene_asset_compiled_version = 13;
+
+// Compression level compiled data is stored with for each config_type. Debug and profile
+// favour compile time, release favours disk size.
+constexpr std::array<int, static_cast<int>(config_type::COUNT)> k_scene_compression_levels = { 1, 1, 6 };
 
 };
 
@@ -97,9 +101,9 @@ void scene_loader::unload(asset* instance)
     delete instance;
 }
 
-bool scene_loader::save(const char* path, scene& asset)
+bool scene_loader::save(const char* path, scene& asset, int compression_level)
 {
-    return serialize(path, asset, true);
+    return serialize(path, asset, true, compression_level);
 }
 
 bool scene_loader::compile(const char* input_path, const char* output_path, platform_type asset_platform, config_type asset_config, asset_flags flags)
@@ -124,7 +128,7 @@ bool scene_loader::compile(const char* input_path, const char* output_path, plat
     asset.header.version = k_scene_asset_compiled_version;
 
     // Write binary format to disk.
-    if (!save(output_path, asset))
+    if (!save(output_path, asset, get_compression_level(asset_config)))
     {
         return false;
     }
@@ -132,20 +136,18 @@ bool scene_loader::compile(const char* input_path, const char* output_path, plat
     return true;
 }
 
+int scene_loader::get_compression_level(config_type asset_config)
+{
+    return k_scene_compression_levels[static_cast<int>(asset_config)];
+}
+
 size_t scene_loader::get_compiled_version()
 {
     return k_scene_asset_compiled_version;
 }
 
-bool scene_loader::serialize(const char* path, scene& asset, bool isSaving)
+bool scene_loader::serialize(const char* path, scene& asset, bool isSaving, int compression_level)
 {
-    std::unique_ptr<stream> stream = virtual_file_system::get().open(path, isSaving);
-    if (!stream)
-    {
-        db_error(asset, "[%s] Failed to open stream to save asset.", path);
-        return false;
-    }
-
     if (!isSaving)
     {
         asset.header.type = k_scene_asset_descriptor_type;
@@ -153,7 +155,8 @@ bool scene_loader::serialize(const char* path, scene& asset, bool isSaving)
         asset.name = path;
     }
 
-    if (!serialize_header(*stream, asset.header, path))
+    std::unique_ptr<stream> stream = open_compiled_stream(path, isSaving, asset.header, compression_level);
+    if (!stream)
     {
         return false;
     }
@@ -164,6 +167,11 @@ bool scene_loader::serialize(const char* path, scene& asset, bool isSaving)
     stream_serialize_list(*stream, asset.fields);
     stream_serialize_list(*stream, asset.data);
 
+    if (isSaving && !close_compiled_stream(*stream, path))
+    {
+        return false;
+    }
+
     return true;
 }
 
@@ -33,12 +33,13 @@ public:
     virtual bool compile(const char* input_path, const char* output_path, platform_type asset_platform, config_type asset_config, asset_flags flags) override;
     virtual bool can_hot_reload() override { return false; };
     virtual size_t get_compiled_version() override;
+    virtual int get_compression_level(config_type asset_config) override;
     virtual bool save_uncompiled(const char* path, asset& instance) override;
 
 private:
 
-    bool serialize(const char* path, scene& asset, bool isSaving);    
-    bool save(const char* path, scene& asset);
+    bool serialize(const char* path, scene& asset, bool isSaving, int compression_level = 0);    
+    bool save(const char* path, scene& asset, int compression_level = 0);
 
     bool parse_objects(const char* path, YAML::Node& node, scene& asset, std::vector<scene::object_info>& objects);
     bool parse_components(const char* path, YAML::Node& node, scene& asset, scene::object_info& obj);
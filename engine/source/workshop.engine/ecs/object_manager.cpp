@@ -673,75 +673,93 @@ void object_manager::deserialize_object(object handle, const std::vector<uint8_t
     }
 }
 
-void object_manager::step_systems(const frame_time& time, bool in_editor)
+void object_manager::build_system_graph()
 {
-    task_scheduler& scheduler = task_scheduler::get();
-    std::vector<task_handle> step_tasks;
+    profile_marker(profile_colors::simulation, "build ecs system graph");
+
+    m_system_graph.clear();
 
+    // Create nodes for stepping each system.
+    for (size_t i = 0; i < m_systems.size(); i++)
     {
-        std::scoped_lock lock(m_system_mutex);
+        m_system_graph.add_node(m_systems[i]->get_name(), [this, i]() {
+            step_system(i);
+        });
+    }
 
-        // Update all systems in parallel.
-        step_tasks.resize(m_systems.size());
+    // Add dependencies between the nodes.
+    for (size_t i = 0; i < m_systems.size(); i++)
+    {
+        auto& main_system = m_systems[i];
 
-        // Create tasks for stepping each system.
-        for (size_t i = 0; i < m_systems.size(); i++)
+        for (system* dependency : main_system->get_dependencies())
         {
-            auto& base_system = m_systems[i];
+            auto iter = std::find_if(m_systems.begin(), m_systems.end(), [dependency](auto& system) {
+                return system.get() == dependency;
+                });
+            db_assert(iter != m_systems.end());
 
-            step_tasks[i] = scheduler.create_task(base_system->get_name(), task_queue::standard, [this, &time, i, in_editor]() {
-                profile_marker(profile_colors::simulation, "step ecs system: %s", m_systems[i]->get_name());
+            size_t dependency_index = std::distance(m_systems.begin(), iter);
+            m_system_graph.add_dependency(i, dependency_index);
+        }
+    }
 
-                auto& system = m_systems[i];
+    if (!m_system_graph.compile())
+    {
+        db_fatal(engine, "Dependencies between ecs systems contain a cycle.");
+    }
 
-                if (in_editor)
-                {
-                    if ((system->get_flags() & system_flags::run_in_editor) == system_flags::none &&
-                        (system->get_flags() & system_flags::run_in_editor_only) == system_flags::none)
-                    {
-                        return;
-                    }
-                }
-                else
-                {
-                    if ((system->get_flags() & system_flags::run_in_editor_only) != system_flags::none)
-                    {
-                        return;
-                    }
-                }
+    m_system_graph_dirty = false;
+}
 
-                system->step(time);
-            });
-        }
+void object_manager::step_system(size_t index)
+{
+    auto& system = m_systems[index];
 
-        // Add dependencies between the tasks.
-        for (size_t i = 0; i < m_systems.size(); i++)
+    profile_marker(profile_colors::simulation, "step ecs system: %s", system->get_name());
+
+    if (m_step_in_editor)
+    {
+        if ((system->get_flags() & system_flags::run_in_editor) == system_flags::none &&
+            (system->get_flags() & system_flags::run_in_editor_only) == system_flags::none)
+        {
+            return;
+        }
+    }
+    else
+    {
+        if ((system->get_flags() & system_flags::run_in_editor_only) != system_flags::none)
         {
-            auto& main_system = m_systems[i];
+            return;
+        }
+    }
 
-            for (system* dependency : main_system->get_dependencies())
-            {
-                auto iter = std::find_if(m_systems.begin(), m_systems.end(), [dependency](auto& system) {
-                    return system.get() == dependency;
-                    });
-                db_assert(iter != m_systems.end());
+    system->step(*m_step_time);
+}
 
-                size_t dependency_index = std::distance(m_systems.begin(), iter);
-                step_tasks[i].add_dependency(step_tasks[dependency_index]);
-            }
+void object_manager::step_systems(const frame_time& time, bool in_editor)
+{
+    {
+        std::scoped_lock lock(m_system_mutex);
+
+        if (m_system_graph_dirty)
+        {
+            build_system_graph();
         }
     }
 
-    // Dispatch and away for completion.
+    // Execute and away for completion.
     m_is_system_step_active = true;
+    m_step_time = &time;
+    m_step_in_editor = in_editor;
 
     {
         profile_marker(profile_colors::simulation, "step ecs systems");
 
-        scheduler.dispatch_tasks(step_tasks);
-        scheduler.wait_for_tasks(step_tasks, true);
+        m_system_graph.execute(true);
     }
 
+    m_step_time = nullptr;
     m_is_system_step_active = false;
 }
 
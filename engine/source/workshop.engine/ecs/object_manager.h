@@ -12,6 +12,7 @@
 #include "workshop.engine/ecs/component_filter_archetype.h"
 #include "workshop.core/memory/memory_tracker.h"
 #include "workshop.core/hashing/hash.h"
+#include "workshop.core/async/task_graph.h"
 #include <typeindex>
 #include <unordered_map>
 
@@ -113,6 +114,7 @@ public:
         std::scoped_lock lock(m_system_mutex);
 
         m_systems.push_back(std::make_unique<system_type>(*this, input...));
+        m_system_graph_dirty = true;
     }
 
     // Unregisters a system previously registered.
@@ -127,6 +129,7 @@ public:
         if (iter != m_systems.end())
         {
             m_systems.erase(iter);
+            m_system_graph_dirty = true;
         }
     }
 
@@ -382,6 +385,13 @@ protected:
 
     void step_systems(const frame_time& time, bool in_editor);
 
+    // Rebuilds the task graph used to step systems, called when systems are
+    // registered or unregistered.
+    void build_system_graph();
+
+    // Steps a single system, called from the system task graph.
+    void step_system(size_t index);
+
 private:    
     std::recursive_mutex m_object_mutex;
     std::recursive_mutex m_system_mutex;
@@ -399,6 +409,14 @@ private:
 
     bool m_is_system_step_active = false;
 
+    // Graph with a node for each system, built once and executed each step.
+    task_graph m_system_graph { task_queue::standard, task_priority::critical };
+    bool m_system_graph_dirty = true;
+
+    // Parameters of the step currently being executed by the system graph.
+    const frame_time* m_step_time = nullptr;
+    bool m_step_in_editor = false;
+
     world& m_world;
 
 };
@@ -11,7 +11,7 @@ namespace ws {
 system::system(object_manager& manager, const char* name)
     : m_manager(manager)
     , m_name(name)
-    , m_command_queue(k_command_queue_capacity)
+    , m_command_queue(name, k_command_queue_chunk_size)
 {
 }
 
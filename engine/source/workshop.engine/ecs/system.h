@@ -107,7 +107,8 @@ protected:
 
 protected:
 
-    static inline constexpr size_t k_command_queue_capacity = 1 * 1024 * 1024;
+    // Size of each chunk of the command queue, the queue grows by this much whenever it fills up.
+    static inline constexpr size_t k_command_queue_chunk_size = 64 * 1024;
 
     object_manager& m_manager;
 
@@ -12,6 +12,7 @@
 
 #include "workshop.core/app/app.h"
 #include "workshop.core/async/task_scheduler.h"
+#include "workshop.core/containers/string.h"
 #include "workshop.core/cvar/core_cvars.h"
 #include "workshop.core/filesystem/async_io_manager.h"
 #include "workshop.core/filesystem/file.h"
@@ -20,9 +21,11 @@
 #include "workshop.core/filesystem/virtual_file_system_redirect_handler.h"
 #include "workshop.core/memory/async_copy_manager.h"
 #include "workshop.core/memory/memory_tracker.h"
+#include "workshop.core/memory/memory_profiler.h"
 #include "workshop.core/perf/profile.h"
 #include "workshop.core/perf/timer.h"
 #include "workshop.core/statistics/statistics_manager.h"
+#include "workshop.core/memory/memory_budgets.h"
 #include "workshop.core/utils/init_list.h"
 #include "workshop.core/utils/time.h"
 
@@ -30,6 +33,10 @@
 
 #include "workshop.assets/asset_manager.h"
 #include "workshop.assets/caches/asset_cache_disk.h"
+#include "workshop.assets/caches/asset_cache_archive.h"
+#include "workshop.assets/caches/asset_cache_tiered.h"
+#include "workshop.assets/caches/asset_cache_socket_transport.h"
+#include "workshop.assets/content_hash_index.h"
 #include <workshop.core/debug/log.h>
 #include <workshop.core/perf/timer.h>
 #include <workshop.core/platform/platform.h>
@@ -175,11 +182,39 @@ void engine::step()
     m_stats_frame_time_game->submit(frame_timer.get_elapsed_seconds());
     m_stats_frame_rate->submit(1.0 / m_frame_time.delta_seconds);
 
+    // Submit how much work the scheduler has distributed since last frame.
+    task_scheduler::statistics task_stats = m_task_scheduler->get_statistics();
+    m_stats_tasks_executed->submit(task_stats.tasks_executed - m_last_task_statistics.tasks_executed);
+    m_stats_task_steals->submit(task_stats.steals - m_last_task_statistics.steals);
+    m_stats_task_steal_contention->submit(task_stats.steal_contention - m_last_task_statistics.steal_contention);
+    m_stats_task_lock_contention->submit(task_stats.lock_contention - m_last_task_statistics.lock_contention);
+    m_stats_task_boxed->submit(task_stats.boxed_tasks - m_last_task_statistics.boxed_tasks);
+
+    // Average time tasks of each priority spent queued this frame.
+    for (size_t i = 0; i < static_cast<int>(task_priority::COUNT); i++)
+    {
+        size_t queued_tasks = task_stats.queued_tasks[i] - m_last_task_statistics.queued_tasks[i];
+        double queued_time = task_stats.queue_latency_total[i] - m_last_task_statistics.queue_latency_total[i];
+        m_stats_task_queue_latency[i]->submit(queued_tasks > 0 ? queued_time / queued_tasks : 0.0);
+    }
+
+    m_last_task_statistics = task_stats;
+
     // Swap out the current world if its completed loading.
     if (m_loading_world.is_loaded())
     {
         db_log(engine, "World loaded in %.2f ms: %s", (get_seconds() - m_loading_world_start_time) * 1000.0f, m_loading_world.get_path().c_str());
 
+        if (std::unique_ptr<asset_load_trace> trace = m_asset_manager->end_load_trace())
+        {
+            save_load_trace(*trace, m_loading_world.get_path());
+        }
+
+        if (memory_profiler* profiler = memory_profiler::try_get())
+        {
+            profiler->take_snapshot(string_format("After load: %s", m_loading_world.get_path().c_str()).c_str());
+        }
+
         set_default_world(m_loading_world->world_instance);
 
         // Null out of the world so its not destroyed when the asset_ptr is reset.
@@ -188,6 +223,21 @@ void engine::step()
         m_loading_world.reset();
     }
 
+    // Stop tracing a world that failed to load, otherwise the trace keeps recording every
+    // asset load until the next world is requested.
+    else if (m_loading_world.is_valid() && m_loading_world.get_state() == asset_loading_state::failed)
+    {
+        if (std::unique_ptr<asset_load_trace> trace = m_asset_manager->end_load_trace())
+        {
+            db_error(engine, "World failed to load after %.2f ms: %s", (get_seconds() - m_loading_world_start_time) * 1000.0f, m_loading_world.get_path().c_str());
+
+            save_load_trace(*trace, m_loading_world.get_path());
+        }
+    }
+
+    // Check memory usage against budgets, systems will be asked to release memory if we are over.
+    m_memory_budgets->update();
+
     // Commit engine statistics.
     statistics_manager::get().commit(statistics_commit_point::end_of_game);
 }
@@ -204,6 +254,11 @@ void engine::register_init(init_list& list)
         [this, &list]() -> result<void> { return create_statistics_manager(list); },
         [this, &list]() -> result<void> { return destroy_statistics_manager(); }
     );
+    list.add_step(
+        "Memory Budgets",
+        [this, &list]() -> result<void> { return create_memory_budgets(list); },
+        [this, &list]() -> result<void> { return destroy_memory_budgets(); }
+    );
     list.add_step(
         "Filesystem",
         [this, &list]() -> result<void> { return create_filesystem(list); },
@@ -254,6 +309,11 @@ void engine::register_init(init_list& list)
         [this, &list]() -> result<void> { return load_config(list); },
         [this, &list]() -> result<void> { return true; }
     );
+    list.add_step(
+        "Shared Asset Cache",
+        [this, &list]() -> result<void> { return create_shared_asset_cache(list); },
+        [this, &list]() -> result<void> { return true; }
+    );
     list.add_step(
         "Renderer",
         [this, &list]() -> result<void> { return create_renderer(list); },
@@ -420,6 +480,10 @@ result<void> engine::create_task_scheduler(init_list& list)
 {
     task_scheduler::init_state init_state;
     init_state.worker_count = std::thread::hardware_concurrency();
+    init_state.use_work_stealing = true;
+    init_state.pin_workers = true;
+    init_state.group_by_cache_domain = true;
+    init_state.isolate_smt_siblings = false;
 
     // If you add new task queues, set up and appropriate weight here.
     static_assert(static_cast<int>(task_queue::COUNT) == 3);
@@ -572,6 +636,16 @@ result<void> engine::create_statistics_manager(init_list& list)
 
     m_stats_frame_time_game = m_statistics->find_or_create_channel("frame time/game", 1.0f);
     m_stats_frame_rate = m_statistics->find_or_create_channel("frame rate");
+    m_stats_tasks_executed = m_statistics->find_or_create_channel("task scheduler/tasks executed");
+    m_stats_task_steals = m_statistics->find_or_create_channel("task scheduler/steals");
+    m_stats_task_steal_contention = m_statistics->find_or_create_channel("task scheduler/steal contention");
+    m_stats_task_lock_contention = m_statistics->find_or_create_channel("task scheduler/lock contention");
+    m_stats_task_boxed = m_statistics->find_or_create_channel("task scheduler/boxed tasks");
+
+    for (size_t i = 0; i < static_cast<int>(task_priority::COUNT); i++)
+    {
+        m_stats_task_queue_latency[i] = m_statistics->find_or_create_channel(string_format("task scheduler/queue latency/%s", task_priority_strings[i]).c_str());
+    }
 
     return true;
 }
@@ -583,10 +657,34 @@ result<void> engine::destroy_statistics_manager()
     return true;
 }
 
+result<void> engine::create_memory_budgets(init_list& list)
+{
+    m_memory_budgets = std::make_unique<memory_budgets>();
+
+    return true;
+}
+
+result<void> engine::destroy_memory_budgets()
+{
+    m_memory_budgets = nullptr;
+
+    return true;
+}
+
 result<void> engine::create_asset_manager(init_list& list)
 {
+    m_content_hash_index = std::make_unique<content_hash_index>(get_asset_cache_dir() / "content_hashes.index");
     m_asset_manager = std::make_unique<asset_manager>(get_platform(), get_config());
-    m_asset_manager->register_cache(std::make_unique<asset_cache_disk>("local-cache", "cache", false));
+
+    // If a packed archive of the cache exists, search it before the loose files in the cache.
+    std::filesystem::path archive_path = get_asset_cache_dir() / string_format("%s.archive", to_string(get_platform()).c_str());
+    if (std::shared_ptr<asset_archive> archive = asset_archive::open(archive_path))
+    {
+        m_filesystem->register_handler("archive-cache", 0, std::make_unique<virtual_file_system_archive_handler>(archive));
+        m_asset_manager->register_cache(std::make_unique<asset_cache_archive>(archive, get_platform(), "archive-cache", "cache"));
+    }
+
+    m_local_asset_cache_id = m_asset_manager->register_cache(std::make_unique<asset_cache_disk>("local-cache", "cache", false));
 
     m_asset_database = std::make_unique<asset_database>(m_asset_manager.get());
 
@@ -597,6 +695,34 @@ result<void> engine::destroy_asset_manager()
 {
     m_asset_database = nullptr;
     m_asset_manager = nullptr;
+    m_content_hash_index = nullptr;
+
+    return true;
+}
+
+result<void> engine::create_shared_asset_cache(init_list& list)
+{
+    std::string socket_path = cvar_asset_cache_shared_socket.get();
+    if (socket_path.empty())
+    {
+        return true;
+    }
+
+    db_log(engine, "Shared asset cache socket: %s", socket_path.c_str());
+
+    // Modification times differ between machines, so entries can only be shared if they are
+    // identified by the content of their source files.
+    cvar_asset_cache_content_hash.set(true);
+
+    // The shared cache is only known once the config is loaded, so swap the local cache out for 
+    // one tiered in front of the shared cache. Nothing is loaded before this point so the
+    // local cache is not in use.
+    m_asset_manager->unregister_cache(m_local_asset_cache_id);
+    m_local_asset_cache_id = m_asset_manager->register_cache(std::make_unique<asset_cache_tiered>(
+        std::make_unique<asset_cache_disk>("local-cache", "cache", false),
+        std::make_unique<asset_cache_socket_transport>(socket_path),
+        "local-cache:staging"
+    ));
 
     return true;
 }
@@ -841,10 +967,45 @@ void engine::load_world(const char* path)
 {
     db_log(engine, "Requesting load of world: %s", path);
 
+    // Snapshot the heap so we can diff it against the state once the world has loaded.
+    if (memory_profiler* profiler = memory_profiler::try_get())
+    {
+        profiler->take_snapshot(string_format("Before load: %s", path).c_str());
+    }
+
+    if (cvar_asset_load_trace.get())
+    {
+        m_asset_manager->begin_load_trace(path);
+    }
+
     m_loading_world = m_asset_manager->request_asset<scene>(path, 0);
     m_loading_world_start_time = get_seconds();
 }
 
+void engine::save_load_trace(asset_load_trace& trace, const std::string& root_path)
+{
+    constexpr size_t k_max_summary_assets = 20;
+    const char* trace_path = "temp:asset_load_trace.json";
+
+    std::string summary = trace.export_summary(root_path, k_max_summary_assets);
+    for (const std::string& line : string_split(summary, "\n"))
+    {
+        db_log(engine, "%s", line.c_str());
+    }
+
+    std::unique_ptr<stream> output = virtual_file_system::get().open(trace_path, true);
+    if (!output)
+    {
+        db_warning(engine, "Failed to open '%s' to write asset load trace to.", trace_path);
+        return;
+    }
+
+    std::string json = trace.export_chrome_trace();
+    output->write(json.c_str(), json.size());
+
+    db_log(engine, "Written asset load trace to: %s", trace_path);
+}
+
 bool engine::is_loading_world()
 {
     return m_loading_world.is_valid();
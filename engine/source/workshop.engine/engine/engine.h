@@ -9,6 +9,7 @@
 #include "workshop.core/utils/frame_time.h"
 #include "workshop.core/utils/singleton.h"
 #include "workshop.core/utils/event.h"
+#include "workshop.core/async/task_scheduler.h"
 #include "workshop.engine/assets/scene/scene.h"
 #include "workshop.assets/asset_manager.h"
 
@@ -25,9 +26,11 @@ class presenter;
 class renderer;
 class asset_manager;
 class asset_database;
+class content_hash_index;
 class virtual_file_system;
 class async_io_manager;
 class statistics_manager;
+class memory_budgets;
 class task_scheduler;
 class statistics_channel;
 class object_manager;
@@ -220,14 +223,22 @@ private:
     result<void> create_statistics_manager(init_list& list);
     result<void> destroy_statistics_manager();
 
+    result<void> create_memory_budgets(init_list& list);
+    result<void> destroy_memory_budgets();
+
     result<void> create_asset_manager(init_list& list);
     result<void> destroy_asset_manager();
 
+    result<void> create_shared_asset_cache(init_list& list);
+
     result<void> create_default_world(init_list& list);
     result<void> destroy_default_world();
 
     result<void> load_config(init_list& list);
 
+    // Logs the summary of a world load trace and writes out its timeline as a chrome trace.
+    void save_load_trace(asset_load_trace& trace, const std::string& root_path);
+
 protected:
 
     std::vector<std::unique_ptr<world>> m_worlds;
@@ -253,8 +264,11 @@ protected:
     std::unique_ptr<async_copy_manager> m_async_copy_manager;
 
     std::unique_ptr<statistics_manager> m_statistics;
+    std::unique_ptr<memory_budgets> m_memory_budgets;
     std::unique_ptr<asset_manager> m_asset_manager;
     std::unique_ptr<asset_database> m_asset_database;
+    std::unique_ptr<content_hash_index> m_content_hash_index;
+    asset_manager::cache_id m_local_asset_cache_id;
 
     ri_interface_type m_render_interface_type;
     window_interface_type m_window_interface_type;
@@ -280,6 +294,14 @@ protected:
 
     statistics_channel* m_stats_frame_time_game;
     statistics_channel* m_stats_frame_rate;
+    statistics_channel* m_stats_tasks_executed;
+    statistics_channel* m_stats_task_steals;
+    statistics_channel* m_stats_task_steal_contention;
+    statistics_channel* m_stats_task_lock_contention;
+    statistics_channel* m_stats_task_boxed;
+    std::array<statistics_channel*, static_cast<int>(task_priority::COUNT)> m_stats_task_queue_latency;
+
+    task_scheduler::statistics m_last_task_statistics;
 
     bool m_mouse_over_viewport = false;
 
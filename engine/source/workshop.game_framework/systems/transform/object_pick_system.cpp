@@ -41,7 +41,7 @@ void object_pick_system::model_ray_intersects(object handle, const ray& target_r
     }
 
     db_assert(position_vertex_stream->data_type == geometry_data_type::t_float3);
-    vector3* position_array = reinterpret_cast<vector3*>(position_vertex_stream->data.data());
+    vector3* position_array = reinterpret_cast<vector3*>(position_vertex_stream->get_data().data());
 
     // Check for any sub-mesh intersection.
     std::vector<model::mesh_info*> meshes_to_test;
@@ -71,8 +71,11 @@ void object_pick_system::model_ray_intersects(object handle, const ray& target_r
 
     {
         profile_marker(profile_colors::system, "build transformed vertices");
-        parallel_for("build transformed vertices", task_queue::loading, vertex_count, [&transformed_verts, &transform, &position_array](size_t i) {
-            transformed_verts[i] = position_array[i] * transform;
+        parallel_for_range("build transformed vertices", task_queue::loading, 0, vertex_count, 0, [&transformed_verts, &transform, &position_array](const parallel_range& range) {
+            for (size_t i = range.begin; i < range.end; i++)
+            {
+                transformed_verts[i] = position_array[i] * transform;
+            }
         });
     }
 
@@ -85,12 +88,14 @@ void object_pick_system::model_ray_intersects(object handle, const ray& target_r
 
         aabb world_bounds = obb(mesh->bounds, transform).get_aligned_bounds();
 
+        std::span<uint32_t> indices = mesh->get_indices();
+
         // *shudder*
-        for (size_t i = 0; i < mesh->indices.size(); i += 3)
+        for (size_t i = 0; i < indices.size(); i += 3)
         {
-            uint32_t i1 = mesh->indices[i];
-            uint32_t i2 = mesh->indices[i + 1];
-            uint32_t i3 = mesh->indices[i + 2];
+            uint32_t i1 = indices[i];
+            uint32_t i2 = indices[i + 1];
+            uint32_t i3 = indices[i + 2];
 
             triangle tri(transformed_verts[i1], transformed_verts[i2], transformed_verts[i3]);
 
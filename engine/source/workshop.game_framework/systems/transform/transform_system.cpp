@@ -184,9 +184,12 @@ void transform_system::update_transform(transform_component* transform, transfor
     }
     else
     { 
-        parallel_for("update child transforms", task_queue::standard, transform->children.size(), [this, &transform](size_t index) {
-            transform_component* child = transform->children[index].get(&m_manager);
-            update_transform(child, transform);
+        parallel_for_range("update child transforms", task_queue::standard, 0, transform->children.size(), 0, [this, transform](const parallel_range& range) {
+            for (size_t i = range.begin; i < range.end; i++)
+            {
+                transform_component* child = transform->children[i].get(&m_manager);
+                update_transform(child, transform);
+            }
         });
     }
 }
@@ -198,29 +201,18 @@ void transform_system::step(const frame_time& time)
     // Execute all commands.
     flush_command_queue();
 
-    // Find root of dirty trees.
-    task_scheduler& scheduler = task_scheduler::get();
-    size_t split_factor = scheduler.get_worker_count(task_queue::standard) * 4;
-    size_t chunk_size = static_cast<size_t>(math::ceil(filter.size() / static_cast<float>(split_factor)));
-
-    m_dirty_roots.resize(split_factor);
-    m_dirty_roots_list.resize(split_factor);
+    // Find root of dirty trees. Each range gathers the roots it finds into its own list, 
+    // which are then concatenated together.
+    using root_list = std::vector<transform_component*>;
 
-    // Combine lists together.
+    root_list dirty_roots;
     {
         profile_marker(profile_colors::system, "find dirty roots");
         
-        parallel_for("find dirty roots", task_queue::standard, split_factor, [this, chunk_size, &filter](size_t index) {
+        dirty_roots = parallel_reduce("find dirty roots", task_queue::standard, 0, filter.size(), 0, root_list(), [this, &filter](const parallel_range& range, root_list roots) {
             
-            size_t start_index = (index * chunk_size);
-            size_t end_index = std::min(filter.size(), start_index + chunk_size);
-
-            m_dirty_roots[index].clear();
-            m_dirty_roots_list[index].clear();
-
-            for (size_t i = start_index; i < end_index; i++)
+            for (size_t i = range.begin; i < range.end; i++)
             {
-                object obj = filter.get_object(i);
                 transform_component* transform = filter.get_component<transform_component>(i);
 
                 if (transform->is_dirty)
@@ -236,30 +228,37 @@ void transform_system::step(const frame_time& time)
                         transform = transform->parent.get(&m_manager);
                     }
 
-                    if (m_dirty_roots[index].emplace(last_dirty).second)
+                    // Siblings are generally next to each other, so this catches most duplicates
+                    // before they get to the combine step.
+                    if (roots.empty() || roots.back() != last_dirty)
                     {
-                        m_dirty_roots_list[index].push_back(last_dirty);
+                        roots.push_back(last_dirty);
                     }
                 }
             }
 
+            return roots;
+
+        }, [](root_list lower, root_list upper) {
+
+            lower.insert(lower.end(), upper.begin(), upper.end());
+            return lower;
+
         });
     }
 
-    // Combine the lists from each split.
+    // Remove any duplicate roots found by different ranges.
     {
         profile_marker(profile_colors::system, "combine dirty roots list");
 
-        for (size_t i = 1; i < split_factor; i++)
-        {
-            std::vector<transform_component*>& split_list = m_dirty_roots_list[i];
+        m_dirty_roots.clear();
+        m_dirty_roots_list.clear();
 
-            for (transform_component* component : split_list)
+        for (transform_component* component : dirty_roots)
+        {
+            if (m_dirty_roots.emplace(component).second)
             {
-                if (m_dirty_roots[0].emplace(component).second)
-                {
-                    m_dirty_roots_list[0].push_back(component);
-                }
+                m_dirty_roots_list.push_back(component);
             }
         }
     }
@@ -268,11 +267,15 @@ void transform_system::step(const frame_time& time)
     {
         profile_marker(profile_colors::system, "update dirty roots");
         
-        parallel_for("update dirty roots", task_queue::standard, m_dirty_roots_list[0].size(), [this](size_t index) {
+        parallel_for_range("update dirty roots", task_queue::standard, 0, m_dirty_roots_list.size(), 0, [this](const parallel_range& range) {
             profile_marker(profile_colors::system, "update dirty roots task");
-            transform_component* component = m_dirty_roots_list[0][index];
-            transform_component* parent = m_dirty_roots_list[0][index]->parent.get(&m_manager);
-            update_transform(component, parent);
+
+            for (size_t i = range.begin; i < range.end; i++)
+            {
+                transform_component* component = m_dirty_roots_list[i];
+                transform_component* parent = component->parent.get(&m_manager);
+                update_transform(component, parent);
+            }
         });
     }
 }
@@ -52,8 +52,8 @@ private:
     // How many children a component needs before running in parallel.
     static constexpr inline size_t k_async_update_transform_threshold = 16;
 
-    std::vector<std::unordered_set<transform_component*>> m_dirty_roots;
-    std::vector<std::vector<transform_component*>> m_dirty_roots_list;
+    std::unordered_set<transform_component*> m_dirty_roots;
+    std::vector<transform_component*> m_dirty_roots_list;
 
 };
 
@@ -0,0 +1,200 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.heap_benchmark/heap_benchmark_app.h"
+#include "workshop.heap_benchmark/reference_memory_heap.h"
+#include "workshop.core/filesystem/file.h"
+#include "workshop.core/containers/string.h"
+#include "workshop.core/containers/memory_heap.h"
+#include "workshop.core/utils/time.h"
+#include "workshop.core/debug/debug.h"
+
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+std::shared_ptr<ws::app> make_app()
+{
+    return std::make_shared<ws::heap_benchmark_app>();
+}
+
+namespace ws {
+
+std::string heap_benchmark_app::get_name()
+{
+    return "heap_benchmark";
+}
+
+result<void> heap_benchmark_app::parse_command_line()
+{
+    const std::vector<std::string>& args = get_command_line();
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        const std::string& arg = args[i];
+        bool has_value = (i + 1 < args.size());
+
+        if (arg == "-operations" && has_value)
+        {
+            result<uint64_t> value = from_string<uint64_t>(args[++i]);
+            if (!value || value.get() == 0)
+            {
+                db_error(core, "Invalid operation count: %s", args[i].c_str());
+                return standard_errors::invalid_parameter;
+            }
+            m_operations = static_cast<size_t>(value.get());
+        }
+        else if (arg == "-live" && has_value)
+        {
+            result<uint64_t> value = from_string<uint64_t>(args[++i]);
+            if (!value || value.get() == 0)
+            {
+                db_error(core, "Invalid live allocation count: %s", args[i].c_str());
+                return standard_errors::invalid_parameter;
+            }
+            m_live_allocations = static_cast<size_t>(value.get());
+        }
+        else
+        {
+            db_error(core, "Unknown argument: %s", arg.c_str());
+            db_error(core, "Usage: workshop.heap_benchmark [-operations <count>] [-live <count>]");
+            return standard_errors::invalid_parameter;
+        }
+    }
+
+    return true;
+}
+
+result<void> heap_benchmark_app::start()
+{
+    return parse_command_line();
+}
+
+result<void> heap_benchmark_app::stop()
+{
+    return true;
+}
+
+result<void> heap_benchmark_app::loop()
+{
+    // Large enough that the heap is fragmented by the churn rather than exhausted by it.
+    constexpr size_t k_heap_size = 4ull * 1024 * 1024 * 1024;
+
+    struct heap_operation
+    {
+        bool is_alloc;
+        size_t size;
+        size_t alignment;
+
+        // Which live allocation to free, modulo the number alive.
+        size_t victim;
+    };
+
+    // Generate the operations up front with a fixed seed, so both heaps see the same sequence.
+    // The first allocations fill the heap up to the live count, after which allocs and frees
+    // are interleaved at random.
+    std::mt19937_64 random(0x5eed);
+    std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+
+    auto random_range = [&random](size_t min, size_t max) {
+        return std::uniform_int_distribution<size_t>(min, max)(random);
+    };
+
+    std::vector<heap_operation> operations(m_live_allocations + m_operations);
+    for (size_t i = 0; i < operations.size(); i++)
+    {
+        heap_operation& op = operations[i];
+        op.is_alloc = (i < m_live_allocations || chance(random) < 0.5f);
+        op.victim = random_range(0, std::numeric_limits<uint32_t>::max());
+
+        // Mix of the heaps users: small constant buffers and descriptors, upload staging
+        // buffers and 64kb texture tiles.
+        float kind = chance(random);
+        if (kind < 0.6f)
+        {
+            op.size = random_range(16, 4 * 1024);
+            op.alignment = (chance(random) < 0.5f ? 16 : 256);
+        }
+        else if (kind < 0.9f)
+        {
+            op.size = random_range(4 * 1024, 256 * 1024);
+            op.alignment = 256;
+        }
+        else
+        {
+            op.size = random_range(1, 16) * 64 * 1024;
+            op.alignment = 64 * 1024;
+        }
+    }
+
+    db_log(core, "Running %zi heap operations with about %zi live allocations.", m_operations, m_live_allocations);
+
+    auto measure = [&operations](auto& heap, const char* name) {
+        std::vector<size_t> live;
+        live.reserve(operations.size());
+
+        size_t failed_count = 0;
+
+        double start_time = get_seconds();
+
+        for (const heap_operation& op : operations)
+        {
+            if (op.is_alloc)
+            {
+                size_t offset;
+                if (heap.alloc(op.size, op.alignment, offset))
+                {
+                    live.push_back(offset);
+                }
+                else
+                {
+                    failed_count++;
+                }
+            }
+            else if (!live.empty())
+            {
+                size_t index = op.victim % live.size();
+                heap.free(live[index]);
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+
+        double elapsed = get_seconds() - start_time;
+        double ops_per_second = elapsed > 0.0 ? operations.size() / elapsed : 0.0;
+
+        db_log(core, "%-12s %.3f s, %.2f M ops/s, %zi live, %zi failed, %.2f MB remaining",
+            name,
+            elapsed,
+            ops_per_second / 1'000'000.0,
+            live.size(),
+            failed_count,
+            heap.get_remaining() / (1024.0 * 1024.0));
+
+        for (size_t offset : live)
+        {
+            heap.free(offset);
+        }
+
+        if (!heap.empty())
+        {
+            db_warning(core, "%s heap is not empty after freeing every allocation.", name);
+        }
+
+        return elapsed;
+    };
+
+    std::unique_ptr<legacy_memory_heap> legacy = std::make_unique<legacy_memory_heap>(k_heap_size);
+    std::unique_ptr<memory_heap> current = std::make_unique<memory_heap>(k_heap_size);
+
+    db_log(core, "");
+    double legacy_time = measure(*legacy, "first-fit:");
+    double current_time = measure(*current, "tlsf:");
+    db_log(core, "Speedup: %.2fx", current_time > 0.0 ? legacy_time / current_time : 0.0);
+
+    return true;
+}
+
+}; // namespace ws
@@ -0,0 +1,43 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/app/app.h"
+
+#include <string>
+
+namespace ws {
+
+// ================================================================================================
+//  Benchmarks memory_heap by running the same seeded sequence of allocs and frees through a
+//  copy of the old first-fit heap and the current one, and reports operations per second.
+//
+//  The heap is first filled up to the live allocation count, after which allocs and frees are
+//  interleaved at random so the heap is kept fragmented.
+//
+//  Usage: workshop.heap_benchmark [-operations <count>] [-live <count>]
+// ================================================================================================
+class heap_benchmark_app : public app
+{
+public:
+    virtual std::string get_name() override;
+
+protected:
+    virtual result<void> start() override;
+    virtual result<void> loop() override;
+    virtual result<void> stop() override;
+
+private:
+
+    result<void> parse_command_line();
+
+private:
+
+    size_t m_operations = 1'000'000;
+    size_t m_live_allocations = 4096;
+
+};
+
+}; // namespace ws
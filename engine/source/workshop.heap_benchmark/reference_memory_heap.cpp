@@ -0,0 +1,129 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.heap_benchmark/reference_memory_heap.h"
+#include "workshop.core/math/math.h"
+
+namespace ws {
+
+legacy_memory_heap::legacy_memory_heap(size_t size)
+{
+    m_remaining = size;
+    m_blocks.push_back({ 0, size, false });
+}
+
+legacy_memory_heap::~legacy_memory_heap()
+{
+}
+
+bool legacy_memory_heap::alloc(size_t size, size_t alignment, size_t& offset)
+{
+    for (size_t i = 0; i < m_blocks.size(); i++)
+    {
+        block& curr_block = m_blocks[i];
+        if (!curr_block.used && curr_block.size >= size)
+        {
+            size_t alignment_padding = math::round_up_multiple(curr_block.offset, alignment) - curr_block.offset;
+            size_t size_required = size + alignment_padding;
+            if (curr_block.size >= size_required)
+            {
+                offset = curr_block.offset + alignment_padding;
+                curr_block.used = true;
+
+                if (curr_block.size > size_required)
+                {
+                    block new_block;
+                    new_block.offset = curr_block.offset + size_required;
+                    new_block.size = curr_block.size - size_required;
+                    new_block.used = false;
+
+                    curr_block.size = size_required;
+
+                    m_blocks.insert(m_blocks.begin() + i + 1, new_block);
+                }
+
+                m_remaining -= size_required;
+
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool legacy_memory_heap::get_block_index(size_t offset, size_t& index)
+{
+    for (size_t i = 0; i < m_blocks.size(); i++)
+    {
+        block& block = m_blocks[i];
+        if (offset >= block.offset && offset < block.offset + block.size && block.used)
+        {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool legacy_memory_heap::empty()
+{
+    return (m_blocks.size() == 1 && !m_blocks[0].used);
+}
+
+void legacy_memory_heap::coalesce(size_t index)
+{
+    // Compact current block into previous block.
+    while (index > 0 && index < m_blocks.size())
+    {
+        block& prev_block = m_blocks[index - 1];
+        block& curr_block = m_blocks[index];
+
+        if (!prev_block.used && !curr_block.used)
+        {
+            prev_block.size += curr_block.size;
+            m_blocks.erase(m_blocks.begin() + index);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    // Compact current block into next block.
+    while (index >= 0 && index < m_blocks.size() - 1)
+    {
+        block& curr_block = m_blocks[index];
+        block& next_block = m_blocks[index + 1];
+
+        if (!curr_block.used && !next_block.used)
+        {
+            curr_block.size += next_block.size;
+            m_blocks.erase(m_blocks.begin() + index + 1);
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+void legacy_memory_heap::free(size_t offset)
+{
+    size_t index;
+    if (get_block_index(offset, index))
+    {
+        m_remaining += m_blocks[index].size;
+
+        m_blocks[index].used = false;
+        coalesce(index);
+    }
+}
+
+size_t legacy_memory_heap::get_remaining()
+{
+    return m_remaining;
+}
+
+}; // namespace ws
@@ -0,0 +1,58 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ws {
+
+// ================================================================================================
+//  Copy of the first-fit memory_heap that was replaced by the current two-level segregated
+//  fit implementation. Kept so the heap benchmark can compare the two.
+//
+//  Blocks are kept in a vector sorted by offset, so alloc, free and coalescing are all linear
+//  in the number of blocks.
+// ================================================================================================
+class legacy_memory_heap
+{
+public:
+    legacy_memory_heap(size_t size);
+    ~legacy_memory_heap();
+
+    // Allocates a block within the heap with the given size and alignment. Returns
+    // false on failure. On success, the offset of the block in the heap will be returned
+    // in offset.
+    bool alloc(size_t size, size_t alignment, size_t& offset);
+
+    // Frees a block in the heap previously allocated with alloc.
+    void free(size_t offset);
+
+    // Returns true if there are no allocations in the heap.
+    bool empty();
+
+    // Gets remaining size to be allocated.
+    size_t get_remaining();
+
+private:
+    bool get_block_index(size_t offset, size_t& index);
+
+    void coalesce(size_t index);
+
+    struct block
+    {
+        size_t offset;
+        size_t size;
+        bool used = false;
+    };
+
+    std::vector<block> m_blocks;
+
+    size_t m_remaining = 0;
+
+};
+
+}; // namespace ws
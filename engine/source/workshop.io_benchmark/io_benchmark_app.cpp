@@ -0,0 +1,475 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.io_benchmark/io_benchmark_app.h"
+#include "workshop.core/filesystem/file.h"
+#include "workshop.core/filesystem/disk_stream.h"
+#include "workshop.core/filesystem/compressed_stream.h"
+#include "workshop.core/cvar/core_cvars.h"
+#include "workshop.core/containers/string.h"
+#include "workshop.core/utils/time.h"
+#include "workshop.core/debug/debug.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+std::shared_ptr<ws::app> make_app()
+{
+    return std::make_shared<ws::io_benchmark_app>();
+}
+
+namespace ws {
+
+std::string io_benchmark_app::get_name()
+{
+    return "io_benchmark";
+}
+
+result<void> io_benchmark_app::parse_command_line()
+{
+    const std::vector<std::string>& args = get_command_line();
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        const std::string& arg = args[i];
+        bool has_value = (i + 1 < args.size());
+
+        if (arg == "-block_size" && has_value)
+        {
+            result<uint64_t> value = from_string<uint64_t>(args[++i]);
+            if (!value || value.get() == 0)
+            {
+                db_error(core, "Invalid block size: %s", args[i].c_str());
+                return standard_errors::invalid_parameter;
+            }
+            m_block_size = static_cast<size_t>(value.get()) * 1024;
+        }
+        else if (arg == "-queue_depth" && has_value)
+        {
+            result<uint64_t> value = from_string<uint64_t>(args[++i]);
+            if (!value || value.get() == 0)
+            {
+                db_error(core, "Invalid queue depth: %s", args[i].c_str());
+                return standard_errors::invalid_parameter;
+            }
+            m_queue_depth = static_cast<size_t>(value.get());
+        }
+        else if (arg == "-element_size" && has_value)
+        {
+            result<uint64_t> value = from_string<uint64_t>(args[++i]);
+            if (!value || value.get() == 0 || value.get() > 4096)
+            {
+                db_error(core, "Invalid element size: %s", args[i].c_str());
+                return standard_errors::invalid_parameter;
+            }
+            m_element_size = static_cast<size_t>(value.get());
+        }
+        else if (arg == "-compress" && has_value)
+        {
+            result<uint64_t> value = from_string<uint64_t>(args[++i]);
+            if (!value || value.get() > 9)
+            {
+                db_error(core, "Invalid compression level: %s", args[i].c_str());
+                return standard_errors::invalid_parameter;
+            }
+            m_compression_level = static_cast<int>(value.get());
+        }
+        else if (arg == "-chunk_size" && has_value)
+        {
+            result<uint64_t> value = from_string<uint64_t>(args[++i]);
+            if (!value || value.get() == 0)
+            {
+                db_error(core, "Invalid chunk size: %s", args[i].c_str());
+                return standard_errors::invalid_parameter;
+            }
+            m_chunk_size = static_cast<size_t>(value.get()) * 1024;
+        }
+        else if (arg == "-buffered")
+        {
+            m_buffered = true;
+        }
+        else if (arg == "-stream")
+        {
+            m_stream = true;
+        }
+        else if (m_directory.empty())
+        {
+            m_directory = arg;
+        }
+        else
+        {
+            db_error(core, "Unknown argument: %s", arg.c_str());
+            return standard_errors::invalid_parameter;
+        }
+    }
+
+    if (m_directory.empty() || !std::filesystem::is_directory(m_directory))
+    {
+        db_error(core, "Usage: workshop.io_benchmark <directory> [-block_size <kb>] [-queue_depth <count>] [-buffered] [-stream] [-element_size <bytes>] [-compress <level>] [-chunk_size <kb>]");
+        return standard_errors::invalid_parameter;
+    }
+
+    return true;
+}
+
+result<void> io_benchmark_app::start()
+{
+    if (result<void> ret = parse_command_line(); !ret)
+    {
+        return ret;
+    }
+
+    cvar_async_io_direct.set(!m_buffered);
+
+    // Used to compress and decompress chunks in parallel.
+    task_scheduler::init_state init_state;
+    init_state.worker_count = std::thread::hardware_concurrency();
+    init_state.use_work_stealing = true;
+    init_state.queue_weights.fill(1.0f);
+    m_task_scheduler = std::make_unique<task_scheduler>(init_state);
+
+    m_io_manager = async_io_manager::create();
+
+    return true;
+}
+
+result<void> io_benchmark_app::stop()
+{
+    m_io_manager = nullptr;
+    m_task_scheduler = nullptr;
+
+    return true;
+}
+
+double io_benchmark_app::get_percentile(const std::vector<double>& sorted_latencies, double percentile)
+{
+    if (sorted_latencies.empty())
+    {
+        return 0.0;
+    }
+
+    size_t index = static_cast<size_t>(percentile * (sorted_latencies.size() - 1) + 0.5);
+    return sorted_latencies[std::min(index, sorted_latencies.size() - 1)];
+}
+
+result<void> io_benchmark_app::run_stream_benchmark()
+{
+    std::vector<std::filesystem::path> files;
+    size_t total_bytes = 0;
+
+    for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(m_directory))
+    {
+        if (entry.is_regular_file())
+        {
+            files.push_back(entry.path());
+            total_bytes += static_cast<size_t>(entry.file_size());
+        }
+    }
+
+    db_log(core, "Streaming %zi files (%.2f MB) in %zi byte elements.", files.size(), total_bytes / (1024.0 * 1024.0), m_element_size);
+
+    std::vector<char> element(m_element_size);
+
+    // Stdio, reading and querying the position for each element as the serializers used to.
+    auto read_stdio = [&element](const std::filesystem::path& path) -> size_t {
+        FILE* file = fopen(path.string().c_str(), "rb");
+        if (file == nullptr)
+        {
+            return 0;
+        }
+
+        size_t bytes_read = 0;
+        while (fread(element.data(), element.size(), 1, file) == 1)
+        {
+            bytes_read = static_cast<size_t>(ftell(file));
+        }
+
+        fclose(file);
+        return bytes_read;
+    };
+
+    auto read_disk_stream = [&element](const std::filesystem::path& path) -> size_t {
+        disk_stream stream;
+        if (!stream.open(path, false))
+        {
+            return 0;
+        }
+
+        size_t bytes_read = 0;
+        while (stream.read(element.data(), element.size()) == element.size())
+        {
+            bytes_read = stream.position();
+        }
+
+        stream.close();
+        return bytes_read;
+    };
+
+    // Make sure both runs read from the os file cache, so we measure the cost of the calls rather than the disk.
+    for (const std::filesystem::path& path : files)
+    {
+        read_disk_stream(path);
+    }
+
+    auto measure = [&files](auto& reader, const char* name) {
+        double start_time = get_seconds();
+
+        size_t bytes_read = 0;
+        for (const std::filesystem::path& path : files)
+        {
+            bytes_read += reader(path);
+        }
+
+        double elapsed = get_seconds() - start_time;
+        double throughput = elapsed > 0.0 ? (bytes_read / (1024.0 * 1024.0)) / elapsed : 0.0;
+
+        db_log(core, "%-12s %.3f s, %.2f MB/s", name, elapsed, throughput);
+
+        return elapsed;
+    };
+
+    db_log(core, "");
+    double stdio_time = measure(read_stdio, "stdio:");
+    double disk_stream_time = measure(read_disk_stream, "disk_stream:");
+    db_log(core, "Speedup: %.2fx", disk_stream_time > 0.0 ? stdio_time / disk_stream_time : 0.0);
+
+    return true;
+}
+
+result<void> io_benchmark_app::run_compress_benchmark()
+{
+    std::vector<std::filesystem::path> files;
+    size_t total_bytes = 0;
+
+    for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(m_directory))
+    {
+        if (entry.is_regular_file())
+        {
+            files.push_back(entry.path());
+            total_bytes += static_cast<size_t>(entry.file_size());
+        }
+    }
+
+    std::filesystem::path output_directory = std::filesystem::temp_directory_path() / "workshop.io_benchmark";
+    std::filesystem::remove_all(output_directory);
+    std::filesystem::create_directories(output_directory);
+
+    db_log(core, "Compressing %zi files (%.2f MB) at level %i in %zi KB chunks.", files.size(), total_bytes / (1024.0 * 1024.0), m_compression_level, m_chunk_size / 1024);
+
+    // Write out compressed copies of each file.
+    std::vector<std::filesystem::path> compressed_files;
+    size_t compressed_bytes = 0;
+
+    std::vector<char> buffer;
+    double compress_start_time = get_seconds();
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        disk_stream input;
+        if (!input.open(files[i], false))
+        {
+            db_warning(core, "Failed to open: %s", files[i].string().c_str());
+            continue;
+        }
+
+        buffer.resize(input.length());
+        input.read(buffer.data(), buffer.size());
+        input.close();
+
+        std::filesystem::path output_path = output_directory / string_format("%zi.bin", i);
+
+        std::unique_ptr<disk_stream> output = std::make_unique<disk_stream>();
+        if (!output->open(output_path, true))
+        {
+            db_warning(core, "Failed to open: %s", output_path.string().c_str());
+            continue;
+        }
+
+        compressed_stream compressed(std::move(output), m_compression_level, m_chunk_size);
+        compressed.write(buffer.data(), buffer.size());
+        if (!compressed.finish())
+        {
+            db_warning(core, "Failed to write: %s", output_path.string().c_str());
+            continue;
+        }
+
+        compressed_files.push_back(output_path);
+        compressed_bytes += static_cast<size_t>(std::filesystem::file_size(output_path));
+    }
+
+    double compress_elapsed = get_seconds() - compress_start_time;
+
+    auto read_disk_stream = [&buffer](const std::filesystem::path& path) -> size_t {
+        disk_stream stream;
+        if (!stream.open(path, false))
+        {
+            return 0;
+        }
+
+        buffer.resize(stream.length());
+        size_t bytes_read = stream.read(buffer.data(), buffer.size());
+        stream.close();
+        return bytes_read;
+    };
+
+    auto read_compressed_stream = [&buffer](const std::filesystem::path& path) -> size_t {
+        std::unique_ptr<disk_stream> input = std::make_unique<disk_stream>();
+        if (!input->open(path, false))
+        {
+            return 0;
+        }
+
+        std::unique_ptr<stream> stream = compressed_stream::open_for_reading(std::move(input));
+        buffer.resize(stream->length());
+        size_t bytes_read = stream->read(buffer.data(), buffer.size());
+        stream->close();
+        return bytes_read;
+    };
+
+    // Both are read from the os file cache, so this measures the cost of decompression
+    // against the raw read. The saving in disk bandwidth is shown by the size ratio.
+    auto measure = [](auto& reader, const std::vector<std::filesystem::path>& paths, const char* name) {
+        for (const std::filesystem::path& path : paths)
+        {
+            reader(path);
+        }
+
+        double start_time = get_seconds();
+
+        size_t bytes_read = 0;
+        for (const std::filesystem::path& path : paths)
+        {
+            bytes_read += reader(path);
+        }
+
+        double elapsed = get_seconds() - start_time;
+        double throughput = elapsed > 0.0 ? (bytes_read / (1024.0 * 1024.0)) / elapsed : 0.0;
+
+        db_log(core, "%-12s %.3f s, %.2f MB/s", name, elapsed, throughput);
+    };
+
+    db_log(core, "");
+    db_log(core, "Compressed in %.3f s.", compress_elapsed);
+    db_log(core, "Disk size: %.2f MB -> %.2f MB (%.1f%%)",
+        total_bytes / (1024.0 * 1024.0),
+        compressed_bytes / (1024.0 * 1024.0),
+        total_bytes > 0 ? (compressed_bytes * 100.0) / total_bytes : 0.0);
+
+    measure(read_disk_stream, files, "raw:");
+    measure(read_compressed_stream, compressed_files, "compressed:");
+
+    std::filesystem::remove_all(output_directory);
+
+    return true;
+}
+
+result<void> io_benchmark_app::loop()
+{
+    if (m_stream)
+    {
+        return run_stream_benchmark();
+    }
+
+    if (m_compression_level >= 0)
+    {
+        return run_compress_benchmark();
+    }
+
+    // Split every file into blocks.
+    std::vector<block> blocks;
+    size_t file_count = 0;
+    size_t total_bytes = 0;
+
+    for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(m_directory))
+    {
+        if (!entry.is_regular_file())
+        {
+            continue;
+        }
+
+        std::string path = entry.path().string();
+        size_t file_size = static_cast<size_t>(entry.file_size());
+
+        for (size_t offset = 0; offset < file_size; offset += m_block_size)
+        {
+            block& new_block = blocks.emplace_back();
+            new_block.path = path;
+            new_block.offset = offset;
+            new_block.size = std::min(m_block_size, file_size - offset);
+        }
+
+        file_count++;
+        total_bytes += file_size;
+    }
+
+    db_log(core, "Streaming %zi files (%.2f MB) in %zi blocks of %zi KB, queue depth %zi, %s io.",
+        file_count,
+        total_bytes / (1024.0 * 1024.0),
+        blocks.size(),
+        m_block_size / 1024,
+        m_queue_depth,
+        m_buffered ? "buffered" : "direct");
+
+    // Keep the queue topped up until every block has been read. Latency is measured from
+    // the point each request is made until its completion callback runs.
+    std::vector<double> latencies(blocks.size(), 0.0);
+    std::vector<async_io_request::ptr> in_flight;
+
+    std::atomic_size_t completed_count = 0;
+    std::atomic_size_t failed_count = 0;
+    size_t next_block = 0;
+    float peak_bandwidth = 0.0f;
+
+    double start_time = get_seconds();
+
+    while (completed_count.load() < blocks.size())
+    {
+        while (next_block < blocks.size() && (next_block - completed_count.load()) < m_queue_depth)
+        {
+            size_t index = next_block++;
+            block& request_block = blocks[index];
+
+            double request_time = get_seconds();
+            async_io_request::ptr request = m_io_manager->request(request_block.path.c_str(), request_block.offset, request_block.size, async_io_request_options::none);
+            in_flight.push_back(request);
+
+            request->add_completion_callback([&latencies, &completed_count, &failed_count, request = request.get(), index, request_time]() {
+                latencies[index] = get_seconds() - request_time;
+                if (request->has_failed())
+                {
+                    failed_count++;
+                }
+                completed_count++;
+            });
+        }
+
+        // Drop completed requests so we only hold onto the data of those in flight.
+        std::erase_if(in_flight, [](const async_io_request::ptr& request) {
+            return request->is_complete();
+        });
+
+        peak_bandwidth = std::max(peak_bandwidth, m_io_manager->get_current_bandwidth());
+
+        std::this_thread::yield();
+    }
+
+    double elapsed = get_seconds() - start_time;
+
+    std::sort(latencies.begin(), latencies.end());
+
+    double throughput = elapsed > 0.0 ? (total_bytes / (1024.0 * 1024.0)) / elapsed : 0.0;
+
+    db_log(core, "");
+    db_log(core, "Completed in %.3f s, %zi failed.", elapsed, failed_count.load());
+    db_log(core, "Throughput: %.2f MB/s (peak reported bandwidth %.2f MB/s)", throughput, peak_bandwidth / (1024.0 * 1024.0));
+    db_log(core, "Latency p50: %.3f ms", get_percentile(latencies, 0.50) * 1000.0);
+    db_log(core, "Latency p90: %.3f ms", get_percentile(latencies, 0.90) * 1000.0);
+    db_log(core, "Latency p99: %.3f ms", get_percentile(latencies, 0.99) * 1000.0);
+    db_log(core, "Latency max: %.3f ms", get_percentile(latencies, 1.00) * 1000.0);
+
+    return true;
+}
+
+}; // namespace ws
@@ -0,0 +1,79 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/app/app.h"
+#include "workshop.core/filesystem/async_io_manager.h"
+#include "workshop.core/async/task_scheduler.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace ws {
+
+// ================================================================================================
+//  Benchmarks the async_io_manager by streaming every file in a directory (typically a folder
+//  of compiled textures) in fixed size blocks, and reports throughput and request latency.
+//
+//  With -stream it instead compares the throughput of deserializing every file as a sequence of
+//  small values (as the asset serializers do) through disk_stream against a plain fread/ftell per
+//  value, which is how disk_stream used to read.
+//
+//  With -compress it writes a copy of every file through a compressed_stream at the given level
+//  to a temporary directory, then compares the size on disk and time taken to read the original
+//  and compressed copies in full.
+//
+//  Usage: workshop.io_benchmark <directory> [-block_size <kb>] [-queue_depth <count>] [-buffered]
+//                               [-stream] [-element_size <bytes>]
+//                               [-compress <level>] [-chunk_size <kb>]
+// ================================================================================================
+class io_benchmark_app : public app
+{
+public:
+    virtual std::string get_name() override;
+
+protected:
+    virtual result<void> start() override;
+    virtual result<void> loop() override;
+    virtual result<void> stop() override;
+
+private:
+
+    struct block
+    {
+        std::string path;
+        size_t offset;
+        size_t size;
+    };
+
+    result<void> parse_command_line();
+
+    // Compares reading files in small elements through disk_stream against stdio.
+    result<void> run_stream_benchmark();
+
+    // Compares the size and read time of files against copies written through a compressed_stream.
+    result<void> run_compress_benchmark();
+
+    // Gets the given percentile (0-1) of a sorted list of latencies.
+    double get_percentile(const std::vector<double>& sorted_latencies, double percentile);
+
+private:
+
+    std::filesystem::path m_directory;
+    size_t m_block_size = 1024 * 1024;
+    size_t m_queue_depth = 256;
+    bool m_buffered = false;
+    bool m_stream = false;
+    size_t m_element_size = 4;
+    int m_compression_level = -1;
+    size_t m_chunk_size = 128 * 1024;
+
+    std::unique_ptr<task_scheduler> m_task_scheduler;
+    std::unique_ptr<async_io_manager> m_io_manager;
+
+};
+
+}; // namespace ws
@@ -69,7 +69,7 @@ void jolt_pi_job_system::QueueJob(jolt_pi_job_system::Job* inJob)
     task_handle handle = scheduler.create_task("jolt physics", task_queue::standard, [inJob]() {
         inJob->Execute();
     });
-    scheduler.dispatch_tasks({ handle });
+    handle.dispatch();
 }
 
 void jolt_pi_job_system::QueueJobs(jolt_pi_job_system::Job** inJobs, JPH::uint inNumJobs)
@@ -41,39 +41,33 @@ bool model::load_dependencies()
     for (size_t i = 0; i < meshes.size(); i++)
     {
         mesh_info& info = meshes[i];
+        std::span<uint32_t> indices = info.get_indices();
 
         // Create index buffer for rendering each mesh.
-        std::vector<uint32_t> indices_32;
 #if 0
         std::vector<uint16_t> indices_16;
 #endif
 
         ri_buffer::create_params params;
-        params.element_count = info.indices.size();
+        params.element_count = indices.size();
         params.usage = ri_buffer_usage::index_buffer;
 
-        size_t max_index_value = *std::max_element(info.indices.begin(), info.indices.end());
-
         // Note: Before you enable 16bit index buffers, check out the shaders that read from the index buffer
         // indirectly (eg. the raytracing ones). They don't currently support loading 16bit values.
 #if 0
+        size_t max_index_value = *std::max_element(indices.begin(), indices.end());
         if (max_index_value >= std::numeric_limits<uint16_t>::max())
         {
 #endif
-            indices_32.reserve(info.indices.size());
-            for (uint32_t index : info.indices)
-            {
-                indices_32.push_back(static_cast<uint32_t>(index));
-            }
-
+            // Indices are already stored as 32 bit, so upload them directly rather than copying.
             params.element_size = sizeof(uint32_t);
-            params.linear_data = std::span{ (uint8_t*)indices_32.data(), indices_32.size() * sizeof(uint32_t) };
+            params.linear_data = std::span{ (uint8_t*)indices.data(), indices.size_bytes() };
 #if 0
         }
         else
         {
-            indices_16.reserve(info.indices.size());
-            for (uint32_t index : info.indices)
+            indices_16.reserve(indices.size());
+            for (uint32_t index : indices)
             {
                 indices_16.push_back(static_cast<uint16_t>(index));
             }
@@ -116,7 +110,7 @@ bool model::load_dependencies()
         stream_layout.fields.push_back({ stream_name, k_vertex_stream_runtime_types[i] });
 
         std::unique_ptr<ri_layout_factory> factory = m_renderer.get_render_interface().create_layout_factory(stream_layout, ri_layout_usage::buffer);
-        factory->add(string_hash(stream_name), stream->data, stream->element_size, ri_convert_geometry_data_type(stream->data_type));
+        factory->add(string_hash(stream_name), stream->get_data(), stream->element_size, ri_convert_geometry_data_type(stream->data_type));
 
         std::string vertex_buffer_name = string_format("Model Vertex Stream[%s]: %s", stream_name, name.c_str());
 
@@ -46,6 +46,12 @@ public:
     {
         std::string name;
         std::vector<uint32_t> indices;
+
+        // If the indices are held in the compiled model data this points to them and indices
+        // is left empty. indices_view_owner keeps the compiled data alive.
+        std::span<uint32_t> indices_view;
+        std::shared_ptr<void> indices_view_owner;
+
         std::unique_ptr<ri_buffer> index_buffer;
         std::unique_ptr<ri_raytracing_blas> blas;
 
@@ -58,6 +64,12 @@ public:
         float avg_world_area;
         float uv_density;
         aabb bounds;
+
+        // Gets the indices from whichever of indices or indices_view holds them.
+        std::span<uint32_t> get_indices()
+        {
+            return indices_view_owner ? indices_view : std::span<uint32_t>(indices);
+        }
     };
 
     struct vertex_buffer
@@ -9,7 +9,7 @@
 #include "workshop.core/filesystem/stream.h"
 #include "workshop.core/filesystem/virtual_file_system.h"
 #include "workshop.core/geometry/geometry.h"
-#include "workshop.core/utils/math_serialization.h"
+#include "workshop.core/math/math.h"
 
 #include "workshop.render_interface/ri_interface.h"
 #include "workshop.render_interface/ri_shader_compiler.h"
@@ -21,6 +21,9 @@
 
 #include "thirdparty/yamlcpp/include/yaml-cpp/yaml.h"
 
+#include <array>
+#include <limits>
+
 namespace ws {
 
 namespace {
@@ -30,50 +33,444 @@ constexpr size_t k_model_asset_descriptor_minimum_version = 1;
 constexpr size_t k_model_asset_descriptor_current_version = 1;
 
 // Bump if compiled format ever changes.
-constexpr size_t k_model_asset_compiled_version = 77;
+constexpr size_t k_model_asset_compiled_version = 81;
+
+// Compression level compiled data is stored with for each config_type. Models are left
+// uncompressed in every config so the mapped blob can be used in place, compressing them
+// would force every section to be decompressed into a copy.
+constexpr std::array<int, static_cast<int>(config_type::COUNT)> k_model_compression_levels = { 0, 0, 0 };
+
+// Compiled models are stored as a relocatable blob so they can be loaded with a single read and
+// used in place, rather than deserializing each field. All offsets are from the start of the blob
+// and all sections are aligned to k_model_blob_alignment so the index and vertex data can be
+// pointed at and uploaded directly.
+//
+// Layout:
+//      model_blob_header
+//      padding to k_model_blob_alignment, relative to the start of the file
+//      resident data:
+//          strings
+//          model_blob_material[material_count]
+//          model_blob_mesh[mesh_count]
+//          model_blob_stream[stream_count]
+//          index data for each mesh
+//          position stream data
+//      transient data:
+//          all other vertex stream data
+//
+// The resident and transient data are held in separate buffers once loaded. The indices and
+// positions are kept on the cpu for picking, the transient data is freed once its been uploaded.
+//
+// Bump k_model_asset_compiled_version if the layout changes.
+
+constexpr size_t k_model_blob_alignment = 16;
+
+static_assert(k_model_blob_alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "Loaded blob buffers need to be allocated with the blobs alignment.");
+
+struct model_blob_string
+{
+    uint64_t offset;
+    uint64_t length;
+};
+
+struct model_blob_header
+{
+    uint64_t resident_size;
+    uint64_t transient_size;
+
+    uint32_t material_count;
+    uint32_t mesh_count;
+    uint32_t stream_count;
+    uint32_t padding;
 
+    uint64_t materials_offset;
+    uint64_t meshes_offset;
+    uint64_t streams_offset;
+
+    float bounds_min[3];
+    float bounds_max[3];
 };
 
-template<>
-inline void stream_serialize(stream& out, model::material_info& mat)
+struct model_blob_material
+{
+    model_blob_string name;
+    model_blob_string file;
+};
+
+struct model_blob_mesh
+{
+    model_blob_string name;
+
+    uint64_t index_offset;
+    uint64_t index_count;
+
+    uint32_t material_index;
+    float min_texel_area;
+    float max_texel_area;
+    float avg_texel_area;
+    float min_world_area;
+    float max_world_area;
+    float avg_world_area;
+    float uv_density;
+
+    float bounds_min[3];
+    float bounds_max[3];
+};
+
+struct model_blob_stream
+{
+    uint32_t type;
+    uint32_t data_type;
+    uint64_t element_size;
+    uint64_t data_offset;
+    uint64_t data_size;
+};
+
+// Appends data to the end of a blob buffer, aligned to the blob alignment if requested.
+// Returns the offset it was written at.
+uint64_t append_blob_data(std::vector<uint8_t>& buffer, const void* data, size_t size, bool aligned)
+{
+    if (aligned)
+    {
+        buffer.resize(math::round_up_multiple(buffer.size(), k_model_blob_alignment), 0);
+    }
+
+    size_t offset = buffer.size();
+    buffer.resize(offset + size);
+    if (size > 0)
+    {
+        memcpy(buffer.data() + offset, data, size);
+    }
+
+    return offset;
+}
+
+model_blob_string append_blob_string(std::vector<uint8_t>& buffer, const std::string& value)
 {
-    stream_serialize(out, mat.name);
-    stream_serialize(out, mat.file);
+    model_blob_string result;
+    result.offset = append_blob_data(buffer, value.data(), value.size(), false);
+    result.length = value.size();
+    return result;
 }
 
-template<>
-inline void stream_serialize(stream& out, model::mesh_info& mat)
+template <typename record_type>
+uint64_t append_blob_records(std::vector<uint8_t>& buffer, const std::vector<record_type>& records)
 {
-    stream_serialize(out, mat.name);
-    stream_serialize(out, mat.bounds);
-    stream_serialize(out, mat.material_index);
+    static_assert(std::is_trivially_copyable_v<record_type>);
+    return append_blob_data(buffer, records.data(), records.size() * sizeof(record_type), true);
+}
 
-    stream_serialize(out, mat.min_texel_area);
-    stream_serialize(out, mat.max_texel_area);
-    stream_serialize(out, mat.avg_texel_area);
-    stream_serialize(out, mat.min_world_area);
-    stream_serialize(out, mat.max_world_area);
-    stream_serialize(out, mat.avg_world_area);
-    stream_serialize(out, mat.uv_density);
+template <typename record_type>
+std::span<const record_type> as_blob_records(std::span<uint8_t> data)
+{
+    return std::span<const record_type>(reinterpret_cast<const record_type*>(data.data()), data.size() / sizeof(record_type));
+}
 
-    stream_serialize_list(out, mat.indices);
+void write_blob_bounds(const aabb& bounds, float* out_min, float* out_max)
+{
+    out_min[0] = bounds.min.x;
+    out_min[1] = bounds.min.y;
+    out_min[2] = bounds.min.z;
+    out_max[0] = bounds.max.x;
+    out_max[1] = bounds.max.y;
+    out_max[2] = bounds.max.z;
 }
 
-template<>
-inline void stream_serialize(stream& out, geometry& geo)
+aabb read_blob_bounds(const float* in_min, const float* in_max)
 {
-    std::vector<geometry_vertex_stream>& streams = geo.get_vertex_streams();
+    return aabb(vector3(in_min[0], in_min[1], in_min[2]), vector3(in_max[0], in_max[1], in_max[2]));
+}
 
-    stream_serialize(out, geo.bounds);
+// Gets the number of padding bytes needed to align the given stream position to the blob alignment.
+size_t get_blob_padding(size_t position)
+{
+    return math::round_up_multiple(position, k_model_blob_alignment) - position;
+}
 
-    stream_serialize_list(out, streams, [&out](geometry_vertex_stream& stream) {
-        stream_serialize_enum(out, stream.type);
-        stream_serialize_enum(out, stream.data_type);
-        stream_serialize(out, stream.element_size);
-        stream_serialize_list(out, stream.data);
-    });
+// Reads the next size bytes from the stream into memory aligned to the blob alignment. This is
+// a view of the stream's memory if its mapped and suitably aligned, otherwise its read into a new buffer.
+bool read_blob_section(stream& in, size_t size, std::span<uint8_t>& view, std::shared_ptr<void>& owner)
+{
+    if (size == 0)
+    {
+        view = {};
+        owner = nullptr;
+        return true;
+    }
+
+    std::span<uint8_t> mapped = in.read_view(size);
+    if (!mapped.empty() && (reinterpret_cast<uintptr_t>(mapped.data()) % k_model_blob_alignment) == 0)
+    {
+        view = mapped;
+        owner = in.get_view_owner();
+        return true;
+    }
+
+    // Intentionally not value initialized, it's about to be overwritten.
+    std::shared_ptr<uint8_t[]> buffer(new uint8_t[size]);
+    if (!mapped.empty())
+    {
+        memcpy(buffer.get(), mapped.data(), size);
+    }
+    else if (in.read(reinterpret_cast<char*>(buffer.get()), size) != size)
+    {
+        return false;
+    }
+
+    view = std::span<uint8_t>(buffer.get(), size);
+    owner = buffer;
+    return true;
 }
 
+bool write_model_blob(stream& out, model& asset)
+{
+    std::vector<geometry_vertex_stream>& streams = asset.m_geometry->get_vertex_streams();
+
+    std::vector<uint8_t> resident;
+    std::vector<uint8_t> transient;
+
+    model_blob_header header = {};
+    header.material_count = static_cast<uint32_t>(asset.materials.size());
+    header.mesh_count = static_cast<uint32_t>(asset.meshes.size());
+    header.stream_count = static_cast<uint32_t>(streams.size());
+    write_blob_bounds(asset.m_geometry->bounds, header.bounds_min, header.bounds_max);
+
+    // Strings.
+    std::vector<model_blob_material> materials(asset.materials.size());
+    for (size_t i = 0; i < asset.materials.size(); i++)
+    {
+        materials[i].name = append_blob_string(resident, asset.materials[i].name);
+        materials[i].file = append_blob_string(resident, asset.materials[i].file);
+    }
+
+    std::vector<model_blob_mesh> meshes(asset.meshes.size());
+    for (size_t i = 0; i < asset.meshes.size(); i++)
+    {
+        meshes[i].name = append_blob_string(resident, asset.meshes[i].name);
+    }
+
+    // Reserve space for the tables, they are filled in once we know where the data is.
+    std::vector<model_blob_stream> stream_records(streams.size());
+    header.materials_offset = append_blob_records(resident, materials);
+    header.meshes_offset = append_blob_records(resident, meshes);
+    header.streams_offset = append_blob_records(resident, stream_records);
+
+    // Indices.
+    for (size_t i = 0; i < asset.meshes.size(); i++)
+    {
+        model::mesh_info& info = asset.meshes[i];
+        model_blob_mesh& record = meshes[i];
+
+        std::span<uint32_t> indices = info.get_indices();
+        record.index_offset = append_blob_data(resident, indices.data(), indices.size_bytes(), true);
+        record.index_count = indices.size();
+
+        record.material_index = static_cast<uint32_t>(info.material_index);
+        record.min_texel_area = info.min_texel_area;
+        record.max_texel_area = info.max_texel_area;
+        record.avg_texel_area = info.avg_texel_area;
+        record.min_world_area = info.min_world_area;
+        record.max_world_area = info.max_world_area;
+        record.avg_world_area = info.avg_world_area;
+        record.uv_density = info.uv_density;
+        write_blob_bounds(info.bounds, record.bounds_min, record.bounds_max);
+    }
+
+    // Vertex streams, the position stream is kept resident as its used for picking.
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        geometry_vertex_stream& stream = streams[i];
+        model_blob_stream& record = stream_records[i];
+
+        std::span<uint8_t> data = stream.get_data();
+
+        record.type = static_cast<uint32_t>(stream.type);
+        record.data_type = static_cast<uint32_t>(stream.data_type);
+        record.element_size = stream.element_size;
+        record.data_size = data.size();
+
+        if (stream.type == geometry_vertex_stream_type::position)
+        {
+            record.data_offset = append_blob_data(resident, data.data(), data.size(), true);
+        }
+        else
+        {
+            // Offset within the transient data, this is fixed up below.
+            record.data_offset = append_blob_data(transient, data.data(), data.size(), true);
+        }
+    }
+
+    // Pad the resident data so the transient data that follows is aligned, then make the
+    // transient offsets relative to the start of the blob.
+    resident.resize(math::round_up_multiple(resident.size(), k_model_blob_alignment), 0);
+    for (model_blob_stream& record : stream_records)
+    {
+        if (static_cast<geometry_vertex_stream_type>(record.type) != geometry_vertex_stream_type::position)
+        {
+            record.data_offset += resident.size();
+        }
+    }
+
+    memcpy(resident.data() + header.materials_offset, materials.data(), materials.size() * sizeof(model_blob_material));
+    memcpy(resident.data() + header.meshes_offset, meshes.data(), meshes.size() * sizeof(model_blob_mesh));
+    memcpy(resident.data() + header.streams_offset, stream_records.data(), stream_records.size() * sizeof(model_blob_stream));
+
+    header.resident_size = resident.size();
+    header.transient_size = transient.size();
+
+    if (out.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header))
+    {
+        return false;
+    }
+
+    // The compiled asset header before us is variable length, so pad to make sure the sections 
+    // are aligned within the file. Mapped files are page aligned so this keeps them aligned in memory.
+    std::array<uint8_t, k_model_blob_alignment> padding = {};
+    size_t padding_size = get_blob_padding(out.position());
+
+    return out.write(reinterpret_cast<const char*>(padding.data()), padding_size) == padding_size &&
+           out.write(reinterpret_cast<const char*>(resident.data()), resident.size()) == resident.size() &&
+           out.write(reinterpret_cast<const char*>(transient.data()), transient.size()) == transient.size();
+}
+
+bool read_model_blob(stream& in, model& asset, const char* path)
+{
+    model_blob_header header;
+    if (in.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header))
+    {
+        db_error(asset, "[%s] Compiled model data is truncated.", path);
+        return false;
+    }
+
+    size_t padding_size = get_blob_padding(in.position());
+    if (padding_size > in.remaining() ||
+        header.resident_size > in.remaining() - padding_size ||
+        header.transient_size > in.remaining() - padding_size - header.resident_size)
+    {
+        db_error(asset, "[%s] Compiled model data is truncated.", path);
+        return false;
+    }
+
+    in.seek(in.position() + padding_size);
+
+    std::span<uint8_t> resident;
+    std::shared_ptr<void> resident_owner;
+    std::span<uint8_t> transient;
+    std::shared_ptr<void> transient_owner;
+
+    if (!read_blob_section(in, header.resident_size, resident, resident_owner) ||
+        !read_blob_section(in, header.transient_size, transient, transient_owner))
+    {
+        db_error(asset, "[%s] Failed to read compiled model data.", path);
+        return false;
+    }
+
+    // Resolves a range of the blob to the buffer holding it.
+    bool valid = true;
+    auto resolve = [&](uint64_t offset, uint64_t size, std::shared_ptr<void>* owner) -> std::span<uint8_t> {
+        if (offset <= resident.size() && size <= resident.size() - offset)
+        {
+            if (owner) *owner = resident_owner;
+            return resident.subspan(offset, size);
+        }
+
+        uint64_t transient_offset = offset - resident.size();
+        if (offset >= resident.size() && transient_offset <= transient.size() && size <= transient.size() - transient_offset)
+        {
+            if (owner) *owner = transient_owner;
+            return transient.subspan(transient_offset, size);
+        }
+
+        valid = false;
+        return {};
+    };
+
+    // Resolves an array of elements, making sure the size of the array can't overflow.
+    auto resolve_array = [&](uint64_t offset, uint64_t count, size_t element_size, std::shared_ptr<void>* owner) -> std::span<uint8_t> {
+        if (count > std::numeric_limits<uint64_t>::max() / element_size)
+        {
+            valid = false;
+            return {};
+        }
+
+        return resolve(offset, count * element_size, owner);
+    };
+
+    auto resolve_string = [&](const model_blob_string& value) -> std::string {
+        std::span<uint8_t> data = resolve(value.offset, value.length, nullptr);
+        return std::string(reinterpret_cast<const char*>(data.data()), data.size());
+    };
+
+    std::span<const model_blob_material> materials = as_blob_records<model_blob_material>(resolve_array(header.materials_offset, header.material_count, sizeof(model_blob_material), nullptr));
+    std::span<const model_blob_mesh> meshes = as_blob_records<model_blob_mesh>(resolve_array(header.meshes_offset, header.mesh_count, sizeof(model_blob_mesh), nullptr));
+    std::span<const model_blob_stream> streams = as_blob_records<model_blob_stream>(resolve_array(header.streams_offset, header.stream_count, sizeof(model_blob_stream), nullptr));
+
+    asset.materials.resize(materials.size());
+    for (size_t i = 0; i < materials.size(); i++)
+    {
+        asset.materials[i].name = resolve_string(materials[i].name);
+        asset.materials[i].file = resolve_string(materials[i].file);
+    }
+
+    asset.meshes.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const model_blob_mesh& record = meshes[i];
+        model::mesh_info& info = asset.meshes[i];
+
+        // Meshes are rendered with materials[material_index] without any checks.
+        if (record.material_index >= materials.size())
+        {
+            valid = false;
+        }
+
+        info.name = resolve_string(record.name);
+        info.material_index = record.material_index;
+        info.min_texel_area = record.min_texel_area;
+        info.max_texel_area = record.max_texel_area;
+        info.avg_texel_area = record.avg_texel_area;
+        info.min_world_area = record.min_world_area;
+        info.max_world_area = record.max_world_area;
+        info.avg_world_area = record.avg_world_area;
+        info.uv_density = record.uv_density;
+        info.bounds = read_blob_bounds(record.bounds_min, record.bounds_max);
+
+        std::span<uint8_t> indices = resolve_array(record.index_offset, record.index_count, sizeof(uint32_t), &info.indices_view_owner);
+        info.indices_view = std::span<uint32_t>(reinterpret_cast<uint32_t*>(indices.data()), indices.size() / sizeof(uint32_t));
+    }
+
+    std::vector<geometry_vertex_stream>& geometry_streams = asset.m_geometry->get_vertex_streams();
+    geometry_streams.resize(streams.size());
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        const model_blob_stream& record = streams[i];
+        geometry_vertex_stream& stream = geometry_streams[i];
+
+        if (record.type >= static_cast<uint32_t>(geometry_vertex_stream_type::COUNT) ||
+            record.data_type >= static_cast<uint32_t>(geometry_data_type::COUNT))
+        {
+            valid = false;
+        }
+
+        stream.type = static_cast<geometry_vertex_stream_type>(record.type);
+        stream.data_type = static_cast<geometry_data_type>(record.data_type);
+        stream.element_size = record.element_size;
+        stream.data_view = resolve(record.data_offset, record.data_size, &stream.data_view_owner);
+    }
+
+    asset.m_geometry->bounds = read_blob_bounds(header.bounds_min, header.bounds_max);
+
+    if (!valid)
+    {
+        db_error(asset, "[%s] Compiled model data is corrupt.", path);
+        return false;
+    }
+
+    return true;
+}
+
+};
+
 model_loader::model_loader(ri_interface& instance, renderer& renderer, asset_manager& ass_manager)
     : m_ri_interface(instance)
     , m_renderer(renderer)
@@ -112,20 +509,13 @@ void model_loader::unload(asset* instance)
     delete instance;
 }
 
-bool model_loader::save(const char* path, model& asset)
+bool model_loader::save(const char* path, model& asset, int compression_level)
 {
-    return serialize(path, asset, true);
+    return serialize(path, asset, true, compression_level);
 }
 
-bool model_loader::serialize(const char* path, model& asset, bool isSaving)
+bool model_loader::serialize(const char* path, model& asset, bool isSaving, int compression_level)
 {
-    std::unique_ptr<stream> stream = virtual_file_system::get().open(path, isSaving);
-    if (!stream)
-    {
-        db_error(asset, "[%s] Failed to open stream to save asset.", path);
-        return false;
-    }
-
     if (!isSaving)
     {
         asset.header.type = k_model_asset_descriptor_type;
@@ -133,19 +523,34 @@ bool model_loader::serialize(const char* path, model& asset, bool isSaving)
         asset.name = path;
     }
 
-    if (!serialize_header(*stream, asset.header, path))
+    std::unique_ptr<stream> stream = open_compiled_stream(path, isSaving, asset.header, compression_level);
+    if (!stream)
     {
         return false;
     }
 
-    if (!isSaving)
+    if (isSaving)
     {
-        asset.m_geometry = std::make_unique<geometry>();
+        if (!write_model_blob(*stream, asset))
+        {
+            db_error(asset, "[%s] Failed to write compiled model data.", path);
+            return false;
+        }
+
+        if (!close_compiled_stream(*stream, path))
+        {
+            return false;
+        }
     }
+    else
+    {
+        asset.m_geometry = std::make_unique<geometry>();
 
-    stream_serialize_list(*stream, asset.materials);
-    stream_serialize_list(*stream, asset.meshes);
-    stream_serialize(*stream, *asset.m_geometry);
+        if (!read_model_blob(*stream, asset, path))
+        {
+            return false;
+        }
+    }
 
     return true;
 }
@@ -407,7 +812,7 @@ bool model_loader::compile(const char* input_path, const char* output_path, plat
     asset.header.version = k_model_asset_compiled_version;
 
     // Write binary format to disk.
-    if (!save(output_path, asset))
+    if (!save(output_path, asset, get_compression_level(asset_config)))
     {
         return false;
     }
@@ -415,6 +820,11 @@ bool model_loader::compile(const char* input_path, const char* output_path, plat
     return true;
 }
 
+int model_loader::get_compression_level(config_type asset_config)
+{
+    return k_model_compression_levels[static_cast<int>(asset_config)];
+}
+
 size_t model_loader::get_compiled_version()
 {
     return k_model_asset_compiled_version;
@@ -37,11 +37,12 @@ public:
     virtual void hot_reload(asset* instance, asset* new_instance) override;
     virtual bool can_hot_reload() override { return true; };
     virtual size_t get_compiled_version() override;
+    virtual int get_compression_level(config_type asset_config) override;
 
 private:
-    bool serialize(const char* path, model& asset, bool isSaving);
+    bool serialize(const char* path, model& asset, bool isSaving, int compression_level = 0);
 
-    bool save(const char* path, model& asset);
+    bool save(const char* path, model& asset, int compression_level = 0);
 
     bool parse_properties(const char* path, YAML::Node& node, model& asset);
     bool parse_materials(const char* path, YAML::Node& node, model& asset);
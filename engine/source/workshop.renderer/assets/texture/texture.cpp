@@ -37,7 +37,7 @@ bool texture::load_dependencies()
     params.format = ri_convert_pixmap_format(format);
     params.dimensions = dimensions;
     params.is_render_target = false;
-    params.data = data;
+    params.data = data_view.empty() ? std::span<uint8_t>(data) : data_view;
 
     if (std::max(params.width, params.height) < cvar_texture_streaming_min_dimension.get_int())
     {
@@ -87,6 +87,8 @@ bool texture::load_dependencies()
     // it to the gpu now.
     data.clear();
     data.shrink_to_fit();
+    data_view = {};
+    data_view_owner = nullptr;
 
     return true;
 }
@@ -114,6 +116,8 @@ void texture::swap(texture* other)
     std::swap(faces, other->faces);
     std::swap(mip_levels, other->mip_levels);
     std::swap(data, other->data);
+    std::swap(data_view, other->data_view);
+    std::swap(data_view_owner, other->data_view_owner);
 
     ri_instance->swap(other->ri_instance.get());
 }
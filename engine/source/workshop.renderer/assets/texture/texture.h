@@ -22,6 +22,7 @@ class asset;
 class ri_interface;
 class renderer;
 class pixmap;
+class compressed_stream_index;
 
 // ================================================================================================
 //  Defines how a texture is intended to be used. This is used to determine how
@@ -96,6 +97,11 @@ public:
     size_t mip_levels = 0;
     std::vector<uint8_t> data;
 
+    // View of the texture data. When loaded from a memory mapped file this references the
+    // mapping directly and data is left empty, data_view_owner keeps the mapping alive.
+    std::span<uint8_t> data_view;
+    std::shared_ptr<void> data_view_owner;
+
     // Only used at compile time.
     std::array<size_t, 4> swizzle = { 0, 1, 2, 3 };
     std::array<texture_channel_flags, 4> channel_flags = { texture_channel_flags::none, texture_channel_flags::none, texture_channel_flags::none, texture_channel_flags::none };
@@ -106,6 +112,10 @@ public:
     std::string async_data_path;
     size_t async_data_offset;
 
+    // If the compiled data is compressed this is used to read it, async_data_offset is then
+    // the offset into the decompressed data.
+    std::shared_ptr<compressed_stream_index> async_data_index;
+
 private:
     friend class render_texture_streamer;
 
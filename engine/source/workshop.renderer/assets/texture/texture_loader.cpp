@@ -7,6 +7,7 @@
 #include "workshop.assets/asset_cache.h"
 #include "workshop.core/filesystem/file.h"
 #include "workshop.core/filesystem/stream.h"
+#include "workshop.core/filesystem/compressed_stream.h"
 #include "workshop.core/filesystem/virtual_file_system.h"
 #include "workshop.core/drawing/pixmap.h"
 
@@ -24,7 +25,11 @@ constexpr size_t k_texture_asset_descriptor_minimum_version = 1;
 constexpr size_t k_texture_asset_descriptor_current_version = 1;
 
 // Bump if compiled format ever changes.
-constexpr size_t k_texture_asset_compiled_version = 24;
+constexpr size_t k_texture_asset_compiled_version = 26;
+
+// Compression level compiled data is stored with for each config_type. Debug and profile
+// favour compile time, release favours disk size.
+constexpr std::array<int, static_cast<int>(config_type::COUNT)> k_texture_compression_levels = { 1, 1, 6 };
 
 };
 
@@ -72,20 +77,13 @@ void texture_loader::unload(asset* instance)
     delete instance;
 }
 
-bool texture_loader::save(const char* path, texture& asset)
+bool texture_loader::save(const char* path, texture& asset, int compression_level)
 {
-    return serialize(path, asset, true);
+    return serialize(path, asset, true, compression_level);
 }
 
-bool texture_loader::serialize(const char* path, texture& asset, bool isSaving)
+bool texture_loader::serialize(const char* path, texture& asset, bool isSaving, int compression_level)
 {
-    std::unique_ptr<stream> stream = virtual_file_system::get().open(path, isSaving);
-    if (!stream)
-    {
-        db_error(asset, "[%s] Failed to open stream to save asset.", path);
-        return false;
-    }
-
     if (!isSaving)
     {
         asset.header.type = k_texture_asset_descriptor_type;
@@ -93,7 +91,8 @@ bool texture_loader::serialize(const char* path, texture& asset, bool isSaving)
         asset.name = path;
     }
 
-    if (!serialize_header(*stream, asset.header, path))
+    std::unique_ptr<stream> stream = open_compiled_stream(path, isSaving, asset.header, compression_level);
+    if (!stream)
     {
         return false;
     }
@@ -108,12 +107,33 @@ bool texture_loader::serialize(const char* path, texture& asset, bool isSaving)
     stream_serialize(*stream, asset.streamed);
     stream_serialize(*stream, asset.mip_levels);
     
-    stream_serialize_list(*stream, asset.data);
+    stream_serialize_list_view(*stream, asset.data, asset.data_view, asset.data_view_owner);
 
     if (!isSaving)
     {
-        asset.async_data_path = stream->get_async_path();
-        asset.async_data_offset = stream->get_async_offset() - asset.data.size();
+        // Compressed data is streamed in through its index, which only reads and decompresses
+        // the chunks covering the mips being requested.
+        if (compressed_stream* compressed = dynamic_cast<compressed_stream*>(stream.get()))
+        {
+            asset.async_data_index = compressed->get_index();
+            asset.async_data_path = asset.async_data_index->get_async_path();
+            asset.async_data_offset = stream->position() - asset.data_view.size();
+        }
+        else
+        {
+            asset.async_data_path = stream->get_async_path();
+            asset.async_data_offset = stream->get_async_offset() - asset.data_view.size();
+        }
+
+        // Data that doesn't exist as-is on disk (eg. compressed in an archive) can't be streamed in.
+        if (asset.async_data_path.empty())
+        {
+            asset.streamed = false;
+        }
+    }
+    else if (!close_compiled_stream(*stream, path))
+    {
+        return false;
     }
 
     return true;
@@ -740,7 +760,7 @@ bool texture_loader::compile(const char* input_path, const char* output_path, pl
     asset.header.version = k_texture_asset_compiled_version;
 
     // Write binary format to disk.
-    if (!save(output_path, asset))
+    if (!save(output_path, asset, get_compression_level(asset_config)))
     {
         return false;
     }
@@ -773,6 +793,11 @@ void texture_loader::hot_reload(asset* instance, asset* new_instance)
     old_instance_tex->swap(new_instance_tex);
 }
 
+int texture_loader::get_compression_level(config_type asset_config)
+{
+    return k_texture_compression_levels[static_cast<int>(asset_config)];
+}
+
 size_t texture_loader::get_compiled_version()
 {
     return k_texture_asset_compiled_version;
@@ -68,19 +68,10 @@ void render_pass_geometry::generate(renderer& renderer, generated_state& state_o
     // Generate command lists in parallel for chunks of batches.
     size_t worker_count = task_scheduler::get().get_worker_count(task_queue::standard);     // NOTE: This trades CPU time for GPU time. The more command lists we create the less overlapping of work the gpu can do.
     size_t chunk_size = (size_t)std::ceilf((float)batches.size() / worker_count);
-    std::atomic_size_t chunk_offset = 0;
     std::mutex output_list_mutex;
 
-    auto callback = [&chunk_offset, chunk_size, &batches, &renderer, this, &view, &state_output, &triangles_rendered, &draw_calls, &drawn_instances, &culled_instances, &output_list_mutex](size_t i) mutable
+    auto callback = [&batches, &renderer, this, &view, &state_output, &triangles_rendered, &draw_calls, &drawn_instances, &culled_instances, &output_list_mutex](const parallel_range& range) mutable
     {
-        size_t batch_start = chunk_offset.fetch_add(chunk_size);
-        size_t batch_end = std::min(batches.size(), batch_start + chunk_size);
-
-        if (batch_start >= batches.size())
-        {
-            return;
-        }
-
         ri_command_list& list = renderer.get_render_interface().get_graphics_queue().alloc_command_list();
         {
             list.open();
@@ -103,7 +94,7 @@ void render_pass_geometry::generate(renderer& renderer, generated_state& state_o
             render_visibility_manager& visibility_manager = renderer.get_visibility_manager();
 
             // Draw each batch.
-            for (size_t i = batch_start; i < batch_end; i++)
+            for (size_t i = range.begin; i < range.end; i++)
             {
                 render_batch* batch = batches[i];
                 render_batch_key key = batch->get_key();
@@ -183,10 +174,10 @@ void render_pass_geometry::generate(renderer& renderer, generated_state& state_o
 
                     // Draw everything!
                     list.set_index_buffer(*mesh_info.index_buffer);
-                    list.draw(mesh_info.indices.size(), visible_instance_count);
+                    list.draw(mesh_info.get_indices().size(), visible_instance_count);
                 }
 
-                triangles_rendered += mesh_info.indices.size() / 3;
+                triangles_rendered += mesh_info.get_indices().size() / 3;
                 draw_calls++;
             }
 
@@ -201,7 +192,7 @@ void render_pass_geometry::generate(renderer& renderer, generated_state& state_o
     };
     
     // Run callback in parallel for each chunk of batches to handle.
-    parallel_for("build geometry command lists", task_queue::standard, worker_count, callback, true);
+    parallel_for_range("build geometry command lists", task_queue::standard, 0, batches.size(), chunk_size, callback);
 
     // Command list to transition output targets back to the original format
     {
@@ -113,9 +113,9 @@ void render_pass_instanced_model::generate(renderer& renderer, generated_state&
 
             // Draw everything!
             list.set_index_buffer(*mesh_info.index_buffer);        
-            list.draw(mesh_info.indices.size(), instances.size());
+            list.draw(mesh_info.get_indices().size(), instances.size());
 
-            triangles_rendered += mesh_info.indices.size() / 3;
+            triangles_rendered += mesh_info.get_indices().size() / 3;
             draw_calls++;
         }
 
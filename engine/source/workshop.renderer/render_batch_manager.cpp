@@ -62,6 +62,20 @@ void render_batch::remove_instance(const render_batch_instance& instance)
 render_batch_manager::render_batch_manager(renderer& render)
     : m_renderer(render)
 {
+    if (memory_budgets* budgets = memory_budgets::try_get())
+    {
+        m_memory_pressure_delegate = budgets->on_pressure.add_shared([this](const memory_budgets::budget_state& state) {
+            if (state.pressure != memory_pressure::none && state.contains(memory_type::rendering__vram__generic_buffer))
+            {
+                m_trim_requested = true;
+            }
+        });
+    }
+}
+
+render_batch_manager::~render_batch_manager()
+{
+    m_memory_pressure_delegate = nullptr;
 }
 
 void render_batch_manager::register_init(init_list& list)
@@ -87,6 +101,13 @@ render_batch* render_batch_manager::find_or_create_batch(render_batch_key key)
 
 void render_batch_manager::begin_frame()
 {
+    if (m_trim_requested.exchange(false))
+    {
+        for (auto& [key, batch] : m_batches)
+        {
+            batch->get_resource_cache().trim();
+        }
+    }
 }
 
 void render_batch_manager::register_instance(const render_batch_instance& instance)
@@ -12,6 +12,7 @@
 #include "workshop.renderer/render_resource_cache.h"
 #include "workshop.renderer/render_visibility_manager.h"
 #include "workshop.render_interface/ri_param_block.h"
+#include "workshop.core/memory/memory_budgets.h"
 
 #include <unordered_map>
 #include <string>
@@ -163,6 +164,7 @@ class render_batch_manager
 public:
 
     render_batch_manager(renderer& render);
+    ~render_batch_manager();
 
     // Registers all the steps required to initialize the system.
     void register_init(init_list& list);
@@ -193,6 +195,12 @@ private:
 
     std::unordered_map<render_batch_key, std::unique_ptr<render_batch>> m_batches;
 
+    // Set when the buffer memory budget is under pressure, resource caches are trimmed
+    // at the start of the next frame when the gpu is no longer using them.
+    std::atomic_bool m_trim_requested = false;
+
+    event<const memory_budgets::budget_state&>::delegate_ptr m_memory_pressure_delegate;
+
 };
 
 }; // namespace ws
@@ -9,8 +9,8 @@
 
 namespace ws {
     
-render_command_queue::render_command_queue(renderer& render, size_t capacity)
-    : command_queue(capacity)
+render_command_queue::render_command_queue(renderer& render, size_t chunk_size)
+    : command_queue("renderer", chunk_size)
     , m_renderer(render)
 {
 }
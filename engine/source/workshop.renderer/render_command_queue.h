@@ -51,7 +51,7 @@ static inline constexpr render_object_id null_render_object = 0;
 class render_command_queue : public command_queue
 {
 public:
-    render_command_queue(renderer& render, size_t capacity);
+    render_command_queue(renderer& render, size_t chunk_size);
 
 public:
 
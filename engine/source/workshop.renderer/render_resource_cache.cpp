@@ -94,9 +94,28 @@ void render_batch_instance_buffer::commit()
         }
     }
 
+    buf.last_slots_in_use = buf.slots_in_use;
     buf.slots_in_use = 0;
 }
 
+void render_batch_instance_buffer::trim()
+{
+    buffer& buf = get_internal_buffer();
+
+    size_t required_size = std::max(k_min_slot_count, buf.last_slots_in_use);
+    if (buf.buffer == nullptr || buf.buffer->get_element_count() <= required_size)
+    {
+        return;
+    }
+
+    // Drop the backing storage, it will be recreated at the smaller size on the next commit.
+    buf.slots.resize(buf.last_slots_in_use);
+    buf.slots.shrink_to_fit();
+    buf.buffer = nullptr;
+
+    resize(buf, buf.last_slots_in_use, true);
+}
+
 size_t render_batch_instance_buffer::size()
 {
     return get_internal_buffer().slots.size();
@@ -264,4 +283,14 @@ void render_resource_cache::clear()
     m_untyped_values.clear();
 }
 
+void render_resource_cache::trim()
+{
+    std::scoped_lock lock(m_mutex);
+
+    for (auto& [key, instance] : m_instance_buffers)
+    {
+        instance.buffer->trim();
+    }
+}
+
 }; // namespace ws
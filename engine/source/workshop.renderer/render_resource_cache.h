@@ -34,6 +34,10 @@ public:
     size_t size();
     size_t capacity();
 
+    // Shrinks the buffer used by the current frame down to what was needed the last time
+    // it was committed, releasing any slack left over from earlier growth.
+    void trim();
+
     ri_buffer& get_buffer();
 
 private:
@@ -49,6 +53,7 @@ private:
         std::unique_ptr<ri_buffer> buffer;
         std::vector<slot> slots;
         size_t slots_in_use;
+        size_t last_slots_in_use = 0;
     };
 
     buffer& get_internal_buffer();
@@ -122,6 +127,9 @@ public:
     // Clears all data from the cache.
     void clear();
 
+    // Releases any excess memory held by the cached resources without invalidating them.
+    void trim();
+
 public:
     renderer& m_renderer;
 
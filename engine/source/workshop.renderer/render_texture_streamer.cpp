@@ -12,6 +12,7 @@
 
 #include "workshop.core/perf/profile.h"
 #include "workshop.core/filesystem/virtual_file_system.h"
+#include "workshop.core/filesystem/compressed_stream.h"
 #include "workshop.core/memory/memory_tracker.h"
 
 #include "workshop.core/math/plane.h"
@@ -23,10 +24,34 @@ namespace ws {
 render_texture_streamer::render_texture_streamer(renderer& renderer)
     : m_renderer(renderer)
 {
+    // Drop mips from everything while textures are over budget, the streamer will
+    // release the excess the next time it updates.
+    if (memory_budgets* budgets = memory_budgets::try_get())
+    {
+        m_memory_pressure_delegate = budgets->on_pressure.add_shared([this](const memory_budgets::budget_state& state) {
+            if (!state.contains(memory_type::rendering__vram__texture))
+            {
+                return;
+            }
+
+            int bias = 0;
+            if (state.pressure == memory_pressure::hard)
+            {
+                bias = -2;
+            }
+            else if (state.pressure == memory_pressure::soft)
+            {
+                bias = -1;
+            }
+            m_budget_mip_bias.store(bias);
+        });
+    }
 }
 
 render_texture_streamer::~render_texture_streamer()
 {
+    m_memory_pressure_delegate = nullptr;
+
     if (m_async_update_task.is_valid())
     {
         m_async_update_task.wait(true);
@@ -448,7 +473,7 @@ size_t render_texture_streamer::calculate_ideal_mip_count(const texture_bounds&
     float ideal_mip_float = 0.5f * log2(screen_space_area / uv_density);
                                                                                     // The -1 is because the algorithm we use overestimates the texture usage
                                                                                     // this brings it down to a more accurate value.
-    size_t ideal_mip_count = (size_t)std::clamp((int)std::truncf(ideal_mip_float) - 1 + cvar_texture_streaming_mip_bias.get(), 0, (int)mip_count);
+    size_t ideal_mip_count = (size_t)std::clamp((int)std::truncf(ideal_mip_float) - 1 + cvar_texture_streaming_mip_bias.get() + m_budget_mip_bias.load(), 0, (int)mip_count);
 
     // Clamp to minimum and maximum mip bounds.
     ideal_mip_count = std::clamp(
@@ -544,12 +569,27 @@ void render_texture_streamer::start_upgrade(texture_streaming_info& streaming_in
 
             texture_mip_request& request = streaming_info.mip_requests.emplace_back();
             request.mip_index = mip_index;
-            request.async_request = async_io_manager::get().request(
-                streaming_info.instance->async_data_path.c_str(),
-                streaming_info.instance->async_data_offset + mip_data_offset,
-                mip_data_size,
-                async_io_request_options::none
-            );
+
+            async_io_request_priority priority = streaming_info.locked_count > 0 ? async_io_request_priority::high : async_io_request_priority::normal;
+
+            if (streaming_info.instance->async_data_index)
+            {
+                request.async_request = streaming_info.instance->async_data_index->request_async(
+                    streaming_info.instance->async_data_offset + mip_data_offset,
+                    mip_data_size,
+                    priority
+                );
+            }
+            else
+            {
+                request.async_request = async_io_manager::get().request(
+                    streaming_info.instance->async_data_path.c_str(),
+                    streaming_info.instance->async_data_offset + mip_data_offset,
+                    mip_data_size,
+                    async_io_request_options::none,
+                    priority
+                );
+            }
 
             // Only stream in the first mip thats required, we do each mip individually to allow the streamer to spread
             // memory across all textures that want to upgrade evenly, rather than just whatever large textures tries to load
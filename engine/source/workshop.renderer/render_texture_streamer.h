@@ -9,6 +9,7 @@
 #include "workshop.core/async/task_scheduler.h"
 #include "workshop.core/math/obb.h"
 #include "workshop.core/filesystem/async_io_manager.h"
+#include "workshop.core/memory/memory_budgets.h"
 #include "workshop.render_interface/ri_staging_buffer.h"
 
 #include <shared_mutex>
@@ -206,6 +207,11 @@ private:
     std::unordered_map<texture*, std::shared_ptr<texture_streaming_info>> m_streaming_textures;
 
     bool m_pool_overcomitted = false;
+
+    // Extra mip bias applied while the texture memory budget is under pressure.
+    std::atomic_int m_budget_mip_bias = 0;
+
+    event<const memory_budgets::budget_state&>::delegate_ptr m_memory_pressure_delegate;
 };
 
 }; // namespace ws
@@ -80,7 +80,7 @@ renderer::renderer(ri_interface& rhi, input_interface& input, window& main_windo
 {
     for (size_t i = 0; i < k_frame_depth; i++)
     {
-        m_command_queues[i] = std::make_unique<render_command_queue>(*this, k_command_queue_size);
+        m_command_queues[i] = std::make_unique<render_command_queue>(*this, k_command_queue_chunk_size);
     }
 }
 
@@ -146,6 +146,7 @@ result<void> renderer::create_systems(init_list& list)
     m_systems.push_back(std::make_unique<render_system_debug>(*this));
     m_systems.push_back(std::make_unique<render_system_selection_outline>(*this));
     m_systems.push_back(std::make_unique<render_system_imgui>(*this));
+    m_system_graph_dirty = true;
 
     for (auto& system : m_systems)
     {
@@ -157,7 +158,9 @@ result<void> renderer::create_systems(init_list& list)
 
 result<void> renderer::destroy_systems()
 {
+    m_system_graph.clear();
     m_systems.clear();
+    m_system_graph_dirty = true;
 
     return true;
 }
@@ -701,41 +704,14 @@ void renderer::render_state(render_world_state& state)
     }
 
     // Update all systems in parallel.
-    task_scheduler& scheduler = task_scheduler::get();
-    std::vector<task_handle> step_tasks;
-    step_tasks.resize(m_systems.size());
-
-    // Create tasks for stepping each system.
-    for (size_t i = 0; i < m_systems.size(); i++)
+    if (m_system_graph_dirty)
     {
-        auto& system = m_systems[i];
-
-        step_tasks[i] = scheduler.create_task(system->name.c_str(), task_queue::standard, [this, &state, i]() {
-            profile_marker(profile_colors::render, "step render system: %s", m_systems[i]->name.c_str());
-            m_systems[i]->step(state);
-        });
+        build_system_graph();
     }
 
-    // Add dependencies between the tasks.
-    for (size_t i = 0; i < m_systems.size(); i++)
-    {
-        auto& system = m_systems[i];
-
-        for (render_system* dependency : system->get_dependencies())
-        {
-            auto iter = std::find_if(m_systems.begin(), m_systems.end(), [dependency](auto& system) {
-                return system.get() == dependency;
-            });
-            db_assert(iter != m_systems.end());
-
-            size_t dependency_index = std::distance(m_systems.begin(), iter);
-            step_tasks[i].add_dependency(step_tasks[dependency_index]);
-        }
-    }
-
-    // Dispatch and away for completion.
-    scheduler.dispatch_tasks(step_tasks);
-    scheduler.wait_for_tasks(step_tasks, true);
+    m_system_step_state = &state;
+    m_system_graph.execute(true);
+    m_system_step_state = nullptr;
 
     // Begin the new frame.
     m_render_interface.begin_frame();
@@ -1023,6 +999,44 @@ void renderer::render_post_views(render_world_state& state, std::vector<render_p
     });
 }
 
+void renderer::build_system_graph()
+{
+    m_system_graph.clear();
+
+    // Create nodes for stepping each system.
+    for (size_t i = 0; i < m_systems.size(); i++)
+    {
+        m_system_graph.add_node(m_systems[i]->name.c_str(), [this, i]() {
+            profile_marker(profile_colors::render, "step render system: %s", m_systems[i]->name.c_str());
+            m_systems[i]->step(*m_system_step_state);
+        });
+    }
+
+    // Add dependencies between the nodes.
+    for (size_t i = 0; i < m_systems.size(); i++)
+    {
+        auto& system = m_systems[i];
+
+        for (render_system* dependency : system->get_dependencies())
+        {
+            auto iter = std::find_if(m_systems.begin(), m_systems.end(), [dependency](auto& system) {
+                return system.get() == dependency;
+            });
+            db_assert(iter != m_systems.end());
+
+            size_t dependency_index = std::distance(m_systems.begin(), iter);
+            m_system_graph.add_dependency(i, dependency_index);
+        }
+    }
+
+    if (!m_system_graph.compile())
+    {
+        db_fatal(renderer, "Dependencies between render systems contain a cycle.");
+    }
+
+    m_system_graph_dirty = false;
+}
+
 void renderer::render_job()
 {
     std::unique_ptr<render_world_state> state;
@@ -1094,7 +1108,7 @@ void renderer::step(std::unique_ptr<render_world_state>&& state)
     // If previous render job has finished, start a new one.
     if (start_new_render_job)
     {
-        m_render_job_task = async("Render Job", task_queue::standard, [this]() {
+        m_render_job_task = async("Render Job", task_queue::standard, task_priority::critical, [this]() {
             render_job();
         });
     }
@@ -6,6 +6,7 @@
 
 #include "workshop.core/utils/init_list.h"
 #include "workshop.core/async/task_scheduler.h"
+#include "workshop.core/async/task_graph.h"
 #include "workshop.core/reflection/reflect.h"
 
 #include "workshop.renderer/render_system.h"
@@ -197,6 +198,11 @@ public:
     // Registers all the steps required to initialize the renderer.
     void register_init(init_list& list);
 
+    // Registers the renderers asset loaders with the asset manager. This is done as part of
+    // register_init, tools that only compile assets can call it without initializing the renderer.
+    result<void> register_asset_loaders();
+    result<void> unregister_asset_loaders();
+
     // Takes the world state and dispatches a new render task which
     // will draw the state to screen.
     void step(std::unique_ptr<render_world_state>&& state);
@@ -352,9 +358,6 @@ private:
     result<void> create_managers(init_list& list);
     result<void> destroy_managers();
 
-    result<void> register_asset_loaders();
-    result<void> unregister_asset_loaders();
-
     result<void> recreate_resizable_targets();
 
     result<void> create_statistics();
@@ -378,6 +381,9 @@ private:
     // Renders all post-view work.
     void render_post_views(render_world_state& state, std::vector<render_pass::generated_state>& output);
 
+    // Builds the task graph used to step all render systems.
+    void build_system_graph();
+
     // Runs all callbacks that have been queued.
     void run_callbacks();
 
@@ -395,8 +401,8 @@ private:
     // How many frames can be in the pipeline at a given time.
     constexpr static inline size_t k_frame_depth = 3;
 
-    // How much data we need to store in each command queue per frame.
-    constexpr static inline size_t k_command_queue_size = 16'000'000;
+    // Size of each chunk of the command queues, the queues grow by this much whenever they fill up.
+    constexpr static inline size_t k_command_queue_chunk_size = 1 * 1024 * 1024;
 
     ri_interface& m_render_interface;
     input_interface& m_input_interface;
@@ -405,6 +411,12 @@ private:
     
     std::vector<std::unique_ptr<render_system>> m_systems;
 
+    // Graph with a node for stepping each system, executed each frame. Rebuilt before the next
+    // frame whenever m_systems changes.
+    task_graph m_system_graph { task_queue::standard, task_priority::critical };
+    bool m_system_graph_dirty = true;
+    render_world_state* m_system_step_state = nullptr;
+
     std::unique_ptr<render_param_block_manager> m_param_block_manager;
     std::unique_ptr<render_effect_manager> m_effect_manager;
     std::unique_ptr<render_scene_manager> m_scene_manager;
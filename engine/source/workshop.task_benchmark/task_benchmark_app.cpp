@@ -0,0 +1,224 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#include "workshop.task_benchmark/task_benchmark_app.h"
+#include "workshop.core/filesystem/file.h"
+#include "workshop.core/containers/string.h"
+#include "workshop.core/utils/time.h"
+#include "workshop.core/debug/debug.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+std::shared_ptr<ws::app> make_app()
+{
+    return std::make_shared<ws::task_benchmark_app>();
+}
+
+namespace ws {
+
+namespace {
+
+// Captures a pointer and three values, about what most tasks in the engine capture. This fits
+// in task_function's inline storage.
+auto make_small_work(std::atomic_size_t* counter, size_t seed)
+{
+    return [counter, a = seed, b = seed * 3, c = seed * 7]() {
+        counter->fetch_add(a ^ b ^ c, std::memory_order_relaxed);
+    };
+}
+
+// Too large for task_function's inline storage, so is boxed on the heap.
+auto make_large_work(std::atomic_size_t* counter, size_t seed)
+{
+    std::array<size_t, 8> values;
+    values.fill(seed);
+    return [counter, values]() {
+        counter->fetch_add(values[0] ^ values[7], std::memory_order_relaxed);
+    };
+}
+
+static_assert(task_scheduler::task_function::fits_inline<decltype(make_small_work(nullptr, 0))>());
+static_assert(!task_scheduler::task_function::fits_inline<decltype(make_large_work(nullptr, 0))>());
+
+}; // namespace
+
+std::string task_benchmark_app::get_name()
+{
+    return "task_benchmark";
+}
+
+result<void> task_benchmark_app::parse_command_line()
+{
+    const std::vector<std::string>& args = get_command_line();
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        const std::string& arg = args[i];
+        bool has_value = (i + 1 < args.size());
+
+        if (arg == "-tasks" && has_value)
+        {
+            result<uint64_t> value = from_string<uint64_t>(args[++i]);
+            if (!value || value.get() == 0)
+            {
+                db_error(core, "Invalid task count: %s", args[i].c_str());
+                return standard_errors::invalid_parameter;
+            }
+            m_task_count = static_cast<size_t>(value.get());
+        }
+        else if (arg == "-workers" && has_value)
+        {
+            result<uint64_t> value = from_string<uint64_t>(args[++i]);
+            if (!value || value.get() == 0)
+            {
+                db_error(core, "Invalid worker count: %s", args[i].c_str());
+                return standard_errors::invalid_parameter;
+            }
+            m_worker_count = static_cast<size_t>(value.get());
+        }
+        else
+        {
+            db_error(core, "Unknown argument: %s", arg.c_str());
+            db_error(core, "Usage: workshop.task_benchmark [-tasks <count>] [-workers <count>]");
+            return standard_errors::invalid_parameter;
+        }
+    }
+
+    if (m_worker_count == 0)
+    {
+        m_worker_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    return true;
+}
+
+result<void> task_benchmark_app::start()
+{
+    return parse_command_line();
+}
+
+result<void> task_benchmark_app::stop()
+{
+    m_task_scheduler = nullptr;
+
+    return true;
+}
+
+void task_benchmark_app::run_scenarios(bool use_work_stealing)
+{
+    task_scheduler::init_state init_state;
+    init_state.worker_count = m_worker_count;
+    init_state.use_work_stealing = use_work_stealing;
+    init_state.queue_weights.fill(1.0f);
+    m_task_scheduler = std::make_unique<task_scheduler>(init_state);
+
+    db_log(core, "");
+    db_log(core, "Work stealing %s:", use_work_stealing ? "enabled" : "disabled");
+
+    // Runs the given scenario, which should return the number of tasks it ran, and logs the
+    // throughput along with how the scheduler distributed the work.
+    auto measure = [this](const char* name, const std::function<size_t()>& scenario) {
+        task_scheduler::statistics start_stats = m_task_scheduler->get_statistics();
+        double start_time = get_seconds();
+
+        size_t task_count = scenario();
+
+        double elapsed = get_seconds() - start_time;
+        task_scheduler::statistics end_stats = m_task_scheduler->get_statistics();
+
+        db_log(core, "  %-30s %.3f s, %.2f M tasks/s, %zi steals, %zi boxed",
+            name,
+            elapsed,
+            elapsed > 0.0 ? (task_count / 1'000'000.0) / elapsed : 0.0,
+            end_stats.steals - start_stats.steals,
+            end_stats.boxed_tasks - start_stats.boxed_tasks);
+    };
+
+    // Creates, dispatches and waits for batches of independent tasks from the main thread.
+    auto run_batches = [this](auto& make_work, size_t batch_size) {
+        std::atomic_size_t counter = 0;
+        size_t batch_count = std::max(size_t(1), m_task_count / batch_size);
+
+        for (size_t i = 0; i < batch_count; i++)
+        {
+            std::vector<task_handle> handles = m_task_scheduler->create_tasks(batch_size, "benchmark task", task_queue::standard, make_work(&counter, i));
+            m_task_scheduler->dispatch_tasks(handles);
+            m_task_scheduler->wait_for_tasks(handles, true);
+        }
+
+        return batch_count * batch_size;
+    };
+
+    for (size_t batch_size : { size_t(1), size_t(64), size_t(1024) })
+    {
+        measure(string_format("inline work, batch %zi:", batch_size).c_str(), [&]() { return run_batches(make_small_work, batch_size); });
+        measure(string_format("boxed work, batch %zi:", batch_size).c_str(), [&]() { return run_batches(make_large_work, batch_size); });
+    }
+
+    // Each batch fans out from a single root task, so every task has a dependency to resolve.
+    measure("fan out, batch 64:", [this]() {
+        constexpr size_t k_batch_size = 64;
+
+        std::atomic_size_t counter = 0;
+        size_t batch_count = std::max(size_t(1), m_task_count / k_batch_size);
+
+        for (size_t i = 0; i < batch_count; i++)
+        {
+            task_handle root = m_task_scheduler->create_task("benchmark root", task_queue::standard, make_small_work(&counter, i));
+
+            std::vector<task_handle> handles = m_task_scheduler->create_tasks(k_batch_size - 1, "benchmark task", task_queue::standard, make_small_work(&counter, i));
+            for (task_handle& handle : handles)
+            {
+                handle.add_dependency(root);
+            }
+
+            handles.push_back(root);
+            m_task_scheduler->dispatch_tasks(handles);
+            m_task_scheduler->wait_for_tasks(handles, true);
+        }
+
+        return batch_count * k_batch_size;
+    });
+
+    // Tasks running on workers spawn and wait on their own batches, which is how parallel_for
+    // and most nested work behaves. Tasks dispatched from workers go to their local deques.
+    measure("nested, batch 64:", [this]() {
+        constexpr size_t k_batch_size = 64;
+
+        std::atomic_size_t counter = 0;
+        size_t iterations = std::max(size_t(1), m_task_count / (m_worker_count * k_batch_size));
+
+        std::vector<task_handle> outer = m_task_scheduler->create_tasks(m_worker_count, "benchmark outer task", task_queue::standard, [this, &counter, iterations]() {
+            for (size_t i = 0; i < iterations; i++)
+            {
+                std::vector<task_handle> inner = m_task_scheduler->create_tasks(k_batch_size, "benchmark task", task_queue::standard, make_small_work(&counter, i));
+                m_task_scheduler->dispatch_tasks(inner);
+                m_task_scheduler->wait_for_tasks(inner, true);
+            }
+        });
+        m_task_scheduler->dispatch_tasks(outer);
+        m_task_scheduler->wait_for_tasks(outer, true);
+
+        return m_worker_count * iterations * k_batch_size;
+    });
+
+    m_task_scheduler = nullptr;
+}
+
+result<void> task_benchmark_app::loop()
+{
+    db_log(core, "Running %zi tasks per scenario on %zi workers.", m_task_count, m_worker_count);
+
+    run_scenarios(true);
+    run_scenarios(false);
+
+    return true;
+}
+
+}; // namespace ws
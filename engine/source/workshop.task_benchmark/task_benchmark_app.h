@@ -0,0 +1,50 @@
+// ================================================================================================
+//  workshop
+//  Copyright (C) 2021 Tim Leonard
+// ================================================================================================
+#pragma once
+
+#include "workshop.core/app/app.h"
+#include "workshop.core/async/task_scheduler.h"
+
+#include <memory>
+#include <string>
+
+namespace ws {
+
+// ================================================================================================
+//  Benchmarks the task_scheduler by measuring how many tasks per second can be created,
+//  dispatched, run and waited on through it. 
+//
+//  Each scenario is run with work stealing enabled and disabled, with work small enough to
+//  be stored inline in a task and work large enough that it has to be boxed on the heap.
+//
+//  Usage: workshop.task_benchmark [-tasks <count>] [-workers <count>]
+// ================================================================================================
+class task_benchmark_app : public app
+{
+public:
+    virtual std::string get_name() override;
+
+protected:
+    virtual result<void> start() override;
+    virtual result<void> loop() override;
+    virtual result<void> stop() override;
+
+private:
+
+    result<void> parse_command_line();
+
+    // Runs every scenario against a scheduler created with the given settings.
+    void run_scenarios(bool use_work_stealing);
+
+private:
+
+    size_t m_task_count = 1'000'000;
+    size_t m_worker_count = 0;
+
+    std::unique_ptr<task_scheduler> m_task_scheduler;
+
+};
+
+}; // namespace ws